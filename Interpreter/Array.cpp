@@ -0,0 +1,382 @@
+
+#include "Array.h"
+
+#include <algorithm>
+
+namespace {
+
+// how far past its end the list of an array will grow to take a new key
+constexpr size_t MinListGrowth = 16;
+
+/**
+ * @brief listIndex
+ * @param key
+ * @param index
+ * @return true if "key" is the way a non-negative integer is written as a
+ * string, without leading zeros, in which case that integer is stored in
+ * "index"
+ */
+bool listIndex(const std::string &key, size_t *index) {
+
+	if (key.empty() || key.size() > 9 || (key[0] == '0' && key.size() != 1)) {
+		return false;
+	}
+
+	size_t n = 0;
+	for (char ch : key) {
+		if (ch < '0' || ch > '9') {
+			return false;
+		}
+
+		n = (n * 10) + static_cast<size_t>(ch - '0');
+	}
+
+	*index = n;
+	return true;
+}
+
+/**
+ * @brief appendListKeys
+ * @param list
+ * @param index
+ * @param keys
+ *
+ * Appends the keys of "list" which start with the digits of "index", in
+ * string order, which is that of a depth first walk of the decimal digits
+ */
+void appendListKeys(const std::vector<boost::optional<DataValue>> &list, size_t index, std::vector<std::string> *keys) {
+
+	if (list[index]) {
+		keys->push_back(std::to_string(index));
+	}
+
+	for (size_t digit = 0; digit < 10; ++digit) {
+		const size_t next = (index * 10) + digit;
+		if (next >= list.size()) {
+			break;
+		}
+
+		appendListKeys(list, next, keys);
+	}
+}
+
+}
+
+/**
+ * @brief Array::Array
+ */
+Array::Array()
+	: storage_(std::make_shared<Storage>()) {
+}
+
+/**
+ * @brief Array::find
+ * @param key
+ * @return the value of "key", or nullptr if it isn't in the array
+ */
+const DataValue *Array::find(const std::string &key) const {
+
+	size_t index;
+	if (listIndex(key, &index) && index < storage_->list.size()) {
+		const boost::optional<DataValue> &value = storage_->list[index];
+		return value ? &*value : nullptr;
+	}
+
+	auto it = storage_->table.find(key);
+	if (it != storage_->table.end()) {
+		return &it->second;
+	}
+
+	return nullptr;
+}
+
+/**
+ * @brief Array::find
+ * @param key
+ * @return the value of "key", or nullptr if it isn't in the array
+ */
+const DataValue *Array::find(int64_t key) const {
+
+	if (key >= 0 && static_cast<size_t>(key) < storage_->list.size()) {
+		const boost::optional<DataValue> &value = storage_->list[static_cast<size_t>(key)];
+		return value ? &*value : nullptr;
+	}
+
+	if (storage_->table.empty()) {
+		return nullptr;
+	}
+
+	auto it = storage_->table.find(std::to_string(key));
+	if (it != storage_->table.end()) {
+		return &it->second;
+	}
+
+	return nullptr;
+}
+
+/**
+ * @brief Array::getValue
+ * @param key
+ * @param value
+ * @return true if "key" was found, and its value copied to "value"
+ *
+ * An array fetched from this one can be modified through the copy, so if it
+ * is shared with a copy of this array, this one gets its own first
+ */
+template <class Key>
+bool Array::getValue(const Key &key, DataValue *value) {
+
+	const DataValue *found = find(key);
+	if (found && is_array(*found) && storage_.use_count() > 1) {
+		detach();
+		found = find(key);
+	}
+
+	if (!found) {
+		return false;
+	}
+
+	*value = *found;
+	return true;
+}
+
+/**
+ * @brief Array::get
+ * @param key
+ * @param value
+ * @return
+ */
+bool Array::get(const std::string &key, DataValue *value) {
+	return getValue(key, value);
+}
+
+/**
+ * @brief Array::get
+ * @param key
+ * @param value
+ * @return
+ */
+bool Array::get(int64_t key, DataValue *value) {
+	return getValue(key, value);
+}
+
+/**
+ * @brief Array::size
+ * @return
+ */
+size_t Array::size() const noexcept {
+	return storage_->listCount + storage_->table.size();
+}
+
+/**
+ * @brief Array::keys
+ * @return all of the keys of the array, in sorted order
+ */
+std::shared_ptr<const Array::Keys> Array::keys() const {
+
+	if (!storage_->keys) {
+		const std::vector<boost::optional<DataValue>> &list = storage_->list;
+
+		auto keys = std::make_shared<Keys>();
+		keys->reserve(size());
+
+		// the list keys are generated in order, so only those of the table need sorting
+		if (!list.empty() && list[0]) {
+			keys->emplace_back("0");
+		}
+
+		for (size_t digit = 1; digit < 10 && digit < list.size(); ++digit) {
+			appendListKeys(list, digit, keys.get());
+		}
+
+		const auto listEnd = keys->size();
+
+		for (const auto &entry : storage_->table) {
+			keys->push_back(entry.first);
+		}
+
+		std::sort(keys->begin() + static_cast<ptrdiff_t>(listEnd), keys->end());
+		std::inplace_merge(keys->begin(), keys->begin() + static_cast<ptrdiff_t>(listEnd), keys->end());
+		storage_->keys = std::move(keys);
+	}
+
+	return storage_->keys;
+}
+
+/**
+ * @brief Array::clear
+ */
+void Array::clear() {
+	if (size() != 0) {
+		storage_ = std::make_shared<Storage>();
+	}
+}
+
+/**
+ * @brief Array::erase
+ * @param key
+ */
+void Array::erase(const std::string &key) {
+
+	size_t index;
+	if (listIndex(key, &index) && index < storage_->list.size()) {
+		if (!storage_->list[index]) {
+			return;
+		}
+
+		detach();
+		storage_->list[index] = boost::none;
+		--storage_->listCount;
+		storage_->keys = nullptr;
+		return;
+	}
+
+	if (storage_->table.find(key) == storage_->table.end()) {
+		return;
+	}
+
+	detach();
+	storage_->table.erase(key);
+	storage_->keys = nullptr;
+}
+
+/**
+ * @brief Array::insert
+ * @param key
+ * @param value
+ *
+ * Sets the value of "key", adding it to the array if it isn't already there
+ */
+void Array::insert(const std::string &key, DataValue value) {
+
+	detach();
+
+	size_t index;
+	if (listIndex(key, &index) && growList(index)) {
+		insertInList(index, std::move(value));
+	} else {
+		insertInTable(key, std::move(value));
+	}
+}
+
+/**
+ * @brief Array::insert
+ * @param key
+ * @param value
+ *
+ * Sets the value of "key", adding it to the array if it isn't already there
+ */
+void Array::insert(int64_t key, DataValue value) {
+
+	detach();
+
+	if (key >= 0 && growList(static_cast<size_t>(key))) {
+		insertInList(static_cast<size_t>(key), std::move(value));
+	} else {
+		insertInTable(std::to_string(key), std::move(value));
+	}
+}
+
+/**
+ * @brief Array::insertInList
+ * @param index
+ * @param value
+ */
+void Array::insertInList(size_t index, DataValue value) {
+
+	boost::optional<DataValue> &slot = storage_->list[index];
+	if (!slot) {
+		++storage_->listCount;
+		storage_->keys = nullptr;
+	}
+
+	slot = std::move(value);
+}
+
+/**
+ * @brief Array::insertInTable
+ * @param key
+ * @param value
+ */
+void Array::insertInTable(std::string key, DataValue value) {
+
+	auto it = storage_->table.find(key);
+	if (it != storage_->table.end()) {
+		it->second = std::move(value);
+		return;
+	}
+
+	storage_->table.emplace(std::move(key), std::move(value));
+	storage_->keys = nullptr;
+}
+
+/**
+ * @brief Array::growList
+ * @param index
+ * @return true if the list of the array covers "index", growing it if needed.
+ * It only grows to take keys close to those already in it, so that a few
+ * large keys don't use up lots of memory
+ */
+bool Array::growList(size_t index) {
+
+	std::vector<boost::optional<DataValue>> &list = storage_->list;
+
+	if (index < list.size()) {
+		return true;
+	}
+
+	if (index > list.size() * 2 + MinListGrowth) {
+		return false;
+	}
+
+	const size_t oldSize = list.size();
+	list.resize(index + 1);
+
+	// keys which the list now covers can't stay in the table
+	if (!storage_->table.empty()) {
+		for (size_t i = oldSize; i < list.size(); ++i) {
+			auto it = storage_->table.find(std::to_string(i));
+			if (it != storage_->table.end()) {
+				list[i] = std::move(it->second);
+				++storage_->listCount;
+				storage_->table.erase(it);
+			}
+		}
+	}
+
+	return true;
+}
+
+/**
+ * @brief Array::detach
+ *
+ * Makes sure that this array's contents aren't shared with any copy of it,
+ * so that they can be modified
+ */
+void Array::detach() {
+
+	if (storage_.use_count() == 1) {
+		return;
+	}
+
+	auto storage = std::make_shared<Storage>(*storage_);
+
+	// the arrays held in this one are still shared with the original
+	auto copyArray = [](DataValue &value) {
+		if (is_array(value)) {
+			value = make_value(std::make_shared<Array>(*to_array(value)));
+		}
+	};
+
+	for (boost::optional<DataValue> &value : storage->list) {
+		if (value) {
+			copyArray(*value);
+		}
+	}
+
+	for (auto &entry : storage->table) {
+		copyArray(entry.second);
+	}
+
+	storage_ = std::move(storage);
+}
@@ -0,0 +1,90 @@
+
+#ifndef ARRAY_H_
+#define ARRAY_H_
+
+#include "DataValue.h"
+
+#include <boost/optional.hpp>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* The associative arrays of the macro language. Keys are strings, but the
+ * keys "0", "1", "2"... of arrays used as lists are kept in a vector, indexed
+ * by their value, so that they don't have to be converted to strings and
+ * hashed. All other keys are kept in a hash table.
+ *
+ * Copying an array only copies a reference to its contents, which are
+ * copied the first time either copy is modified. Arrays held inside of an
+ * array get copied the same way when their container is, so that modifying
+ * an element of a nested array, as in a[1][2] = 3, never affects a copy.
+ *
+ * Iteration visits the keys in (string) sorted order, as it always has,
+ * because macros rely on it. The sorted keys are worked out when an array is
+ * first iterated and kept until its keys change. */
+class Array {
+public:
+	using Keys = std::vector<std::string>;
+
+public:
+	Array();
+	Array(const Array &other) = default;
+	Array &operator=(const Array &other) = default;
+	~Array() = default;
+
+public:
+	const DataValue *find(const std::string &key) const;
+	const DataValue *find(int64_t key) const;
+	bool get(const std::string &key, DataValue *value);
+	bool get(int64_t key, DataValue *value);
+	size_t size() const noexcept;
+	std::shared_ptr<const Keys> keys() const;
+	void clear();
+	void erase(const std::string &key);
+	void insert(const std::string &key, DataValue value);
+	void insert(int64_t key, DataValue value);
+
+public:
+	/**
+	 * @brief Array::forEach
+	 * @param func
+	 *
+	 * Calls "func" with the key and value of each element, in no particular
+	 * order
+	 */
+	template <class Func>
+	void forEach(Func func) const {
+		for (size_t i = 0; i < storage_->list.size(); ++i) {
+			if (const boost::optional<DataValue> &value = storage_->list[i]) {
+				func(std::to_string(i), *value);
+			}
+		}
+
+		for (const auto &entry : storage_->table) {
+			func(entry.first, entry.second);
+		}
+	}
+
+private:
+	template <class Key>
+	bool getValue(const Key &key, DataValue *value);
+
+	bool growList(size_t index);
+	void detach();
+	void insertInList(size_t index, DataValue value);
+	void insertInTable(std::string key, DataValue value);
+
+private:
+	struct Storage {
+		std::vector<boost::optional<DataValue>> list; // the values of the keys "0" to "list.size() - 1" which are present
+		size_t listCount = 0;                         // how many of them are present
+		std::unordered_map<std::string, DataValue> table;
+		std::shared_ptr<const Keys> keys; // all of the keys, sorted; null until needed
+	};
+
+	std::shared_ptr<Storage> storage_;
+};
+
+#endif
@@ -2,19 +2,21 @@
 #ifndef DATA_VALUE_H_
 #define DATA_VALUE_H_
 
+#include "MacroString.h"
 #include "Util/string_view.h"
 
 #include <gsl/span>
 
-#include <map>
 #include <memory>
 #include <string>
 #include <system_error>
+#include <vector>
 
 #include <boost/variant.hpp>
 
 #include <QString>
 
+class Array;
 class DocumentWidget;
 struct DataValue;
 struct Program;
@@ -22,21 +24,21 @@ union Inst;
 
 using Arguments      = gsl::span<DataValue>;
 using LibraryRoutine = std::error_code (*)(DocumentWidget *document, Arguments arguments, DataValue *result);
-using Array          = std::map<std::string, DataValue>;
 using ArrayPtr       = std::shared_ptr<Array>;
 
-// we use a kind of "fat iterator", because the arrayIter function
-// needs to know if the iterator is at the end of the map. This requirement
-// means that we need a reference to the map to compare against
+// iterates over a snapshot of the keys the array had when iteration began,
+// and keeps a reference to the array, so that the arrayIter function can
+// skip any which have since been deleted
 struct ArrayIterator {
-	ArrayPtr m;
-	Array::iterator it;
+	ArrayPtr array;
+	std::shared_ptr<const std::vector<std::string>> keys;
+	size_t index = 0;
 };
 
 using Data = boost::variant<
 	boost::blank,
-	int32_t,
-	std::string,
+	int64_t,
+	MacroString,
 	ArrayPtr,
 	ArrayIterator,
 	LibraryRoutine,
@@ -68,34 +70,43 @@ inline DataValue make_value() {
 
 inline DataValue make_value(int32_t n) {
 	DataValue DV;
-	DV.value = n;
+	DV.value = static_cast<int64_t>(n);
 	return DV;
 }
 
 inline DataValue make_value(int64_t n) {
 	DataValue DV;
-	if (n > std::numeric_limits<int32_t>::max() || n < std::numeric_limits<int32_t>::min()) {
-		qWarning("A value being stored in a macro variable will be truncated");
-	}
-	DV.value = static_cast<int32_t>(n);
+	DV.value = n;
 	return DV;
 }
 
 inline DataValue make_value(bool n) {
 	DataValue DV;
-	DV.value = n ? 1 : 0;
+	DV.value = static_cast<int64_t>(n ? 1 : 0);
 	return DV;
 }
 
 inline DataValue make_value(view::string_view str) {
 	DataValue DV;
-	DV.value = str.to_string();
+	DV.value = MacroString(str);
+	return DV;
+}
+
+inline DataValue make_value(std::string &&str) {
+	DataValue DV;
+	DV.value = MacroString(std::move(str));
+	return DV;
+}
+
+inline DataValue make_value(MacroString str) {
+	DataValue DV;
+	DV.value = std::move(str);
 	return DV;
 }
 
 inline DataValue make_value(const QString &str) {
 	DataValue DV;
-	DV.value = str.toStdString();
+	DV.value = MacroString(str.toStdString());
 	return DV;
 }
 
@@ -141,14 +152,23 @@ inline bool is_array(const DataValue &dv) {
 
 inline std::string to_string(const DataValue &dv) {
 
-	if (auto n = boost::get<int>(&dv.value)) {
+	if (auto n = boost::get<int64_t>(&dv.value)) {
 		return std::to_string(*n);
 	}
-	return boost::get<std::string>(dv.value);
+	return boost::get<MacroString>(dv.value).str();
+}
+
+// the text of a string value, without copying it
+inline view::string_view to_string_view(const DataValue &dv) {
+	return boost::get<MacroString>(dv.value).view();
+}
+
+inline const MacroString &to_macro_string(const DataValue &dv) {
+	return boost::get<MacroString>(dv.value);
 }
 
-inline int to_integer(const DataValue &dv) {
-	return boost::get<int>(dv.value);
+inline int64_t to_integer(const DataValue &dv) {
+	return boost::get<int64_t>(dv.value);
 }
 
 inline Program *to_program(const DataValue &dv) {
@@ -0,0 +1,110 @@
+
+#ifndef MACRO_STRING_H_
+#define MACRO_STRING_H_
+
+#include "Util/string_view.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+/* The string values of the macro language. Strings are immutable, so a value
+ * is a view of part of a shared buffer, and copying one only copies the view.
+ * Appending to a string which ends where its buffer's contents end writes into
+ * the spare capacity of that buffer; other values sharing the buffer can't see
+ * the difference, because they only look at the part they were given. When
+ * there is no room, the text is copied into a new buffer with room to grow, so
+ * that repeatedly appending to a string takes amortized constant time. A buffer
+ * is never reallocated while it is shared, so views of it stay valid. */
+class MacroString {
+public:
+	MacroString() = default;
+
+	explicit MacroString(std::string str)
+		: buffer_(std::make_shared<std::string>(std::move(str))), size_(buffer_->size()) {
+	}
+
+	explicit MacroString(view::string_view str)
+		: buffer_(std::make_shared<std::string>(str.data(), str.size())), size_(str.size()) {
+	}
+
+public:
+	view::string_view view() const noexcept {
+		if (!buffer_) {
+			return view::string_view();
+		}
+
+		return view::string_view(buffer_->data() + offset_, size_);
+	}
+
+	std::string str() const {
+		return view().to_string();
+	}
+
+	size_t size() const noexcept {
+		return size_;
+	}
+
+	bool empty() const noexcept {
+		return size_ == 0;
+	}
+
+public:
+	/**
+	 * @brief MacroString::substr
+	 * @param pos
+	 * @param count
+	 * @return the "count" characters starting at "pos", sharing this string's
+	 * buffer unless the result is so much smaller than the buffer that keeping
+	 * all of it alive for the sake of the substring would waste memory
+	 */
+	MacroString substr(size_t pos, size_t count) const {
+
+		pos   = std::min(pos, size_);
+		count = std::min(count, size_ - pos);
+
+		if (!buffer_ || count * 4 < buffer_->capacity()) {
+			return MacroString(view().substr(pos, count));
+		}
+
+		MacroString result;
+		result.buffer_ = buffer_;
+		result.offset_ = offset_ + pos;
+		result.size_   = count;
+		return result;
+	}
+
+	/**
+	 * @brief MacroString::append
+	 * @param str
+	 */
+	void append(view::string_view str) {
+
+		if (str.empty()) {
+			return;
+		}
+
+		if (buffer_ && offset_ + size_ == buffer_->size() && buffer_->capacity() - buffer_->size() >= str.size()) {
+			// fits without reallocating, so even if "str" is part of this buffer it stays valid
+			buffer_->append(str.data(), str.size());
+			size_ += str.size();
+			return;
+		}
+
+		auto buffer = std::make_shared<std::string>();
+		buffer->reserve(std::max<size_t>((size_ + str.size()) * 2, 32));
+		buffer->append(view().data(), size_);
+		buffer->append(str.data(), str.size());
+
+		buffer_ = std::move(buffer);
+		offset_ = 0;
+		size_   = buffer_->size();
+	}
+
+private:
+	std::shared_ptr<std::string> buffer_;
+	size_t offset_ = 0;
+	size_t size_   = 0;
+};
+
+#endif
@@ -0,0 +1,238 @@
+
+#include "interpret.h"
+#include "parse.h"
+
+#include <QString>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/* Measures the macro interpreter on its own, without the rest of the editor.
+ *
+ * Usage: nedit-interpreter-benchmark [-functions n] [-iterations n]
+ *
+ * The execution benchmarks are loop-heavy macros, each of which runs its loop
+ * "-iterations" times, so that the time taken is dominated by the dispatch
+ * and evaluation of the instructions inside of the loop.
+ */
+
+namespace {
+
+constexpr const char cmdLineHelp[] = "Usage: nedit-interpreter-benchmark [-functions n] [-iterations n]\n";
+
+struct ExecutionCase {
+	const char *name;
+	const char *body;
+};
+
+// each case is given the number of iterations to run as $1
+const ExecutionCase ExecutionCases[] = {
+	{"empty loop",
+	 "count = $1\n"
+	 "for (i = 0; i < count; i++) {\n"
+	 "}\n"},
+	{"arithmetic",
+	 "count = $1\n"
+	 "total = 0\n"
+	 "for (i = 0; i < count; i++) {\n"
+	 "	total = (total + i * 3) % 1000003\n"
+	 "}\n"
+	 "return total\n"},
+	{"conditionals",
+	 "count = $1\n"
+	 "odd = 0\n"
+	 "for (i = 0; i < count; i++) {\n"
+	 "	if (i % 2 == 1) {\n"
+	 "		odd++\n"
+	 "	} else {\n"
+	 "		odd--\n"
+	 "	}\n"
+	 "}\n"
+	 "return odd\n"},
+	{"while loop",
+	 "i = $1\n"
+	 "steps = 0\n"
+	 "while (i > 0) {\n"
+	 "	i -= 1\n"
+	 "	steps += 1\n"
+	 "}\n"
+	 "return steps\n"},
+	{"globals",
+	 "$benchmark_total = 0\n"
+	 "for (i = 0; i < $1; i++) {\n"
+	 "	$benchmark_total = ($benchmark_total + i) & 65535\n"
+	 "}\n"
+	 "return $benchmark_total\n"},
+	{"strings",
+	 "s = \"\"\n"
+	 "for (i = 0; i < $1; i++) {\n"
+	 "	if (i % 100 == 0) {\n"
+	 "		s = s \"x\"\n"
+	 "	}\n"
+	 "}\n"
+	 "return s\n"},
+	{"concatenation",
+	 "s = \"\"\n"
+	 "count = $1 / 10\n"
+	 "for (i = 0; i < count; i++) {\n"
+	 "	s = s \"line \" i \"\\n\"\n"
+	 "}\n"
+	 "return s\n"},
+	{"arrays",
+	 "count = $1 / 10\n"
+	 "for (i = 0; i < count; i++) {\n"
+	 "	a[i] = i\n"
+	 "}\n"
+	 "total = 0\n"
+	 "for (k in a) {\n"
+	 "	total = (total + a[k]) % 1000003\n"
+	 "}\n"
+	 "return total\n"},
+};
+
+/**
+ * @brief functionBody
+ * @param n
+ * @return the body of a macro function, like those of a large macro library,
+ * with its own local and global variables and string constants
+ */
+QString functionBody(int n) {
+	return QStringLiteral(
+			   "count_%1 = 0\n"
+			   "name_%1 = \"function %1\"\n"
+			   "$library_global_%1 = \"global %1\"\n"
+			   "for (i = 0; i < $1; i++) {\n"
+			   "	label_%1 = \"item \" i \" of %1\"\n"
+			   "	count_%1 = count_%1 + i\n"
+			   "}\n"
+			   "return name_%1 \": \" count_%1\n")
+		.arg(n);
+}
+
+/**
+ * @brief reportTime
+ * @param name
+ * @param count
+ * @param start
+ */
+void reportTime(const char *name, int count, std::chrono::steady_clock::time_point start) {
+
+	const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+
+	printf("%-40s %8d %12.3f %12.3f\n", name, count, elapsed.count(), elapsed.count() * 1000.0 / count);
+}
+
+/**
+ * @brief benchmarkLoad
+ * @param functions
+ *
+ * Compiles "functions" separate function bodies, as loading a macro file
+ * does, so the symbol tables grow as they would for a large library
+ */
+bool benchmarkLoad(int functions) {
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < functions; ++i) {
+		QString message;
+		int stoppedAt;
+
+		Program *prog = compileMacro(functionBody(i), &message, &stoppedAt);
+		if (!prog) {
+			fprintf(stderr, "nedit-interpreter-benchmark: %s at %d\n", qPrintable(message), stoppedAt);
+			return false;
+		}
+
+		delete prog;
+	}
+
+	reportTime("load (per function)", functions, start);
+	return true;
+}
+
+/**
+ * @brief benchmarkExecute
+ * @param executionCase
+ * @param iterations
+ *
+ * Runs a loop-heavy macro to completion, resuming it each time it gives up
+ * its time slice, as the editor would
+ */
+bool benchmarkExecute(const ExecutionCase &executionCase, int iterations) {
+
+	QString message;
+	int stoppedAt;
+
+	Program *prog = compileMacro(QString::fromLatin1(executionCase.body), &message, &stoppedAt);
+	if (!prog) {
+		fprintf(stderr, "nedit-interpreter-benchmark: %s: %s at %d\n", executionCase.name, qPrintable(message), stoppedAt);
+		return false;
+	}
+
+	DataValue arguments[] = {make_value(iterations)};
+	DataValue result;
+	std::shared_ptr<MacroContext> continuation;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	int status = executeMacro(nullptr, prog, arguments, &result, continuation, &message);
+	while (status == MACRO_TIME_LIMIT) {
+		status = continueMacro(continuation, &result, &message);
+	}
+
+	delete prog;
+
+	if (status != MACRO_DONE) {
+		fprintf(stderr, "nedit-interpreter-benchmark: %s: %s\n", executionCase.name, qPrintable(message));
+		return false;
+	}
+
+	const std::string name = std::string("execute ") + executionCase.name + " (per iteration)";
+	reportTime(name.c_str(), iterations, start);
+	return true;
+}
+
+}
+
+/**
+ * @brief main
+ * @param argc
+ * @param argv
+ * @return
+ */
+int main(int argc, char *argv[]) {
+
+	int functions  = 20000;
+	int iterations = 1000000;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "-functions") == 0 && i + 1 < argc) {
+			functions = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-iterations") == 0 && i + 1 < argc) {
+			iterations = atoi(argv[++i]);
+		} else {
+			fputs(cmdLineHelp, stderr);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (functions <= 0 || iterations <= 0) {
+		fputs(cmdLineHelp, stderr);
+		return EXIT_FAILURE;
+	}
+
+	InitMacroGlobals();
+
+	printf("%-40s %8s %12s %12s\n", "benchmark", "count", "total ms", "each us");
+
+	bool ok = benchmarkLoad(functions);
+
+	for (const ExecutionCase &executionCase : ExecutionCases) {
+		ok = benchmarkExecute(executionCase, iterations) && ok;
+	}
+
+	CleanupMacroGlobals();
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
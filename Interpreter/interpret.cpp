@@ -1,9 +1,14 @@
 
 #include "interpret.h"
 #include "Util/utils.h"
+#include <QElapsedTimer>
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdlib>
 #include <gsl/gsl_util>
+#include <map>
+#include <unordered_map>
 
 // This enables preemption, useful to disable it for debugging things
 #define ENABLE_PREEMPTION
@@ -13,13 +18,18 @@
 
 namespace {
 
-// Maximum stack size
-constexpr int STACK_SIZE = 1024;
+/* The stack of a macro starts out small, and doubles in size each time it
+   fills up, until it reaches the maximum, which is only there to catch
+   runaway recursion */
+constexpr size_t INITIAL_STACK_SIZE = 256;
+constexpr size_t MAX_STACK_SIZE     = 1024 * 1024;
+constexpr size_t MAX_SPARE_STACKS   = 4; // Number of finished macros' stacks kept for reuse
 
-constexpr int PROGRAM_SIZE      = 4096; // Maximum program size
-constexpr int MAX_ERR_MSG_LEN   = 256;  // Max. length for error messages
-constexpr int LOOP_STACK_SIZE   = 200;  // (Approx.) Number of break/continue stmts allowed per program
-constexpr int INSTRUCTION_LIMIT = 100;  // Number of instructions the interpreter is allowed to execute before preempting and returning to allow other things to run
+constexpr size_t MAX_PROGRAM_SIZE = 16 * 1024 * 1024; // Maximum program size, which is only there to catch runaway code generation
+
+constexpr int MAX_ERR_MSG_LEN     = 256; // Max. length for error messages
+constexpr int DEFAULT_TIME_SLICE  = 15;  // Milliseconds the interpreter is allowed to run before preempting and returning to allow other things to run
+constexpr int TIME_CHECK_INTERVAL = 256; // Number of instructions executed between checks of the time used by a slice
 
 /* Temporary markers placed in a branch address location to designate
    which loop address (break or continue) the location needs */
@@ -49,19 +59,60 @@ const auto MacroTooLarge = QLatin1String("macro too large");
 // Global symbols and function definitions
 std::deque<Symbol *> GlobalSymList;
 
-// Temporary global data for use while accumulating programs
+/* Hash indexes of the symbol tables, so that symbols can be found without
+   searching the lists. Names are views of the Symbol's own name, which
+   doesn't move or change once installed */
+std::unordered_map<view::string_view, Symbol *> GlobalSymIndex; // first global symbol of each name
+std::unordered_map<view::string_view, Symbol *> LocalSymIndex;  // most recent local symbol of each name
+std::unordered_map<std::string, Symbol *> StringConstIndex;     // first string constant of each value
+
+/* Temporary global data for use while accumulating programs. Code is
+   referred to by its offset from the start of the program, rather than by
+   address, because the storage for it moves as it grows. Both vectors keep
+   their capacity from one program to the next */
 std::deque<Symbol *> LocalSymList; // symbols local to the program
-Inst Prog[PROGRAM_SIZE];           // the program
-Inst *ProgP;                       // next free spot for code gen.
-Inst *LoopStack[LOOP_STACK_SIZE];  // addresses of break, cont stmts
-Inst **LoopStackPtr = LoopStack;   //  to fill at the end of a loop
+std::vector<Inst> Prog;            // the program
+std::vector<int> ProgLines;        // the source line of each instruction of the program
+std::vector<CodeOffset> LoopStack; // offsets of break, cont stmts to fill at the end of a loop
+int SourceLine = 1;                // the line the parser is on
+
+constexpr CodeOffset LOOP_START = -1; // marks the start of a loop's entries in LoopStack
+
+// Stacks of macros which have finished, kept for reuse by the next macro to run
+std::vector<std::unique_ptr<DataValue[]>> SpareStacks;
 
 // Global data for the interpreter
 MacroContext Context;
 
+/* Data of the macro profiler. Instructions are attributed to the program
+   they belong to, which is found from their address, and to the line of that
+   program they were compiled from. Programs are profiled by name, so that a
+   macro function keeps its counts when its file is reloaded */
+struct ProfileCounters {
+	int64_t calls        = 0; // times called, for functions and built-ins
+	int64_t instructions = 0; // instructions executed
+	int64_t nanoseconds  = 0; // time spent, including in built-ins called
+};
+
+struct FunctionProfile {
+	ProfileCounters total;
+	std::map<int, ProfileCounters> lines;
+};
+
+bool Profiling = false;
+QElapsedTimer ProfileTimer;
+std::map<std::string, FunctionProfile> FunctionProfiles; // by program name
+std::map<std::string, ProfileCounters> BuiltinProfiles;  // by built-in name
+std::map<const Inst *, const Program *> ProgramIndex;    // every program, by the address of its code
+
+const Program *ProfiledProgram    = nullptr; // the program the last instruction profiled belongs to
+FunctionProfile *ProfiledFunction = nullptr; // and its profile
+
 const char *ErrorMessage; // global for returning error messages from executing functions
 bool PreemptRequest;      // passes preemption requests from called routines back up to the interpreter
 
+int64_t TimeSliceNanoseconds = DEFAULT_TIME_SLICE * INT64_C(1000000); // how long a macro may run before giving other things a chance
+
 // Stack-> symN-sym0(FP), argArray, nArgs, oldFP, retPC, argN-arg1, next, ...
 constexpr int FP_ARG_ARRAY_CACHE_INDEX = -1;
 constexpr int FP_ARG_COUNT_INDEX       = -2;
@@ -74,7 +125,7 @@ DataValue &FP_GET_ARG_ARRAY_CACHE(DataValue *FrameP) {
 }
 
 int FP_GET_ARG_COUNT(const DataValue *FrameP) {
-	return to_integer(FrameP[FP_ARG_COUNT_INDEX]);
+	return static_cast<int>(to_integer(FrameP[FP_ARG_COUNT_INDEX]));
 }
 
 DataValue *FP_GET_OLD_FP(const DataValue *FrameP) {
@@ -98,7 +149,7 @@ DataValue &FP_GET_SYM_N(DataValue *FrameP, int n) {
 }
 
 DataValue &FP_GET_SYM_VAL(DataValue *FrameP, Symbol *sym) {
-	return FP_GET_SYM_N(FrameP, to_integer(sym->value));
+	return FP_GET_SYM_N(FrameP, static_cast<int>(to_integer(sym->value)));
 }
 
 /*
@@ -108,20 +159,174 @@ template <class Pointer>
 void saveContext(Pointer context) {
 	context->Stack         = Context.Stack;
 	context->StackP        = Context.StackP;
+	context->StackEnd      = Context.StackEnd;
 	context->FrameP        = Context.FrameP;
 	context->PC            = Context.PC;
 	context->RunDocument   = Context.RunDocument;
 	context->FocusDocument = Context.FocusDocument;
+	context->Statistics    = Context.Statistics;
 }
 
 template <class Pointer>
 void restoreContext(Pointer context) {
 	Context.Stack         = context->Stack;
 	Context.StackP        = context->StackP;
+	Context.StackEnd      = context->StackEnd;
 	Context.FrameP        = context->FrameP;
 	Context.PC            = context->PC;
 	Context.RunDocument   = context->RunDocument;
 	Context.FocusDocument = context->FocusDocument;
+	Context.Statistics    = context->Statistics;
+}
+
+/*
+** Allocate storage for a macro stack of "size" values. Starting a macro
+** happens for every keystroke in smart indent mode, so rather than allocating
+** a new stack each time, the storage of those which are released is kept for
+** reuse, as long as it is the usual initial size.
+*/
+MacroContext::stack_type allocateStack(size_t size) {
+
+	std::unique_ptr<DataValue[]> values;
+	if (size == INITIAL_STACK_SIZE && !SpareStacks.empty()) {
+		values = std::move(SpareStacks.back());
+		SpareStacks.pop_back();
+	} else {
+		values = std::make_unique<DataValue[]>(size);
+	}
+
+	return MacroContext::stack_type(values.release(), [size](DataValue *released) {
+		std::unique_ptr<DataValue[]> spare(released);
+		if (size == INITIAL_STACK_SIZE && SpareStacks.size() < MAX_SPARE_STACKS) {
+			// don't keep what was left on the stack alive
+			std::fill_n(released, size, DataValue());
+			SpareStacks.push_back(std::move(spare));
+		}
+	});
+}
+
+/*
+** Make room on the stack of the running macro for "count" more values, by
+** moving it to storage at least twice the size. The frame pointers which
+** subroutine calls saved on the stack are moved along with it. Returns false
+** if the stack would grow past its maximum size.
+*/
+bool growStack(size_t count) {
+
+	DataValue *const oldBase = Context.Stack.get();
+	const auto oldSize       = static_cast<size_t>(Context.StackEnd - oldBase);
+	const auto used          = static_cast<size_t>(Context.StackP - oldBase);
+
+	if (count > MAX_STACK_SIZE - used) {
+		return false;
+	}
+
+	const size_t newSize              = std::min(std::max(oldSize * 2, used + count), MAX_STACK_SIZE);
+	MacroContext::stack_type newStack = allocateStack(newSize);
+	DataValue *const newBase          = newStack.get();
+
+	std::move(oldBase, Context.StackP, newBase);
+
+	auto moved = [oldBase, newBase](DataValue *p) -> DataValue * {
+		return p ? newBase + (p - oldBase) : nullptr;
+	};
+
+	Context.FrameP = moved(Context.FrameP);
+	for (DataValue *frameP = Context.FrameP; frameP; frameP = FP_GET_OLD_FP(frameP)) {
+		DataValue &oldFrameP = frameP[FP_OLD_FP_INDEX];
+		oldFrameP            = make_value(moved(to_data_value(oldFrameP)));
+	}
+
+	Context.StackP   = moved(Context.StackP);
+	Context.StackEnd = newBase + newSize;
+	Context.Stack    = std::move(newStack);
+	return true;
+}
+
+/*
+** Make sure that there is room on the stack for "count" more values
+*/
+bool reserveStack(size_t count) {
+	return static_cast<size_t>(Context.StackEnd - Context.StackP) >= count || growStack(count);
+}
+
+/*
+** Returns the profile of the program "prog"
+*/
+FunctionProfile *programProfile(const Program *prog) {
+	return &FunctionProfiles[prog->name.empty() ? std::string("(unnamed macro)") : prog->name];
+}
+
+/*
+** Count a call of the program "prog", when profiling
+*/
+void profileCall(const Program *prog) {
+	++programProfile(prog)->total.calls;
+}
+
+/*
+** Attribute an instruction, which took "nanoseconds" to execute, to the
+** program and line it came from
+*/
+void profileInstruction(const Inst *inst, int64_t nanoseconds) {
+
+	auto contains = [inst](const Program *prog) {
+		return inst >= prog->code.data() && inst < prog->code.data() + prog->code.size();
+	};
+
+	if (!ProfiledProgram || !contains(ProfiledProgram)) {
+		auto it = ProgramIndex.upper_bound(inst);
+		if (it == ProgramIndex.begin() || !contains(std::prev(it)->second)) {
+			return;
+		}
+
+		ProfiledProgram  = std::prev(it)->second;
+		ProfiledFunction = programProfile(ProfiledProgram);
+	}
+
+	const auto index      = static_cast<size_t>(inst - ProfiledProgram->code.data());
+	ProfileCounters &line = ProfiledFunction->lines[ProfiledProgram->lines[index]];
+
+	++line.instructions;
+	line.nanoseconds += nanoseconds;
+	++ProfiledFunction->total.instructions;
+	ProfiledFunction->total.nanoseconds += nanoseconds;
+}
+
+/*
+** Execute instructions as continueMacro does, timing each one for the
+** profiler, until one returns something other than STAT_OK, "executed"
+** reaches TIME_CHECK_INTERVAL, or profiling is turned off
+*/
+int executeProfiled(int *executed) {
+
+	int status    = STAT_OK;
+	int64_t start = ProfileTimer.nsecsElapsed();
+
+	do {
+		const Inst *inst = Context.PC++;
+		status           = inst->func();
+
+		if (!Profiling) {
+			break;
+		}
+
+		const int64_t end = ProfileTimer.nsecsElapsed();
+		profileInstruction(inst, end - start);
+		start = end;
+	} while (status == STAT_OK && ++*executed != TIME_CHECK_INTERVAL);
+
+	return status;
+}
+
+/*
+** Appends a line of a profile report to "report"
+*/
+template <class... T>
+void appendReportLine(std::string *report, const char *format, T &&...args) {
+	char line[256];
+	qsnprintf(line, sizeof(line), format, std::forward<T>(args)...);
+	report->append(line);
 }
 
 /*
@@ -149,24 +354,9 @@ int execError(const char *s1, T &&...args) {
 	return STAT_ERROR;
 }
 
-/*
-** checks errno after operations which can set it.  If an error occurred,
-** creates appropriate error messages and returns false
-*/
-int errCheck(const char *s) {
-	switch (errno) {
-	case EDOM:
-		return execError("%s argument out of domain", s);
-	case ERANGE:
-		return execError("%s result out of range", s);
-	default:
-		return STAT_OK;
-	}
-}
-
 }
 
-static void addLoopAddr(Inst *addr);
+static void addLoopAddr(CodeOffset addr);
 static int returnNoVal();
 static int returnVal();
 static int returnValOrNone(bool valOnStack);
@@ -211,10 +401,14 @@ static int beginArrayIter();
 static int arrayIter();
 static int inArray();
 static int deleteArrayElement();
+static int stackOverflow();
 
 static ArrayIterator arrayIterateFirst(DataValue *theArray);
 static ArrayIterator arrayIterateNext(ArrayIterator iterator);
 
+static void fuseInstructions(std::vector<Inst> &code);
+static void prepareProgram(Program *prog);
+
 #if defined(DEBUG_ASSEMBLY) || defined(DEBUG_STACK)
 #define DEBUG_DISASSEMBLER
 static void disasm(Inst *inst, size_t nInstr);
@@ -308,9 +502,15 @@ void InitMacroGlobals() {
  * @brief CleanupMacroGlobals
  */
 void CleanupMacroGlobals() {
+	GlobalSymIndex.clear();
+	StringConstIndex.clear();
+
 	for (Symbol *sym : GlobalSymList) {
 		delete sym;
 	}
+
+	GlobalSymList.clear();
+	SpareStacks.clear();
 }
 
 /*
@@ -327,8 +527,11 @@ void CleanupMacroGlobals() {
 */
 void BeginCreatingProgram() {
 	LocalSymList.clear();
-	ProgP        = Prog;
-	LoopStackPtr = LoopStack;
+	LocalSymIndex.clear();
+	Prog.clear();
+	ProgLines.clear();
+	LoopStack.clear();
+	SourceLine = 1;
 }
 
 /*
@@ -339,84 +542,125 @@ void BeginCreatingProgram() {
 Program *FinishCreatingProgram() {
 
 	auto newProg = std::make_unique<Program>();
-	std::copy(Prog, ProgP, std::back_inserter(newProg->code));
+	newProg->code  = Prog;
+	newProg->lines = ProgLines;
 
 	newProg->localSymList = LocalSymList;
 	LocalSymList.clear();
+	LocalSymIndex.clear();
+
+	DISASM(newProg->code.data(), newProg->code.size());
+
+	prepareProgram(newProg.get());
+	return newProg.release();
+}
+
+/*
+** Get a program which has all of its code and symbols ready to be executed
+*/
+static void prepareProgram(Program *prog) {
 
 	int fpOffset = 0;
 
 	/* Local variables' values are stored on the stack.  Here we assign
 	   frame pointer offsets to them. */
-	for (Symbol *s : newProg->localSymList) {
+	for (Symbol *s : prog->localSymList) {
 		s->value = make_value(fpOffset++);
 	}
 
-	DISASM(newProg->code.data(), newProg->code.size());
-	return newProg.release();
+	fuseInstructions(prog->code);
+
+	if (!prog->code.empty()) {
+		ProgramIndex.emplace(prog->code.data(), prog);
+	}
 }
 
 /*
-** Add an operator (instruction) to the end of the current program
+** Free a program, and forget about it in the profiler
 */
-bool AddOp(int op, QString *msg) {
-	if (ProgP >= &Prog[PROGRAM_SIZE]) {
-		*msg = MacroTooLarge;
-		return false;
+Program::~Program() {
+
+	if (!code.empty()) {
+		ProgramIndex.erase(code.data());
 	}
 
-	ProgP++->func = OpFns[op];
-	return true;
+	if (ProfiledProgram == this) {
+		ProfiledProgram  = nullptr;
+		ProfiledFunction = nullptr;
+	}
+
+	qDeleteAll(localSymList);
 }
 
 /*
-** Add a symbol operand to the current program
+** Add an instruction to the end of the current program
 */
-bool AddSym(Symbol *sym, QString *msg) {
-	if (ProgP >= &Prog[PROGRAM_SIZE]) {
+static bool addInst(Inst inst, QString *msg) {
+	if (Prog.size() >= MAX_PROGRAM_SIZE) {
 		*msg = MacroTooLarge;
 		return false;
 	}
 
-	ProgP++->sym = sym;
+	Prog.push_back(inst);
+	ProgLines.push_back(SourceLine);
 	return true;
 }
 
+/*
+** Add an operator (instruction) to the end of the current program
+*/
+bool AddOp(int op, QString *msg) {
+	Inst inst;
+	inst.func = OpFns[op];
+	return addInst(inst, msg);
+}
+
+/*
+** Add a symbol operand to the current program
+*/
+bool AddSym(Symbol *sym, QString *msg) {
+	Inst inst;
+	inst.sym = sym;
+	return addInst(inst, msg);
+}
+
 /*
 ** Add an immediate value operand to the current program
 */
 bool AddImmediate(int value, QString *msg) {
-	if (ProgP >= &Prog[PROGRAM_SIZE]) {
-		*msg = MacroTooLarge;
-		return false;
-	}
-
-	ProgP++->value = value;
-	return true;
+	Inst inst;
+	inst.value = value;
+	return addInst(inst, msg);
 }
 
 /*
 ** Add a branch offset operand to the current program
 */
-bool AddBranchOffset(const Inst *to, QString *msg) {
-	if (ProgP >= &Prog[PROGRAM_SIZE]) {
-		*msg = MacroTooLarge;
-		return false;
-	}
+bool AddBranchOffset(CodeOffset to, QString *msg) {
+	Inst inst;
+	inst.value = to - GetPC();
+	return addInst(inst, msg);
+}
 
-	/* we don't use gsl::narrow here because when to is nullptr (to indicate
-	 * end of program) it produces values that won't fit into an int on
-	 * 64-bit systems */
-	ProgP->value = static_cast<int>(to - ProgP);
-	ProgP++;
-	return true;
+/*
+** Set the branch offset operand at "from" to branch to "to"
+*/
+void SetBranchOffset(CodeOffset from, CodeOffset to) {
+	Prog[static_cast<size_t>(from)].value = to - from;
+}
+
+/*
+** Set the source line which the instructions added next were compiled from
+*/
+void SetSourceLine(int line) {
+	SourceLine = line;
 }
 
 /*
-** Return the address at which the next instruction will be stored
+** Return the offset at which the next instruction will be stored
 */
-Inst *GetPC() {
-	return ProgP;
+CodeOffset GetPC() {
+	return static_cast<CodeOffset>(Prog.size());
 }
 
 /*
@@ -424,13 +668,18 @@ Inst *GetPC() {
 ** running between locations start and boundary, and the second between
 ** boundary and end.
 */
-void SwapCode(Inst *start, Inst *boundary, Inst *end) {
+void SwapCode(CodeOffset start, CodeOffset boundary, CodeOffset end) {
 
 	// double-reverse method: reverse elements of both parts then whole lot
 	// eg abcdeABCD -1-> edcbaABCD -2-> edcbaDCBA -3-> DCBAedcba
-	std::reverse(start, boundary); // 1
-	std::reverse(boundary, end);   // 2
-	std::reverse(start, end);      // 3
+	std::reverse(Prog.begin() + start, Prog.begin() + boundary); // 1
+	std::reverse(Prog.begin() + boundary, Prog.begin() + end);   // 2
+	std::reverse(Prog.begin() + start, Prog.begin() + end);      // 3
+
+	// the lines they came from go with them
+	std::reverse(ProgLines.begin() + start, ProgLines.begin() + boundary);
+	std::reverse(ProgLines.begin() + boundary, ProgLines.begin() + end);
+	std::reverse(ProgLines.begin() + start, ProgLines.begin() + end);
 }
 
 /*
@@ -444,53 +693,52 @@ void SwapCode(Inst *start, Inst *boundary, Inst *end) {
 ** in all the addresses and return to the level of the enclosing loop.
 */
 void StartLoopAddrList() {
-	addLoopAddr(nullptr);
+	addLoopAddr(LOOP_START);
 }
 
-bool AddBreakAddr(Inst *addr) {
-	if (LoopStackPtr == LoopStack) {
+bool AddBreakAddr(CodeOffset addr) {
+	if (LoopStack.empty()) {
 		return true;
 	}
 
 	addLoopAddr(addr);
-	addr->value = NEEDS_BREAK;
+	Prog[static_cast<size_t>(addr)].value = NEEDS_BREAK;
 	return false;
 }
 
-bool AddContinueAddr(Inst *addr) {
-	if (LoopStackPtr == LoopStack) {
+bool AddContinueAddr(CodeOffset addr) {
+	if (LoopStack.empty()) {
 		return true;
 	}
 
 	addLoopAddr(addr);
-	addr->value = NEEDS_CONTINUE;
+	Prog[static_cast<size_t>(addr)].value = NEEDS_CONTINUE;
 	return false;
 }
 
-static void addLoopAddr(Inst *addr) {
-	if (LoopStackPtr > &LoopStack[LOOP_STACK_SIZE - 1]) {
-		qCritical("NEdit: loop stack overflow in macro parser");
-		return;
-	}
-	*LoopStackPtr++ = addr;
+static void addLoopAddr(CodeOffset addr) {
+	LoopStack.push_back(addr);
 }
 
-void FillLoopAddrs(const Inst *breakAddr, const Inst *continueAddr) {
+void FillLoopAddrs(CodeOffset breakAddr, CodeOffset continueAddr) {
 	while (true) {
-		LoopStackPtr--;
-		if (LoopStackPtr < LoopStack) {
+		if (LoopStack.empty()) {
 			qCritical("NEdit: internal error (lsu) in macro parser");
 			return;
 		}
 
-		if (*LoopStackPtr == nullptr) {
+		const CodeOffset addr = LoopStack.back();
+		LoopStack.pop_back();
+
+		if (addr == LOOP_START) {
 			break;
 		}
 
-		if ((*LoopStackPtr)->value == NEEDS_BREAK) {
-			(*LoopStackPtr)->value = breakAddr - *LoopStackPtr;
-		} else if ((*LoopStackPtr)->value == NEEDS_CONTINUE) {
-			(*LoopStackPtr)->value = continueAddr - *LoopStackPtr;
+		Inst &inst = Prog[static_cast<size_t>(addr)];
+		if (inst.value == NEEDS_BREAK) {
+			inst.value = breakAddr - addr;
+		} else if (inst.value == NEEDS_CONTINUE) {
+			inst.value = continueAddr - addr;
 		} else {
 			qCritical("NEdit: internal error (uat) in macro parser");
 		}
@@ -510,9 +758,12 @@ int executeMacro(DocumentWidget *document, Program *prog, gsl::span<DataValue> a
 	   and a program counter) which will retain the program state across
 	   preemption and resumption of execution */
 
+	const size_t stackSize = std::max(INITIAL_STACK_SIZE, arguments.size() + FP_TO_ARGS_DIST + prog->localSymList.size());
+
 	auto context           = std::make_shared<MacroContext>();
-	context->Stack         = std::shared_ptr<DataValue>(new DataValue[STACK_SIZE], std::default_delete<DataValue[]>());
+	context->Stack         = allocateStack(stackSize);
 	context->StackP        = context->Stack.get();
+	context->StackEnd      = context->StackP + stackSize;
 	context->PC            = prog->code.data();
 	context->RunDocument   = document;
 	context->FocusDocument = document;
@@ -537,6 +788,10 @@ int executeMacro(DocumentWidget *document, Program *prog, gsl::span<DataValue> a
 		context->StackP++;
 	}
 
+	if (Profiling) {
+		profileCall(prog);
+	}
+
 	// Begin execution, return on error or preemption
 	return continueMacro(context, result, msg);
 }
@@ -547,7 +802,8 @@ int executeMacro(DocumentWidget *document, Program *prog, gsl::span<DataValue> a
 */
 ExecReturnCodes continueMacro(const std::shared_ptr<MacroContext> &continuation, DataValue *result, QString *msg) {
 
-	int instCount = 0;
+	QElapsedTimer sliceTimer;
+	sliceTimer.start();
 
 	/* To allow macros to be invoked arbitrarily (such as those automatically
 	   triggered within smart-indent) within executing macros, this call is
@@ -563,16 +819,32 @@ ExecReturnCodes continueMacro(const std::shared_ptr<MacroContext> &continuation,
 	*/
 	restoreContext(continuation);
 	ErrorMessage = nullptr;
+
+	const int64_t startNanoseconds = Context.Statistics.nanoseconds;
+	++Context.Statistics.slices;
+
 	Q_FOREVER {
 
-		// Execute an instruction
-		Inst *inst = Context.PC++;
+		/* Execute instructions until one returns something other than STAT_OK,
+		   or until it is time to check how long the slice has taken. Reading
+		   the clock is much more expensive than most instructions, so it isn't
+		   done for each one */
+		int status   = STAT_OK;
+		int executed = 0;
+		if (Profiling) {
+			status = executeProfiled(&executed);
+		} else {
+			do {
+				status = (Context.PC++)->func();
+			} while (status == STAT_OK && ++executed != TIME_CHECK_INTERVAL);
+		}
 
-		auto status = static_cast<OpStatusCodes>(inst->func());
+		Context.Statistics.instructions += executed;
 
 		// If error return was not STAT_OK, return to caller
 		switch (status) {
 		case STAT_PREEMPT:
+			Context.Statistics.nanoseconds = startNanoseconds + sliceTimer.nsecsElapsed();
 			saveContext(continuation);
 			restoreContext(&oldContext);
 			return MACRO_PREEMPT;
@@ -585,16 +857,17 @@ ExecReturnCodes continueMacro(const std::shared_ptr<MacroContext> &continuation,
 			*result = *--Context.StackP;
 			restoreContext(&oldContext);
 			return MACRO_DONE;
-		case STAT_OK:
+		default:
 			break;
 		}
 
-		/* Count instructions executed.  If the instruction limit is hit,
-		   preempt, store re-start information in continuation and give
-		   X, other macros, and other shell scripts a chance to execute */
-		++instCount;
+		/* If the time slice is used up, preempt, store re-start information
+		   in continuation and give X, other macros, and other shell scripts
+		   a chance to execute */
+		const int64_t elapsed          = sliceTimer.nsecsElapsed();
+		Context.Statistics.nanoseconds = startNanoseconds + elapsed;
 #if defined(ENABLE_PREEMPTION)
-		if (instCount >= INSTRUCTION_LIMIT) {
+		if (elapsed >= TimeSliceNanoseconds) {
 			saveContext(continuation);
 			restoreContext(&oldContext);
 			return MACRO_TIME_LIMIT;
@@ -603,6 +876,102 @@ ExecReturnCodes continueMacro(const std::shared_ptr<MacroContext> &continuation,
 	}
 }
 
+/*
+** Set how long a macro may execute before it is preempted to let the rest of
+** the editor run. Longer slices spend less time going around the event loop,
+** at the cost of making the editor less responsive while macros run.
+*/
+void SetMacroTimeSlice(int milliseconds) {
+	TimeSliceNanoseconds = std::max(1, milliseconds) * INT64_C(1000000);
+}
+
+/*
+** Called within a routine invoked from a macro, returns the execution
+** statistics of the macro which is running
+*/
+MacroStatistics CurrentMacroStatistics() {
+	return Context.Statistics;
+}
+
+/*
+** Turn the macro profiler on or off. Turning it on starts a new profile;
+** turning it off keeps the one gathered so far, for MacroProfileReport.
+** While it is off, the interpreter doesn't do any more work than it would
+** without it, aside from checking whether it is on.
+*/
+void SetMacroProfiling(bool enabled) {
+
+	if (enabled) {
+		FunctionProfiles.clear();
+		BuiltinProfiles.clear();
+		ProfiledProgram  = nullptr;
+		ProfiledFunction = nullptr;
+
+		if (!ProfileTimer.isValid()) {
+			ProfileTimer.start();
+		}
+	}
+
+	Profiling = enabled;
+}
+
+/*
+** Returns true if the macro profiler is on
+*/
+bool MacroProfilingEnabled() {
+	return Profiling;
+}
+
+/*
+** Returns a report of the profile gathered by the macro profiler: the calls,
+** instructions and time of each macro, with the instructions and time of each
+** of its lines, and the calls and time of each built-in routine. The time of
+** a macro or line includes that of the built-ins it calls, but not that of
+** the macros it calls. Macros and built-ins are listed with those which took
+** the longest first.
+*/
+std::string MacroProfileReport() {
+
+	auto byTime = [](const ProfileCounters &lhs, const ProfileCounters &rhs) {
+		return lhs.nanoseconds > rhs.nanoseconds;
+	};
+
+	std::vector<std::pair<std::string, const FunctionProfile *>> functions;
+	for (const auto &entry : FunctionProfiles) {
+		functions.emplace_back(entry.first, &entry.second);
+	}
+
+	std::stable_sort(functions.begin(), functions.end(), [&byTime](const auto &lhs, const auto &rhs) {
+		return byTime(lhs.second->total, rhs.second->total);
+	});
+
+	std::string report;
+	appendReportLine(&report, "%-32s %10s %14s %12s\n", "macro", "calls", "instructions", "ms");
+
+	for (const auto &function : functions) {
+		const ProfileCounters &total = function.second->total;
+		appendReportLine(&report, "%-32s %10lld %14lld %12.3f\n", function.first.c_str(), static_cast<long long>(total.calls), static_cast<long long>(total.instructions), static_cast<double>(total.nanoseconds) / 1.0e6);
+
+		for (const auto &line : function.second->lines) {
+			appendReportLine(&report, "    line %-23d %10s %14lld %12.3f\n", line.first, "", static_cast<long long>(line.second.instructions), static_cast<double>(line.second.nanoseconds) / 1.0e6);
+		}
+	}
+
+	std::vector<std::pair<std::string, ProfileCounters>> builtins(BuiltinProfiles.begin(), BuiltinProfiles.end());
+
+	std::stable_sort(builtins.begin(), builtins.end(), [&byTime](const auto &lhs, const auto &rhs) {
+		return byTime(lhs.second, rhs.second);
+	});
+
+	appendReportLine(&report, "\n%-32s %10s %14s %12s\n", "built-in", "calls", "", "ms");
+
+	for (const auto &builtin : builtins) {
+		appendReportLine(&report, "%-32s %10lld %14s %12.3f\n", builtin.first.c_str(), static_cast<long long>(builtin.second.calls), "", static_cast<double>(builtin.second.nanoseconds) / 1.0e6);
+	}
+
+	return report;
+}
+
 /*
 ** If a macro is already executing, and requests that another macro be run,
 ** this can be called instead of ExecuteMacro to run it in the same context
@@ -614,6 +983,14 @@ void RunMacroAsSubrCall(Program *prog) {
 
 	/* See "callSubroutine" for a description of the stack frame
 	   for a subroutine call */
+	if (!reserveStack(FP_TO_ARGS_DIST + prog->localSymList.size())) {
+		/* There is no room for the call, so the next instruction the running
+		   macro executes reports the overflow, and stops it */
+		static Inst overflow[] = {{stackOverflow}};
+		Context.PC             = overflow;
+		return;
+	}
+
 	*Context.StackP++ = make_value(Context.PC);     // return PC
 	*Context.StackP++ = make_value(Context.FrameP); // old FrameP
 	*Context.StackP++ = make_value(0);              // nArgs
@@ -626,6 +1003,10 @@ void RunMacroAsSubrCall(Program *prog) {
 		FP_GET_SYM_VAL(Context.FrameP, s) = make_value();
 		Context.StackP++;
 	}
+
+	if (Profiling) {
+		profileCall(prog);
+	}
 }
 
 /*
@@ -690,12 +1071,9 @@ Symbol *InstallIteratorSymbol() {
 */
 Symbol *LookupStringConstSymbol(view::string_view value) {
 
-	auto it = std::find_if(GlobalSymList.begin(), GlobalSymList.end(), [value](Symbol *s) {
-		return (s->type == CONST_SYM && is_string(s->value) && to_string(s->value) == value);
-	});
-
-	if (it != GlobalSymList.end()) {
-		return *it;
+	auto it = StringConstIndex.find(value.to_string());
+	if (it != StringConstIndex.end()) {
+		return it->second;
 	}
 
 	return nullptr;
@@ -732,21 +1110,15 @@ Symbol *LookupSymbolEx(const QString &name) {
 Symbol *LookupSymbol(view::string_view name) {
 
 	// first look for a local symbol
-	auto local = std::find_if(LocalSymList.begin(), LocalSymList.end(), [name](Symbol *s) {
-		return (s->name == name);
-	});
-
-	if (local != LocalSymList.end()) {
-		return *local;
+	auto local = LocalSymIndex.find(name);
+	if (local != LocalSymIndex.end()) {
+		return local->second;
 	}
 
 	// then a global symbol
-	auto global = std::find_if(GlobalSymList.begin(), GlobalSymList.end(), [name](Symbol *s) {
-		return (s->name == name);
-	});
-
-	if (global != GlobalSymList.end()) {
-		return *global;
+	auto global = GlobalSymIndex.find(name);
+	if (global != GlobalSymIndex.end()) {
+		return global->second;
 	}
 
 	return nullptr;
@@ -765,8 +1137,14 @@ Symbol *InstallSymbol(const std::string &name, SymTypes type, const DataValue &v
 
 	if (type == LOCAL_SYM) {
 		LocalSymList.push_front(s);
+		LocalSymIndex[s->name] = s;
 	} else {
 		GlobalSymList.push_back(s);
+		GlobalSymIndex.emplace(s->name, s);
+
+		if (type == CONST_SYM && is_string(value)) {
+			StringConstIndex.emplace(to_string(value), s);
+		}
 	}
 	return s;
 }
@@ -790,6 +1168,18 @@ Symbol *PromoteToGlobal(Symbol *sym) {
 	// Remove sym from the local symbol list
 	LocalSymList.erase(std::remove(LocalSymList.begin(), LocalSymList.end(), sym), LocalSymList.end());
 
+	/* If another local symbol has the same name, it becomes the one which is
+	   found by that name */
+	LocalSymIndex.erase(sym->name);
+
+	auto shadowed = std::find_if(LocalSymList.begin(), LocalSymList.end(), [sym](Symbol *s) {
+		return s->name == sym->name;
+	});
+
+	if (shadowed != LocalSymList.end()) {
+		LocalSymIndex.emplace((*shadowed)->name, *shadowed);
+	}
+
 	/* There are two scenarios which could make this check succeed:
 	   a) this sym is in the GlobalSymList as a LOCAL_SYM symbol
 	   b) there is another symbol as a non-LOCAL_SYM in the GlobalSymList
@@ -817,22 +1207,32 @@ Symbol *PromoteToGlobal(Symbol *sym) {
 	sym->type = GLOBAL_SYM;
 
 	GlobalSymList.push_back(sym);
+	GlobalSymIndex.emplace(sym->name, sym);
 
 	return sym;
 }
 
+/* Values are moved off of the stack, rather than copied, because nothing
+   reads a stack slot after it has been popped */
 #define POP(dataVal)                               \
 	do {                                           \
 		if (Context.StackP == Context.Stack.get()) \
 			return execError(StackUnderflowMsg);   \
-		(dataVal) = *--Context.StackP;             \
+		(dataVal) = std::move(*--Context.StackP);  \
 	} while (0)
 
-#define PUSH(dataVal)                                           \
-	do {                                                        \
-		if (Context.StackP >= &Context.Stack.get()[STACK_SIZE]) \
-			return execError(StackOverflowMsg);                 \
-		*Context.StackP++ = (dataVal);                          \
+/* When the stack is full, the value is copied before the stack grows, because
+   it may be one which is on the stack */
+#define PUSH(dataVal)                                   \
+	do {                                                \
+		if (Context.StackP == Context.StackEnd) {       \
+			DataValue pushedValue = (dataVal);          \
+			if (!growStack(1))                          \
+				return execError(StackOverflowMsg);     \
+			*Context.StackP++ = std::move(pushedValue); \
+		} else {                                        \
+			*Context.StackP++ = (dataVal);              \
+		}                                               \
 	} while (0)
 
 #define PEEK(dataVal, peekIndex)                       \
@@ -868,84 +1268,329 @@ Symbol *PromoteToGlobal(Symbol *sym) {
 		}                                                               \
 	} while (0)
 
-#define PUSH_INT(number)                                        \
-	do {                                                        \
-		if (Context.StackP >= &Context.Stack.get()[STACK_SIZE]) \
-			return execError(StackOverflowMsg);                 \
-		*Context.StackP++ = make_value(number);                 \
+#define PUSH_INT(number)                                         \
+	do {                                                         \
+		if (Context.StackP == Context.StackEnd && !growStack(1)) \
+			return execError(StackOverflowMsg);                  \
+		*Context.StackP++ = make_value(number);                  \
 	} while (0)
 
-#define PUSH_STRING(string)                                     \
-	do {                                                        \
-		if (Context.StackP >= &Context.Stack.get()[STACK_SIZE]) \
-			return execError(StackOverflowMsg);                 \
-		*Context.StackP++ = make_value(string);                 \
+#define BINARY_NUMERIC_OPERATION(Operation) \
+	do {                                    \
+		int64_t n1;                         \
+		int64_t n2;                         \
+		DISASM_RT(PC - 1, 1);               \
+		STACKDUMP(2, 3);                    \
+		if (applyToIntegers<Operation>()) { \
+			return STAT_OK;                 \
+		}                                   \
+		POP_INT(n2);                        \
+		POP_INT(n1);                        \
+		Operation::apply(n1, n2);           \
+		PUSH_INT(n1);                       \
+		return STAT_OK;                     \
 	} while (0)
 
-#define BINARY_NUMERIC_OPERATION(op) \
-	do {                             \
-		int n1;                      \
-		int n2;                      \
-		DISASM_RT(PC - 1, 1);        \
-		STACKDUMP(2, 3);             \
-		POP_INT(n2);                 \
-		POP_INT(n1);                 \
-		PUSH_INT(n1 op n2);          \
-		return STAT_OK;              \
+#define UNARY_NUMERIC_OPERATION(Operation)                                   \
+	do {                                                                     \
+		int64_t n;                                                           \
+		DISASM_RT(PC - 1, 1);                                                \
+		STACKDUMP(1, 3);                                                     \
+		if (Context.StackP != Context.Stack.get()) {                         \
+			if (auto top = boost::get<int64_t>(&Context.StackP[-1].value)) { \
+				Operation::apply(*top);                                      \
+				return STAT_OK;                                              \
+			}                                                                \
+		}                                                                    \
+		POP_INT(n);                                                          \
+		Operation::apply(n);                                                 \
+		PUSH_INT(n);                                                         \
+		return STAT_OK;                                                      \
 	} while (0)
 
-#define UNARY_NUMERIC_OPERATION(op) \
-	do {                            \
-		int n;                      \
-		DISASM_RT(PC - 1, 1);       \
-		STACKDUMP(1, 3);            \
-		POP_INT(n);                 \
-		PUSH_INT(op n);             \
-		return STAT_OK;             \
-	} while (0)
+namespace {
 
-/*
-** copy a symbol's value onto the stack
-** Before: Prog->  [Sym], next, ...
-**         TheStack-> next, ...
-** After:  Prog->  Sym, [next], ...
-**         TheStack-> [symVal], next, ...
-*/
-static int pushSymVal() {
+/* Macro integers are 64 bit, and arithmetic which overflows wraps around,
+   as it would for two's complement integers, rather than being undefined.
+   The sums are done unsigned, where wrapping around is well defined */
+int64_t wrappingAdd(int64_t n1, int64_t n2) {
+	return static_cast<int64_t>(static_cast<uint64_t>(n1) + static_cast<uint64_t>(n2));
+}
 
-	DataValue symVal;
+int64_t wrappingSubtract(int64_t n1, int64_t n2) {
+	return static_cast<int64_t>(static_cast<uint64_t>(n1) - static_cast<uint64_t>(n2));
+}
 
-	DISASM_RT(PC - 1, 2);
-	STACKDUMP(0, 3);
+int64_t wrappingMultiply(int64_t n1, int64_t n2) {
+	return static_cast<int64_t>(static_cast<uint64_t>(n1) * static_cast<uint64_t>(n2));
+}
 
-	Symbol *s = Context.PC++->sym;
+/* Integer operations, shared by the operators and the superinstructions.
+   Each replaces n1 with the result of the operation, or returns false if the
+   operation can't be done, leaving it to the general code to report why */
+struct IntegerAdd {
+	static bool apply(int64_t &n1, int64_t n2) {
+		n1 = wrappingAdd(n1, n2);
+		return true;
+	}
+};
 
-	if (s->type == LOCAL_SYM) {
-		symVal = FP_GET_SYM_VAL(Context.FrameP, s);
-	} else if (s->type == GLOBAL_SYM || s->type == CONST_SYM) {
-		symVal = s->value;
-	} else if (s->type == ARG_SYM) {
-		int nArgs  = FP_GET_ARG_COUNT(Context.FrameP);
-		int argNum = to_integer(s->value);
-		if (argNum >= nArgs) {
-			return execError("referenced undefined argument: %s", s->name.c_str());
-		}
-		if (argNum == N_ARGS_ARG_SYM) {
-			symVal = make_value(nArgs);
-		} else {
-			symVal = FP_GET_ARG_N(Context.FrameP, argNum);
-		}
-	} else if (s->type == PROC_VALUE_SYM) {
+struct IntegerSubtract {
+	static bool apply(int64_t &n1, int64_t n2) {
+		n1 = wrappingSubtract(n1, n2);
+		return true;
+	}
+};
 
-		if (std::error_code ec = (to_subroutine(s->value))(Context.FocusDocument, {}, &symVal)) {
-			return execError(ec, s->name.c_str());
-		}
-	} else {
-		return execError("reading non-variable: %s", s->name.c_str());
+struct IntegerMultiply {
+	static bool apply(int64_t &n1, int64_t n2) {
+		n1 = wrappingMultiply(n1, n2);
+		return true;
 	}
+};
 
-	if (is_unset(symVal)) {
-		return execError("variable not set: %s", s->name.c_str());
+// the one quotient which doesn't fit, INT64_MIN / -1, wraps around to INT64_MIN
+struct IntegerDivide {
+	static bool apply(int64_t &n1, int64_t n2) {
+		if (n2 == 0) {
+			return false;
+		}
+		n1 = (n2 == -1) ? wrappingSubtract(0, n1) : n1 / n2;
+		return true;
+	}
+};
+
+struct IntegerModulo {
+	static bool apply(int64_t &n1, int64_t n2) {
+		if (n2 == 0) {
+			return false;
+		}
+		n1 = (n2 == -1) ? 0 : n1 % n2;
+		return true;
+	}
+};
+
+struct IntegerGreater {
+	static bool apply(int64_t &n1, int64_t n2) {
+		n1 = n1 > n2;
+		return true;
+	}
+};
+
+struct IntegerLess {
+	static bool apply(int64_t &n1, int64_t n2) {
+		n1 = n1 < n2;
+		return true;
+	}
+};
+
+struct IntegerGreaterEqual {
+	static bool apply(int64_t &n1, int64_t n2) {
+		n1 = n1 >= n2;
+		return true;
+	}
+};
+
+struct IntegerLessEqual {
+	static bool apply(int64_t &n1, int64_t n2) {
+		n1 = n1 <= n2;
+		return true;
+	}
+};
+
+struct IntegerEqual {
+	static bool apply(int64_t &n1, int64_t n2) {
+		n1 = n1 == n2;
+		return true;
+	}
+};
+
+struct IntegerNotEqual {
+	static bool apply(int64_t &n1, int64_t n2) {
+		n1 = n1 != n2;
+		return true;
+	}
+};
+
+struct IntegerBitAnd {
+	static bool apply(int64_t &n1, int64_t n2) {
+		n1 &= n2;
+		return true;
+	}
+};
+
+struct IntegerBitOr {
+	static bool apply(int64_t &n1, int64_t n2) {
+		n1 |= n2;
+		return true;
+	}
+};
+
+struct IntegerAnd {
+	static bool apply(int64_t &n1, int64_t n2) {
+		n1 = n1 && n2;
+		return true;
+	}
+};
+
+struct IntegerOr {
+	static bool apply(int64_t &n1, int64_t n2) {
+		n1 = n1 || n2;
+		return true;
+	}
+};
+
+struct IntegerNegate {
+	static void apply(int64_t &n) {
+		n = wrappingSubtract(0, n);
+	}
+};
+
+struct IntegerIncrement {
+	static void apply(int64_t &n) {
+		n = wrappingAdd(n, 1);
+	}
+};
+
+struct IntegerDecrement {
+	static void apply(int64_t &n) {
+		n = wrappingSubtract(n, 1);
+	}
+};
+
+struct IntegerNot {
+	static void apply(int64_t &n) {
+		n = !n;
+	}
+};
+
+}
+
+/*
+** If the top two values on the stack are both integers, replaces them with
+** the result of "Operation", in place, without copying values on and off of
+** the stack. Returns false, leaving the stack alone, if anything else is
+** needed
+*/
+template <class Operation>
+static bool applyToIntegers() {
+
+	if (Context.StackP - Context.Stack.get() < 2) {
+		return false;
+	}
+
+	auto n1 = boost::get<int64_t>(&Context.StackP[-2].value);
+	auto n2 = boost::get<int64_t>(&Context.StackP[-1].value);
+	if (!n1 || !n2 || !Operation::apply(*n1, *n2)) {
+		return false;
+	}
+
+	--Context.StackP;
+	return true;
+}
+
+/*
+** Returns the value of a symbol which can be read directly, without side
+** effects or errors (aside from not being set yet), or nullptr if reading
+** it needs the general handling of pushSymVal
+*/
+static const DataValue *directSymVal(Symbol *s) {
+	switch (s->type) {
+	case LOCAL_SYM:
+		return &FP_GET_SYM_VAL(Context.FrameP, s);
+	case GLOBAL_SYM:
+	case CONST_SYM:
+		return &s->value;
+	case ARG_SYM: {
+		const auto argNum = static_cast<int>(to_integer(s->value));
+		if (argNum >= 0 && argNum < FP_GET_ARG_COUNT(Context.FrameP)) {
+			return &FP_GET_ARG_N(Context.FrameP, argNum);
+		}
+		return nullptr;
+	}
+	default:
+		return nullptr;
+	}
+}
+
+/*
+** Reads the value of a symbol, if it is an integer which can be read
+** directly
+*/
+static bool symInteger(Symbol *s, int64_t *n) {
+	if (const DataValue *value = directSymVal(s)) {
+		if (auto p = boost::get<int64_t>(&value->value)) {
+			*n = *p;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+** Returns where the value of a variable is stored, if it can be assigned
+** to directly
+*/
+static DataValue *assignableSymVal(Symbol *s) {
+	switch (s->type) {
+	case LOCAL_SYM:
+		return &FP_GET_SYM_VAL(Context.FrameP, s);
+	case GLOBAL_SYM:
+		return &s->value;
+	default:
+		return nullptr;
+	}
+}
+
+/*
+** copy a symbol's value onto the stack
+** Before: Prog->  [Sym], next, ...
+**         TheStack-> next, ...
+** After:  Prog->  Sym, [next], ...
+**         TheStack-> [symVal], next, ...
+*/
+static int pushSymVal() {
+
+	DataValue symVal;
+
+	DISASM_RT(PC - 1, 2);
+	STACKDUMP(0, 3);
+
+	Symbol *s = Context.PC++->sym;
+
+	// most symbols are variables, which are pushed without making a copy first
+	if (const DataValue *value = directSymVal(s)) {
+		if (is_unset(*value)) {
+			return execError("variable not set: %s", s->name.c_str());
+		}
+
+		PUSH(*value);
+		return STAT_OK;
+	}
+
+	if (s->type == ARG_SYM) {
+		int nArgs  = FP_GET_ARG_COUNT(Context.FrameP);
+		auto argNum = static_cast<int>(to_integer(s->value));
+		if (argNum >= nArgs) {
+			return execError("referenced undefined argument: %s", s->name.c_str());
+		}
+		if (argNum == N_ARGS_ARG_SYM) {
+			symVal = make_value(nArgs);
+		} else {
+			symVal = FP_GET_ARG_N(Context.FrameP, argNum);
+		}
+	} else if (s->type == PROC_VALUE_SYM) {
+
+		if (std::error_code ec = (to_subroutine(s->value))(Context.FocusDocument, {}, &symVal)) {
+			return execError(ec, s->name.c_str());
+		}
+	} else {
+		return execError("reading non-variable: %s", s->name.c_str());
+	}
+
+	if (is_unset(symVal)) {
+		return execError("variable not set: %s", s->name.c_str());
 	}
 
 	PUSH(symVal);
@@ -954,7 +1599,7 @@ static int pushSymVal() {
 }
 
 static int pushArgVal() {
-	int argNum;
+	int64_t argNum;
 
 	DISASM_RT(PC - 1, 1);
 	STACKDUMP(1, 3);
@@ -967,7 +1612,7 @@ static int pushArgVal() {
 		auto argStr = std::to_string(argNum + 1);
 		return execError("referenced undefined argument: $args[%s]", argStr.c_str());
 	}
-	PUSH(FP_GET_ARG_N(Context.FrameP, argNum));
+	PUSH(FP_GET_ARG_N(Context.FrameP, static_cast<int>(argNum)));
 	return STAT_OK;
 }
 
@@ -995,10 +1640,8 @@ static int pushArgArray() {
 
 		for (int argNum = 0; argNum < nArgs; ++argNum) {
 
-			auto intStr = std::to_string(argNum);
-
 			argVal = FP_GET_ARG_N(Context.FrameP, argNum);
-			if (!ArrayInsert(resultArray, intStr, &argVal)) {
+			if (!ArrayInsert(resultArray, argNum, &argVal)) {
 				return execError("array insertion failure");
 			}
 		}
@@ -1087,7 +1730,7 @@ static int assign() {
 		return ArrayCopy(dataPtr, &value);
 	}
 
-	*dataPtr = value;
+	*dataPtr = std::move(value);
 	return STAT_OK;
 }
 
@@ -1123,62 +1766,38 @@ static int add() {
 	DISASM_RT(PC - 1, 1);
 	STACKDUMP(2, 3);
 
+	if (applyToIntegers<IntegerAdd>()) {
+		return STAT_OK;
+	}
+
 	PEEK(rightVal, 0);
 	if (is_array(rightVal)) {
 
 		PEEK(leftVal, 1);
 		if (is_array(leftVal)) {
 
-			DataValue resultArray = make_value(std::make_shared<Array>());
-
 			POP(rightVal);
 			POP(leftVal);
 
-			const ArrayPtr &leftMap  = to_array(leftVal);
-			const ArrayPtr &rightMap = to_array(rightVal);
-
-			auto leftIter  = leftMap->begin();
-			auto rightIter = rightMap->begin();
+			// starting from the left array shares its contents until the first insertion
+			auto result = std::make_shared<Array>(*to_array(leftVal));
 
-			while (leftIter != leftMap->end() || rightIter != rightMap->end()) {
+			to_array(rightVal)->forEach([&result](const std::string &key, const DataValue &value) {
+				result->insert(key, value);
+			});
 
-				bool insertResult = true;
-
-				if (leftIter != leftMap->end() && rightIter != rightMap->end()) {
-					int compareResult = leftIter->first.compare(rightIter->first);
-					if (compareResult < 0) {
-						insertResult = ArrayInsert(&resultArray, leftIter->first, &leftIter->second);
-						++leftIter;
-					} else if (compareResult > 0) {
-						insertResult = ArrayInsert(&resultArray, rightIter->first, &rightIter->second);
-						++rightIter;
-					} else {
-						insertResult = ArrayInsert(&resultArray, rightIter->first, &rightIter->second);
-						++leftIter;
-						++rightIter;
-					}
-				} else if (leftIter != leftMap->end()) {
-					insertResult = ArrayInsert(&resultArray, leftIter->first, &leftIter->second);
-					++leftIter;
-				} else {
-					insertResult = ArrayInsert(&resultArray, rightIter->first, &rightIter->second);
-					++rightIter;
-				}
-				if (!insertResult) {
-					return execError("array insertion failure");
-				}
-			}
-			PUSH(resultArray);
+			PUSH(make_value(result));
 		} else {
 			return execError("can't mix math with arrays and non-arrays");
 		}
 	} else {
-		int n1;
-		int n2;
+		int64_t n1;
+		int64_t n2;
 
 		POP_INT(n2);
 		POP_INT(n1);
-		PUSH_INT(n1 + n2);
+		IntegerAdd::apply(n1, n2);
+		PUSH_INT(n1);
 	}
 	return STAT_OK;
 }
@@ -1198,55 +1817,36 @@ static int subtract() {
 	DISASM_RT(PC - 1, 1);
 	STACKDUMP(2, 3);
 
+	if (applyToIntegers<IntegerSubtract>()) {
+		return STAT_OK;
+	}
+
 	PEEK(rightVal, 0);
 	if (is_array(rightVal)) {
 		PEEK(leftVal, 1);
 		if (is_array(leftVal)) {
 
-			DataValue resultArray = make_value(std::make_shared<Array>());
-
 			POP(rightVal);
 			POP(leftVal);
 
-			const ArrayPtr &leftMap  = to_array(leftVal);
-			const ArrayPtr &rightMap = to_array(rightVal);
-
-			auto leftIter  = leftMap->begin();
-			auto rightIter = rightMap->begin();
-
-			while (leftIter != leftMap->end()) {
-				bool insertResult = true;
-
-				if (leftIter != leftMap->end() && rightIter != rightMap->end()) {
-					int compareResult = leftIter->first.compare(rightIter->first);
-					if (compareResult < 0) {
-						insertResult = ArrayInsert(&resultArray, leftIter->first, &leftIter->second);
-						++leftIter;
-					} else if (compareResult > 0) {
-						++rightIter;
-					} else {
-						++leftIter;
-						++rightIter;
-					}
-				} else if (leftIter != leftMap->end()) {
-					insertResult = ArrayInsert(&resultArray, leftIter->first, &leftIter->second);
-					++leftIter;
-				}
-				if (!insertResult) {
-					return execError("array insertion failure");
-				}
-			}
-			PUSH(resultArray);
+			auto result = std::make_shared<Array>(*to_array(leftVal));
+
+			to_array(rightVal)->forEach([&result](const std::string &key, const DataValue &) {
+				result->erase(key);
+			});
+
+			PUSH(make_value(result));
 		} else {
 			return execError("can't mix math with arrays and non-arrays");
 		}
 	} else {
-		int n1;
-		int n2;
+		int64_t n1;
+		int64_t n2;
 
 		POP_INT(n2);
 		POP_INT(n1);
-		PUSH_INT(n1 - n2);
+		IntegerSubtract::apply(n1, n2);
+		PUSH_INT(n1);
 	}
 	return STAT_OK;
 }
@@ -1261,67 +1861,75 @@ static int subtract() {
 ** After:  TheStack-> resValue, next, ...
 */
 static int multiply() {
-	BINARY_NUMERIC_OPERATION(*);
+	BINARY_NUMERIC_OPERATION(IntegerMultiply);
 }
 
 static int divide() {
-	int n1;
-	int n2;
+	int64_t n1;
+	int64_t n2;
 
 	DISASM_RT(PC - 1, 1);
 	STACKDUMP(2, 3);
 
+	if (applyToIntegers<IntegerDivide>()) {
+		return STAT_OK;
+	}
+
 	POP_INT(n2);
 	POP_INT(n1);
-	if (n2 == 0) {
+	if (!IntegerDivide::apply(n1, n2)) {
 		return execError("division by zero");
 	}
-	PUSH_INT(n1 / n2);
+	PUSH_INT(n1);
 	return STAT_OK;
 }
 
 static int modulo() {
-	int n1;
-	int n2;
+	int64_t n1;
+	int64_t n2;
 
 	DISASM_RT(PC - 1, 1);
 	STACKDUMP(2, 3);
 
+	if (applyToIntegers<IntegerModulo>()) {
+		return STAT_OK;
+	}
+
 	POP_INT(n2);
 	POP_INT(n1);
-	if (n2 == 0) {
+	if (!IntegerModulo::apply(n1, n2)) {
 		return execError("modulo by zero");
 	}
-	PUSH_INT(n1 % n2);
+	PUSH_INT(n1);
 	return STAT_OK;
 }
 
 static int negate() {
-	UNARY_NUMERIC_OPERATION(-);
+	UNARY_NUMERIC_OPERATION(IntegerNegate);
 }
 
 static int increment() {
-	UNARY_NUMERIC_OPERATION(++);
+	UNARY_NUMERIC_OPERATION(IntegerIncrement);
 }
 
 static int decrement() {
-	UNARY_NUMERIC_OPERATION(--);
+	UNARY_NUMERIC_OPERATION(IntegerDecrement);
 }
 
 static int gt() {
-	BINARY_NUMERIC_OPERATION(>);
+	BINARY_NUMERIC_OPERATION(IntegerGreater);
 }
 
 static int lt() {
-	BINARY_NUMERIC_OPERATION(<);
+	BINARY_NUMERIC_OPERATION(IntegerLess);
 }
 
 static int ge() {
-	BINARY_NUMERIC_OPERATION(>=);
+	BINARY_NUMERIC_OPERATION(IntegerGreaterEqual);
 }
 
 static int le() {
-	BINARY_NUMERIC_OPERATION(<=);
+	BINARY_NUMERIC_OPERATION(IntegerLessEqual);
 }
 
 /*
@@ -1337,6 +1945,10 @@ static int eq() {
 	DISASM_RT(PC - 1, 1);
 	STACKDUMP(2, 3);
 
+	if (applyToIntegers<IntegerEqual>()) {
+		return STAT_OK;
+	}
+
 	POP(v1);
 	POP(v2);
 
@@ -1345,18 +1957,18 @@ static int eq() {
 		auto n2 = to_integer(v2);
 		v1      = make_value(n1 == n2);
 	} else if (is_string(v1) && is_string(v2)) {
-		auto s1 = to_string(v1);
-		auto s2 = to_string(v2);
+		auto s1 = to_string_view(v1);
+		auto s2 = to_string_view(v2);
 		v1      = make_value(s1 == s2);
 	} else if (is_string(v1) && is_integer(v2)) {
-		int number;
+		int64_t number;
 		if (!StringToNum(to_string(v1), &number)) {
 			v1 = make_value(0);
 		} else {
 			v1 = make_value(number == to_integer(v2));
 		}
 	} else if (is_string(v2) && is_integer(v1)) {
-		int number;
+		int64_t number;
 		if (!StringToNum(to_string(v2), &number)) {
 			v1 = make_value(0);
 		} else {
@@ -1372,6 +1984,10 @@ static int eq() {
 
 // negated eq() call
 static int ne() {
+	if (applyToIntegers<IntegerNotEqual>()) {
+		return STAT_OK;
+	}
+
 	eq();
 	return logicalNot();
 }
@@ -1391,50 +2007,39 @@ static int bitAnd() {
 	DISASM_RT(PC - 1, 1);
 	STACKDUMP(2, 3);
 
+	if (applyToIntegers<IntegerBitAnd>()) {
+		return STAT_OK;
+	}
+
 	PEEK(rightVal, 0);
 	if (is_array(rightVal)) {
 		PEEK(leftVal, 1);
 		if (is_array(leftVal)) {
 
-			DataValue resultArray = make_value(std::make_shared<Array>());
-
 			POP(rightVal);
 			POP(leftVal);
 
-			const ArrayPtr &leftMap  = to_array(leftVal);
-			const ArrayPtr &rightMap = to_array(rightVal);
-
-			auto leftIter  = leftMap->begin();
-			auto rightIter = rightMap->begin();
-
-			while (leftIter != leftMap->end() && rightIter != rightMap->end()) {
-				bool insertResult = true;
-				int compareResult = leftIter->first.compare(rightIter->first);
+			const ArrayPtr leftArray = to_array(leftVal);
+			auto result              = std::make_shared<Array>();
 
-				if (compareResult < 0) {
-					++leftIter;
-				} else if (compareResult > 0) {
-					++rightIter;
-				} else {
-					insertResult = ArrayInsert(&resultArray, rightIter->first, &rightIter->second);
-					++leftIter;
-					++rightIter;
-				}
-				if (!insertResult) {
-					return execError("array insertion failure");
+			to_array(rightVal)->forEach([&leftArray, &result](const std::string &key, const DataValue &value) {
+				if (leftArray->find(key)) {
+					result->insert(key, value);
 				}
-			}
-			PUSH(resultArray);
+			});
+
+			PUSH(make_value(result));
 		} else {
 			return execError("can't mix math with arrays and non-arrays");
 		}
 	} else {
-		int n1;
-		int n2;
+		int64_t n1;
+		int64_t n2;
 
 		POP_INT(n2);
 		POP_INT(n1);
-		PUSH_INT(n1 & n2);
+		IntegerBitAnd::apply(n1, n2);
+		PUSH_INT(n1);
 	}
 	return STAT_OK;
 }
@@ -1454,72 +2059,59 @@ static int bitOr() {
 	DISASM_RT(PC - 1, 1);
 	STACKDUMP(2, 3);
 
+	if (applyToIntegers<IntegerBitOr>()) {
+		return STAT_OK;
+	}
+
 	PEEK(rightVal, 0);
 	if (is_array(rightVal)) {
 		PEEK(leftVal, 1);
 		if (is_array(leftVal)) {
 
-			DataValue resultArray = make_value(std::make_shared<Array>());
-
 			POP(rightVal);
 			POP(leftVal);
 
-			const ArrayPtr &leftMap  = to_array(leftVal);
-			const ArrayPtr &rightMap = to_array(rightVal);
-
-			auto leftIter  = leftMap->begin();
-			auto rightIter = rightMap->begin();
-
-			while (leftIter != leftMap->end() || rightIter != rightMap->end()) {
-				bool insertResult = true;
-
-				if (leftIter != leftMap->end() && rightIter != rightMap->end()) {
-					int compareResult = leftIter->first.compare(rightIter->first);
-					if (compareResult < 0) {
-						insertResult = ArrayInsert(&resultArray, leftIter->first, &leftIter->second);
-						++leftIter;
-					} else if (compareResult > 0) {
-						insertResult = ArrayInsert(&resultArray, rightIter->first, &rightIter->second);
-						++rightIter;
-					} else {
-						++leftIter;
-						++rightIter;
-					}
-				} else if (leftIter != leftMap->end()) {
-					insertResult = ArrayInsert(&resultArray, leftIter->first, &leftIter->second);
-					++leftIter;
-				} else {
-					insertResult = ArrayInsert(&resultArray, rightIter->first, &rightIter->second);
-					++rightIter;
+			const ArrayPtr leftArray  = to_array(leftVal);
+			const ArrayPtr rightArray = to_array(rightVal);
+			auto result               = std::make_shared<Array>();
+
+			leftArray->forEach([&rightArray, &result](const std::string &key, const DataValue &value) {
+				if (!rightArray->find(key)) {
+					result->insert(key, value);
 				}
-				if (!insertResult) {
-					return execError("array insertion failure");
+			});
+
+			rightArray->forEach([&leftArray, &result](const std::string &key, const DataValue &value) {
+				if (!leftArray->find(key)) {
+					result->insert(key, value);
 				}
-			}
-			PUSH(resultArray);
+			});
+
+			PUSH(make_value(result));
 		} else {
 			return execError("can't mix math with arrays and non-arrays");
 		}
 	} else {
-		int n1;
-		int n2;
+		int64_t n1;
+		int64_t n2;
 		POP_INT(n2);
 		POP_INT(n1);
-		PUSH_INT(n1 | n2);
+		IntegerBitOr::apply(n1, n2);
+		PUSH_INT(n1);
 	}
 	return STAT_OK;
 }
 
 static int logicalAnd() {
-	BINARY_NUMERIC_OPERATION(&&);
+	BINARY_NUMERIC_OPERATION(IntegerAnd);
 }
 
 static int logicalOr() {
-	BINARY_NUMERIC_OPERATION(||);
+	BINARY_NUMERIC_OPERATION(IntegerOr);
 }
 
 static int logicalNot() {
-	UNARY_NUMERIC_OPERATION(!);
+	UNARY_NUMERIC_OPERATION(IntegerNot);
 }
 
 /*
@@ -1528,61 +2120,81 @@ static int logicalNot() {
 ** After:  TheStack-> result, next, ...
 */
 static int power() {
-	int n1;
-	int n2;
-	int n3;
+	int64_t n1;
+	int64_t n2;
+	int64_t n3;
 
 	DISASM_RT(PC - 1, 1);
 	STACKDUMP(2, 3);
 
 	POP_INT(n2);
 	POP_INT(n1);
-	/*  We need to round to deal with pow() giving results slightly above
-		or below the real result since it deals with floating point numbers.
-		Note: We're not really wanting rounded results, we merely
-		want to deal with this simple issue. So, 2^-2 = .5, but we
-		don't want to round this to 1. This is mainly intended to deal with
-		4^2 = 15.999996 and 16.000001.
-	*/
 
 	if (n2 < 0 && n1 != 1 && n1 != -1) {
-		if (n1 != 0) {
-			// since we're integer only, nearly all negative exponents result in 0
-			n3 = 0;
-		} else {
-			// allow error to occur
-			n3 = static_cast<int>(pow(static_cast<double>(n1), static_cast<double>(n2)));
+		if (n1 == 0) {
+			return execError("exponentiation result out of range");
 		}
+
+		// since we're integer only, nearly all negative exponents result in 0
+		n3 = 0;
 	} else {
-		// round to nearest integer
-		// NOTE(eteran): this use to detect if the result would be negative and round by adding/subtracting
-		// 0.5 before the final cast to int
-		// this SHOULD be the equivalent to that
-		n3 = static_cast<int>(std::lround(pow(static_cast<double>(n1), static_cast<double>(n2))));
+		/* Exponentiation by squaring, which is exact, and wraps around on
+		   overflow like the other operators. The only negative exponents
+		   which get here are those of 1 and -1, which only need the parity */
+		auto exponent = (n2 < 0) ? 0 - static_cast<uint64_t>(n2) : static_cast<uint64_t>(n2);
+		int64_t base  = n1;
+
+		n3 = 1;
+		while (exponent != 0) {
+			if (exponent & 1) {
+				n3 = wrappingMultiply(n3, base);
+			}
+			base = wrappingMultiply(base, base);
+			exponent >>= 1;
+		}
 	}
 
 	PUSH_INT(n3);
-	return errCheck("exponentiation");
+	return STAT_OK;
 }
 
 /*
 ** concatenate two top items on the stack
 ** Before: TheStack-> str2, str1, next, ...
 ** After:  TheStack-> result, next, ...
+**
+** str1 is extended in place, and str2 appended to it straight from the
+** stack, so that building up a string a piece at a time doesn't copy all of
+** it each time (see MacroString)
 */
 static int concat() {
-	std::string s1;
-	std::string s2;
 
 	DISASM_RT(PC - 1, 1);
 	STACKDUMP(2, 3);
 
-	POP_STRING(s2);
-	POP_STRING(s1);
+	if (Context.StackP - Context.Stack.get() < 2) {
+		return execError(StackUnderflowMsg);
+	}
+
+	DataValue &left  = Context.StackP[-2];
+	DataValue &right = Context.StackP[-1];
+
+	if ((!is_integer(left) && !is_string(left)) || (!is_integer(right) && !is_string(right))) {
+		return execError(CantConvertArrayToString);
+	}
+
+	if (is_integer(left)) {
+		left = make_value(std::to_string(to_integer(left)));
+	}
 
-	std::string out = s1 + s2;
+	auto &result = boost::get<MacroString>(left.value);
+	if (is_integer(right)) {
+		result.append(std::to_string(to_integer(right)));
+	} else {
+		result.append(to_string_view(right));
+	}
 
-	PUSH_STRING(out);
+	--Context.StackP;
 	return STAT_OK;
 }
 
@@ -1623,7 +2235,18 @@ static int callSubroutine() {
 		// Call the function and check for preemption
 		PreemptRequest = false;
 
-		if (std::error_code ec = to_subroutine(sym->value)(Context.FocusDocument, Arguments(Context.StackP, nArgs), &result)) {
+		const bool profiled = Profiling;
+		const int64_t start = profiled ? ProfileTimer.nsecsElapsed() : 0;
+
+		const std::error_code ec = to_subroutine(sym->value)(Context.FocusDocument, Arguments(Context.StackP, nArgs), &result);
+
+		if (profiled && Profiling) {
+			ProfileCounters &counters = BuiltinProfiles[sym->name];
+			++counters.calls;
+			counters.nanoseconds += ProfileTimer.nsecsElapsed() - start;
+		}
+
+		if (ec) {
 			return execError(ec, sym->name.c_str());
 		}
 
@@ -1648,6 +2271,11 @@ static int callSubroutine() {
 	** values which are already there.
 	*/
 	if (sym->type == MACRO_FUNCTION_SYM) {
+		Program *prog = to_program(sym->value);
+
+		if (!reserveStack(FP_TO_ARGS_DIST + prog->localSymList.size())) {
+			return execError(StackOverflowMsg);
+		}
 
 		*Context.StackP++ = make_value(Context.PC);     // return PC
 		*Context.StackP++ = make_value(Context.FrameP); // old FrameP
@@ -1655,13 +2283,16 @@ static int callSubroutine() {
 		*Context.StackP++ = make_value();               // cached arg array
 
 		Context.FrameP = Context.StackP;
-		Program *prog  = to_program(sym->value);
 		Context.PC     = prog->code.data();
 
 		for (Symbol *s : prog->localSymList) {
 			FP_GET_SYM_VAL(Context.FrameP, s) = make_value();
 			Context.StackP++;
 		}
+
+		if (Profiling) {
+			profileCall(prog);
+		}
 		return STAT_OK;
 	}
 
@@ -1759,7 +2390,7 @@ static int branch() {
 ** After:  or:     Prog->  branchDest, next, ..., (branchdest)[next]
 */
 static int branchTrue() {
-	int value;
+	int64_t value;
 
 	DISASM_RT(PC - 1, 2);
 	STACKDUMP(1, 3);
@@ -1776,7 +2407,7 @@ static int branchTrue() {
 }
 
 static int branchFalse() {
-	int value;
+	int64_t value;
 
 	DISASM_RT(PC - 1, 2);
 	STACKDUMP(1, 3);
@@ -1809,95 +2440,811 @@ static int branchNever() {
 }
 
 /*
-** recursively copy(duplicate) the sparse array nodes of an array
-** this does not duplicate the key/node data since they are never
-** modified, only replaced
+** Superinstructions: each stands for a common sequence of instructions, and
+** performs the whole of it in one step when all of the values involved are
+** integers which can be read directly. Only the first word of the sequence
+** is replaced (see fuseInstructions), so when anything else is involved, a
+** superinstruction just performs that first instruction (a PUSH_SYM) and
+** execution carries on through the rest of the sequence as normal. The
+** instructions skipped are counted as though they had been executed.
+**
+** pushSymsAndOperate:
+** Before: Prog->  [sym1], PUSH_SYM, sym2, OP, next, ...
+** After:  Prog->  sym1, PUSH_SYM, sym2, OP, [next], ...
+**         TheStack-> [result], next, ...
 */
-int ArrayCopy(DataValue *dstArray, const DataValue *srcArray) {
-	*dstArray = *srcArray;
+template <class Operation>
+static int pushSymsAndOperate() {
+
+	Inst *const pc = Context.PC;
+
+	int64_t n1;
+	int64_t n2;
+	if (!symInteger(pc[0].sym, &n1) || !symInteger(pc[2].sym, &n2) || !Operation::apply(n1, n2)) {
+		return pushSymVal();
+	}
+
+	PUSH_INT(n1);
+	Context.PC = pc + 4;
+	Context.Statistics.instructions += 2;
 	return STAT_OK;
 }
 
 /*
-** creates a string of a single key for all the sub-scripts
-** using ARRAY_DIM_SEP as a separator
-** this function uses the PEEK macros in order to remove most limits on
-** the number of arguments to an array
+** pushSymsOperateAndBranchFalse:
+** Before: Prog->  [sym1], PUSH_SYM, sym2, OP, BRANCH_FALSE, branchDest, next, ...
+** After:  either: Prog->  ..., BRANCH_FALSE, branchDest, [next], ...
+**         or:     Prog->  ..., (branchDest)[next]
 */
-static int makeArrayKeyFromArgs(int64_t nArgs, std::string *keyString, bool leaveParams) {
-	DataValue tmpVal;
-
-	std::string str;
+template <class Operation>
+static int pushSymsOperateAndBranchFalse() {
 
-	for (int64_t i = nArgs - 1; i >= 0; --i) {
-		if (i != nArgs - 1) {
-			str.append(ARRAY_DIM_SEP);
-		}
-		PEEK(tmpVal, i);
-		if (is_integer(tmpVal)) {
-			str.append(std::to_string(to_integer(tmpVal)));
-		} else if (is_string(tmpVal)) {
-			auto s = to_string(tmpVal);
-			str.append(s.begin(), s.end());
-		} else {
-			return execError("can only index array with string or int.");
-		}
-	}
+	Inst *const pc = Context.PC;
 
-	if (!leaveParams) {
-		for (int64_t i = nArgs - 1; i >= 0; --i) {
-			POP(tmpVal);
-		}
+	int64_t n1;
+	int64_t n2;
+	if (!symInteger(pc[0].sym, &n1) || !symInteger(pc[2].sym, &n2) || !Operation::apply(n1, n2)) {
+		return pushSymVal();
 	}
 
-	*keyString = str;
-
+	Context.PC = n1 ? pc + 6 : pc + 5 + pc[5].value;
+	Context.Statistics.instructions += 3;
 	return STAT_OK;
 }
 
 /*
-** insert a DataValue into an array
+** pushSymsOperateAndAssign:
+** Before: Prog->  [sym1], PUSH_SYM, sym2, OP, ASSIGN, dest, next, ...
+** After:  Prog->  ..., ASSIGN, dest, [next], ...
 */
-bool ArrayInsert(DataValue *theArray, const std::string &keyStr, DataValue *theValue) {
+template <class Operation>
+static int pushSymsOperateAndAssign() {
 
-	const ArrayPtr &m = to_array(*theArray);
-	auto p            = m->insert(std::make_pair(keyStr, *theValue));
-	if (p.second) {
-		return true;
+	Inst *const pc = Context.PC;
+
+	int64_t n1;
+	int64_t n2;
+	DataValue *dest = assignableSymVal(pc[5].sym);
+	if (!dest || !symInteger(pc[0].sym, &n1) || !symInteger(pc[2].sym, &n2) || !Operation::apply(n1, n2)) {
+		return pushSymVal();
 	}
 
-	p.first->second = *theValue;
-	return true;
+	*dest      = make_value(n1);
+	Context.PC = pc + 6;
+	Context.Statistics.instructions += 3;
+	return STAT_OK;
 }
 
 /*
-** remove a node from an array whose key matches keyStr
+** pushSymAndOperate:
+** Before: Prog->  [sym], OP, next, ...
+**         TheStack-> value, next, ...
+** After:  Prog->  sym, OP, [next], ...
+**         TheStack-> [result], next, ...
 */
-void ArrayDelete(DataValue *theArray, const std::string &keyStr) {
+template <class Operation>
+static int pushSymAndOperate() {
 
-	const ArrayPtr &m = to_array(*theArray);
+	Inst *const pc = Context.PC;
+
+	int64_t n2;
+	int64_t *n1 = (Context.StackP != Context.Stack.get()) ? boost::get<int64_t>(&Context.StackP[-1].value) : nullptr;
+	if (!n1 || !symInteger(pc[0].sym, &n2) || !Operation::apply(*n1, n2)) {
+		return pushSymVal();
+	}
+
+	Context.PC = pc + 2;
+	Context.Statistics.instructions += 1;
+	return STAT_OK;
+}
+
+/*
+** pushSymOperateAndBranchFalse:
+** Before: Prog->  [sym], OP, BRANCH_FALSE, branchDest, next, ...
+**         TheStack-> value, next, ...
+** After:  either: Prog->  ..., BRANCH_FALSE, branchDest, [next], ...
+**         or:     Prog->  ..., (branchDest)[next]
+**         TheStack-> next, ...
+*/
+template <class Operation>
+static int pushSymOperateAndBranchFalse() {
+
+	Inst *const pc = Context.PC;
+
+	int64_t n2;
+	const int64_t *top = (Context.StackP != Context.Stack.get()) ? boost::get<int64_t>(&Context.StackP[-1].value) : nullptr;
+	if (!top || !symInteger(pc[0].sym, &n2)) {
+		return pushSymVal();
+	}
+
+	int64_t n1 = *top;
+	if (!Operation::apply(n1, n2)) {
+		return pushSymVal();
+	}
+
+	--Context.StackP;
+	Context.PC = n1 ? pc + 4 : pc + 3 + pc[3].value;
+	Context.Statistics.instructions += 2;
+	return STAT_OK;
+}
+
+/*
+** pushSymIncrementAndAssign:
+** Before: Prog->  [sym], INCR or DECR, ASSIGN, dest, next, ...
+** After:  Prog->  ..., ASSIGN, dest, [next], ...
+*/
+template <int Delta>
+static int pushSymIncrementAndAssign() {
+
+	Inst *const pc = Context.PC;
+
+	int64_t n;
+	DataValue *dest = assignableSymVal(pc[3].sym);
+	if (!dest || !symInteger(pc[0].sym, &n)) {
+		return pushSymVal();
+	}
+
+	*dest      = make_value(wrappingAdd(n, Delta));
+	Context.PC = pc + 4;
+	Context.Statistics.instructions += 2;
+	return STAT_OK;
+}
+
+namespace {
+
+// The superinstructions for each operator which has them
+struct FusedOperation {
+	int op;
+	operation_type pushSyms;
+	operation_type pushSymsAndBranchFalse;
+	operation_type pushSymsAndAssign;
+	operation_type pushSym;
+	operation_type pushSymAndBranchFalse;
+};
+
+template <class Operation>
+constexpr FusedOperation makeFusedOperation(int op) {
+	return FusedOperation{
+		op,
+		pushSymsAndOperate<Operation>,
+		pushSymsOperateAndBranchFalse<Operation>,
+		pushSymsOperateAndAssign<Operation>,
+		pushSymAndOperate<Operation>,
+		pushSymOperateAndBranchFalse<Operation>,
+	};
+}
+
+const FusedOperation FusedOperations[] = {
+	makeFusedOperation<IntegerAdd>(OP_ADD),
+	makeFusedOperation<IntegerSubtract>(OP_SUB),
+	makeFusedOperation<IntegerMultiply>(OP_MUL),
+	makeFusedOperation<IntegerDivide>(OP_DIV),
+	makeFusedOperation<IntegerModulo>(OP_MOD),
+	makeFusedOperation<IntegerGreater>(OP_GT),
+	makeFusedOperation<IntegerLess>(OP_LT),
+	makeFusedOperation<IntegerGreaterEqual>(OP_GE),
+	makeFusedOperation<IntegerLessEqual>(OP_LE),
+	makeFusedOperation<IntegerEqual>(OP_EQ),
+	makeFusedOperation<IntegerNotEqual>(OP_NE),
+	makeFusedOperation<IntegerBitAnd>(OP_BIT_AND),
+	makeFusedOperation<IntegerBitOr>(OP_BIT_OR),
+	makeFusedOperation<IntegerAnd>(OP_AND),
+	makeFusedOperation<IntegerOr>(OP_OR),
+};
+
+const FusedOperation *findFusedOperation(int op) {
+	for (const FusedOperation &fused : FusedOperations) {
+		if (fused.op == op) {
+			return &fused;
+		}
+	}
+
+	return nullptr;
+}
+
+/*
+** Returns the operation performed by an instruction, or -1 if it isn't one
+*/
+int opcodeOf(const Inst &inst) {
+	auto it = std::find(std::begin(OpFns), std::end(OpFns), inst.func);
+	if (it == std::end(OpFns)) {
+		return -1;
+	}
+
+	return static_cast<int>(it - std::begin(OpFns));
+}
+
+/*
+** Returns the number of operand words which follow an instruction
+*/
+int operandCount(int op) {
+	switch (op) {
+	case OP_PUSH_SYM:
+	case OP_ASSIGN:
+	case OP_BRANCH:
+	case OP_BRANCH_TRUE:
+	case OP_BRANCH_FALSE:
+	case OP_BRANCH_NEVER:
+	case OP_ARRAY_REF:
+	case OP_ARRAY_ASSIGN:
+	case OP_BEGIN_ARRAY_ITER:
+	case OP_ARRAY_DELETE:
+		return 1;
+	case OP_SUBR_CALL:
+	case OP_PUSH_ARRAY_SYM:
+	case OP_ARRAY_REF_ASSIGN_SETUP:
+		return 2;
+	case OP_ARRAY_ITER:
+		return 3;
+	default:
+		return 0;
+	}
+}
+
+}
+
+/*
+** Replace the first instruction of common sequences of instructions in a
+** finished program with superinstructions which perform the whole sequence
+** at once. Because the rest of each sequence is left as it was, branches
+** into the middle of one still find the original instructions there.
+*/
+static void fuseInstructions(std::vector<Inst> &code) {
+
+	// Find where each instruction starts, so that operands are never mistaken for them
+	std::vector<int> ops(code.size(), -1);
+	for (size_t i = 0; i < code.size(); i += static_cast<size_t>(1 + operandCount(ops[i]))) {
+		ops[i] = opcodeOf(code[i]);
+		if (ops[i] == -1) {
+			return;
+		}
+	}
+
+	auto opAt = [&ops](size_t i) {
+		return i < ops.size() ? ops[i] : -1;
+	};
+
+	for (size_t i = 0; i < code.size(); ++i) {
+		if (ops[i] != OP_PUSH_SYM) {
+			continue;
+		}
+
+		if (opAt(i + 2) == OP_PUSH_SYM) {
+			if (const FusedOperation *fused = findFusedOperation(opAt(i + 4))) {
+				if (opAt(i + 5) == OP_BRANCH_FALSE) {
+					code[i].func = fused->pushSymsAndBranchFalse;
+				} else if (opAt(i + 5) == OP_ASSIGN) {
+					code[i].func = fused->pushSymsAndAssign;
+				} else {
+					code[i].func = fused->pushSyms;
+				}
+			}
+		} else if (const FusedOperation *fused = findFusedOperation(opAt(i + 2))) {
+			if (opAt(i + 3) == OP_BRANCH_FALSE) {
+				code[i].func = fused->pushSymAndBranchFalse;
+			} else {
+				code[i].func = fused->pushSym;
+			}
+		} else if (opAt(i + 2) == OP_INCR && opAt(i + 3) == OP_ASSIGN) {
+			code[i].func = pushSymIncrementAndAssign<1>;
+		} else if (opAt(i + 2) == OP_DECR && opAt(i + 3) == OP_ASSIGN) {
+			code[i].func = pushSymIncrementAndAssign<-1>;
+		}
+	}
+}
+
+namespace {
+
+/* Serialized programs start with this, followed by the version of their
+   format, which must change whenever the meaning of the code does, such as
+   when operations are added, removed or reordered */
+constexpr int64_t PROGRAM_MAGIC          = 0x4e4d5047; // "NMPG"
+constexpr int64_t PROGRAM_FORMAT_VERSION = 1;
+
+// How a global symbol used by a serialized program is found again
+enum SymbolReference {
+	NAMED_SYMBOL,        // a global symbol of this name, which must exist
+	NAMED_OR_NEW_SYMBOL, // a global symbol of this name, installed if it doesn't exist yet, as the parser would
+	INTEGER_CONSTANT,    // an integer constant
+	STRING_CONSTANT      // a string constant, found by its value
+};
+
+/*
+** Appends values to a serialized program, in a form which doesn't depend on
+** the machine it was written on
+*/
+class ProgramWriter {
+public:
+	void write(int64_t value) {
+		const auto bits = static_cast<uint64_t>(value);
+		for (int i = 0; i < 8; ++i) {
+			data_.push_back(static_cast<char>((bits >> (i * 8)) & 0xff));
+		}
+	}
+
+	void write(const std::string &string) {
+		write(static_cast<int64_t>(string.size()));
+		data_.append(string);
+	}
+
+	std::string &data() {
+		return data_;
+	}
+
+private:
+	std::string data_;
+};
+
+/*
+** Reads back the values written by ProgramWriter, failing instead of reading
+** past the end of the data
+*/
+class ProgramReader {
+public:
+	explicit ProgramReader(view::string_view data)
+		: data_(data) {
+	}
+
+	bool read(int64_t *value) {
+		if (data_.size() - pos_ < 8) {
+			return false;
+		}
+
+		uint64_t bits = 0;
+		for (int i = 0; i < 8; ++i) {
+			bits |= static_cast<uint64_t>(static_cast<uint8_t>(data_[pos_++])) << (i * 8);
+		}
+
+		*value = static_cast<int64_t>(bits);
+		return true;
+	}
+
+	bool read(std::string *string) {
+		int64_t size;
+		if (!read(&size) || size < 0 || static_cast<uint64_t>(size) > data_.size() - pos_) {
+			return false;
+		}
+
+		string->assign(&data_[pos_], static_cast<size_t>(size));
+		pos_ += static_cast<size_t>(size);
+		return true;
+	}
+
+	bool atEnd() const {
+		return pos_ == data_.size();
+	}
+
+private:
+	view::string_view data_;
+	size_t pos_ = 0;
+};
+
+/*
+** Returns the operation an instruction was compiled as, seeing through the
+** superinstructions which fuseInstructions put in place of OP_PUSH_SYM, or
+** -1 if it isn't an instruction
+*/
+int compiledOpcodeOf(const Inst &inst) {
+
+	const int op = opcodeOf(inst);
+	if (op != -1) {
+		return op;
+	}
+
+	if (inst.func == pushSymIncrementAndAssign<1> || inst.func == pushSymIncrementAndAssign<-1>) {
+		return OP_PUSH_SYM;
+	}
+
+	for (const FusedOperation &fused : FusedOperations) {
+		for (operation_type func : {fused.pushSyms, fused.pushSymsAndBranchFalse, fused.pushSymsAndAssign, fused.pushSym, fused.pushSymAndBranchFalse}) {
+			if (inst.func == func) {
+				return OP_PUSH_SYM;
+			}
+		}
+	}
 
-	auto it = m->find(keyStr);
-	if (it != m->end()) {
-		m->erase(it);
+	return -1;
+}
+
+/*
+** Returns true if operand "index" of an instruction is a symbol, rather than
+** an immediate value or branch offset
+*/
+bool isSymbolOperand(int op, int index) {
+	switch (op) {
+	case OP_PUSH_SYM:
+	case OP_ASSIGN:
+	case OP_BEGIN_ARRAY_ITER:
+	case OP_SUBR_CALL:
+	case OP_PUSH_ARRAY_SYM:
+		return index == 0;
+	case OP_ARRAY_ITER:
+		return index < 2;
+	default:
+		return false;
 	}
 }
 
+}
+
+/*
+** Convert a finished program to a string of bytes, from which
+** DeserializeProgram can recreate it, for keeping compiled macros from one
+** session to the next. Symbols are stored by name or value rather than by
+** address, so that they can be found again in a different symbol table.
+** Returns an empty string if the program can't be serialized.
+*/
+std::string SerializeProgram(const Program *prog) {
+
+	std::unordered_map<const Symbol *, int64_t> references;
+
+	// local symbols are referred to by their position in the program's list
+	for (const Symbol *sym : prog->localSymList) {
+		references.emplace(sym, static_cast<int64_t>(references.size()));
+	}
+
+	// global symbols by their position after those
+	std::vector<const Symbol *> globals;
+	std::vector<bool> called;
+
+	std::vector<int64_t> code;
+	code.reserve(prog->code.size());
+
+	size_t i = 0;
+	while (i < prog->code.size()) {
+		const int op = compiledOpcodeOf(prog->code[i]);
+		if (op == -1) {
+			return std::string();
+		}
+
+		code.push_back(op);
+
+		const int nOperands = operandCount(op);
+		if (static_cast<size_t>(nOperands) >= prog->code.size() - i) {
+			return std::string();
+		}
+
+		for (int operand = 0; operand < nOperands; ++operand) {
+			const Inst &inst = prog->code[i + 1 + static_cast<size_t>(operand)];
+
+			if (!isSymbolOperand(op, operand)) {
+				code.push_back(inst.value);
+				continue;
+			}
+
+			auto it = references.find(inst.sym);
+			if (it == references.end()) {
+				it = references.emplace(inst.sym, static_cast<int64_t>(references.size())).first;
+				globals.push_back(inst.sym);
+				called.push_back(false);
+			}
+
+			// the parser promotes the names of called functions to globals
+			if (op == OP_SUBR_CALL && it->second >= static_cast<int64_t>(prog->localSymList.size())) {
+				called[static_cast<size_t>(it->second) - prog->localSymList.size()] = true;
+			}
+
+			code.push_back(it->second);
+		}
+
+		i += 1 + static_cast<size_t>(nOperands);
+	}
+
+	ProgramWriter writer;
+	writer.write(PROGRAM_MAGIC);
+	writer.write(PROGRAM_FORMAT_VERSION);
+	writer.write(N_OPS);
+
+	writer.write(static_cast<int64_t>(prog->localSymList.size()));
+	for (const Symbol *sym : prog->localSymList) {
+		writer.write(sym->name);
+	}
+
+	writer.write(static_cast<int64_t>(globals.size()));
+	for (size_t g = 0; g < globals.size(); ++g) {
+		const Symbol *sym = globals[g];
+
+		if (sym->type == CONST_SYM && is_integer(sym->value)) {
+			writer.write(INTEGER_CONSTANT);
+			writer.write(sym->name);
+			writer.write(to_integer(sym->value));
+		} else if (sym->type == CONST_SYM && is_string(sym->value)) {
+			writer.write(STRING_CONSTANT);
+			writer.write(to_string(sym->value));
+		} else if (called[g] || (!sym->name.empty() && sym->name[0] == '$')) {
+			writer.write(NAMED_OR_NEW_SYMBOL);
+			writer.write(sym->name);
+		} else {
+			writer.write(NAMED_SYMBOL);
+			writer.write(sym->name);
+		}
+	}
+
+	writer.write(static_cast<int64_t>(code.size()));
+	for (int64_t word : code) {
+		writer.write(word);
+	}
+
+	writer.write(static_cast<int64_t>(prog->lines.size()));
+	for (int line : prog->lines) {
+		writer.write(line);
+	}
+
+	return std::move(writer.data());
+}
+
+/*
+** Recreate a program from the output of SerializeProgram, installing any
+** global symbols it needs which the parser would have. Returns nullptr if
+** the data is damaged or from a different version of the interpreter, or if
+** parsing the program's source now would give a different program, because
+** the global symbols have changed since it was serialized, in which case the
+** source needs to be compiled again.
+*/
+Program *DeserializeProgram(view::string_view data) {
+
+	ProgramReader reader(data);
+
+	int64_t magic;
+	int64_t version;
+	int64_t nOps;
+	if (!reader.read(&magic) || !reader.read(&version) || !reader.read(&nOps)) {
+		return nullptr;
+	}
+
+	if (magic != PROGRAM_MAGIC || version != PROGRAM_FORMAT_VERSION || nOps != N_OPS) {
+		return nullptr;
+	}
+
+	int64_t nLocals;
+	if (!reader.read(&nLocals) || nLocals < 0) {
+		return nullptr;
+	}
+
+	std::vector<std::string> localNames;
+	for (int64_t n = 0; n < nLocals; ++n) {
+		std::string name;
+		if (!reader.read(&name)) {
+			return nullptr;
+		}
+
+		// the parser would use a global of the same name instead, if there is one now
+		if (GlobalSymIndex.find(name) != GlobalSymIndex.end()) {
+			return nullptr;
+		}
+
+		localNames.push_back(std::move(name));
+	}
+
+	struct GlobalReference {
+		int64_t kind;
+		std::string name;
+		int64_t value;
+	};
+
+	int64_t nGlobals;
+	if (!reader.read(&nGlobals) || nGlobals < 0) {
+		return nullptr;
+	}
+
+	std::vector<GlobalReference> globalReferences;
+	for (int64_t n = 0; n < nGlobals; ++n) {
+		GlobalReference reference = {};
+		if (!reader.read(&reference.kind) || !reader.read(&reference.name)) {
+			return nullptr;
+		}
+
+		switch (reference.kind) {
+		case INTEGER_CONSTANT:
+			if (!reader.read(&reference.value)) {
+				return nullptr;
+			}
+			break;
+		case NAMED_SYMBOL:
+			// the parser would use a local variable instead, if there isn't one now
+			if (GlobalSymIndex.find(reference.name) == GlobalSymIndex.end()) {
+				return nullptr;
+			}
+			break;
+		case NAMED_OR_NEW_SYMBOL:
+		case STRING_CONSTANT:
+			break;
+		default:
+			return nullptr;
+		}
+
+		globalReferences.push_back(std::move(reference));
+	}
+
+	int64_t nWords;
+	if (!reader.read(&nWords) || nWords < 0) {
+		return nullptr;
+	}
+
+	std::vector<int64_t> words;
+	for (int64_t n = 0; n < nWords; ++n) {
+		int64_t word;
+		if (!reader.read(&word)) {
+			return nullptr;
+		}
+		words.push_back(word);
+	}
+
+	int64_t nLines;
+	if (!reader.read(&nLines) || nLines != nWords) {
+		return nullptr;
+	}
+
+	std::vector<int> lines;
+	for (int64_t n = 0; n < nLines; ++n) {
+		int64_t line;
+		if (!reader.read(&line)) {
+			return nullptr;
+		}
+		lines.push_back(static_cast<int>(line));
+	}
+
+	if (!reader.atEnd()) {
+		return nullptr;
+	}
+
+	// check that the code makes sense before installing anything
+	for (size_t i = 0; i < words.size();) {
+		const int64_t op = words[i];
+		if (op < 0 || op >= N_OPS) {
+			return nullptr;
+		}
+
+		const int nOperands = operandCount(static_cast<int>(op));
+		if (static_cast<size_t>(nOperands) >= words.size() - i) {
+			return nullptr;
+		}
+
+		for (int operand = 0; operand < nOperands; ++operand) {
+			const int64_t word = words[i + 1 + static_cast<size_t>(operand)];
+			if (isSymbolOperand(static_cast<int>(op), operand) && (word < 0 || word >= nLocals + nGlobals)) {
+				return nullptr;
+			}
+		}
+
+		i += 1 + static_cast<size_t>(nOperands);
+	}
+
+	auto prog = std::make_unique<Program>();
+
+	std::vector<Symbol *> symbols;
+	for (std::string &name : localNames) {
+		auto sym = new Symbol{std::move(name), LOCAL_SYM, make_value()};
+		prog->localSymList.push_back(sym);
+		symbols.push_back(sym);
+	}
+
+	for (const GlobalReference &reference : globalReferences) {
+		Symbol *sym;
+		switch (reference.kind) {
+		case INTEGER_CONSTANT:
+			sym = LookupSymbol(reference.name);
+			if (!sym) {
+				sym = InstallSymbol(reference.name, CONST_SYM, make_value(reference.value));
+			}
+			break;
+		case STRING_CONSTANT:
+			sym = InstallStringConstSymbol(reference.name);
+			break;
+		default:
+			sym = LookupSymbol(reference.name);
+			if (!sym) {
+				sym = InstallSymbol(reference.name, GLOBAL_SYM, make_value());
+			}
+			break;
+		}
+
+		symbols.push_back(sym);
+	}
+
+	prog->code.resize(words.size());
+	for (size_t i = 0; i < words.size();) {
+		const int op = static_cast<int>(words[i]);
+		prog->code[i].func = OpFns[op];
+
+		const int nOperands = operandCount(op);
+		for (int operand = 0; operand < nOperands; ++operand) {
+			const size_t index = i + 1 + static_cast<size_t>(operand);
+
+			if (isSymbolOperand(op, operand)) {
+				prog->code[index].sym = symbols[static_cast<size_t>(words[index])];
+			} else {
+				prog->code[index].value = words[index];
+			}
+		}
+
+		i += 1 + static_cast<size_t>(nOperands);
+	}
+
+	prog->lines = std::move(lines);
+
+	prepareProgram(prog.get());
+	return prog.release();
+}
+
+/*
+** copy an array, so that changes to the copy don't affect the original.
+** the contents are shared until one of them is modified (see Array)
+*/
+int ArrayCopy(DataValue *dstArray, const DataValue *srcArray) {
+	*dstArray = make_value(std::make_shared<Array>(*to_array(*srcArray)));
+	return STAT_OK;
+}
+
+/*
+** creates a string of a single key for all the sub-scripts
+** using ARRAY_DIM_SEP as a separator
+** this function uses the PEEK macros in order to remove most limits on
+** the number of arguments to an array
+*/
+static int makeArrayKeyFromArgs(int64_t nArgs, std::string *keyString, bool leaveParams) {
+	DataValue tmpVal;
+
+	std::string str;
+
+	for (int64_t i = nArgs - 1; i >= 0; --i) {
+		if (i != nArgs - 1) {
+			str.append(ARRAY_DIM_SEP);
+		}
+		PEEK(tmpVal, i);
+		if (is_integer(tmpVal)) {
+			str.append(std::to_string(to_integer(tmpVal)));
+		} else if (is_string(tmpVal)) {
+			auto s = to_string_view(tmpVal);
+			str.append(s.data(), s.size());
+		} else {
+			return execError("can only index array with string or int.");
+		}
+	}
+
+	if (!leaveParams) {
+		for (int64_t i = nArgs - 1; i >= 0; --i) {
+			POP(tmpVal);
+		}
+	}
+
+	*keyString = str;
+
+	return STAT_OK;
+}
+
+/*
+** insert a DataValue into an array
+*/
+bool ArrayInsert(DataValue *theArray, const std::string &keyStr, DataValue *theValue) {
+	to_array(*theArray)->insert(keyStr, *theValue);
+	return true;
+}
+
+bool ArrayInsert(DataValue *theArray, int64_t key, DataValue *theValue) {
+	to_array(*theArray)->insert(key, *theValue);
+	return true;
+}
+
+/*
+** remove a node from an array whose key matches keyStr
+*/
+void ArrayDelete(DataValue *theArray, const std::string &keyStr) {
+	to_array(*theArray)->erase(keyStr);
+}
+
 /*
 ** remove all nodes from an array
 */
 void ArrayDeleteAll(DataValue *theArray) {
-
-	const ArrayPtr &m = to_array(*theArray);
-	m->clear();
+	to_array(*theArray)->clear();
 }
 
 /*
 ** returns the number of elements (nodes containing values) of an array
 */
 int ArraySize(DataValue *theArray) {
-	const ArrayPtr &m = to_array(*theArray);
-	return gsl::narrow<int>(m->size());
+	return gsl::narrow<int>(to_array(*theArray)->size());
 }
 
 /*
@@ -1905,15 +3252,11 @@ int ArraySize(DataValue *theArray) {
 ** returns 1 for success 0 for not found
 */
 bool ArrayGet(DataValue *theArray, const std::string &keyStr, DataValue *theValue) {
+	return to_array(*theArray)->get(keyStr, theValue);
+}
 
-	const ArrayPtr &m = to_array(*theArray);
-	auto it           = m->find(keyStr);
-	if (it != m->end()) {
-		*theValue = it->second;
-		return true;
-	}
-
-	return false;
+bool ArrayGet(DataValue *theArray, int64_t key, DataValue *theValue) {
+	return to_array(*theArray)->get(key, theValue);
 }
 
 /*
@@ -1922,8 +3265,10 @@ bool ArrayGet(DataValue *theArray, const std::string &keyStr, DataValue *theValu
 ArrayIterator arrayIterateFirst(DataValue *theArray) {
 
 	const ArrayPtr &m = to_array(*theArray);
-	ArrayIterator it{m, m->begin()};
 
+	ArrayIterator it;
+	it.array = m;
+	it.keys  = m->keys();
 	return it;
 }
 
@@ -1932,8 +3277,8 @@ ArrayIterator arrayIterateFirst(DataValue *theArray) {
 */
 ArrayIterator arrayIterateNext(ArrayIterator iterator) {
 
-	Q_ASSERT(iterator.it != iterator.m->end());
-	++(iterator.it);
+	Q_ASSERT(iterator.index != iterator.keys->size());
+	++iterator.index;
 	return iterator;
 }
 
@@ -1956,6 +3301,18 @@ static int arrayRef() {
 	DISASM_RT(PC - 2, 2);
 	STACKDUMP(nDim, 3);
 
+	if (nDim == 1 && Context.StackP - Context.Stack.get() >= 2 && is_integer(Context.StackP[-1]) && is_array(Context.StackP[-2])) {
+		// a list element, which can be looked up without making a key string
+		const int64_t key = to_integer(Context.StackP[-1]);
+		if (!ArrayGet(&Context.StackP[-2], key, &valueItem)) {
+			return execError("referenced array value not in array: %s", std::to_string(key).c_str());
+		}
+
+		--Context.StackP;
+		Context.StackP[-1] = std::move(valueItem);
+		return STAT_OK;
+	}
+
 	if (nDim > 0) {
 		int errNum = makeArrayKeyFromArgs(nDim, &keyString, false);
 		if (errNum != STAT_OK) {
@@ -2004,6 +3361,28 @@ static int arrayAssign() {
 	if (nDim > 0) {
 		POP(srcValue);
 
+		if (is_array(srcValue)) {
+			DataValue arrayCopyValue;
+
+			int errNum = ArrayCopy(&arrayCopyValue, &srcValue);
+			srcValue   = arrayCopyValue;
+			if (errNum != STAT_OK) {
+				return errNum;
+			}
+		}
+
+		if (nDim == 1 && Context.StackP - Context.Stack.get() >= 2 && is_integer(Context.StackP[-1]) && is_array(Context.StackP[-2])) {
+			// a list element, which can be stored without making a key string
+			const int64_t key = to_integer(Context.StackP[-1]);
+			Context.StackP -= 2;
+
+			if (ArrayInsert(&Context.StackP[0], key, &srcValue)) {
+				return STAT_OK;
+			}
+
+			return execError("array member allocation failure");
+		}
+
 		int errNum = makeArrayKeyFromArgs(nDim, &keyString, false);
 		if (errNum != STAT_OK) {
 			return errNum;
@@ -2015,16 +3394,6 @@ static int arrayAssign() {
 			return execError("cannot assign array element of non-array");
 		}
 
-		if (is_array(srcValue)) {
-			DataValue arrayCopyValue;
-
-			errNum   = ArrayCopy(&arrayCopyValue, &srcValue);
-			srcValue = arrayCopyValue;
-			if (errNum != STAT_OK) {
-				return errNum;
-			}
-		}
-
 		if (ArrayInsert(&dstArray, keyString, &srcValue)) {
 			return STAT_OK;
 		}
@@ -2176,8 +3545,13 @@ static int arrayIter() {
 
 	ArrayIterator thisEntry = to_iterator(*iteratorValPtr);
 
-	if (thisEntry.it != thisEntry.m->end()) {
-		*itemValPtr     = make_value(thisEntry.it->first);
+	// skip keys which were deleted since the loop began
+	while (thisEntry.index != thisEntry.keys->size() && !thisEntry.array->find((*thisEntry.keys)[thisEntry.index])) {
+		++thisEntry.index;
+	}
+
+	if (thisEntry.index != thisEntry.keys->size()) {
+		*itemValPtr     = make_value((*thisEntry.keys)[thisEntry.index]);
 		*iteratorValPtr = make_value(arrayIterateNext(thisEntry));
 	} else {
 		Context.PC = branchAddr;
@@ -2218,13 +3592,19 @@ static int inArray() {
 
 		POP(leftArray);
 
-		const ArrayPtr &m = to_array(leftArray);
+		const ArrayPtr rightArray = to_array(theArray);
+
+		inResult = 1;
+		to_array(leftArray)->forEach([&rightArray, &inResult](const std::string &key, const DataValue &) {
+			if (!rightArray->find(key)) {
+				inResult = 0;
+			}
+		});
+	} else if (is_integer(leftArray)) {
+		POP(leftArray);
 
-		inResult  = 1;
-		auto iter = m->begin();
-		while (inResult && iter != m->end()) {
-			inResult = inResult && ArrayGet(&theArray, iter->first, &theValue);
-			++iter;
+		if (to_array(theArray)->find(to_integer(leftArray))) {
+			inResult = 1;
 		}
 	} else {
 		std::string keyStr;
@@ -2276,7 +3656,15 @@ static int deleteArrayElement() {
 	return STAT_OK;
 }
 
-bool StringToNum(const std::string &string, int *number) {
+/*
+** Stop the macro with a stack overflow error. RunMacroAsSubrCall jumps here
+** when there is no room on the stack to call the macro it was given.
+*/
+static int stackOverflow() {
+	return execError(StackOverflowMsg);
+}
+
+bool StringToNum(const std::string &string, int64_t *number) {
 	auto it = string.begin();
 
 	while (it != string.end() && (*it == ' ' || *it == '\t')) {
@@ -2301,7 +3689,10 @@ bool StringToNum(const std::string &string, int *number) {
 	}
 
 	if (number) {
-		if (sscanf(string.c_str(), "%d", number) != 1) {
+		// numbers too large for 64 bits are clamped, rather than being undefined
+		char *end;
+		*number = std::strtoll(string.c_str(), &end, 10);
+		if (end == string.c_str()) {
 			// This case is here to support old behavior
 			*number = 0;
 		}
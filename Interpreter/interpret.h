@@ -2,13 +2,16 @@
 #ifndef INTERPRET_H_
 #define INTERPRET_H_
 
+#include "Array.h"
 #include "DataValue.h"
 #include "Util/string_view.h"
 
 #include <gsl/span>
 
+#include <cstddef>
 #include <deque>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <QString>
@@ -91,6 +94,9 @@ union Inst {
 	Symbol *sym;
 };
 
+// position of an instruction in the program being created, from its start
+using CodeOffset = ptrdiff_t;
+
 //------------------------------------------------------------------------------
 
 /* symbol table entry */
@@ -101,13 +107,19 @@ struct Symbol {
 };
 
 struct Program {
+	~Program();
 
-	~Program() {
-		qDeleteAll(localSymList);
-	}
-
+	std::string name; // what the profiler reports the program as, such as the name of a macro function
 	std::deque<Symbol *> localSymList;
 	std::vector<Inst> code;
+	std::vector<int> lines; // the source line of each instruction, counting from 1
+};
+
+/* Execution statistics of a macro, accumulated over all of its time slices */
+struct MacroStatistics {
+	int64_t instructions = 0; // instructions executed
+	int64_t slices       = 0; // number of times execution was started or resumed
+	int64_t nanoseconds  = 0; // time spent executing instructions
 };
 
 /* Information needed to re-start a preempted macro */
@@ -115,33 +127,37 @@ struct MacroContext {
 
 	using stack_type = std::shared_ptr<DataValue>;
 
-	stack_type Stack;                        // the stack
+	stack_type Stack;                        // the stack, which is moved to larger storage when it fills up
 	DataValue *StackP             = nullptr; // next free spot on stack
+	DataValue *StackEnd           = nullptr; // end of the storage of the stack
 	DataValue *FrameP             = nullptr; // frame pointer (start of local variables for the current subroutine invocation)
 	Inst *PC                      = nullptr; // program counter during execution
 	DocumentWidget *RunDocument   = nullptr; // document from which macro was run
 	DocumentWidget *FocusDocument = nullptr; // document on which macro commands operate
+	MacroStatistics Statistics;              // how much work the macro has done so far
 };
 
 void InitMacroGlobals();
 void CleanupMacroGlobals();
 
 bool ArrayInsert(DataValue *theArray, const std::string &keyStr, DataValue *theValue);
+bool ArrayInsert(DataValue *theArray, int64_t key, DataValue *theValue);
 void ArrayDelete(DataValue *theArray, const std::string &keyStr);
 void ArrayDeleteAll(DataValue *theArray);
 int ArraySize(DataValue *theArray);
 bool ArrayGet(DataValue *theArray, const std::string &keyStr, DataValue *theValue);
+bool ArrayGet(DataValue *theArray, int64_t key, DataValue *theValue);
 int ArrayCopy(DataValue *dstArray, const DataValue *srcArray);
 
 /* Routines for creating a program, (accumulated beginning with
    BeginCreatingProgram and returned via FinishCreatingProgram) */
-bool AddBranchOffset(const Inst *to, QString *msg);
-bool AddBreakAddr(Inst *addr);
-bool AddContinueAddr(Inst *addr);
+bool AddBranchOffset(CodeOffset to, QString *msg);
+bool AddBreakAddr(CodeOffset addr);
+bool AddContinueAddr(CodeOffset addr);
 bool AddImmediate(int value, QString *msg);
 bool AddOp(int op, QString *msg);
 bool AddSym(Symbol *sym, QString *msg);
-Inst *GetPC();
+CodeOffset GetPC();
 Program *FinishCreatingProgram();
 Symbol *InstallIteratorSymbol();
 Symbol *InstallStringConstSymbol(view::string_view str);
@@ -152,15 +168,28 @@ Symbol *LookupStringConstSymbol(view::string_view value);
 Symbol *LookupSymbolEx(const QString &name);
 Symbol *LookupSymbol(view::string_view name);
 void BeginCreatingProgram();
-void FillLoopAddrs(const Inst *breakAddr, const Inst *continueAddr);
+void FillLoopAddrs(CodeOffset breakAddr, CodeOffset continueAddr);
+void SetBranchOffset(CodeOffset from, CodeOffset to);
+void SetSourceLine(int line);
 void StartLoopAddrList();
-void SwapCode(Inst *start, Inst *boundary, Inst *end);
+void SwapCode(CodeOffset start, CodeOffset boundary, CodeOffset end);
+
+// Routines for keeping compiled programs from one session to the next
+std::string SerializeProgram(const Program *prog);
+Program *DeserializeProgram(view::string_view data);
 
 // Routines for executing programs
 int executeMacro(DocumentWidget *document, Program *prog, gsl::span<DataValue> arguments, DataValue *result, std::shared_ptr<MacroContext> &continuation, QString *msg);
 ExecReturnCodes continueMacro(const std::shared_ptr<MacroContext> &continuation, DataValue *result, QString *msg);
 void RunMacroAsSubrCall(Program *prog);
 void preemptMacro();
+void SetMacroTimeSlice(int milliseconds);
+MacroStatistics CurrentMacroStatistics();
+
+// Routines for profiling the execution of macros
+void SetMacroProfiling(bool enabled);
+bool MacroProfilingEnabled();
+std::string MacroProfileReport();
 
 Symbol *PromoteToGlobal(Symbol *sym);
 void modifyReturnedValue(const std::shared_ptr<MacroContext> &context, const DataValue &dv);
@@ -169,6 +198,6 @@ DocumentWidget *MacroFocusDocument();
 void SetMacroFocusDocument(DocumentWidget *document);
 
 // function used for implicit conversion from string to number
-bool StringToNum(const std::string &string, int *number);
+bool StringToNum(const std::string &string, int64_t *number);
 
 #endif
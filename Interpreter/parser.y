@@ -16,8 +16,8 @@
 #define ADD_IMMED(val) if (!AddImmediate(val, &ErrMsg)) return 1
 #define ADD_BR_OFF(to) if (!AddBranchOffset(to, &ErrMsg)) return 1
 
-static void SET_BR_OFF(Inst *from, Inst *to) {
-    from->value = to - from;
+static void SET_BR_OFF(CodeOffset from, CodeOffset to) {
+    SetBranchOffset(from, to);
 }
 
 static int yyerror(const char *s);
@@ -30,14 +30,12 @@ static int follow_non_whitespace(char expect, int yes, int no);
 static QString ErrMsg;
 static QString::const_iterator InPtr;
 static QString::const_iterator EndPtr;
-extern Inst *LoopStack[]; /* addresses of break, cont stmts */
-extern Inst **LoopStackPtr;  /*  to fill at the end of a loop */
 
 %}
 
 %union {
     Symbol *sym;
-    Inst *inst;
+    CodeOffset inst;
     int nArgs;
 }
 
@@ -109,7 +107,7 @@ stmt:       simpstmt '\n' blank
             | for '(' SYMBOL IN arrayexpr ')' {
                 Symbol *iterSym = InstallIteratorSymbol();
                 ADD_OP(OP_BEGIN_ARRAY_ITER); ADD_SYM(iterSym);
-                ADD_OP(OP_ARRAY_ITER); ADD_SYM($3); ADD_SYM(iterSym); ADD_BR_OFF(nullptr);
+                ADD_OP(OP_ARRAY_ITER); ADD_SYM($3); ADD_SYM(iterSym); ADD_BR_OFF(GetPC());
             }
                 blank block {
                     ADD_OP(OP_BRANCH); ADD_BR_OFF($5+2);
@@ -117,13 +115,13 @@ stmt:       simpstmt '\n' blank
                     FillLoopAddrs(GetPC(), $5+2);
             }
             | BREAK '\n' blank {
-                ADD_OP(OP_BRANCH); ADD_BR_OFF(nullptr);
+                ADD_OP(OP_BRANCH); ADD_BR_OFF(GetPC());
                 if (AddBreakAddr(GetPC()-1)) {
                     yyerror("break outside loop"); YYERROR;
                 }
             }
             | CONTINUE '\n' blank {
-                ADD_OP(OP_BRANCH); ADD_BR_OFF(nullptr);
+                ADD_OP(OP_BRANCH); ADD_BR_OFF(GetPC());
                 if (AddContinueAddr(GetPC()-1)) {
                     yyerror("continue outside loop"); YYERROR;
                 }
@@ -398,24 +396,24 @@ for:    FOR {
         }
         ;
 else:   ELSE {
-            ADD_OP(OP_BRANCH); $$ = GetPC(); ADD_BR_OFF(nullptr);
+            ADD_OP(OP_BRANCH); $$ = GetPC(); ADD_BR_OFF(GetPC());
         }
         ;
 cond:   /* nothing */ {
-            ADD_OP(OP_BRANCH_NEVER); $$ = GetPC(); ADD_BR_OFF(nullptr);
+            ADD_OP(OP_BRANCH_NEVER); $$ = GetPC(); ADD_BR_OFF(GetPC());
         }
         | numexpr {
-            ADD_OP(OP_BRANCH_FALSE); $$ = GetPC(); ADD_BR_OFF(nullptr);
+            ADD_OP(OP_BRANCH_FALSE); $$ = GetPC(); ADD_BR_OFF(GetPC());
         }
         ;
 and:    AND {
             ADD_OP(OP_DUP); ADD_OP(OP_BRANCH_FALSE); $$ = GetPC();
-            ADD_BR_OFF(nullptr);
+            ADD_BR_OFF(GetPC());
         }
         ;
 or:     OR {
             ADD_OP(OP_DUP); ADD_OP(OP_BRANCH_TRUE); $$ = GetPC();
-            ADD_BR_OFF(nullptr);
+            ADD_BR_OFF(GetPC());
         }
         ;
 blank:  /* nothing */
@@ -424,6 +422,10 @@ blank:  /* nothing */
 
 %% /* User Subroutines Section */
 
+/* The line of the source which the lexer has reached, which the instructions
+   compiled are attributed to for the profiler */
+static QString::const_iterator LinePtr;
+static int Line;
 
 /*
 ** Parse a string and create a program from it (this is the parser entry point).
@@ -439,8 +441,10 @@ Program *compileMacro(const QString &expr, QString *msg, int *stoppedAt) {
        failed, return the error message and string index (the grammar aborts
        parsing at the first error) */
     QString::const_iterator start = expr.begin();
-    InPtr  = start;
-    EndPtr = start + expr.size();
+    InPtr   = start;
+    EndPtr  = start + expr.size();
+    LinePtr = start;
+    Line    = 1;
 
     if (yyparse()) {
         *msg       = ErrMsg;
@@ -488,6 +492,16 @@ static int yylex(void) {
         }
     }
 
+    /* count the lines up to the start of the token. The parser has usually
+       read one token ahead by the time it generates code, so the code is
+       attributed to the line of the token before this one */
+    SetSourceLine(Line);
+    for (; LinePtr != InPtr; ++LinePtr) {
+        if (*LinePtr == QLatin1Char('\n')) {
+            ++Line;
+        }
+    }
+
     /* return end of input at the end of the string */
     if (InPtr == EndPtr) {
         return 0;
@@ -504,13 +518,17 @@ static int yylex(void) {
             *p++ = *InPtr++;
         }
 
-        int n = value.toInt();
+        /* constants too large for 64 bits wrap around, as arithmetic does, so
+           that -9223372036854775808 is the smallest integer */
+        uint64_t n = 0;
+        for (QChar ch : value) {
+            n = (n * 10) + static_cast<uint64_t>(ch.toLatin1() - '0');
+        }
 
-        char name[28];
-        snprintf(name, sizeof(name), "const %d", n);
+        const std::string name = "const " + std::to_string(static_cast<int64_t>(n));
 
         if ((yylval.sym = LookupSymbol(name)) == nullptr) {
-            yylval.sym = InstallSymbol(name, CONST_SYM, make_value(n));
+            yylval.sym = InstallSymbol(name, CONST_SYM, make_value(static_cast<int64_t>(n)));
         }
 
         return NUMBER;
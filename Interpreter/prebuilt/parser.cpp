@@ -86,8 +86,8 @@
 #define ADD_IMMED(val) if (!AddImmediate(val, &ErrMsg)) return 1
 #define ADD_BR_OFF(to) if (!AddBranchOffset(to, &ErrMsg)) return 1
 
-static void SET_BR_OFF(Inst *from, Inst *to) {
-    from->value = to - from;
+static void SET_BR_OFF(CodeOffset from, CodeOffset to) {
+    SetBranchOffset(from, to);
 }
 
 static int yyerror(const char *s);
@@ -100,11 +100,9 @@ static int follow_non_whitespace(char expect, int yes, int no);
 static QString ErrMsg;
 static QString::const_iterator InPtr;
 static QString::const_iterator EndPtr;
-extern Inst *LoopStack[]; /* addresses of break, cont stmts */
-extern Inst **LoopStackPtr;  /*  to fill at the end of a loop */
 
 
-#line 108 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 106 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
 
 # ifndef YY_CAST
 #  ifdef __cplusplus
@@ -1365,783 +1363,783 @@ yyreduce:
   switch (yyn)
     {
   case 2: /* program: blank stmts  */
-#line 73 "parser.y"
+#line 71 "parser.y"
                         {
                 ADD_OP(OP_RETURN_NO_VAL); return 0;
             }
-#line 1373 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1371 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 3: /* program: blank '{' blank stmts '}'  */
-#line 76 "parser.y"
+#line 74 "parser.y"
                                         {
                 ADD_OP(OP_RETURN_NO_VAL); return 0;
             }
-#line 1381 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1379 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 4: /* program: blank '{' blank '}'  */
-#line 79 "parser.y"
+#line 77 "parser.y"
                                   {
                 ADD_OP(OP_RETURN_NO_VAL); return 0;
             }
-#line 1389 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1387 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 5: /* program: error  */
-#line 82 "parser.y"
+#line 80 "parser.y"
                     {
                 return 1;
             }
-#line 1397 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1395 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 12: /* stmt: IF '(' cond ')' blank block  */
-#line 94 "parser.y"
+#line 92 "parser.y"
                                                            {
                 SET_BR_OFF((yyvsp[-3].inst), GetPC());
             }
-#line 1405 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1403 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 13: /* stmt: IF '(' cond ')' blank block else blank block  */
-#line 97 "parser.y"
+#line 95 "parser.y"
                                                                       {
                 SET_BR_OFF((yyvsp[-6].inst), ((yyvsp[-2].inst)+1)); SET_BR_OFF((yyvsp[-2].inst), GetPC());
             }
-#line 1413 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1411 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 14: /* stmt: while '(' cond ')' blank block  */
-#line 100 "parser.y"
+#line 98 "parser.y"
                                              {
                 ADD_OP(OP_BRANCH); ADD_BR_OFF((yyvsp[-5].inst));
                 SET_BR_OFF((yyvsp[-3].inst), GetPC()); FillLoopAddrs(GetPC(), (yyvsp[-5].inst));
             }
-#line 1422 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1420 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 15: /* stmt: for '(' comastmts ';' cond ';' comastmts ')' blank block  */
-#line 104 "parser.y"
+#line 102 "parser.y"
                                                                        {
                 FillLoopAddrs(GetPC()+2+((yyvsp[-3].inst)-((yyvsp[-5].inst)+1)), GetPC());
                 SwapCode((yyvsp[-5].inst)+1, (yyvsp[-3].inst), GetPC());
                 ADD_OP(OP_BRANCH); ADD_BR_OFF((yyvsp[-7].inst)); SET_BR_OFF((yyvsp[-5].inst), GetPC());
             }
-#line 1432 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1430 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 16: /* $@1: %empty  */
-#line 109 "parser.y"
+#line 107 "parser.y"
                                               {
                 Symbol *iterSym = InstallIteratorSymbol();
                 ADD_OP(OP_BEGIN_ARRAY_ITER); ADD_SYM(iterSym);
-                ADD_OP(OP_ARRAY_ITER); ADD_SYM((yyvsp[-3].sym)); ADD_SYM(iterSym); ADD_BR_OFF(nullptr);
+                ADD_OP(OP_ARRAY_ITER); ADD_SYM((yyvsp[-3].sym)); ADD_SYM(iterSym); ADD_BR_OFF(GetPC());
             }
-#line 1442 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1440 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 17: /* stmt: for '(' SYMBOL IN arrayexpr ')' $@1 blank block  */
-#line 114 "parser.y"
+#line 112 "parser.y"
                             {
                     ADD_OP(OP_BRANCH); ADD_BR_OFF((yyvsp[-4].inst)+2);
                     SET_BR_OFF((yyvsp[-4].inst)+5, GetPC());
                     FillLoopAddrs(GetPC(), (yyvsp[-4].inst)+2);
             }
-#line 1452 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1450 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 18: /* stmt: BREAK '\n' blank  */
-#line 119 "parser.y"
+#line 117 "parser.y"
                                {
-                ADD_OP(OP_BRANCH); ADD_BR_OFF(nullptr);
+                ADD_OP(OP_BRANCH); ADD_BR_OFF(GetPC());
                 if (AddBreakAddr(GetPC()-1)) {
                     yyerror("break outside loop"); YYERROR;
                 }
             }
-#line 1463 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1461 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 19: /* stmt: CONTINUE '\n' blank  */
-#line 125 "parser.y"
+#line 123 "parser.y"
                                   {
-                ADD_OP(OP_BRANCH); ADD_BR_OFF(nullptr);
+                ADD_OP(OP_BRANCH); ADD_BR_OFF(GetPC());
                 if (AddContinueAddr(GetPC()-1)) {
                     yyerror("continue outside loop"); YYERROR;
                 }
             }
-#line 1474 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1472 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 20: /* stmt: RETURN expr '\n' blank  */
-#line 131 "parser.y"
+#line 129 "parser.y"
                                      {
                 ADD_OP(OP_RETURN);
             }
-#line 1482 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1480 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 21: /* stmt: RETURN '\n' blank  */
-#line 134 "parser.y"
+#line 132 "parser.y"
                                 {
                 ADD_OP(OP_RETURN_NO_VAL);
             }
-#line 1490 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1488 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 22: /* simpstmt: SYMBOL '=' expr  */
-#line 138 "parser.y"
+#line 136 "parser.y"
                             {
                 ADD_OP(OP_ASSIGN); ADD_SYM((yyvsp[-2].sym));
             }
-#line 1498 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1496 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 23: /* simpstmt: evalsym ADDEQ expr  */
-#line 141 "parser.y"
+#line 139 "parser.y"
                                  {
                 ADD_OP(OP_ADD); ADD_OP(OP_ASSIGN); ADD_SYM((yyvsp[-2].sym));
             }
-#line 1506 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1504 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 24: /* simpstmt: evalsym SUBEQ expr  */
-#line 144 "parser.y"
+#line 142 "parser.y"
                                  {
                 ADD_OP(OP_SUB); ADD_OP(OP_ASSIGN); ADD_SYM((yyvsp[-2].sym));
             }
-#line 1514 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1512 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 25: /* simpstmt: evalsym MULEQ expr  */
-#line 147 "parser.y"
+#line 145 "parser.y"
                                  {
                 ADD_OP(OP_MUL); ADD_OP(OP_ASSIGN); ADD_SYM((yyvsp[-2].sym));
             }
-#line 1522 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1520 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 26: /* simpstmt: evalsym DIVEQ expr  */
-#line 150 "parser.y"
+#line 148 "parser.y"
                                  {
                 ADD_OP(OP_DIV); ADD_OP(OP_ASSIGN); ADD_SYM((yyvsp[-2].sym));
             }
-#line 1530 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1528 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 27: /* simpstmt: evalsym MODEQ expr  */
-#line 153 "parser.y"
+#line 151 "parser.y"
                                  {
                 ADD_OP(OP_MOD); ADD_OP(OP_ASSIGN); ADD_SYM((yyvsp[-2].sym));
             }
-#line 1538 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1536 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 28: /* simpstmt: evalsym ANDEQ expr  */
-#line 156 "parser.y"
+#line 154 "parser.y"
                                  {
                 ADD_OP(OP_BIT_AND); ADD_OP(OP_ASSIGN); ADD_SYM((yyvsp[-2].sym));
             }
-#line 1546 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1544 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 29: /* simpstmt: evalsym OREQ expr  */
-#line 159 "parser.y"
+#line 157 "parser.y"
                                 {
                 ADD_OP(OP_BIT_OR); ADD_OP(OP_ASSIGN); ADD_SYM((yyvsp[-2].sym));
             }
-#line 1554 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1552 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 30: /* simpstmt: DELETE arraylv '[' arglist ']'  */
-#line 162 "parser.y"
+#line 160 "parser.y"
                                              {
                 ADD_OP(OP_ARRAY_DELETE); ADD_IMMED((yyvsp[-1].nArgs));
             }
-#line 1562 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1560 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 31: /* simpstmt: initarraylv '[' arglist ']' '=' expr  */
-#line 165 "parser.y"
+#line 163 "parser.y"
                                                    {
                 ADD_OP(OP_ARRAY_ASSIGN); ADD_IMMED((yyvsp[-3].nArgs));
             }
-#line 1570 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1568 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 32: /* simpstmt: initarraylv '[' arglist ']' ADDEQ expr  */
-#line 168 "parser.y"
+#line 166 "parser.y"
                                                      {
                 ADD_OP(OP_ARRAY_REF_ASSIGN_SETUP); ADD_IMMED(1); ADD_IMMED((yyvsp[-3].nArgs));
                 ADD_OP(OP_ADD);
                 ADD_OP(OP_ARRAY_ASSIGN); ADD_IMMED((yyvsp[-3].nArgs));
             }
-#line 1580 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1578 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 33: /* simpstmt: initarraylv '[' arglist ']' SUBEQ expr  */
-#line 173 "parser.y"
+#line 171 "parser.y"
                                                      {
                 ADD_OP(OP_ARRAY_REF_ASSIGN_SETUP); ADD_IMMED(1); ADD_IMMED((yyvsp[-3].nArgs));
                 ADD_OP(OP_SUB);
                 ADD_OP(OP_ARRAY_ASSIGN); ADD_IMMED((yyvsp[-3].nArgs));
             }
-#line 1590 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1588 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 34: /* simpstmt: initarraylv '[' arglist ']' MULEQ expr  */
-#line 178 "parser.y"
+#line 176 "parser.y"
                                                      {
                 ADD_OP(OP_ARRAY_REF_ASSIGN_SETUP); ADD_IMMED(1); ADD_IMMED((yyvsp[-3].nArgs));
                 ADD_OP(OP_MUL);
                 ADD_OP(OP_ARRAY_ASSIGN); ADD_IMMED((yyvsp[-3].nArgs));
             }
-#line 1600 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1598 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 35: /* simpstmt: initarraylv '[' arglist ']' DIVEQ expr  */
-#line 183 "parser.y"
+#line 181 "parser.y"
                                                      {
                 ADD_OP(OP_ARRAY_REF_ASSIGN_SETUP); ADD_IMMED(1); ADD_IMMED((yyvsp[-3].nArgs));
                 ADD_OP(OP_DIV);
                 ADD_OP(OP_ARRAY_ASSIGN); ADD_IMMED((yyvsp[-3].nArgs));
             }
-#line 1610 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1608 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 36: /* simpstmt: initarraylv '[' arglist ']' MODEQ expr  */
-#line 188 "parser.y"
+#line 186 "parser.y"
                                                      {
                 ADD_OP(OP_ARRAY_REF_ASSIGN_SETUP); ADD_IMMED(1); ADD_IMMED((yyvsp[-3].nArgs));
                 ADD_OP(OP_MOD);
                 ADD_OP(OP_ARRAY_ASSIGN); ADD_IMMED((yyvsp[-3].nArgs));
             }
-#line 1620 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1618 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 37: /* simpstmt: initarraylv '[' arglist ']' ANDEQ expr  */
-#line 193 "parser.y"
+#line 191 "parser.y"
                                                      {
                 ADD_OP(OP_ARRAY_REF_ASSIGN_SETUP); ADD_IMMED(1); ADD_IMMED((yyvsp[-3].nArgs));
                 ADD_OP(OP_BIT_AND);
                 ADD_OP(OP_ARRAY_ASSIGN); ADD_IMMED((yyvsp[-3].nArgs));
             }
-#line 1630 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1628 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 38: /* simpstmt: initarraylv '[' arglist ']' OREQ expr  */
-#line 198 "parser.y"
+#line 196 "parser.y"
                                                     {
                 ADD_OP(OP_ARRAY_REF_ASSIGN_SETUP); ADD_IMMED(1); ADD_IMMED((yyvsp[-3].nArgs));
                 ADD_OP(OP_BIT_OR);
                 ADD_OP(OP_ARRAY_ASSIGN); ADD_IMMED((yyvsp[-3].nArgs));
             }
-#line 1640 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1638 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 39: /* simpstmt: initarraylv '[' arglist ']' INCR  */
-#line 203 "parser.y"
+#line 201 "parser.y"
                                                {
                 ADD_OP(OP_ARRAY_REF_ASSIGN_SETUP); ADD_IMMED(0); ADD_IMMED((yyvsp[-2].nArgs));
                 ADD_OP(OP_INCR);
                 ADD_OP(OP_ARRAY_ASSIGN); ADD_IMMED((yyvsp[-2].nArgs));
             }
-#line 1650 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1648 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 40: /* simpstmt: initarraylv '[' arglist ']' DECR  */
-#line 208 "parser.y"
+#line 206 "parser.y"
                                                {
                 ADD_OP(OP_ARRAY_REF_ASSIGN_SETUP); ADD_IMMED(0); ADD_IMMED((yyvsp[-2].nArgs));
                 ADD_OP(OP_DECR);
                 ADD_OP(OP_ARRAY_ASSIGN); ADD_IMMED((yyvsp[-2].nArgs));
             }
-#line 1660 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1658 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 41: /* simpstmt: INCR initarraylv '[' arglist ']'  */
-#line 213 "parser.y"
+#line 211 "parser.y"
                                                {
                 ADD_OP(OP_ARRAY_REF_ASSIGN_SETUP); ADD_IMMED(0); ADD_IMMED((yyvsp[-1].nArgs));
                 ADD_OP(OP_INCR);
                 ADD_OP(OP_ARRAY_ASSIGN); ADD_IMMED((yyvsp[-1].nArgs));
             }
-#line 1670 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1668 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 42: /* simpstmt: DECR initarraylv '[' arglist ']'  */
-#line 218 "parser.y"
+#line 216 "parser.y"
                                                {
                 ADD_OP(OP_ARRAY_REF_ASSIGN_SETUP); ADD_IMMED(0); ADD_IMMED((yyvsp[-1].nArgs));
                 ADD_OP(OP_DECR);
                 ADD_OP(OP_ARRAY_ASSIGN); ADD_IMMED((yyvsp[-1].nArgs));
             }
-#line 1680 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1678 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 43: /* simpstmt: SYMBOL '(' arglist ')'  */
-#line 223 "parser.y"
+#line 221 "parser.y"
                                      {
                 ADD_OP(OP_SUBR_CALL);
                 ADD_SYM(PromoteToGlobal((yyvsp[-3].sym))); ADD_IMMED((yyvsp[-1].nArgs));
             }
-#line 1689 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1687 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 44: /* simpstmt: INCR SYMBOL  */
-#line 227 "parser.y"
+#line 225 "parser.y"
                           {
                 ADD_OP(OP_PUSH_SYM); ADD_SYM((yyvsp[0].sym)); ADD_OP(OP_INCR);
                 ADD_OP(OP_ASSIGN); ADD_SYM((yyvsp[0].sym));
             }
-#line 1698 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1696 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 45: /* simpstmt: SYMBOL INCR  */
-#line 231 "parser.y"
+#line 229 "parser.y"
                           {
                 ADD_OP(OP_PUSH_SYM); ADD_SYM((yyvsp[-1].sym)); ADD_OP(OP_INCR);
                 ADD_OP(OP_ASSIGN); ADD_SYM((yyvsp[-1].sym));
             }
-#line 1707 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1705 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 46: /* simpstmt: DECR SYMBOL  */
-#line 235 "parser.y"
+#line 233 "parser.y"
                           {
                 ADD_OP(OP_PUSH_SYM); ADD_SYM((yyvsp[0].sym)); ADD_OP(OP_DECR);
                 ADD_OP(OP_ASSIGN); ADD_SYM((yyvsp[0].sym));
             }
-#line 1716 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1714 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 47: /* simpstmt: SYMBOL DECR  */
-#line 239 "parser.y"
+#line 237 "parser.y"
                           {
                 ADD_OP(OP_PUSH_SYM); ADD_SYM((yyvsp[-1].sym)); ADD_OP(OP_DECR);
                 ADD_OP(OP_ASSIGN); ADD_SYM((yyvsp[-1].sym));
             }
-#line 1725 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1723 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 48: /* evalsym: SYMBOL  */
-#line 244 "parser.y"
+#line 242 "parser.y"
                    {
                 (yyval.sym) = (yyvsp[0].sym); ADD_OP(OP_PUSH_SYM); ADD_SYM((yyvsp[0].sym));
             }
-#line 1733 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1731 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 49: /* comastmts: %empty  */
-#line 248 "parser.y"
+#line 246 "parser.y"
                           {
                 (yyval.inst) = GetPC();
             }
-#line 1741 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1739 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 50: /* comastmts: simpstmt  */
-#line 251 "parser.y"
+#line 249 "parser.y"
                        {
                 (yyval.inst) = GetPC();
             }
-#line 1749 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1747 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 51: /* comastmts: comastmts ',' simpstmt  */
-#line 254 "parser.y"
+#line 252 "parser.y"
                                      {
                 (yyval.inst) = GetPC();
             }
-#line 1757 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1755 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 52: /* arglist: %empty  */
-#line 258 "parser.y"
+#line 256 "parser.y"
                           {
                 (yyval.nArgs) = 0;
             }
-#line 1765 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1763 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 53: /* arglist: expr  */
-#line 261 "parser.y"
+#line 259 "parser.y"
                    {
                 (yyval.nArgs) = 1;
             }
-#line 1773 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1771 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 54: /* arglist: arglist ',' expr  */
-#line 264 "parser.y"
+#line 262 "parser.y"
                                {
                 (yyval.nArgs) = (yyvsp[-2].nArgs) + 1;
             }
-#line 1781 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1779 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 56: /* expr: expr numexpr  */
-#line 269 "parser.y"
+#line 267 "parser.y"
                                         {
                 ADD_OP(OP_CONCAT);
             }
-#line 1789 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1787 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 57: /* initarraylv: SYMBOL  */
-#line 273 "parser.y"
+#line 271 "parser.y"
                        {
                     ADD_OP(OP_PUSH_ARRAY_SYM); ADD_SYM((yyvsp[0].sym)); ADD_IMMED(1);
                 }
-#line 1797 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1795 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 58: /* initarraylv: initarraylv '[' arglist ']'  */
-#line 276 "parser.y"
+#line 274 "parser.y"
                                               {
                     ADD_OP(OP_ARRAY_REF); ADD_IMMED((yyvsp[-1].nArgs));
                 }
-#line 1805 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1803 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 59: /* arraylv: SYMBOL  */
-#line 280 "parser.y"
+#line 278 "parser.y"
                    {
                 ADD_OP(OP_PUSH_ARRAY_SYM); ADD_SYM((yyvsp[0].sym)); ADD_IMMED(0);
             }
-#line 1813 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1811 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 60: /* arraylv: arraylv '[' arglist ']'  */
-#line 283 "parser.y"
+#line 281 "parser.y"
                                       {
                 ADD_OP(OP_ARRAY_REF); ADD_IMMED((yyvsp[-1].nArgs));
             }
-#line 1821 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1819 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 61: /* arrayexpr: numexpr  */
-#line 287 "parser.y"
+#line 285 "parser.y"
                     {
                 (yyval.inst) = GetPC();
             }
-#line 1829 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1827 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 62: /* numexpr: NUMBER  */
-#line 291 "parser.y"
+#line 289 "parser.y"
                    {
                 ADD_OP(OP_PUSH_SYM); ADD_SYM((yyvsp[0].sym));
             }
-#line 1837 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1835 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 63: /* numexpr: STRING  */
-#line 294 "parser.y"
+#line 292 "parser.y"
                      {
                 ADD_OP(OP_PUSH_SYM); ADD_SYM((yyvsp[0].sym));
             }
-#line 1845 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1843 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 64: /* numexpr: SYMBOL  */
-#line 297 "parser.y"
+#line 295 "parser.y"
                      {
                 ADD_OP(OP_PUSH_SYM); ADD_SYM((yyvsp[0].sym));
             }
-#line 1853 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1851 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 65: /* numexpr: SYMBOL '(' arglist ')'  */
-#line 300 "parser.y"
+#line 298 "parser.y"
                                      {
                 ADD_OP(OP_SUBR_CALL);
                 ADD_SYM(PromoteToGlobal((yyvsp[-3].sym))); ADD_IMMED((yyvsp[-1].nArgs));
                 ADD_OP(OP_FETCH_RET_VAL);
             }
-#line 1863 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1861 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 67: /* numexpr: ARG_LOOKUP '[' numexpr ']'  */
-#line 306 "parser.y"
+#line 304 "parser.y"
                                          {
                ADD_OP(OP_PUSH_ARG);
             }
-#line 1871 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1869 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 68: /* numexpr: ARG_LOOKUP '[' ']'  */
-#line 309 "parser.y"
+#line 307 "parser.y"
                                  {
                ADD_OP(OP_PUSH_ARG_COUNT);
             }
-#line 1879 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1877 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 69: /* numexpr: ARG_LOOKUP  */
-#line 312 "parser.y"
+#line 310 "parser.y"
                          {
                ADD_OP(OP_PUSH_ARG_ARRAY);
             }
-#line 1887 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1885 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 70: /* numexpr: numexpr '[' arglist ']'  */
-#line 315 "parser.y"
+#line 313 "parser.y"
                                       {
                 ADD_OP(OP_ARRAY_REF); ADD_IMMED((yyvsp[-1].nArgs));
             }
-#line 1895 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1893 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 71: /* numexpr: numexpr '+' numexpr  */
-#line 318 "parser.y"
+#line 316 "parser.y"
                                   {
                 ADD_OP(OP_ADD);
             }
-#line 1903 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1901 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 72: /* numexpr: numexpr '-' numexpr  */
-#line 321 "parser.y"
+#line 319 "parser.y"
                                   {
                 ADD_OP(OP_SUB);
             }
-#line 1911 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1909 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 73: /* numexpr: numexpr '*' numexpr  */
-#line 324 "parser.y"
+#line 322 "parser.y"
                                   {
                 ADD_OP(OP_MUL);
             }
-#line 1919 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1917 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 74: /* numexpr: numexpr '/' numexpr  */
-#line 327 "parser.y"
+#line 325 "parser.y"
                                   {
                 ADD_OP(OP_DIV);
             }
-#line 1927 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1925 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 75: /* numexpr: numexpr '%' numexpr  */
-#line 330 "parser.y"
+#line 328 "parser.y"
                                   {
                 ADD_OP(OP_MOD);
             }
-#line 1935 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1933 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 76: /* numexpr: numexpr POW numexpr  */
-#line 333 "parser.y"
+#line 331 "parser.y"
                                   {
                 ADD_OP(OP_POWER);
             }
-#line 1943 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1941 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 77: /* numexpr: '-' numexpr  */
-#line 336 "parser.y"
+#line 334 "parser.y"
                                              {
                 ADD_OP(OP_NEGATE);
             }
-#line 1951 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1949 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 78: /* numexpr: numexpr GT numexpr  */
-#line 339 "parser.y"
+#line 337 "parser.y"
                                   {
                 ADD_OP(OP_GT);
             }
-#line 1959 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1957 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 79: /* numexpr: numexpr GE numexpr  */
-#line 342 "parser.y"
+#line 340 "parser.y"
                                   {
                 ADD_OP(OP_GE);
             }
-#line 1967 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1965 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 80: /* numexpr: numexpr LT numexpr  */
-#line 345 "parser.y"
+#line 343 "parser.y"
                                   {
                 ADD_OP(OP_LT);
             }
-#line 1975 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1973 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 81: /* numexpr: numexpr LE numexpr  */
-#line 348 "parser.y"
+#line 346 "parser.y"
                                   {
                 ADD_OP(OP_LE);
             }
-#line 1983 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1981 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 82: /* numexpr: numexpr EQ numexpr  */
-#line 351 "parser.y"
+#line 349 "parser.y"
                                   {
                 ADD_OP(OP_EQ);
             }
-#line 1991 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1989 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 83: /* numexpr: numexpr NE numexpr  */
-#line 354 "parser.y"
+#line 352 "parser.y"
                                   {
                 ADD_OP(OP_NE);
             }
-#line 1999 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 1997 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 84: /* numexpr: numexpr '&' numexpr  */
-#line 357 "parser.y"
+#line 355 "parser.y"
                                   {
                 ADD_OP(OP_BIT_AND);
             }
-#line 2007 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 2005 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 85: /* numexpr: numexpr '|' numexpr  */
-#line 360 "parser.y"
+#line 358 "parser.y"
                                    {
                 ADD_OP(OP_BIT_OR);
             }
-#line 2015 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 2013 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 86: /* numexpr: numexpr and numexpr  */
-#line 363 "parser.y"
+#line 361 "parser.y"
                                             {
                 ADD_OP(OP_AND); SET_BR_OFF((yyvsp[-1].inst), GetPC());
             }
-#line 2023 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 2021 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 87: /* numexpr: numexpr or numexpr  */
-#line 366 "parser.y"
+#line 364 "parser.y"
                                           {
                 ADD_OP(OP_OR); SET_BR_OFF((yyvsp[-1].inst), GetPC());
             }
-#line 2031 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 2029 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 88: /* numexpr: NOT numexpr  */
-#line 369 "parser.y"
+#line 367 "parser.y"
                           {
                 ADD_OP(OP_NOT);
             }
-#line 2039 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 2037 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 89: /* numexpr: INCR SYMBOL  */
-#line 372 "parser.y"
+#line 370 "parser.y"
                           {
                 ADD_OP(OP_PUSH_SYM); ADD_SYM((yyvsp[0].sym)); ADD_OP(OP_INCR);
                 ADD_OP(OP_DUP); ADD_OP(OP_ASSIGN); ADD_SYM((yyvsp[0].sym));
             }
-#line 2048 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 2046 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 90: /* numexpr: SYMBOL INCR  */
-#line 376 "parser.y"
+#line 374 "parser.y"
                           {
                 ADD_OP(OP_PUSH_SYM); ADD_SYM((yyvsp[-1].sym)); ADD_OP(OP_DUP);
                 ADD_OP(OP_INCR); ADD_OP(OP_ASSIGN); ADD_SYM((yyvsp[-1].sym));
             }
-#line 2057 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 2055 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 91: /* numexpr: DECR SYMBOL  */
-#line 380 "parser.y"
+#line 378 "parser.y"
                           {
                 ADD_OP(OP_PUSH_SYM); ADD_SYM((yyvsp[0].sym)); ADD_OP(OP_DECR);
                 ADD_OP(OP_DUP); ADD_OP(OP_ASSIGN); ADD_SYM((yyvsp[0].sym));
             }
-#line 2066 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 2064 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 92: /* numexpr: SYMBOL DECR  */
-#line 384 "parser.y"
+#line 382 "parser.y"
                           {
                 ADD_OP(OP_PUSH_SYM); ADD_SYM((yyvsp[-1].sym)); ADD_OP(OP_DUP);
                 ADD_OP(OP_DECR); ADD_OP(OP_ASSIGN); ADD_SYM((yyvsp[-1].sym));
             }
-#line 2075 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 2073 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 93: /* numexpr: numexpr IN numexpr  */
-#line 388 "parser.y"
+#line 386 "parser.y"
                                  {
                 ADD_OP(OP_IN_ARRAY);
             }
-#line 2083 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 2081 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 94: /* while: WHILE  */
-#line 392 "parser.y"
+#line 390 "parser.y"
               {
             (yyval.inst) = GetPC(); StartLoopAddrList();
         }
-#line 2091 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 2089 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 95: /* for: FOR  */
-#line 396 "parser.y"
+#line 394 "parser.y"
             {
             StartLoopAddrList(); (yyval.inst) = GetPC();
         }
-#line 2099 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 2097 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 96: /* else: ELSE  */
-#line 400 "parser.y"
+#line 398 "parser.y"
              {
-            ADD_OP(OP_BRANCH); (yyval.inst) = GetPC(); ADD_BR_OFF(nullptr);
+            ADD_OP(OP_BRANCH); (yyval.inst) = GetPC(); ADD_BR_OFF(GetPC());
         }
-#line 2107 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 2105 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 97: /* cond: %empty  */
-#line 404 "parser.y"
+#line 402 "parser.y"
                       {
-            ADD_OP(OP_BRANCH_NEVER); (yyval.inst) = GetPC(); ADD_BR_OFF(nullptr);
+            ADD_OP(OP_BRANCH_NEVER); (yyval.inst) = GetPC(); ADD_BR_OFF(GetPC());
         }
-#line 2115 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 2113 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 98: /* cond: numexpr  */
-#line 407 "parser.y"
+#line 405 "parser.y"
                   {
-            ADD_OP(OP_BRANCH_FALSE); (yyval.inst) = GetPC(); ADD_BR_OFF(nullptr);
+            ADD_OP(OP_BRANCH_FALSE); (yyval.inst) = GetPC(); ADD_BR_OFF(GetPC());
         }
-#line 2123 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 2121 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 99: /* and: AND  */
-#line 411 "parser.y"
+#line 409 "parser.y"
             {
             ADD_OP(OP_DUP); ADD_OP(OP_BRANCH_FALSE); (yyval.inst) = GetPC();
-            ADD_BR_OFF(nullptr);
+            ADD_BR_OFF(GetPC());
         }
-#line 2132 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 2130 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
   case 100: /* or: OR  */
-#line 416 "parser.y"
+#line 414 "parser.y"
            {
             ADD_OP(OP_DUP); ADD_OP(OP_BRANCH_TRUE); (yyval.inst) = GetPC();
-            ADD_BR_OFF(nullptr);
+            ADD_BR_OFF(GetPC());
         }
-#line 2141 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 2139 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
     break;
 
 
-#line 2145 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
+#line 2143 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.cpp"
 
       default: break;
     }
@@ -2335,9 +2333,13 @@ yyreturn:
   return yyresult;
 }
 
-#line 425 "parser.y"
+#line 423 "parser.y"
  /* User Subroutines Section */
 
+/* The line of the source which the lexer has reached, which the instructions
+   compiled are attributed to for the profiler */
+static QString::const_iterator LinePtr;
+static int Line;
 
 /*
 ** Parse a string and create a program from it (this is the parser entry point).
@@ -2353,8 +2355,10 @@ Program *compileMacro(const QString &expr, QString *msg, int *stoppedAt) {
        failed, return the error message and string index (the grammar aborts
        parsing at the first error) */
     QString::const_iterator start = expr.begin();
-    InPtr  = start;
-    EndPtr = start + expr.size();
+    InPtr   = start;
+    EndPtr  = start + expr.size();
+    LinePtr = start;
+    Line    = 1;
 
     if (yyparse()) {
 		*msg       = ErrMsg;
@@ -2402,6 +2406,16 @@ static int yylex(void) {
         }
     }
 
+    /* count the lines up to the start of the token. The parser has usually
+       read one token ahead by the time it generates code, so the code is
+       attributed to the line of the token before this one */
+    SetSourceLine(Line);
+    for (; LinePtr != InPtr; ++LinePtr) {
+        if (*LinePtr == QLatin1Char('\n')) {
+            ++Line;
+        }
+    }
+
     /* return end of input at the end of the string */
     if (InPtr == EndPtr) {
         return 0;
@@ -2418,13 +2432,17 @@ static int yylex(void) {
             *p++ = *InPtr++;
         }
 
-        int n = value.toInt();
+        /* constants too large for 64 bits wrap around, as arithmetic does, so
+           that -9223372036854775808 is the smallest integer */
+        uint64_t n = 0;
+        for (QChar ch : value) {
+            n = (n * 10) + static_cast<uint64_t>(ch.toLatin1() - '0');
+        }
 
-        char name[28];
-        snprintf(name, sizeof(name), "const %d", n);
+        const std::string name = "const " + std::to_string(static_cast<int64_t>(n));
 
         if ((yylval.sym = LookupSymbol(name)) == nullptr) {
-            yylval.sym = InstallSymbol(name, CONST_SYM, make_value(n));
+            yylval.sym = InstallSymbol(name, CONST_SYM, make_value(static_cast<int64_t>(n)));
         }
 
         return NUMBER;
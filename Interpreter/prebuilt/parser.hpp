@@ -100,7 +100,7 @@ union YYSTYPE
 #line 38 "parser.y"
 
     Symbol *sym;
-    Inst *inst;
+    CodeOffset inst;
     int nArgs;
 
 #line 107 "/home/eteran/projects/nedit-ng/build/Interpreter/parser.hpp"
@@ -0,0 +1,294 @@
+
+#include "interpret.h"
+#include "parse.h"
+
+#include <QString>
+
+#include <iostream>
+
+namespace {
+
+struct Test {
+	const char *macro;
+	const char *result; // the result as a string, or nullptr if the macro should fail
+};
+
+/**
+ * @brief runProgram
+ * @param prog
+ * @param result
+ * @return true if "prog" ran to completion, in which case its return value is
+ * stored in "result". "prog" is freed
+ */
+bool runProgram(Program *prog, std::string *result) {
+
+	QString message;
+	DataValue value;
+	std::shared_ptr<MacroContext> continuation;
+
+	int status = executeMacro(nullptr, prog, {}, &value, continuation, &message);
+	while (status == MACRO_TIME_LIMIT) {
+		status = continueMacro(continuation, &value, &message);
+	}
+
+	delete prog;
+
+	if (status != MACRO_DONE) {
+		return false;
+	}
+
+	if (is_integer(value)) {
+		*result = std::to_string(to_integer(value));
+	} else if (is_string(value)) {
+		*result = to_string(value);
+	} else {
+		result->clear();
+	}
+
+	return true;
+}
+
+/**
+ * @brief runMacro
+ * @param macro
+ * @param result
+ * @return true if "macro" compiled and ran to completion, in which case its
+ * return value is stored in "result"
+ */
+bool runMacro(const std::string &macro, std::string *result) {
+
+	QString message;
+	int stoppedAt;
+
+	Program *prog = compileMacro(QString::fromStdString(macro), &message, &stoppedAt);
+	if (!prog) {
+		std::cerr << "ERROR    : " << macro << ": " << message.toStdString() << " at " << stoppedAt << std::endl;
+		return false;
+	}
+
+	return runProgram(prog, result);
+}
+
+/**
+ * @brief runSerializedMacro
+ * @param macro
+ * @param result
+ * @return true if "macro" compiled, survived being serialized and
+ * deserialized unchanged, and then ran to completion, in which case its
+ * return value is stored in "result"
+ */
+bool runSerializedMacro(const std::string &macro, std::string *result) {
+
+	QString message;
+	int stoppedAt;
+
+	Program *prog = compileMacro(QString::fromStdString(macro), &message, &stoppedAt);
+	if (!prog) {
+		std::cerr << "ERROR    : " << macro << ": " << message.toStdString() << " at " << stoppedAt << std::endl;
+		return false;
+	}
+
+	const std::string data = SerializeProgram(prog);
+	delete prog;
+
+	prog = DeserializeProgram(data);
+	if (!prog) {
+		std::cerr << "ERROR    : " << macro << ": could not be deserialized" << std::endl;
+		return false;
+	}
+
+	if (SerializeProgram(prog) != data) {
+		std::cerr << "ERROR    : " << macro << ": changed by being deserialized" << std::endl;
+		delete prog;
+		return false;
+	}
+
+	return runProgram(prog, result);
+}
+
+/**
+ * @brief defineFunction
+ * @param name
+ * @param body
+ * @return true if "body" compiled, and was installed as the macro function
+ * "name", the way a define block in a macro file is
+ */
+bool defineFunction(const char *name, const char *body) {
+
+	QString message;
+	int stoppedAt;
+
+	Program *prog = compileMacro(QString::fromLatin1(body), &message, &stoppedAt);
+	if (!prog) {
+		std::cerr << "ERROR    : " << name << ": " << message.toStdString() << " at " << stoppedAt << std::endl;
+		return false;
+	}
+
+	if (Symbol *const sym = LookupSymbol(name)) {
+		sym->type  = MACRO_FUNCTION_SYM;
+		sym->value = make_value(prog);
+	} else {
+		InstallSymbol(name, MACRO_FUNCTION_SYM, make_value(prog));
+	}
+
+	prog->name = name;
+
+	return true;
+}
+
+}
+
+int main() {
+
+	static const Test tests[] = {
+		// values which don't fit in 32 bits
+		{"return 3000000000 * 2\n", "6000000000"},
+		{"return 2 ^ 62\n", "4611686018427387904"},
+		{"return 4294967296 / 3\n", "1431655765"},
+		{"return 9223372036854775807\n", "9223372036854775807"},
+		{"return -9223372036854775808\n", "-9223372036854775808"},
+		{"return \"8589934592\" + 1\n", "8589934593"},
+		{"return (1 ^ 40) + (2 ^ 40)\n", "1099511627777"},
+
+		// overflow wraps around
+		{"return 9223372036854775807 + 1\n", "-9223372036854775808"},
+		{"return -9223372036854775808 - 1\n", "9223372036854775807"},
+		{"return 4294967296 * 4294967296\n", "0"},
+		{"return 2 ^ 64\n", "0"},
+		{"x = 9223372036854775807\nx++\nreturn x\n", "-9223372036854775808"},
+		{"x = -9223372036854775808\nx--\nreturn x\n", "9223372036854775807"},
+		{"x = -9223372036854775808\nreturn -x\n", "-9223372036854775808"},
+		{"x = 9223372036854775807\nx += 2\nreturn x\n", "-9223372036854775807"},
+
+		// division
+		{"return -9223372036854775808 / -1\n", "-9223372036854775808"},
+		{"return -9223372036854775808 % -1\n", "0"},
+		{"return -7 / 2\n", "-3"},
+		{"return -7 % 2\n", "-1"},
+		{"return 1 / 0\n", nullptr},
+		{"return 1 % 0\n", nullptr},
+
+		// negative exponents
+		{"return 5 ^ -1\n", "0"},
+		{"return 1 ^ -5\n", "1"},
+		{"return -1 ^ -3\n", "-1"},
+		{"return 0 ^ -1\n", nullptr},
+
+		// integer array keys
+		{"a[5000000000] = 1\na[705032704] = 2\nreturn a[5000000000] \" \" a[705032704]\n", "1 2"},
+
+		// strings which are out of range are clamped
+		{"return \"99999999999999999999\" + 0\n", "9223372036854775807"},
+		{"return \"-99999999999999999999\" + 0\n", "-9223372036854775808"},
+	};
+
+	InitMacroGlobals();
+
+	for (const Test &test : tests) {
+		std::string result;
+		const bool ok = runMacro(test.macro, &result);
+
+		// a program behaves the same after being kept in serialized form
+		std::string serializedResult;
+		if (runSerializedMacro(test.macro, &serializedResult) != ok || serializedResult != result) {
+			std::cerr << "ERROR    : " << test.macro << " gave " << serializedResult << " once serialized, instead of " << result << std::endl;
+			return -1;
+		}
+
+		if (!test.result) {
+			if (ok) {
+				std::cerr << "ERROR    : Expected failure of: " << test.macro << std::endl;
+				return -1;
+			}
+			continue;
+		}
+
+		if (!ok || result != test.result) {
+			std::cerr << "ERROR    : " << test.macro << " gave " << result << ", expected " << test.result << std::endl;
+			return -1;
+		}
+	}
+
+	// recursion much deeper than the initial size of the stack
+	if (!defineFunction("depth", "if ($1 <= 0) {\n\treturn 0\n}\nlocal = $1\nreturn depth($1 - 1) + 1\n")) {
+		return -1;
+	}
+
+	std::string result;
+	if (!runMacro("return depth(20000)\n", &result) || result != "20000") {
+		std::cerr << "ERROR    : Failed to recurse 20000 deep: " << result << std::endl;
+		return -1;
+	}
+
+	// unbounded recursion still fails, rather than using up all of memory
+	if (!defineFunction("forever", "return forever($1 + 1)\n")) {
+		return -1;
+	}
+
+	if (runMacro("return forever(0)\n", &result)) {
+		std::cerr << "ERROR    : Expected failure of unbounded recursion" << std::endl;
+		return -1;
+	}
+
+	// a program much larger than the size programs used to be limited to
+	std::string large;
+	for (int i = 0; i < 10000; ++i) {
+		large += "x = x + " + std::to_string(i) + "\n";
+	}
+
+	if (!runMacro("x = 0\n" + large + "return x\n", &result) || result != "49995000") {
+		std::cerr << "ERROR    : Failed to run a large program: " << result << std::endl;
+		return -1;
+	}
+
+	// lots of values on the stack at once
+	std::string sum = "return 0";
+	for (int i = 1; i <= 2000; ++i) {
+		sum += " + (" + std::to_string(i);
+	}
+	sum += std::string(2000, ')') + "\n";
+
+	if (!runMacro(sum, &result) || result != "2001000") {
+		std::cerr << "ERROR    : Failed to evaluate a deeply nested expression: " << result << std::endl;
+		return -1;
+	}
+
+	// serialized programs keep their loops, arrays and calls of other functions
+	const std::string loops = "s = 0\nfor (i = 0; i < 10; i++) {\n\ts += i\n}\na[\"x\"] = 5\nfor (k in a) {\n\ts += a[k]\n}\nreturn s \" \" depth(30)\n";
+	if (!runSerializedMacro(loops, &result) || result != "50 30") {
+		std::cerr << "ERROR    : Failed to run a serialized program with loops: " << result << std::endl;
+		return -1;
+	}
+
+	// a serialized program isn't used once a global hides one of its local variables
+	QString message;
+	int stoppedAt;
+	Program *prog = compileMacro(QLatin1String("hidden = 1\nreturn hidden\n"), &message, &stoppedAt);
+	const std::string data = SerializeProgram(prog);
+	delete prog;
+
+	if (data.empty() || DeserializeProgram(data.substr(0, data.size() - 1))) {
+		std::cerr << "ERROR    : Used a serialized program which is incomplete" << std::endl;
+		return -1;
+	}
+
+	InstallSymbol("hidden", GLOBAL_SYM, make_value());
+	if (DeserializeProgram(data)) {
+		std::cerr << "ERROR    : Used a serialized program which is out of date" << std::endl;
+		return -1;
+	}
+
+	// the profiler counts calls of each macro function, by name
+	SetMacroProfiling(true);
+	const bool profiled = runMacro("return depth(10)\n", &result);
+	SetMacroProfiling(false);
+
+	const std::string report = MacroProfileReport();
+	if (!profiled || report.find("depth                                    11") == std::string::npos) {
+		std::cerr << "ERROR    : Unexpected macro profile:\n" << report << std::endl;
+		return -1;
+	}
+
+	CleanupMacroGlobals();
+	std::cout << "SUCCESS\n";
+}
@@ -17,6 +17,8 @@
 #include <limits>
 #include <gsl/gsl_util>
 
+thread_local ParseContext pContext;
+
 namespace {
 
 const auto FirstPassToken = reinterpret_cast<uint8_t *>(1);
@@ -124,11 +126,9 @@ bool isQuantifier(char ch) noexcept {
  *--------------------------------------------------------------------*/
 bool init_ansi_classes() noexcept {
 
-	static bool initialized = false;
-
-	if (!initialized) {
-		initialized = true; // Only need to generate character sets once.
-
+	/* Only need to generate character sets once. A static is only initialized
+	   once, even when regular expressions are compiled on several threads */
+	static const bool initialized = []() noexcept {
 		constexpr char Underscore = '_';
 		constexpr char Newline    = '\n';
 
@@ -166,9 +166,10 @@ bool init_ansi_classes() noexcept {
 		Word_Char[word_count]     = '\0';
 		Letter_Char[letter_count] = '\0';
 		White_Space[space_count]  = '\0';
-	}
+		return true;
+	}();
 
-	return true;
+	return initialized;
 }
 
 /*----------------------------------------------------------------------*
@@ -1205,7 +1206,8 @@ uint8_t *piece(int *flag_param, len_range &range_param) {
 			*flag_param = flags_local;
 			range_param = range_local;
 			return ret_val;
-		} else if (pContext.Num_Braces > static_cast<int>(std::numeric_limits<uint8_t>::max())) {
+		} else if (pContext.Num_Braces >= static_cast<int>(std::numeric_limits<uint8_t>::max())) {
+			// the count, and so the index of the next one, must fit in a byte of the program
 			Raise<RegexError>("number of {m,n} constructs > %d", UINT8_MAX);
 		}
 	}
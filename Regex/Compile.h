@@ -26,6 +26,7 @@ struct ParseContext {
 	char Brace_Char;
 };
 
-extern ParseContext pContext;
+// one per thread, so that regular expressions can be compiled on several at once
+extern thread_local ParseContext pContext;
 
 #endif
@@ -17,6 +17,9 @@
 #include <cstring>
 #include <limits>
 
+// constant initialized, so that using it needs no check for initialization
+thread_local ExecuteContext eContext = {};
+
 namespace {
 
 bool match(uint8_t *prog, size_t *branch_index_param);
@@ -1078,10 +1081,8 @@ bool Regex::ExecRE(const char *start, const char *end, bool reverse, int prev_ch
 	// Reset the recursion detection flag
 	eContext.Recursion_Limit_Exceeded = false;
 
-	// Allocate memory for {m,n} construct counting variables if need be.
-	if (eContext.Num_Braces > 0) {
-		eContext.BraceCounts = std::make_unique<uint32_t[]>(eContext.Num_Braces);
-	}
+	// Reset the {m,n} construct counting variables
+	std::fill_n(eContext.BraceCounts.begin(), eContext.Num_Braces, 0);
 
 	/* Initialize the first nine (9) capturing parentheses start and end
 	   pointers to point to the start of the search string.  This is to prevent
@@ -19,19 +19,19 @@ template <size_t N>
 using array_iterator = typename std::array<const char *, N>::iterator;
 
 struct ExecuteContext {
-	std::unique_ptr<uint32_t[]> BraceCounts;     // Define a pointer to an array to hold general (...){m,n} counts.
-	const char *Reg_Input;                       // String-input pointer.
-	const char *Start_Of_String;                 // Beginning of input, for ^ and < checks.
-	const char *End_Of_String;                   // Logical end of input
-	const char *Real_End_Of_String;              // Point that the string truly ends and we may not pass safely
-	const char *Look_Behind_To;                  // Position till were look behind can safely check back
-	array_iterator<MaxSubExpr> Start_Ptr_Ptr;    // Pointer to 'startp' array.
-	array_iterator<MaxSubExpr> End_Ptr_Ptr;      // Ditto for 'endp'.
-	const char *Extent_Ptr_FW;                   // Forward extent pointer
-	const char *Extent_Ptr_BW;                   // Backward extent pointer
-	std::array<const char *, 10> Back_Ref_Start; // Back_Ref_Start [0] and
-	std::array<const char *, 10> Back_Ref_End;   // Back_Ref_End [0] are not used. This simplifies indexing.
-	int Recursion_Count;                         // Recursion counter
+	std::array<uint32_t, UINT8_MAX + 1> BraceCounts; // Holds general (...){m,n} counts, indexed by a byte of the program.
+	const char *Reg_Input;                           // String-input pointer.
+	const char *Start_Of_String;                     // Beginning of input, for ^ and < checks.
+	const char *End_Of_String;                       // Logical end of input
+	const char *Real_End_Of_String;                  // Point that the string truly ends and we may not pass safely
+	const char *Look_Behind_To;                      // Position till were look behind can safely check back
+	array_iterator<MaxSubExpr> Start_Ptr_Ptr;        // Pointer to 'startp' array.
+	array_iterator<MaxSubExpr> End_Ptr_Ptr;          // Ditto for 'endp'.
+	const char *Extent_Ptr_FW;                       // Forward extent pointer
+	const char *Extent_Ptr_BW;                       // Backward extent pointer
+	std::array<const char *, 10> Back_Ref_Start;     // Back_Ref_Start [0] and
+	std::array<const char *, 10> Back_Ref_End;       // Back_Ref_End [0] are not used. This simplifies indexing.
+	int Recursion_Count;                             // Recursion counter
 
 #ifdef ENABLE_CROSS_REGEX_BACKREF
 	Regex *Cross_Regex_Backref;
@@ -46,6 +46,7 @@ struct ExecuteContext {
 	std::bitset<256> Current_Delimiters; // Current delimiter table
 };
 
-extern ExecuteContext eContext;
+// one per thread, so that regular expressions can be matched on several at once
+extern thread_local ExecuteContext eContext;
 
 #endif
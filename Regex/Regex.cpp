@@ -87,9 +87,6 @@
 // Default table for determining whether a character is a word delimiter.
 std::bitset<256> Regex::Default_Delimiters;
 
-ExecuteContext eContext;
-ParseContext pContext;
-
 /* The "internal use only" fields in `Regex.h' are present to pass info from
  * `CompileRE' to `ExecRE' which permits the execute phase to run lots faster on
  * simple cases.  They are:
@@ -773,6 +773,24 @@ int main() {
 		return -1;
 	}
 
+	// the most {m,n} constructs of non-simple atoms there can be is 255
+	std::string braces;
+	for (int i = 0; i < 255; ++i) {
+		braces += "(?:a){0,2}";
+	}
+
+	if (test_regex_match(braces + "b", "aab") != 0) {
+		std::cerr << "ERROR    : Failed to match 255 {m,n} constructs" << std::endl;
+		return -1;
+	}
+
+	try {
+		Regex re(braces + "(?:a){0,2}b", RE_DEFAULT_STANDARD);
+		std::cerr << "ERROR    : Compiled 256 {m,n} constructs" << std::endl;
+		return -1;
+	} catch (const RegexError &) {
+	}
+
 #if 0 // testing "catastrophic backtracking"
     if (test_regex_match(R"((\\?.)*\\\n)", R"(Ada:Default\n\tAwk:Default\n\tC++:Default\n\tC:Default\n\tCSS:Default\n\tCsh:Default\n\tFortran:Default\n\tJava:Default\n\tJavaScript:Default\n\tLaTeX:Default\n\tLex:Default\n\tMakefile:Default\n\tMatlab:Default\n\tNEdit Macro:Default\n\tPascal:Default\n\tPerl:Default\n\tPostScript:Default\n\tPython:Default\n\tRegex:Default\n\tSGML HTML:Default\n\tSQL:Default\n\tSh Ksh Bash:Default\n\tTcl:Default\n\tVHDL:Default\n\tVerilog:Default\n\tXML:Default\n\tX Resources:Default\n\tYacc:Default)") != 0) {
 		std::cerr << "ERROR    : Failed to X resources match" << std::endl;
@@ -23,6 +23,7 @@ const QStringList DEFAULT_INCLUDE_PATHS = {
 
 const auto DEFAULT_DELIMITERS      = QLatin1String(".,/\\`'!|@#%^&*()-=+{}[]\":;<>?");
 const auto DEFAULT_BACKLIGHT_CHARS = QLatin1String("0-8,10-31,127:red;9:#dedede;32,160-255:#f0f0f0;128-159:orange");
+const auto DEFAULT_FIND_IGNORE     = QLatin1String(".git .hg .svn CVS *.o *.obj *.a *.lib *.so *.dll *.exe *.pyc");
 
 QString defaultTextFont() {
 	QFont fixedFont = QFontDatabase::systemFont(QFontDatabase::FixedFont);
@@ -96,6 +97,8 @@ bool focusOnRaise;
 bool forceOSConversion;
 bool globalTabNavigate;
 bool heavyCursor;
+bool highlightAllMatches;
+bool showOverviewRuler;
 bool highlightSyntax;
 bool honorSymlinks;
 bool insertTabs;
@@ -131,14 +134,18 @@ int autoSaveCharLimit;
 int autoSaveOpLimit;
 int autoScrollVPadding;
 int emulateTabs;
+int macroTimeSlice;
 int maxPrevOpenFiles;
 int tabDistance;
 int textCols;
 int textRows;
 int truncateLongNamesInTabs;
+int undoMemoryLimit;
+int totalUndoMemoryLimit;
 int wrapMargin;
 QFont font;
 QString backlightCharTypes;
+QString findInFilesIgnore;
 QString bgMenuCommands;
 QString colors[9];
 QString fontName;
@@ -271,6 +278,16 @@ QString smartIndentFile() {
 	return filename;
 }
 
+/**
+ * @brief macroCacheDirectory
+ * @return
+ */
+QString macroCacheDirectory() {
+	static const QString configDir = configDirectory();
+	static const auto dirname      = QStringLiteral("%1/macro-cache").arg(configDir);
+	return dirname;
+}
+
 /**
  * @brief loadPreferences
  */
@@ -303,6 +320,7 @@ void loadPreferences(bool isServer) {
 	backlightCharTypes     = settings.value(tr("nedit.backlightCharTypes"), DEFAULT_BACKLIGHT_CHARS).toString();
 	searchDialogs          = settings.value(tr("nedit.searchDialogs"), false).toBool();
 	beepOnSearchWrap       = settings.value(tr("nedit.beepOnSearchWrap"), false).toBool();
+	highlightAllMatches    = settings.value(tr("nedit.highlightAllMatches"), false).toBool();
 	retainSearchDialogs    = settings.value(tr("nedit.retainSearchDialogs"), false).toBool();
 	searchWraps            = settings.value(tr("nedit.searchWraps"), true).toBool();
 	stickyCaseSenseButton  = settings.value(tr("nedit.stickyCaseSenseButton"), true).toBool();
@@ -336,17 +354,22 @@ void loadPreferences(bool isServer) {
 	geometry                     = settings.value(tr("nedit.geometry"), QString()).toString();
 	tagFile                      = settings.value(tr("nedit.tagFile"), QString()).toString();
 	wordDelimiters               = settings.value(tr("nedit.wordDelimiters"), DEFAULT_DELIMITERS).toString();
+	findInFilesIgnore            = settings.value(tr("nedit.findInFilesIgnore"), DEFAULT_FIND_IGNORE).toString();
 	includePaths                 = settings.value(tr("nedit.includePaths"), DEFAULT_INCLUDE_PATHS).toStringList();
 	serverName                   = settings.value(tr("nedit.serverName"), QString()).toString();
 	maxPrevOpenFiles             = settings.value(tr("nedit.maxPrevOpenFiles"), 30).toInt();
 	autoSaveCharLimit            = settings.value(tr("nedit.autoSaveCharLimit"), 80).toInt();
 	autoSaveOpLimit              = settings.value(tr("nedit.autoSaveOpLimit"), 8).toInt();
+	macroTimeSlice               = settings.value(tr("nedit.macroTimeSlice"), 15).toInt();
+	undoMemoryLimit              = settings.value(tr("nedit.undoMemoryLimit"), 256).toInt();
+	totalUndoMemoryLimit         = settings.value(tr("nedit.totalUndoMemoryLimit"), 1024).toInt();
 	smartTags                    = settings.value(tr("nedit.smartTags"), true).toBool();
 	typingHidesPointer           = settings.value(tr("nedit.typingHidesPointer"), false).toBool();
 	alwaysCheckRelativeTagsSpecs = settings.value(tr("nedit.alwaysCheckRelativeTagsSpecs"), true).toBool();
 	colorizeHighlightedText      = settings.value(tr("nedit.colorizeHighlightedText"), true).toBool();
 	autoWrapPastedText           = settings.value(tr("nedit.autoWrapPastedText"), false).toBool();
 	heavyCursor                  = settings.value(tr("nedit.heavyCursor"), false).toBool();
+	showOverviewRuler            = settings.value(tr("nedit.showOverviewRuler"), false).toBool();
 	prefFileRead                 = settings.value(tr("nedit.prefFileRead"), false).toBool();
 	findReplaceUsesSelection     = settings.value(tr("nedit.findReplaceUsesSelection"), false).toBool();
 	titleFormat                  = settings.value(tr("nedit.titleFormat"), QLatin1String("{%c} [%s] %f (%S) - %d")).toString();
@@ -403,6 +426,7 @@ void importSettings(const QString &filename) {
 	backlightCharTypes    = settings.value(tr("nedit.backlightCharTypes"), backlightCharTypes).toString();
 	searchDialogs         = settings.value(tr("nedit.searchDialogs"), searchDialogs).toBool();
 	beepOnSearchWrap      = settings.value(tr("nedit.beepOnSearchWrap"), beepOnSearchWrap).toBool();
+	highlightAllMatches   = settings.value(tr("nedit.highlightAllMatches"), highlightAllMatches).toBool();
 	retainSearchDialogs   = settings.value(tr("nedit.retainSearchDialogs"), retainSearchDialogs).toBool();
 	searchWraps           = settings.value(tr("nedit.searchWraps"), searchWraps).toBool();
 	stickyCaseSenseButton = settings.value(tr("nedit.stickyCaseSenseButton"), stickyCaseSenseButton).toBool();
@@ -435,15 +459,20 @@ void importSettings(const QString &filename) {
 	geometry                     = settings.value(tr("nedit.geometry"), geometry).toString();
 	tagFile                      = settings.value(tr("nedit.tagFile"), tagFile).toString();
 	wordDelimiters               = settings.value(tr("nedit.wordDelimiters"), wordDelimiters).toString();
+	findInFilesIgnore            = settings.value(tr("nedit.findInFilesIgnore"), findInFilesIgnore).toString();
 	includePaths                 = settings.value(tr("nedit.includePaths"), includePaths).toStringList();
 	serverName                   = settings.value(tr("nedit.serverName"), serverName).toString();
 	maxPrevOpenFiles             = settings.value(tr("nedit.maxPrevOpenFiles"), maxPrevOpenFiles).toInt();
 	autoSaveCharLimit            = settings.value(tr("nedit.autoSaveCharLimit"), autoSaveCharLimit).toInt();
 	autoSaveOpLimit              = settings.value(tr("nedit.autoSaveOpLimit"), autoSaveOpLimit).toInt();
+	macroTimeSlice               = settings.value(tr("nedit.macroTimeSlice"), macroTimeSlice).toInt();
+	undoMemoryLimit              = settings.value(tr("nedit.undoMemoryLimit"), undoMemoryLimit).toInt();
+	totalUndoMemoryLimit         = settings.value(tr("nedit.totalUndoMemoryLimit"), totalUndoMemoryLimit).toInt();
 	smartTags                    = settings.value(tr("nedit.smartTags"), smartTags).toBool();
 	typingHidesPointer           = settings.value(tr("nedit.typingHidesPointer"), typingHidesPointer).toBool();
 	alwaysCheckRelativeTagsSpecs = settings.value(tr("nedit.alwaysCheckRelativeTagsSpecs"), alwaysCheckRelativeTagsSpecs).toBool();
 	heavyCursor                  = settings.value(tr("nedit.heavyCursor"), heavyCursor).toBool();
+	showOverviewRuler            = settings.value(tr("nedit.showOverviewRuler"), showOverviewRuler).toBool();
 	autoWrapPastedText           = settings.value(tr("nedit.autoWrapPastedText"), autoWrapPastedText).toBool();
 	colorizeHighlightedText      = settings.value(tr("nedit.colorizeHighlightedText"), colorizeHighlightedText).toBool();
 	prefFileRead                 = settings.value(tr("nedit.prefFileRead"), prefFileRead).toBool();
@@ -489,6 +518,7 @@ bool savePreferences() {
 	settings.setValue(tr("nedit.backlightCharTypes"), backlightCharTypes);
 	settings.setValue(tr("nedit.searchDialogs"), searchDialogs);
 	settings.setValue(tr("nedit.beepOnSearchWrap"), beepOnSearchWrap);
+	settings.setValue(tr("nedit.highlightAllMatches"), highlightAllMatches);
 	settings.setValue(tr("nedit.retainSearchDialogs"), retainSearchDialogs);
 	settings.setValue(tr("nedit.searchWraps"), searchWraps);
 	settings.setValue(tr("nedit.stickyCaseSenseButton"), stickyCaseSenseButton);
@@ -521,15 +551,20 @@ bool savePreferences() {
 	settings.setValue(tr("nedit.geometry"), geometry);
 	settings.setValue(tr("nedit.tagFile"), tagFile);
 	settings.setValue(tr("nedit.wordDelimiters"), wordDelimiters);
+	settings.setValue(tr("nedit.findInFilesIgnore"), findInFilesIgnore);
 	settings.setValue(tr("nedit.includePaths"), includePaths);
 	settings.setValue(tr("nedit.serverName"), serverName);
 	settings.setValue(tr("nedit.maxPrevOpenFiles"), maxPrevOpenFiles);
 	settings.setValue(tr("nedit.autoSaveCharLimit"), autoSaveCharLimit);
 	settings.setValue(tr("nedit.autoSaveOpLimit"), autoSaveOpLimit);
+	settings.setValue(tr("nedit.macroTimeSlice"), macroTimeSlice);
+	settings.setValue(tr("nedit.undoMemoryLimit"), undoMemoryLimit);
+	settings.setValue(tr("nedit.totalUndoMemoryLimit"), totalUndoMemoryLimit);
 	settings.setValue(tr("nedit.smartTags"), smartTags);
 	settings.setValue(tr("nedit.typingHidesPointer"), typingHidesPointer);
 	settings.setValue(tr("nedit.autoWrapPastedText"), autoWrapPastedText);
 	settings.setValue(tr("nedit.heavyCursor"), heavyCursor);
+	settings.setValue(tr("nedit.showOverviewRuler"), showOverviewRuler);
 	settings.setValue(tr("nedit.alwaysCheckRelativeTagsSpecs"), alwaysCheckRelativeTagsSpecs);
 	settings.setValue(tr("nedit.colorizeHighlightedText"), colorizeHighlightedText);
 	settings.setValue(tr("nedit.prefFileRead"), prefFileRead);
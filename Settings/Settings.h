@@ -45,6 +45,7 @@ QString macroMenuFile();
 QString shellMenuFile();
 QString contextMenuFile();
 QString smartIndentFile();
+QString macroCacheDirectory();
 
 // Standard
 extern bool showResizeNotification;
@@ -54,6 +55,7 @@ extern bool autoScroll;
 extern bool backlightChars;
 extern bool beepOnSearchWrap;
 extern bool globalTabNavigate;
+extern bool highlightAllMatches;
 extern bool highlightSyntax;
 extern bool insertTabs;
 extern bool iSearchLine;
@@ -106,6 +108,7 @@ extern QString titleFormat;
 extern bool autoWrapPastedText;
 extern bool colorizeHighlightedText;
 extern bool heavyCursor;
+extern bool showOverviewRuler;
 extern bool alwaysCheckRelativeTagsSpecs;
 extern bool findReplaceUsesSelection;
 extern bool focusOnRaise;
@@ -120,10 +123,14 @@ extern int autoScrollVPadding;
 extern int maxPrevOpenFiles;
 extern int autoSaveCharLimit;
 extern int autoSaveOpLimit;
+extern int macroTimeSlice;
+extern int undoMemoryLimit;
+extern int totalUndoMemoryLimit;
 extern TruncSubstitution truncSubstitution;
 extern QString backlightCharTypes;
 extern QString tagFile;
 extern QString wordDelimiters;
+extern QString findInFilesIgnore;
 extern QStringList includePaths;
 
 // Created implicitly from other "real" settings
@@ -0,0 +1,168 @@
+
+#include "BackupWriter.h"
+#include "ThreadPool.h"
+
+#include <QFile>
+#include <QSaveFile>
+
+#include <algorithm>
+
+namespace {
+
+// how much is written between checks for the write having been abandoned
+constexpr size_t ChunkSize = 1024 * 1024;
+
+}
+
+/**
+ * @brief BackupWriter::BackupWriter
+ * @param parent
+ */
+BackupWriter::BackupWriter(QObject *parent)
+	: QObject(parent) {
+}
+
+/**
+ * @brief BackupWriter::~BackupWriter
+ *
+ * Waits for the snapshots which have been asked for to be written, they are
+ * still the latest backup of the document.
+ */
+BackupWriter::~BackupWriter() {
+	QMutexLocker locker(&mutex_);
+	while (running_) {
+		idle_.wait(&mutex_);
+	}
+}
+
+/**
+ * @brief BackupWriter::write
+ * @param filename
+ * @param text
+ * @param appendLF
+ *
+ * Write "text" to the backup file "filename" in the background, replacing any
+ * snapshot which is still waiting to be written.
+ */
+void BackupWriter::write(const QString &filename, std::string text, bool appendLF) {
+
+	QMutexLocker locker(&mutex_);
+	pending_ = Job{filename, std::move(text), appendLF};
+
+	if (!running_) {
+		running_ = true;
+		StartInPool(QThreadPool::globalInstance(), [this]() {
+			run();
+		});
+	}
+}
+
+/**
+ * @brief BackupWriter::remove
+ * @param filename
+ *
+ * Remove the backup file "filename", abandoning any write which would have
+ * created it again.
+ */
+void BackupWriter::remove(const QString &filename) {
+
+	{
+		QMutexLocker locker(&mutex_);
+		pending_ = boost::none;
+		++generation_;
+	}
+
+	QFile::remove(filename);
+}
+
+/**
+ * @brief BackupWriter::run
+ *
+ * Runs on a thread of the global pool, writing snapshots until there are none
+ * left.
+ */
+void BackupWriter::run() {
+
+	QMutexLocker locker(&mutex_);
+
+	while (pending_) {
+		const Job job             = std::move(*pending_);
+		const uint64_t generation = generation_;
+		pending_                  = boost::none;
+
+		locker.unlock();
+
+		QString error;
+		if (!writeFile(job, generation, &error)) {
+			Q_EMIT writeFailed(job.filename, error);
+		}
+
+		locker.relock();
+	}
+
+	running_ = false;
+	idle_.wakeAll();
+}
+
+/**
+ * @brief BackupWriter::writeFile
+ * @param job
+ * @param generation
+ * @param error
+ * @return false if the backup couldn't be written, with the reason in "error"
+ *
+ * The text goes to a temporary file which only replaces the previous backup
+ * once it is complete, so a crash part way through a write still leaves a
+ * usable backup behind.
+ */
+bool BackupWriter::writeFile(const Job &job, uint64_t generation, QString *error) {
+
+	QSaveFile file(job.filename);
+	if (!file.open(QIODevice::WriteOnly)) {
+		*error = file.errorString();
+		return false;
+	}
+
+	/* set more restrictive permissions (using default permissions was somewhat
+	   of a security hole, because permissions were independent of those of the
+	   original file being edited */
+	file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+
+	const std::string &text = job.text;
+	for (size_t offset = 0; offset < text.size(); offset += ChunkSize) {
+		if (generation_ != generation) {
+			file.cancelWriting();
+			return true;
+		}
+
+		const auto length = static_cast<qint64>(std::min(ChunkSize, text.size() - offset));
+		if (file.write(&text[offset], length) != length) {
+			*error = file.errorString();
+			file.cancelWriting();
+			return false;
+		}
+	}
+
+	if (job.appendLF && !text.empty() && text.back() != '\n') {
+		if (file.write("\n", 1) != 1) {
+			*error = file.errorString();
+			file.cancelWriting();
+			return false;
+		}
+	}
+
+	// committed with the lock held, so that remove() can't come in between
+	// checking for the write having been abandoned and the file appearing
+	QMutexLocker locker(&mutex_);
+	if (generation_ != generation) {
+		file.cancelWriting();
+		return true;
+	}
+
+	if (!file.commit()) {
+		*error = file.errorString();
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,57 @@
+
+#ifndef BACKUP_WRITER_H_
+#define BACKUP_WRITER_H_
+
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <string>
+
+#include <boost/optional.hpp>
+
+/*
+** Writes the backup file of a document on a worker thread, from a snapshot of
+** its text, so that editing isn't held up by the disk. Only one write is in
+** progress at a time; snapshots taken meanwhile replace each other, so that
+** just the most recent one is written once the current write is done.
+*/
+class BackupWriter : public QObject {
+	Q_OBJECT
+
+public:
+	explicit BackupWriter(QObject *parent = nullptr);
+	BackupWriter(const BackupWriter &) = delete;
+	BackupWriter &operator=(const BackupWriter &) = delete;
+	~BackupWriter() override;
+
+Q_SIGNALS:
+	// emitted from the worker thread
+	void writeFailed(const QString &filename, const QString &error);
+
+public:
+	void remove(const QString &filename);
+	void write(const QString &filename, std::string text, bool appendLF);
+
+private:
+	struct Job {
+		QString filename;
+		std::string text;
+		bool appendLF; // add a terminating newline if the text doesn't end with one
+	};
+
+private:
+	bool writeFile(const Job &job, uint64_t generation, QString *error);
+	void run();
+
+private:
+	QMutex mutex_;
+	QWaitCondition idle_;
+	boost::optional<Job> pending_;        // the most recent snapshot which hasn't been written yet
+	bool running_ = false;                // is a task writing snapshots?
+	std::atomic<uint64_t> generation_{0}; // changed by remove(), to abandon the write in progress
+};
+
+#endif
@@ -0,0 +1,342 @@
+
+#include "DialogFindInFiles.h"
+#include "DocumentWidget.h"
+#include "MainWindow.h"
+#include "Preferences.h"
+#include "Regex.h"
+#include "Search.h"
+#include "TextArea.h"
+#include "TextBuffer.h"
+#include "Util/FileSystem.h"
+#include "Util/regex.h"
+
+#include <QDir>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QMessageBox>
+
+namespace {
+
+// how often (msec) the progress of a search is shown while it runs
+constexpr int StatusInterval = 250;
+
+}
+
+/**
+ * @brief DialogFindInFiles::DialogFindInFiles
+ * @param window
+ * @param f
+ */
+DialogFindInFiles::DialogFindInFiles(MainWindow *window, Qt::WindowFlags f)
+	: Dialog(window, f), window_(window) {
+	ui.setupUi(this);
+	connectSlots();
+
+	ui.textIgnore->setText(Preferences::GetPrefFindInFilesIgnore());
+	ui.treeResults->setFont(Preferences::GetPrefDefaultFont());
+
+	statusTimer_.setInterval(StatusInterval);
+}
+
+/**
+ * @brief DialogFindInFiles::connectSlots
+ */
+void DialogFindInFiles::connectSlots() {
+	connect(ui.buttonBrowse, &QPushButton::clicked, this, &DialogFindInFiles::buttonBrowse_clicked);
+	connect(ui.buttonFind, &QPushButton::clicked, this, &DialogFindInFiles::buttonFind_clicked);
+	connect(ui.buttonStop, &QPushButton::clicked, this, &DialogFindInFiles::buttonStop_clicked);
+	connect(ui.checkRegex, &QCheckBox::toggled, this, &DialogFindInFiles::checkRegex_toggled);
+	connect(ui.textFind, &QLineEdit::textChanged, this, &DialogFindInFiles::textFind_textChanged);
+	connect(ui.treeResults, &QTreeWidget::itemActivated, this, &DialogFindInFiles::treeResults_itemActivated);
+	connect(&engine_, &FindInFiles::matchesFound, this, &DialogFindInFiles::engine_matchesFound);
+	connect(&engine_, &FindInFiles::finished, this, &DialogFindInFiles::engine_finished);
+	connect(&statusTimer_, &QTimer::timeout, this, &DialogFindInFiles::updateStatus);
+}
+
+/**
+ * @brief DialogFindInFiles::showEvent
+ * @param event
+ */
+void DialogFindInFiles::showEvent(QShowEvent *event) {
+	Dialog::showEvent(event);
+	ui.textFind->setFocus();
+}
+
+/**
+ * @brief DialogFindInFiles::reject
+ *
+ * Closing the dialog stops the search, but keeps its results for next time.
+ */
+void DialogFindInFiles::reject() {
+	if (engine_.isRunning()) {
+		buttonStop_clicked();
+	}
+
+	Dialog::reject();
+}
+
+/**
+ * @brief DialogFindInFiles::setDirectory
+ * @param directory
+ *
+ * Suggest "directory" to search in, unless one has been chosen already.
+ */
+void DialogFindInFiles::setDirectory(const QString &directory) {
+	if (ui.textDirectory->text().isEmpty()) {
+		ui.textDirectory->setText(QDir::toNativeSeparators(directory));
+	}
+}
+
+/*
+** initialize the state of the regex/case/word toggle buttons
+*/
+void DialogFindInFiles::initToggleButtons(SearchType searchType) {
+	ui.checkRegex->setChecked(Search::isRegexType(searchType));
+	ui.checkCase->setChecked(searchType == SearchType::CaseSense || searchType == SearchType::CaseSenseWord || searchType == SearchType::Regex);
+	ui.checkWord->setChecked(searchType == SearchType::LiteralWord || searchType == SearchType::CaseSenseWord);
+	ui.checkWord->setEnabled(!Search::isRegexType(searchType));
+}
+
+/**
+ * @brief DialogFindInFiles::checkRegex_toggled
+ * @param checked
+ */
+void DialogFindInFiles::checkRegex_toggled(bool checked) {
+	// make the Whole Word button insensitive for regex searches
+	ui.checkWord->setEnabled(!checked);
+}
+
+/**
+ * @brief DialogFindInFiles::textFind_textChanged
+ * @param text
+ */
+void DialogFindInFiles::textFind_textChanged(const QString &text) {
+	ui.buttonFind->setEnabled(!text.isEmpty());
+}
+
+/**
+ * @brief DialogFindInFiles::buttonBrowse_clicked
+ */
+void DialogFindInFiles::buttonBrowse_clicked() {
+	const QString directory = QFileDialog::getExistingDirectory(this, tr("Directory to Search"), ui.textDirectory->text());
+	if (!directory.isEmpty()) {
+		ui.textDirectory->setText(QDir::toNativeSeparators(directory));
+	}
+}
+
+/*
+** Fetch and verify (particularly regular expression) the search string and
+** type, and where to search, from the dialog.
+*/
+boost::optional<FindInFiles::Query> DialogFindInFiles::readFields() {
+
+	FindInFiles::Query query;
+	query.searchString = ui.textFind->text();
+	if (query.searchString.isEmpty()) {
+		return boost::none;
+	}
+
+	if (ui.checkRegex->isChecked()) {
+		query.searchType = ui.checkCase->isChecked() ? SearchType::Regex : SearchType::RegexNoCase;
+
+		/* If the search type is a regular expression, test compile it
+		   immediately and present error messages */
+		try {
+			auto compiledRE = make_regex(query.searchString, Search::defaultRegexFlags(query.searchType));
+		} catch (const RegexError &e) {
+			QMessageBox::warning(
+				this,
+				tr("Regex Error"),
+				tr("Please re-specify the search string:\n%1").arg(QString::fromLatin1(e.what())));
+			return boost::none;
+		}
+	} else if (ui.checkCase->isChecked()) {
+		query.searchType = ui.checkWord->isChecked() ? SearchType::CaseSenseWord : SearchType::CaseSense;
+	} else {
+		query.searchType = ui.checkWord->isChecked() ? SearchType::LiteralWord : SearchType::Literal;
+	}
+
+	const QFileInfo directory(QDir::fromNativeSeparators(ui.textDirectory->text()));
+	if (!directory.isDir()) {
+		QMessageBox::warning(
+			this,
+			tr("Find in Files"),
+			tr("%1 is not a directory").arg(ui.textDirectory->text()));
+		return boost::none;
+	}
+
+	query.directory = directory.absoluteFilePath();
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+	query.filePatterns   = ui.textPatterns->text().split(QLatin1Char(' '), Qt::SkipEmptyParts);
+	query.ignorePatterns = ui.textIgnore->text().split(QLatin1Char(' '), Qt::SkipEmptyParts);
+#else
+	query.filePatterns   = ui.textPatterns->text().split(QLatin1Char(' '), QString::SkipEmptyParts);
+	query.ignorePatterns = ui.textIgnore->text().split(QLatin1Char(' '), QString::SkipEmptyParts);
+#endif
+	query.delimiters = Preferences::GetPrefDelimiters();
+	return query;
+}
+
+/**
+ * @brief DialogFindInFiles::buttonFind_clicked
+ */
+void DialogFindInFiles::buttonFind_clicked() {
+
+	boost::optional<FindInFiles::Query> query = readFields();
+	if (!query) {
+		return;
+	}
+
+	// save a copy of the search string in the search history
+	Search::saveSearchHistory(query->searchString, QString(), query->searchType, /*isIncremental=*/false);
+
+	ui.treeResults->clear();
+	directory_  = query->directory;
+	matchCount_ = 0;
+	stopped_    = false;
+
+	engine_.start(*query);
+
+	ui.buttonStop->setEnabled(true);
+	statusTimer_.start();
+	updateStatus();
+}
+
+/**
+ * @brief DialogFindInFiles::buttonStop_clicked
+ */
+void DialogFindInFiles::buttonStop_clicked() {
+	stopped_ = true;
+	engine_.cancel();
+}
+
+/**
+ * @brief DialogFindInFiles::engine_matchesFound
+ *
+ * Show the matches found since the last time, while the search goes on.
+ */
+void DialogFindInFiles::engine_matchesFound() {
+
+	const std::vector<FindInFiles::Match> matches = engine_.takeMatches();
+	if (matches.empty()) {
+		return;
+	}
+
+	const QDir directory(directory_);
+
+	QList<QTreeWidgetItem *> items;
+	items.reserve(static_cast<int>(matches.size()));
+
+	for (const FindInFiles::Match &match : matches) {
+		auto item = new QTreeWidgetItem(QStringList{
+			QDir::toNativeSeparators(directory.relativeFilePath(match.path)),
+			QString::number(match.line),
+			match.text.trimmed()});
+
+		item->setData(0, Qt::UserRole, match.path);
+		item->setData(1, Qt::UserRole, static_cast<qlonglong>(match.line));
+		item->setData(2, Qt::UserRole, static_cast<qlonglong>(match.column));
+		item->setData(2, Qt::UserRole + 1, static_cast<qlonglong>(match.length));
+		item->setTextAlignment(1, Qt::AlignRight);
+		items.append(item);
+	}
+
+	ui.treeResults->addTopLevelItems(items);
+	matchCount_ += items.size();
+
+	// size the columns to the first results, rather than to those still to come
+	if (matchCount_ == items.size()) {
+		ui.treeResults->resizeColumnToContents(0);
+		ui.treeResults->resizeColumnToContents(1);
+	}
+}
+
+/**
+ * @brief DialogFindInFiles::engine_finished
+ * @param search
+ */
+void DialogFindInFiles::engine_finished(int search) {
+
+	// a search which was replaced by another one finishes too
+	if (search != engine_.currentSearch()) {
+		return;
+	}
+
+	engine_matchesFound();
+
+	statusTimer_.stop();
+	ui.buttonStop->setEnabled(false);
+	updateStatus();
+
+	if (matchCount_ == 0 && !stopped_) {
+		QApplication::beep();
+	}
+}
+
+/**
+ * @brief DialogFindInFiles::updateStatus
+ */
+void DialogFindInFiles::updateStatus() {
+
+	const QString found = tr("%n match(es) in %1 files", nullptr, matchCount_).arg(engine_.fileCount());
+
+	if (engine_.isRunning()) {
+		ui.labelStatus->setText(tr("Searching... %1").arg(found));
+	} else if (engine_.limitReached()) {
+		ui.labelStatus->setText(tr("Stopped at %1").arg(found));
+	} else if (stopped_) {
+		ui.labelStatus->setText(tr("Stopped, %1").arg(found));
+	} else {
+		ui.labelStatus->setText(found);
+	}
+}
+
+/**
+ * @brief DialogFindInFiles::treeResults_itemActivated
+ * @param item
+ *
+ * Open the file of the match, or go to it if it's open already, and select
+ * the match.
+ */
+void DialogFindInFiles::treeResults_itemActivated(QTreeWidgetItem *item) {
+
+	const QString path   = item->data(0, Qt::UserRole).toString();
+	const int64_t line   = item->data(1, Qt::UserRole).toLongLong();
+	const int64_t column = item->data(2, Qt::UserRole).toLongLong();
+	const int64_t length = item->data(2, Qt::UserRole + 1).toLongLong();
+	const PathInfo fi    = parseFilename(path);
+
+	DocumentWidget::editExistingFile(
+		window_->currentDocument(),
+		fi.filename,
+		fi.pathname,
+		0,
+		QString(),
+		/*iconic=*/false,
+		QString(),
+		Preferences::GetPrefOpenInTab(),
+		/*background=*/false);
+
+	DocumentWidget *document = MainWindow::findWindowWithFile(fi);
+	if (!document) {
+		return;
+	}
+
+	/* the file may have changed since it was searched, so the match is only
+	   selected as far as the line it was found on still goes */
+	TextBuffer *buffer         = document->buffer();
+	const TextCursor lineStart = buffer->BufCountForwardNLines(buffer->BufStartOfBuffer(), line - 1);
+	const TextCursor lineEnd   = buffer->BufEndOfLine(lineStart);
+	const TextCursor start     = std::min(lineStart + column, lineEnd);
+	const TextCursor end       = std::min(start + length, lineEnd);
+
+	buffer->BufSelect(start, end);
+	document->raiseFocusDocumentWindow(true);
+
+	if (MainWindow *win = MainWindow::fromDocument(document)) {
+		if (QPointer<TextArea> area = win->lastFocus()) {
+			area->TextSetCursorPos(end);
+			document->makeSelectionVisible(area);
+		}
+	}
+}
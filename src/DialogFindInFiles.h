@@ -0,0 +1,57 @@
+
+#ifndef DIALOG_FIND_IN_FILES_H_
+#define DIALOG_FIND_IN_FILES_H_
+
+#include "Dialog.h"
+#include "FindInFiles.h"
+#include "SearchType.h"
+
+#include <QTimer>
+
+#include <boost/optional.hpp>
+
+#include "ui_DialogFindInFiles.h"
+
+class MainWindow;
+
+class DialogFindInFiles final : public Dialog {
+	Q_OBJECT
+
+public:
+	DialogFindInFiles(MainWindow *window, Qt::WindowFlags f = Qt::WindowFlags());
+	~DialogFindInFiles() override = default;
+
+protected:
+	void showEvent(QShowEvent *event) override;
+
+public:
+	void initToggleButtons(SearchType searchType);
+	void reject() override;
+	void setDirectory(const QString &directory);
+
+private:
+	boost::optional<FindInFiles::Query> readFields();
+	void updateStatus();
+
+private:
+	void buttonBrowse_clicked();
+	void buttonFind_clicked();
+	void buttonStop_clicked();
+	void checkRegex_toggled(bool checked);
+	void connectSlots();
+	void engine_finished(int search);
+	void engine_matchesFound();
+	void textFind_textChanged(const QString &text);
+	void treeResults_itemActivated(QTreeWidgetItem *item);
+
+private:
+	Ui::DialogFindInFiles ui;
+	MainWindow *window_;
+	FindInFiles engine_;
+	QTimer statusTimer_; // shows the progress of the search while it runs
+	QString directory_;  // being searched, the file names shown are relative to it
+	int matchCount_ = 0;
+	bool stopped_   = false;
+};
+
+#endif
@@ -5,7 +5,22 @@
 #include "DocumentWidget.h"
 #include "MainWindow.h"
 #include "Preferences.h"
+#include "TextBuffer.h"
+#include "ThreadPool.h"
+#include "WindowMenuEvent.h"
+
+#include <QEventLoop>
 #include <QMessageBox>
+#include <QProgressDialog>
+
+#include <atomic>
+
+namespace {
+
+// how long (msec) searching the documents takes before its progress is shown
+constexpr int ProgressDelay = 500;
+
+}
 
 /**
  * @brief DialogMultiReplace::DialogMultiReplace
@@ -21,6 +36,21 @@ DialogMultiReplace::DialogMultiReplace(DialogReplace *replace, Qt::WindowFlags f
 	ui.listFiles->setModel(model_);
 }
 
+/**
+ * @brief DialogMultiReplace::~DialogMultiReplace
+ */
+DialogMultiReplace::~DialogMultiReplace() {
+
+	/* stop the search in progress, if there is one, and wait for the tasks of
+	 * the ones which were canceled to finish */
+	if (job_) {
+		job_->canceled = true;
+	}
+
+	pool_.clear();
+	pool_.waitForDone();
+}
+
 /**
  * @brief DialogMultiReplace::connectSlots
  */
@@ -94,37 +124,54 @@ void DialogMultiReplace::buttonReplace_clicked() {
 	// Set the initial focus of the dialog back to the search string
 	replace_->ui.textFind->setFocus();
 
-	bool replaceFailed  = true;
-	bool noWritableLeft = true;
+	// save a copy of search and replace strings in the search history
+	Search::saveSearchHistory(fields->searchString, fields->replaceString, fields->searchType, /*isIncremental=*/false);
 
-	// Perform the replacements and mark the selected files (history)
+	/* Take a snapshot of each of the documents, which can then be searched on
+	 * other threads while the user can still cancel. First check again whether
+	 * the file is still writable. If the file status has changed or the file
+	 * was locked in the mean time, we just skip the window. */
+	std::vector<Target> targets;
 	for (QModelIndex index : selections) {
 		if (DocumentWidget *writeableDocument = model_->itemFromIndex(index)) {
-
-			/* First check again whether the file is still writable. If the
-			 * file status has changed or the file was locked in the mean time,
-			 * we just skip the window. */
 			if (!writeableDocument->lockReasons().isAnyLocked()) {
-				noWritableLeft                    = false;
-				writeableDocument->multiFileBusy_ = true; // Avoid multi-beep/dialog
-				writeableDocument->replaceFailed_ = false;
-
-				if (MainWindow *win = MainWindow::fromDocument(writeableDocument)) {
-					win->action_Replace_All(
-						writeableDocument,
-						fields->searchString,
-						fields->replaceString,
-						fields->searchType);
-				}
-
-				writeableDocument->multiFileBusy_ = false;
-				if (!writeableDocument->replaceFailed_) {
-					replaceFailed = false;
-				}
+				targets.push_back(Target{writeableDocument, writeableDocument->buffer()->BufGetAll(), writeableDocument->getWindowDelimiters(), {}});
 			}
 		}
 	}
 
+	const bool noWritableLeft = targets.empty();
+	bool replaceFailed        = true;
+
+	if (!searchDocuments(targets, fields->searchString, fields->replaceString, fields->searchType)) {
+		return;
+	}
+
+	// Perform the replacements, each one undoable on its own, and mark the selected files (history)
+	for (Target &target : targets) {
+		DocumentWidget *document = target.document;
+		if (!document || document->lockReasons().isAnyLocked()) {
+			continue;
+		}
+
+		// a document which was changed while it was being searched is searched again
+		TextBuffer *buffer = document->buffer();
+		if (!fields->searchString.isEmpty() && buffer->BufAsString() != target.text) {
+			target.replacements = Search::ReplacementsInString(buffer->BufAsString(), fields->searchString, fields->replaceString, fields->searchType, target.delimiters);
+		}
+
+		emit_event("replace_all", fields->searchString, fields->replaceString, to_string(fields->searchType));
+
+		if (target.replacements.empty()) {
+			continue;
+		}
+
+		if (MainWindow *win = MainWindow::fromDocument(document)) {
+			win->replaceRanges(document, document->firstPane(), target.replacements);
+			replaceFailed = false;
+		}
+	}
+
 	if (!replace_->keepDialog()) {
 		replace_->hide();
 	}
@@ -146,6 +193,79 @@ void DialogMultiReplace::buttonReplace_clicked() {
 	}
 }
 
+/**
+ * @brief DialogMultiReplace::searchDocuments
+ * @param targets
+ * @param searchString
+ * @param replaceString
+ * @param searchType
+ * @return false if the user cancelled the search
+ *
+ * Find the replacements to make in each of "targets", by searching their
+ * snapshots on a pool of threads, while the progress made is shown. If the
+ * user cancels, the documents being searched stop at their next match, the
+ * rest are skipped, and none of them are waited for.
+ */
+bool DialogMultiReplace::searchDocuments(std::vector<Target> &targets, const QString &searchString, const QString &replaceString, SearchType searchType) {
+
+	// an empty string is never found
+	const int count = static_cast<int>(targets.size());
+	if (count == 0 || searchString.isEmpty()) {
+		return true;
+	}
+
+	QProgressDialog progress(tr("Searching %1 files...").arg(count), tr("Cancel"), 0, count, this);
+	progress.setWindowModality(Qt::WindowModal);
+	progress.setMinimumDuration(ProgressDelay);
+
+	QEventLoop loop;
+	int searched = 0;
+
+	const int search = ++search_;
+
+	connect(this, &DialogMultiReplace::documentSearched, &loop, [&](int from) {
+		// the tasks of a canceled search may still be finishing
+		if (from != search) {
+			return;
+		}
+
+		progress.setValue(++searched);
+		if (searched == count) {
+			loop.quit();
+		}
+	});
+
+	connect(&progress, &QProgressDialog::canceled, &loop, &QEventLoop::quit);
+
+	auto job     = std::make_shared<SearchJob>();
+	job->targets = std::move(targets);
+	job_         = job;
+
+	for (size_t i = 0; i < job->targets.size(); ++i) {
+		StartInPool(&pool_, [this, job, i, search, searchString, replaceString, searchType]() {
+			Target &target = job->targets[i];
+			if (!job->canceled) {
+				target.replacements = Search::ReplacementsInString(target.text, searchString, replaceString, searchType, target.delimiters, nullptr, &job->canceled);
+			}
+
+			Q_EMIT documentSearched(search);
+		});
+	}
+
+	loop.exec();
+	job_ = nullptr;
+
+	if (progress.wasCanceled()) {
+		job->canceled = true;
+		pool_.clear();
+		return false;
+	}
+
+	// every document has been searched, so the tasks are done with the targets
+	targets = std::move(job->targets);
+	return true;
+}
+
 /**
  * @brief DialogMultiReplace::uploadFileListItems
  */
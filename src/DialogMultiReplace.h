@@ -3,8 +3,18 @@
 #define DIALOG_MULTI_REPLACE_H_
 
 #include "Dialog.h"
+#include "Search.h"
+#include "SearchType.h"
 #include "ui_DialogMultiReplace.h"
 
+#include <QPointer>
+#include <QThreadPool>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
 class DialogReplace;
 class DocumentModel;
 class DocumentWidget;
@@ -14,9 +24,28 @@ class DialogMultiReplace : public Dialog {
 	Q_OBJECT
 public:
 	explicit DialogMultiReplace(DialogReplace *replace, Qt::WindowFlags f = Qt::WindowFlags());
-	~DialogMultiReplace() override = default;
+	~DialogMultiReplace() override;
+
+Q_SIGNALS:
+	// emitted from a worker thread once a document has been searched by "search"
+	void documentSearched(int search);
+
+private:
+	struct Target {
+		QPointer<DocumentWidget> document;
+		std::string text; // the snapshot of the document which is searched
+		QString delimiters;
+		std::vector<Search::Replacement> replacements;
+	};
+
+	// what the tasks searching the documents share, so that a canceled search can be left to them
+	struct SearchJob {
+		std::atomic<bool> canceled{false};
+		std::vector<Target> targets;
+	};
 
 private:
+	bool searchDocuments(std::vector<Target> &targets, const QString &searchString, const QString &replaceString, SearchType searchType);
 	void checkShowPaths_toggled(bool checked);
 	void buttonDeselectAll_clicked();
 	void buttonSelectAll_clicked();
@@ -30,6 +59,11 @@ public:
 	Ui::DialogMultiReplace ui;
 	DialogReplace *replace_;
 	DocumentModel *model_;
+
+private:
+	QThreadPool pool_;               // searches the documents
+	std::shared_ptr<SearchJob> job_; // the search in progress, if any
+	int search_ = 0;                 // identifies the search in progress
 };
 
 #endif
@@ -2,6 +2,7 @@
 #ifndef DOCUMENT_INFO_H_
 #define DOCUMENT_INFO_H_
 
+#include "DocumentLayout.h"
 #include "IndentStyle.h"
 #include "LockReasons.h"
 #include "ShowMatchingStyle.h"
@@ -34,8 +35,12 @@ struct DocumentInfo {
 
 	FileFormats fileFormat = FileFormats::Unix;                    // whether to save the file straight (Unix format), or convert it to MS DOS style with \r\n line breaks
 	std::shared_ptr<TextBuffer> buffer;                            // holds the text being edited
+	std::unique_ptr<DocumentLayout> layout;                        // line and wrap information shared by all panes showing the buffer
 	int autoSaveCharCount               = 0;                       // count of single characters typed since last backup file generated
 	int autoSaveOpCount                 = 0;                       // count of editing operations
+	int64_t undoMemory                  = 0;                       // bytes used by the undo and redo lists
+	uint64_t undoGeneration             = 0;                       // the generation of the newest undo or redo record
+	uint64_t savedGeneration            = 0;                       // the generation of the record which, undone or redone, restores the file to its last saved state, if any
 	bool filenameSet                    = false;                   // is the window still "Untitled"?
 	bool fileChanged                    = false;                   // has window been modified?
 	bool autoSave                       = false;                   // is autosave turned on?
@@ -0,0 +1,200 @@
+
+#include "DocumentLayout.h"
+#include "TextBuffer.h"
+
+#include <QtGlobal>
+
+#include <algorithm>
+
+namespace {
+
+void layoutBufModifiedCB(TextCursor pos, int64_t nInserted, int64_t nDeleted, int64_t nRestyled, view::string_view deletedText, void *user) {
+	Q_UNUSED(nRestyled)
+
+	if (auto *layout = static_cast<DocumentLayout *>(user)) {
+		layout->bufModifiedCallback(pos, nInserted, nDeleted, deletedText);
+	}
+}
+
+}
+
+/**
+ * @brief DocumentLayout::DocumentLayout
+ * @param buffer
+ */
+DocumentLayout::DocumentLayout(TextBuffer *buffer)
+	: buffer_(buffer) {
+
+	lineCount_ = buffer->BufCountLines(buffer->BufStartOfBuffer(), buffer->BufEndOfBuffer());
+
+	/* The layout must be updated before the text display callbacks are
+	   called, so that the panes see the counts for the current modification */
+	buffer->BufAddHighPriorityModifyCB(layoutBufModifiedCB, this);
+}
+
+/**
+ * @brief DocumentLayout::~DocumentLayout
+ */
+DocumentLayout::~DocumentLayout() {
+	buffer_->BufRemoveModifyCB(layoutBufModifiedCB, this);
+}
+
+/**
+ * Counts the newlines of a modification once for the whole document, and
+ * keeps the line number checkpoint in sync with the new text.
+ *
+ * @brief DocumentLayout::bufModifiedCallback
+ * @param pos
+ * @param nInserted
+ * @param nDeleted
+ * @param deletedText
+ */
+void DocumentLayout::bufModifiedCallback(TextCursor pos, int64_t nInserted, int64_t nDeleted, view::string_view deletedText) {
+
+	modPos_      = pos;
+	modInserted_ = nInserted;
+	modDeleted_  = nDeleted;
+
+	wrapRanges_.clear();
+	wrappedLineCounts_.clear();
+
+	linesInserted_ = (nInserted == 0) ? 0 : buffer_->BufCountLines(pos, pos + nInserted);
+	linesDeleted_  = (nDeleted == 0) ? 0 : std::count(deletedText.begin(), deletedText.end(), '\n');
+	lineCount_ += linesInserted_ - linesDeleted_;
+
+	// changes after the checkpoint don't affect the number of lines before it
+	if (pos >= checkpointPos_) {
+		return;
+	}
+
+	if (pos + nDeleted <= checkpointPos_) {
+		checkpointPos_ += nInserted - nDeleted;
+		checkpointLines_ += linesInserted_ - linesDeleted_;
+	} else {
+		checkpointPos_   = buffer_->BufStartOfBuffer();
+		checkpointLines_ = 0;
+	}
+}
+
+/**
+ * Returns true if the modification described by the arguments is the one most
+ * recently reported by the buffer, meaning that the counts and wrap results
+ * stored in this object apply to it.
+ *
+ * @brief DocumentLayout::isCurrent
+ * @param pos
+ * @param nInserted
+ * @param nDeleted
+ * @return
+ */
+bool DocumentLayout::isCurrent(TextCursor pos, int64_t nInserted, int64_t nDeleted) const noexcept {
+	return pos == modPos_ && nInserted == modInserted_ && nDeleted == modDeleted_;
+}
+
+/**
+ * @brief DocumentLayout::lineCount
+ * @return the number of newlines in the buffer
+ */
+int64_t DocumentLayout::lineCount() const noexcept {
+	return lineCount_;
+}
+
+/**
+ * @brief DocumentLayout::linesInserted
+ * @return the number of newlines inserted by the most recent modification
+ */
+int64_t DocumentLayout::linesInserted() const noexcept {
+	return linesInserted_;
+}
+
+/**
+ * @brief DocumentLayout::linesDeleted
+ * @return the number of newlines deleted by the most recent modification
+ */
+int64_t DocumentLayout::linesDeleted() const noexcept {
+	return linesDeleted_;
+}
+
+/*
+** Return the number of newlines preceding "pos". Counting starts from the
+** closest of the start of the buffer and the last position asked about, so
+** panes scrolling around in the same area of a large file don't have to count
+** from the start of the buffer every time.
+*/
+int64_t DocumentLayout::countLinesBefore(TextCursor pos) {
+
+	const TextCursor start = buffer_->BufStartOfBuffer();
+
+	int64_t lines;
+	if (pos >= checkpointPos_) {
+		lines = checkpointLines_ + buffer_->BufCountLines(checkpointPos_, pos);
+	} else if (pos - start < checkpointPos_ - pos) {
+		lines = buffer_->BufCountLines(start, pos);
+	} else {
+		lines = checkpointLines_ - buffer_->BufCountLines(pos, checkpointPos_);
+	}
+
+	checkpointPos_   = pos;
+	checkpointLines_ = lines;
+	return lines;
+}
+
+/**
+ * @brief DocumentLayout::wrapRange
+ * @param geometry
+ * @return the wrap range of the current modification, if a pane with the same
+ * wrap geometry has already calculated it
+ */
+boost::optional<DocumentLayout::WrapRange> DocumentLayout::wrapRange(const WrapGeometry &geometry) const {
+
+	auto it = std::find_if(wrapRanges_.begin(), wrapRanges_.end(), [&geometry](const std::pair<WrapGeometry, WrapRange> &entry) {
+		return entry.first == geometry;
+	});
+
+	if (it == wrapRanges_.end()) {
+		return boost::none;
+	}
+
+	return it->second;
+}
+
+/**
+ * @brief DocumentLayout::setWrapRange
+ * @param geometry
+ * @param range
+ */
+void DocumentLayout::setWrapRange(const WrapGeometry &geometry, const WrapRange &range) {
+	if (!wrapRange(geometry)) {
+		wrapRanges_.emplace_back(geometry, range);
+	}
+}
+
+/**
+ * @brief DocumentLayout::wrappedLineCount
+ * @param geometry
+ * @return the number of wrapped lines in the whole buffer, if a pane with the
+ * same wrap geometry has counted them since the last modification
+ */
+boost::optional<int64_t> DocumentLayout::wrappedLineCount(const WrapGeometry &geometry) const {
+
+	auto it = std::find_if(wrappedLineCounts_.begin(), wrappedLineCounts_.end(), [&geometry](const std::pair<WrapGeometry, int64_t> &entry) {
+		return entry.first == geometry;
+	});
+
+	if (it == wrappedLineCounts_.end()) {
+		return boost::none;
+	}
+
+	return it->second;
+}
+
+/**
+ * @brief DocumentLayout::setWrappedLineCount
+ * @param geometry
+ * @param lines
+ */
+void DocumentLayout::setWrappedLineCount(const WrapGeometry &geometry, int64_t lines) {
+	if (!wrappedLineCount(geometry)) {
+		wrappedLineCounts_.emplace_back(geometry, lines);
+	}
+}
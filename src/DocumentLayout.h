@@ -0,0 +1,77 @@
+
+#ifndef DOCUMENT_LAYOUT_H_
+#define DOCUMENT_LAYOUT_H_
+
+#include "TextBufferFwd.h"
+#include "TextCursor.h"
+#include "Util/string_view.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+/* Layout information about a document which does not depend on the pane
+ * displaying it. Every TextArea showing the same buffer queries this object
+ * instead of re-counting lines on its own, so that the per-modification cost
+ * of line counting is paid once per document, rather than once per pane.
+ * Wrapping does depend on the pane geometry, so wrap results are cached keyed
+ * by that geometry, and panes with identical geometry share them. */
+class DocumentLayout {
+public:
+	struct WrapGeometry {
+		int wrapMargin; // wrap column, or 0 to wrap at the window edge
+		int wrapWidth;  // width in pixels of the wrapping area (when wrapMargin is 0)
+		int fontWidth;
+		int tabDist;
+
+		bool operator==(const WrapGeometry &rhs) const noexcept {
+			return wrapMargin == rhs.wrapMargin && wrapWidth == rhs.wrapWidth && fontWidth == rhs.fontWidth && tabDist == rhs.tabDist;
+		}
+	};
+
+	struct WrapRange {
+		TextCursor modRangeStart;
+		TextCursor modRangeEnd;
+		int64_t linesInserted;
+		int64_t linesDeleted;
+	};
+
+public:
+	explicit DocumentLayout(TextBuffer *buffer);
+	DocumentLayout(const DocumentLayout &)            = delete;
+	DocumentLayout &operator=(const DocumentLayout &) = delete;
+	~DocumentLayout();
+
+public:
+	bool isCurrent(TextCursor pos, int64_t nInserted, int64_t nDeleted) const noexcept;
+	boost::optional<WrapRange> wrapRange(const WrapGeometry &geometry) const;
+	boost::optional<int64_t> wrappedLineCount(const WrapGeometry &geometry) const;
+	int64_t countLinesBefore(TextCursor pos);
+	int64_t lineCount() const noexcept;
+	int64_t linesDeleted() const noexcept;
+	int64_t linesInserted() const noexcept;
+	void setWrapRange(const WrapGeometry &geometry, const WrapRange &range);
+	void setWrappedLineCount(const WrapGeometry &geometry, int64_t lines);
+
+public:
+	void bufModifiedCallback(TextCursor pos, int64_t nInserted, int64_t nDeleted, view::string_view deletedText);
+
+private:
+	TextBuffer *buffer_;
+	TextCursor modPos_        = {}; // position, and sizes of the most recent modification
+	int64_t modInserted_      = -1;
+	int64_t modDeleted_       = -1;
+	int64_t linesInserted_    = 0; // newlines inserted by the most recent modification
+	int64_t linesDeleted_     = 0; // newlines deleted by the most recent modification
+	int64_t lineCount_        = 0; // newlines in the whole buffer
+	TextCursor checkpointPos_ = {}; // a position with a known count of preceding newlines
+	int64_t checkpointLines_  = 0;
+
+private:
+	// wrap results for the most recent modification, one entry per distinct geometry
+	std::vector<std::pair<WrapGeometry, WrapRange>> wrapRanges_;
+	std::vector<std::pair<WrapGeometry, int64_t>> wrappedLineCounts_;
+};
+
+#endif
@@ -0,0 +1,336 @@
+
+#include "DocumentSummary.h"
+#include "Highlight.h"
+#include "TextBuffer.h"
+
+#include <QtGlobal>
+
+#include <algorithm>
+#include <array>
+
+namespace {
+
+void summaryBufModifiedCB(TextCursor pos, int64_t nInserted, int64_t nDeleted, int64_t nRestyled, view::string_view deletedText, void *user) {
+	Q_UNUSED(nRestyled)
+
+	// restyling-only modifications don't change the summary
+	if (nInserted == 0 && nDeleted == 0) {
+		return;
+	}
+
+	if (auto *summary = static_cast<DocumentSummary *>(user)) {
+		summary->bufModifiedCallback(pos, nInserted, nDeleted, deletedText);
+	}
+}
+
+void summaryStyleModifiedCB(TextCursor pos, int64_t nInserted, int64_t nDeleted, int64_t nRestyled, UTextBuffer::view_type deletedText, void *user) {
+	Q_UNUSED(nDeleted)
+	Q_UNUSED(nRestyled)
+	Q_UNUSED(deletedText)
+
+	if (nInserted == 0) {
+		return;
+	}
+
+	if (auto *summary = static_cast<DocumentSummary *>(user)) {
+		summary->styleModifiedCallback(pos, nInserted);
+	}
+}
+
+/**
+ * @brief isBlank
+ * @param ch
+ * @return
+ */
+constexpr bool isBlank(char ch) noexcept {
+	return ch == ' ' || ch == '\t' || ch == '\n';
+}
+
+}
+
+/**
+ * @brief DocumentSummary::DocumentSummary
+ * @param buffer
+ */
+DocumentSummary::DocumentSummary(TextBuffer *buffer)
+	: buffer_(buffer) {
+
+	blocks_.emplace_back();
+	rescanBlocks(0, 0, buffer->BufStartOfBuffer(), buffer->length());
+
+	/* The summary must see text modifications before the syntax highlighting
+	   does, so that style buffer changes can be mapped on to the blocks */
+	buffer->BufAddHighPriorityModifyCB(summaryBufModifiedCB, this);
+}
+
+/**
+ * @brief DocumentSummary::~DocumentSummary
+ */
+DocumentSummary::~DocumentSummary() {
+	setStyleBuffer(nullptr);
+	buffer_->BufRemoveModifyCB(summaryBufModifiedCB, this);
+}
+
+/**
+ * @brief DocumentSummary::blocks
+ * @return
+ */
+const std::vector<DocumentSummary::Block> &DocumentSummary::blocks() const noexcept {
+	return blocks_;
+}
+
+/**
+ * @brief DocumentSummary::lineCount
+ * @return the number of newlines in the document
+ */
+int64_t DocumentSummary::lineCount() const noexcept {
+	return lineCount_;
+}
+
+/**
+ * Attach the style buffer of the syntax highlighting to the summary, or detach
+ * it when "styleBuffer" is nullptr. The caller must detach the style buffer
+ * before destroying it.
+ *
+ * @brief DocumentSummary::setStyleBuffer
+ * @param styleBuffer
+ */
+void DocumentSummary::setStyleBuffer(UTextBuffer *styleBuffer) {
+
+	if (styleBuffer == styleBuffer_) {
+		return;
+	}
+
+	if (styleBuffer_) {
+		styleBuffer_->BufRemoveModifyCB(summaryStyleModifiedCB, this);
+	}
+
+	styleBuffer_ = styleBuffer;
+
+	if (styleBuffer_) {
+		styleBuffer_->BufAddModifyCB(summaryStyleModifiedCB, this);
+	}
+
+	for (Block &block : blocks_) {
+		block.style      = 0;
+		block.styleStale = true;
+	}
+}
+
+/**
+ * @brief DocumentSummary::stylesInSync
+ * @return true if the blocks, the text buffer and the style buffer all
+ * describe the same text
+ */
+bool DocumentSummary::stylesInSync() const {
+	return styleBuffer_ && length_ == buffer_->length() && styleBuffer_->length() == length_;
+}
+
+/**
+ * Recalculate the most common style of the blocks whose styles have changed.
+ * This is done on demand, when the summary is displayed, rather than for each
+ * change to the style buffer, as highlighting changes in bursts.
+ *
+ * @brief DocumentSummary::updateStyles
+ */
+void DocumentSummary::updateStyles() {
+
+	if (!stylesInSync()) {
+		return;
+	}
+
+	TextCursor start = buffer_->BufStartOfBuffer();
+	for (Block &block : blocks_) {
+		if (block.styleStale) {
+			scanStyles(&block, start);
+		}
+		start += block.length;
+	}
+}
+
+/**
+ * @brief DocumentSummary::findBlock
+ * @param pos
+ * @return the index of the block containing "pos", the last block for the end
+ * of the buffer. The position of its first character is left in cacheStart_
+ */
+size_t DocumentSummary::findBlock(TextCursor pos) {
+
+	size_t index     = cacheIndex_;
+	TextCursor start = cacheStart_;
+
+	while (index > 0 && pos < start) {
+		--index;
+		start -= blocks_[index].length;
+	}
+
+	while (index + 1 < blocks_.size() && pos >= start + blocks_[index].length) {
+		start += blocks_[index].length;
+		++index;
+	}
+
+	cacheIndex_ = index;
+	cacheStart_ = start;
+	return index;
+}
+
+/**
+ * @brief DocumentSummary::bufModifiedCallback
+ * @param pos
+ * @param nInserted
+ * @param nDeleted
+ * @param deletedText
+ */
+void DocumentSummary::bufModifiedCallback(TextCursor pos, int64_t nInserted, int64_t nDeleted, view::string_view deletedText) {
+
+	const size_t first     = findBlock(pos);
+	const TextCursor start = cacheStart_;
+	const size_t last      = (nDeleted == 0) ? first : findBlock(pos + nDeleted - 1);
+
+	int64_t length = nInserted - nDeleted;
+	for (size_t i = first; i <= last; ++i) {
+		length += blocks_[i].length;
+	}
+
+	cacheIndex_ = first;
+	cacheStart_ = start;
+
+	/* In the common case of a change within a single block which stays a
+	   reasonable size, only the changed text needs to be counted */
+	if (first == last && length >= BlockSize / 4 && length < BlockSize * 2) {
+		const std::string insertedText = buffer_->BufGetRange(pos, pos + nInserted);
+
+		Block &block = blocks_[first];
+
+		const int64_t linesInserted = std::count(insertedText.begin(), insertedText.end(), '\n');
+		const int64_t linesDeleted  = std::count(deletedText.begin(), deletedText.end(), '\n');
+
+		block.length += nInserted - nDeleted;
+		block.lines += linesInserted - linesDeleted;
+		block.nonBlank += std::count_if(insertedText.begin(), insertedText.end(), [](char ch) { return !isBlank(ch); });
+		block.nonBlank -= std::count_if(deletedText.begin(), deletedText.end(), [](char ch) { return !isBlank(ch); });
+		block.styleStale = true;
+
+		length_ += nInserted - nDeleted;
+		lineCount_ += linesInserted - linesDeleted;
+		return;
+	}
+
+	rescanBlocks(first, last, start, length);
+}
+
+/**
+ * @brief DocumentSummary::styleModifiedCallback
+ * @param pos
+ * @param nInserted
+ */
+void DocumentSummary::styleModifiedCallback(TextCursor pos, int64_t nInserted) {
+
+	/* Style changes can only be placed when the blocks describe the same text
+	   as the style buffer. Otherwise, the change is the style buffer tracking
+	   a text modification, which marks the blocks itself */
+	if (!stylesInSync()) {
+		return;
+	}
+
+	const TextCursor end = pos + nInserted;
+
+	size_t index     = findBlock(pos);
+	TextCursor start = cacheStart_;
+	while (index < blocks_.size() && start < end) {
+		blocks_[index].styleStale = true;
+		start += blocks_[index].length;
+		++index;
+	}
+}
+
+/**
+ * Replaces blocks "first" to "last" (inclusive) with new blocks covering
+ * "length" characters from "start", counted from the buffer.
+ *
+ * @brief DocumentSummary::rescanBlocks
+ * @param first
+ * @param last
+ * @param start
+ * @param length
+ */
+void DocumentSummary::rescanBlocks(size_t first, size_t last, TextCursor start, int64_t length) {
+
+	// keep blocks from getting too small by merging them with a neighbor
+	if (length < BlockSize / 4) {
+		if (last + 1 < blocks_.size()) {
+			++last;
+			length += blocks_[last].length;
+		} else if (first > 0) {
+			--first;
+			start -= blocks_[first].length;
+			length += blocks_[first].length;
+		}
+	}
+
+	for (size_t i = first; i <= last; ++i) {
+		length_ -= blocks_[i].length;
+		lineCount_ -= blocks_[i].lines;
+	}
+
+	// divide the text in to blocks of BlockSize, the last one taking the remainder
+	const auto count = static_cast<size_t>(std::max<int64_t>(1, length / BlockSize));
+
+	std::vector<Block> replacement(count);
+	TextCursor pos = start;
+	for (size_t i = 0; i < count; ++i) {
+		Block &block = replacement[i];
+		block.length = (i + 1 == count) ? length - BlockSize * static_cast<int64_t>(count - 1) : BlockSize;
+		scanBlock(&block, pos);
+
+		pos += block.length;
+		length_ += block.length;
+		lineCount_ += block.lines;
+	}
+
+	blocks_.erase(blocks_.begin() + static_cast<ptrdiff_t>(first) + 1, blocks_.begin() + static_cast<ptrdiff_t>(last) + 1);
+	blocks_[first] = replacement[0];
+	blocks_.insert(blocks_.begin() + static_cast<ptrdiff_t>(first) + 1, replacement.begin() + 1, replacement.end());
+
+	cacheIndex_ = first;
+	cacheStart_ = start;
+}
+
+/**
+ * @brief DocumentSummary::scanBlock
+ * @param block
+ * @param start
+ */
+void DocumentSummary::scanBlock(Block *block, TextCursor start) const {
+
+	const std::string text = buffer_->BufGetRange(start, start + block->length);
+
+	block->lines      = std::count(text.begin(), text.end(), '\n');
+	block->nonBlank   = std::count_if(text.begin(), text.end(), [](char ch) { return !isBlank(ch); });
+	block->style      = 0;
+	block->styleStale = true;
+}
+
+/**
+ * @brief DocumentSummary::scanStyles
+ * @param block
+ * @param start
+ */
+void DocumentSummary::scanStyles(Block *block, TextCursor start) const {
+
+	std::array<int64_t, 256> counts = {};
+
+	const std::basic_string<uint8_t> styles = styleBuffer_->BufGetRange(start, start + block->length);
+	for (uint8_t style : styles) {
+		++counts[style];
+	}
+
+	// unfinished and plain text don't have a color of their own
+	counts[UNFINISHED_STYLE] = 0;
+	counts[PLAIN_STYLE]      = 0;
+
+	const auto it = std::max_element(counts.begin(), counts.end());
+
+	block->style      = (*it != 0) ? static_cast<uint8_t>(it - counts.begin()) : 0;
+	block->styleStale = false;
+}
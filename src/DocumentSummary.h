@@ -0,0 +1,64 @@
+
+#ifndef DOCUMENT_SUMMARY_H_
+#define DOCUMENT_SUMMARY_H_
+
+#include "TextBufferFwd.h"
+#include "TextCursor.h"
+#include "Util/string_view.h"
+
+#include <cstdint>
+#include <vector>
+
+/* A downsampled description of a document, used to draw the overview ruler.
+ * The text is divided into blocks of roughly BlockSize characters, and for each
+ * block we keep the number of lines, how much of it isn't white space and the
+ * most common highlight style. Blocks are kept up to date from the buffer
+ * modify callbacks, by re-scanning only the blocks touched by a modification,
+ * so the cost of a change does not depend on the size of the document. */
+class DocumentSummary {
+public:
+	static constexpr int64_t BlockSize = 16384;
+
+public:
+	struct Block {
+		int64_t length   = 0;    // characters in the block
+		int64_t lines    = 0;    // newlines in the block
+		int64_t nonBlank = 0;    // characters which are not white space
+		uint8_t style    = 0;    // most common highlight style other than plain text, or 0
+		bool styleStale  = true; // style needs to be recalculated from the style buffer
+	};
+
+public:
+	explicit DocumentSummary(TextBuffer *buffer);
+	DocumentSummary(const DocumentSummary &)            = delete;
+	DocumentSummary &operator=(const DocumentSummary &) = delete;
+	~DocumentSummary();
+
+public:
+	const std::vector<Block> &blocks() const noexcept;
+	int64_t lineCount() const noexcept;
+	void setStyleBuffer(UTextBuffer *styleBuffer);
+	void updateStyles();
+
+public:
+	void bufModifiedCallback(TextCursor pos, int64_t nInserted, int64_t nDeleted, view::string_view deletedText);
+	void styleModifiedCallback(TextCursor pos, int64_t nInserted);
+
+private:
+	bool stylesInSync() const;
+	size_t findBlock(TextCursor pos);
+	void rescanBlocks(size_t first, size_t last, TextCursor start, int64_t length);
+	void scanBlock(Block *block, TextCursor start) const;
+	void scanStyles(Block *block, TextCursor start) const;
+
+private:
+	TextBuffer *buffer_;
+	UTextBuffer *styleBuffer_ = nullptr;
+	int64_t length_           = 0;  // total length of the blocks
+	int64_t lineCount_        = 0;  // total newlines of the blocks
+	size_t cacheIndex_        = 0;  // the most recently located block, and its starting position
+	TextCursor cacheStart_    = {}; // (successive modifications tend to be close to each other)
+	std::vector<Block> blocks_;
+};
+
+#endif
@@ -1,5 +1,6 @@
 
 #include "DocumentWidget.h"
+#include "BackupWriter.h"
 #include "CommandRecorder.h"
 #include "DialogDuplicateTags.h"
 #include "DialogMoveDocument.h"
@@ -8,6 +9,8 @@
 #include "DialogReplace.h"
 #include "DragEndEvent.h"
 #include "EditFlags.h"
+#include "FileMonitor.h"
+#include "FileWriter.h"
 #include "Font.h"
 #include "Highlight.h"
 #include "HighlightData.h"
@@ -43,6 +46,7 @@
 #include <QFile>
 #include <QMessageBox>
 #include <QMimeData>
+#include <QSaveFile>
 #include <QRadioButton>
 #include <QScrollBar>
 #include <QSplitter>
@@ -50,7 +54,10 @@
 #include <QTimer>
 #include <qplatformdefs.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cstring>
+#include <numeric>
 
 #if defined(Q_OS_WIN)
 #define FDOPEN _fdopen
@@ -151,6 +158,66 @@ QString errorString(int error) {
 	return QString::fromLatin1(strerror(error));
 }
 
+/**
+ * @brief writeText
+ * @param file
+ * @param text
+ * @param format
+ * @return true if all of "text" was written to "file". Line endings are
+ * converted to those of "format" a chunk at a time, rather than in a copy of
+ * the whole text.
+ */
+bool writeText(QFileDevice &file, const std::pair<view::string_view, view::string_view> &text, FileFormats format) {
+
+	if (format == FileFormats::Unix) {
+		for (view::string_view part : {text.first, text.second}) {
+			if (file.write(part.data(), static_cast<qint64>(part.size())) != static_cast<qint64>(part.size())) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	constexpr size_t ChunkSize = 1024 * 1024;
+	const view::string_view lineEnd = (format == FileFormats::Dos) ? view::string_view("\r\n") : view::string_view("\r");
+
+	std::string chunk;
+	chunk.reserve(ChunkSize + lineEnd.size());
+
+	auto flush = [&file, &chunk]() {
+		const bool written = file.write(chunk.data(), static_cast<qint64>(chunk.size())) == static_cast<qint64>(chunk.size());
+		chunk.clear();
+		return written;
+	};
+
+	for (view::string_view part : {text.first, text.second}) {
+
+		const char *p          = part.data();
+		const char *const last = p + part.size();
+
+		while (p != last) {
+			const char *const limit = p + std::min<size_t>(static_cast<size_t>(last - p), ChunkSize - chunk.size());
+			const auto eol          = static_cast<const char *>(std::memchr(p, '\n', static_cast<size_t>(limit - p)));
+
+			if (eol) {
+				chunk.append(p, eol);
+				chunk.append(lineEnd.data(), lineEnd.size());
+				p = eol + 1;
+			} else {
+				chunk.append(p, limit);
+				p = limit;
+			}
+
+			if (chunk.size() >= ChunkSize && !flush()) {
+				return false;
+			}
+		}
+	}
+
+	return flush();
+}
+
 /**
  * @brief modifiedCB
  * @param pos
@@ -189,6 +256,16 @@ void movedCB(TextArea *area, void *user) {
 	}
 }
 
+/**
+ * @brief matchesSearchedCB
+ * @param user
+ */
+void matchesSearchedCB(void *user) {
+	if (auto document = static_cast<DocumentWidget *>(user)) {
+		document->matchesSearchedCallback();
+	}
+}
+
 /**
  * @brief dragStartCB
  * @param area
@@ -556,6 +633,12 @@ DocumentWidget::DocumentWidget(std::shared_ptr<DocumentInfo> &info_ptr, QWidget
 		eraseFlash();
 	});
 
+	backupWriter_ = new BackupWriter(this);
+
+	connect(backupWriter_, &BackupWriter::writeFailed, this, [this](const QString &filename, const QString &error) {
+		backupWriteFailed(filename, error);
+	});
+
 	auto area = createTextArea(info_->buffer);
 
 	info_->buffer->BufAddModifyCB(modifiedCB, this);
@@ -587,6 +670,7 @@ DocumentWidget::DocumentWidget(const QString &name, QWidget *parent, Qt::WindowF
 
 	// Every document has a backing buffer
 	info_->buffer = std::make_shared<TextBuffer>();
+	info_->layout = std::make_unique<DocumentLayout>(info_->buffer.get());
 	info_->buffer->BufAddModifyCB(Highlight::SyntaxHighlightModifyCB, this);
 	info_->buffer->BufSetSelectionUpdate(TextArea::updatePrimarySelection);
 
@@ -638,6 +722,12 @@ DocumentWidget::DocumentWidget(const QString &name, QWidget *parent, Qt::WindowF
 		eraseFlash();
 	});
 
+	backupWriter_ = new BackupWriter(this);
+
+	connect(backupWriter_, &BackupWriter::writeFailed, this, [this](const QString &filename, const QString &error) {
+		backupWriteFailed(filename, error);
+	});
+
 	auto area = createTextArea(info_->buffer);
 
 	info_->buffer->BufAddModifyCB(modifiedCB, this);
@@ -662,8 +752,9 @@ DocumentWidget::~DocumentWidget() {
 	const std::vector<TextArea *> textAreas = textPanes();
 	qDeleteAll(textAreas);
 
-	// And delete the rangeset table too for the same reasons
+	// And delete the rangeset table and search matches too for the same reasons
 	rangesetTable_ = nullptr;
+	searchMatches_ = nullptr;
 
 	// Free syntax highlighting patterns, if any. w/o re-displaying
 	freeHighlightingData();
@@ -948,6 +1039,19 @@ void DocumentWidget::movedCallback(TextArea *area) {
 	area->resetCursorBlink(false);
 }
 
+/**
+ * @brief DocumentWidget::matchesSearchedCallback
+ *
+ * All of the text has been searched for the matches to highlight, so show
+ * them in the overview rulers, which are only repainted with the text
+ * otherwise.
+ */
+void DocumentWidget::matchesSearchedCallback() {
+	for (TextArea *area : textPanes()) {
+		area->updateOverviewRuler();
+	}
+}
+
 /**
  * @brief DocumentWidget::dragStartCallback
  * @param area
@@ -1031,6 +1135,17 @@ void DocumentWidget::modifiedCallback(TextCursor pos, int64_t nInserted, int64_t
 	   characters and editing operations for triggering autosave */
 	saveUndoInformation(pos, nInserted, nDeleted, deletedText);
 
+	/* the rest only needs doing once, after the last of a batch of edits has
+	   been made */
+	if (info_->buffer->BufBatchIndex() + 1 < info_->buffer->BufBatchSize()) {
+		return;
+	}
+
+	// a batch record only reaches its full size once all of its edits are made
+	if (info_->buffer->BufBatchSize() > 0) {
+		limitUndoMemory();
+	}
+
 	// Trigger automatic backup if operation or character limits reached
 	if (info_->autoSave && (info_->autoSaveCharCount > autoSaveCharLimit || info_->autoSaveOpCount > autoSaveOpLimit)) {
 		writeBackupFile();
@@ -1481,6 +1596,10 @@ void DocumentWidget::stopHighlighting() {
 		return;
 	}
 
+	if (summary_) {
+		summary_->setStyleBuffer(nullptr);
+	}
+
 	// Free and remove the highlight data from the window
 	highlightData_ = nullptr;
 
@@ -1586,7 +1705,18 @@ void DocumentWidget::saveUndoInformation(TextCursor pos, int64_t nInserted, int6
 
 	/* figure out what kind of editing operation this is, and recall
 	   what the last one was */
-	const UndoTypes newType = determineUndoType(nInserted, nDeleted);
+	/* the edits of a batch are undone together, so all but the first are
+	   added to the record which the first one starts */
+	const int64_t batchIndex = info_->buffer->BufBatchIndex();
+	if (batchIndex > 0) {
+		UndoInfo &batch = isUndo ? info_->redo.front() : info_->undo.front();
+		batch.edits.push_back(UndoEdit{pos, pos + nInserted, deletedText.to_string()});
+		batch.endPos = pos + nInserted;
+		info_->undoMemory += static_cast<int64_t>(sizeof(UndoEdit) + deletedText.size());
+		return;
+	}
+
+	const UndoTypes newType = (batchIndex == 0) ? BATCH_REPLACE : determineUndoType(nInserted, nDeleted);
 	if (newType == UNDO_NOOP) {
 		return;
 	}
@@ -1613,7 +1743,7 @@ void DocumentWidget::saveUndoInformation(TextCursor pos, int64_t nInserted, int6
 
 		// overstrike mode replacement
 		if ((oldType == ONE_CHAR_REPLACE && newType == ONE_CHAR_REPLACE) && (pos == currentUndo->endPos)) {
-			appendDeletedText(deletedText, nDeleted, Direction::Forward);
+			appendDeletedText(deletedText, Direction::Forward);
 			++currentUndo->endPos;
 			++info_->autoSaveCharCount;
 			return;
@@ -1621,13 +1751,13 @@ void DocumentWidget::saveUndoInformation(TextCursor pos, int64_t nInserted, int6
 
 		// forward delete
 		if ((oldType == ONE_CHAR_DELETE && newType == ONE_CHAR_DELETE) && (pos == currentUndo->startPos)) {
-			appendDeletedText(deletedText, nDeleted, Direction::Forward);
+			appendDeletedText(deletedText, Direction::Forward);
 			return;
 		}
 
 		// reverse delete
 		if ((oldType == ONE_CHAR_DELETE && newType == ONE_CHAR_DELETE) && (pos == currentUndo->startPos - 1)) {
-			appendDeletedText(deletedText, nDeleted, Direction::Backward);
+			appendDeletedText(deletedText, Direction::Backward);
 			--currentUndo->startPos;
 			--currentUndo->endPos;
 			return;
@@ -1641,30 +1771,20 @@ void DocumentWidget::saveUndoInformation(TextCursor pos, int64_t nInserted, int6
 	UndoInfo undo(newType, pos, pos + nInserted);
 
 	// if text was deleted, save it
-	if (nDeleted > 0) {
+	if (newType == BATCH_REPLACE) {
+		undo.edits.push_back(UndoEdit{pos, pos + nInserted, deletedText.to_string()});
+	} else if (nDeleted > 0) {
 		undo.oldText = deletedText.to_string();
 	}
 
 	// increment the operation count for the autosave feature
 	++info_->autoSaveOpCount;
 
-	/* if the this is currently unmodified, remove the previous
-	   restoresToSaved marker, and set it on this record */
-
-	// TODO(eteran): there probably is some data structure we could use
-	// to avoid having to loop here.
-	// as we have more entries in the undo/redo lists, the longer these loops
-	// get
+	/* if the document is currently unmodified, this record becomes the one
+	   which restores it to that state, in place of any other */
+	undo.generation = ++info_->undoGeneration;
 	if (!info_->fileChanged) {
-		undo.restoresToSaved = true;
-
-		for (UndoInfo &u : info_->undo) {
-			u.restoresToSaved = false;
-		}
-
-		for (UndoInfo &u : info_->redo) {
-			u.restoresToSaved = false;
-		}
+		info_->savedGeneration = undo.generation;
 	}
 
 	/* Add the new record to the undo list unless saveUndoInformation is
@@ -1685,12 +1805,20 @@ void DocumentWidget::saveUndoInformation(TextCursor pos, int64_t nInserted, int6
 */
 void DocumentWidget::clearUndoList() {
 
+	for (const UndoInfo &undo : info_->undo) {
+		info_->undoMemory -= undo.memoryUsage();
+	}
+
 	info_->undo.clear();
 	Q_EMIT canUndoChanged(!info_->undo.empty());
 }
 
 void DocumentWidget::clearRedoList() {
 
+	for (const UndoInfo &redo : info_->redo) {
+		info_->undoMemory -= redo.memoryUsage();
+	}
+
 	info_->redo.clear();
 	Q_EMIT canRedoChanged(!info_->redo.empty());
 }
@@ -1699,26 +1827,17 @@ void DocumentWidget::clearRedoList() {
 ** Add deleted text to the beginning or end
 ** of the text saved for undoing the last operation.  This routine is intended
 ** for continuing of a string of one character deletes or replaces, but will
-** work with more than one character.
+** work with more than one character. Neither adds more than the length of
+** the new text to the time taken, text added to the beginning is kept
+** separately, in reverse, until the record is used.
 */
-void DocumentWidget::appendDeletedText(view::string_view deletedText, int64_t deletedLen, Direction direction) {
+void DocumentWidget::appendDeletedText(view::string_view deletedText, Direction direction) {
 	UndoInfo &undo = info_->undo.front();
 
-	// re-allocate, adding space for the new character(s)
-	std::string comboText;
-	comboText.reserve(undo.oldText.size() + static_cast<size_t>(deletedLen));
-
-	// copy the new character and the already deleted text to the new memory
-	if (direction == Direction::Forward) {
-		comboText.append(undo.oldText);
-		comboText.append(deletedText.begin(), deletedText.end());
-	} else {
-		comboText.append(deletedText.begin(), deletedText.end());
-		comboText.append(undo.oldText);
-	}
-
-	// replace the old saved text and attach the new
-	undo.oldText = std::move(comboText);
+	// the record may have been compressed, and so uncompressed again
+	const int64_t usage = undo.memoryUsage();
+	undo.addDeletedText(deletedText, direction);
+	info_->undoMemory += undo.memoryUsage() - usage;
 }
 
 /*
@@ -1728,6 +1847,7 @@ void DocumentWidget::appendDeletedText(view::string_view deletedText, int64_t de
 */
 void DocumentWidget::addUndoItem(UndoInfo &&undo) {
 
+	info_->undoMemory += undo.memoryUsage();
 	info_->undo.emplace_front(std::move(undo));
 
 	// Trim the list if it exceeds any of the limits
@@ -1735,6 +1855,8 @@ void DocumentWidget::addUndoItem(UndoInfo &&undo) {
 		trimUndoList(UNDO_OP_TRIMTO);
 	}
 
+	limitUndoMemory();
+
 	Q_EMIT canUndoChanged(!info_->undo.empty());
 }
 
@@ -1743,6 +1865,7 @@ void DocumentWidget::addUndoItem(UndoInfo &&undo) {
 */
 void DocumentWidget::addRedoItem(UndoInfo &&redo) {
 
+	info_->undoMemory += redo.memoryUsage();
 	info_->redo.emplace_front(std::move(redo));
 	Q_EMIT canRedoChanged(!info_->redo.empty());
 }
@@ -1756,6 +1879,7 @@ void DocumentWidget::removeUndoItem() {
 		return;
 	}
 
+	info_->undoMemory -= info_->undo.front().memoryUsage();
 	info_->undo.pop_front();
 	Q_EMIT canUndoChanged(!info_->undo.empty());
 }
@@ -1769,6 +1893,7 @@ void DocumentWidget::removeRedoItem() {
 		return;
 	}
 
+	info_->undoMemory -= info_->redo.front().memoryUsage();
 	info_->redo.pop_front();
 	Q_EMIT canRedoChanged(!info_->redo.empty());
 }
@@ -1786,10 +1911,139 @@ void DocumentWidget::trimUndoList(size_t maxLength) {
 	auto it = info_->undo.begin();
 	std::advance(it, maxLength);
 
+	for (auto trimmed = it; trimmed != info_->undo.end(); ++trimmed) {
+		info_->undoMemory -= trimmed->memoryUsage();
+	}
+
 	// Trim off all subsequent entries
 	info_->undo.erase(it, info_->undo.end());
 }
 
+/*
+** Reduce the memory used by the undo and redo lists to "limit" bytes, if it
+** can be, first by compressing the text saved by the records furthest from
+** being used, and then by discarding them. The memory counted against the
+** limit includes the redo list, so it is shrunk before the undo list is, as
+** its records are lost at the next edit anyway. The most recent undo record
+** is always kept as it is, since it may still be added to, and so is the
+** most recent redo record while an undo or redo is being done, as it is in
+** use.
+*/
+void DocumentWidget::shrinkUndoList(int64_t limit) {
+
+	std::deque<UndoInfo> &undo = info_->undo;
+	std::deque<UndoInfo> &redo = info_->redo;
+
+	// compress the records of "list" from the back, leaving the first "keep" of them
+	auto compress = [this, limit](std::deque<UndoInfo> &list, size_t keep) {
+		for (auto it = list.rbegin(); info_->undoMemory > limit && list.size() > keep && it != list.rend() - static_cast<ptrdiff_t>(keep); ++it) {
+			const int64_t usage = it->memoryUsage();
+			if (it->compress()) {
+				info_->undoMemory += it->memoryUsage() - usage;
+			}
+		}
+	};
+
+	// discard the records of "list" from the back, leaving the first "keep" of them
+	auto discard = [this, limit](std::deque<UndoInfo> &list, size_t keep) {
+		while (info_->undoMemory > limit && list.size() > keep) {
+			info_->undoMemory -= list.back().memoryUsage();
+			list.pop_back();
+		}
+	};
+
+	const bool inUndo  = (!undo.empty() && undo.front().inUndo) || (!redo.empty() && redo.front().inUndo);
+	const size_t keep  = inUndo ? 1 : 0;
+	const bool hadRedo = !redo.empty();
+
+	compress(redo, keep);
+	compress(undo, 1);
+	discard(redo, keep);
+	discard(undo, 1);
+
+	if (hadRedo && redo.empty()) {
+		Q_EMIT canRedoChanged(false);
+	}
+}
+
+/*
+** Keep the memory used by the undo lists of this document, and of all of
+** the documents together, within the limits set by the preferences. Memory
+** is taken from the documents using the most first.
+*/
+void DocumentWidget::limitUndoMemory() {
+
+	constexpr int64_t MegaByte = 1024 * 1024;
+
+	shrinkUndoList(Preferences::GetPrefUndoMemoryLimit() * MegaByte);
+
+	std::vector<DocumentWidget *> documents = allDocuments();
+
+	const int64_t totalLimit = Preferences::GetPrefTotalUndoMemoryLimit() * MegaByte;
+	int64_t total            = std::accumulate(documents.begin(), documents.end(), int64_t{0}, [](int64_t sum, const DocumentWidget *document) {
+		return sum + document->info_->undoMemory;
+	});
+
+	if (total <= totalLimit) {
+		return;
+	}
+
+	std::sort(documents.begin(), documents.end(), [](const DocumentWidget *lhs, const DocumentWidget *rhs) {
+		return lhs->info_->undoMemory > rhs->info_->undoMemory;
+	});
+
+	for (DocumentWidget *document : documents) {
+		const int64_t usage = document->info_->undoMemory;
+		document->shrinkUndoList(usage - (total - totalLimit));
+		total -= usage - document->info_->undoMemory;
+
+		if (total <= totalLimit) {
+			break;
+		}
+	}
+}
+
+/**
+ * @brief DocumentWidget::undoMemory
+ * @return the number of bytes used by the undo and redo lists
+ */
+int64_t DocumentWidget::undoMemory() const {
+	return info_->undoMemory;
+}
+
+/*
+** Put back the text saved in the undo or redo record "undo", and return the
+** length of the text which now spans from its start position
+*/
+int64_t DocumentWidget::restoreUndoText(UndoInfo &undo) {
+
+	undo.joinText();
+
+	if (undo.type != BATCH_REPLACE) {
+		if (!undo.compressedText.isEmpty()) {
+			const std::string oldText = undo.uncompressedText();
+			info_->buffer->BufReplace(undo.startPos, undo.endPos, oldText);
+			return static_cast<int64_t>(oldText.size());
+		}
+
+		info_->buffer->BufReplace(undo.startPos, undo.endPos, undo.oldText);
+		return static_cast<int64_t>(undo.oldText.size());
+	}
+
+	// the edits don't overlap, so each is still where it was made
+	std::vector<TextBuffer::Edit> edits;
+	edits.reserve(undo.edits.size());
+
+	int64_t restoredTextLength = undo.endPos - undo.startPos;
+	for (const UndoEdit &edit : undo.edits) {
+		edits.push_back(TextBuffer::Edit{TextRange{edit.startPos, edit.endPos}, edit.oldText});
+		restoredTextLength += static_cast<int64_t>(edit.oldText.size()) - (edit.endPos - edit.startPos);
+	}
+
+	info_->buffer->BufReplaceRanges(edits);
+	return restoredTextLength;
+}
+
 void DocumentWidget::undo() {
 
 	MainWindow *win = MainWindow::fromDocument(this);
@@ -1811,9 +2065,7 @@ void DocumentWidget::undo() {
 	undo.inUndo = true;
 
 	// use the saved undo information to reverse changes
-	info_->buffer->BufReplace(undo.startPos, undo.endPos, undo.oldText);
-
-	const auto restoredTextLength = static_cast<int64_t>(undo.oldText.size());
+	const int64_t restoredTextLength = restoreUndoText(undo);
 	if (!info_->buffer->primary.hasSelection() || Preferences::GetPrefUndoModifiesSelection()) {
 		/* position the cursor in the focus pane after the changed text
 		   to show the user where the undo was done */
@@ -1838,7 +2090,7 @@ void DocumentWidget::undo() {
 	   when the change being undone was originally made.  Also, remove
 	   the backup file, since the text in the buffer is now identical to
 	   the original file */
-	if (undo.restoresToSaved) {
+	if (undo.generation == info_->savedGeneration) {
 		setWindowModified(false);
 		removeBackupFile();
 	}
@@ -1866,9 +2118,7 @@ void DocumentWidget::redo() {
 	redo.inUndo = true;
 
 	// use the saved redo information to reverse changes
-	info_->buffer->BufReplace(redo.startPos, redo.endPos, redo.oldText);
-
-	const auto restoredTextLength = static_cast<int64_t>(redo.oldText.size());
+	const int64_t restoredTextLength = restoreUndoText(redo);
 	if (!info_->buffer->primary.hasSelection() || Preferences::GetPrefUndoModifiesSelection()) {
 		/* position the cursor in the focus pane after the changed text
 		   to show the user where the undo was done */
@@ -1894,7 +2144,7 @@ void DocumentWidget::redo() {
 	   when the change being redone was originally made. Also, remove
 	   the backup file, since the text in the buffer is now identical to
 	   the original file */
-	if (redo.restoresToSaved) {
+	if (redo.generation == info_->savedGeneration) {
 		setWindowModified(/*modified=*/false);
 		removeBackupFile();
 	}
@@ -1942,7 +2192,7 @@ void DocumentWidget::removeBackupFile() const {
 		return;
 	}
 
-	QFile::remove(backupFileName());
+	backupWriter_->remove(backupFileName());
 }
 
 /*
@@ -1964,29 +2214,10 @@ QString DocumentWidget::backupFileName() const {
 */
 void DocumentWidget::checkForChangesToFile() {
 
-	/* Maximum frequency of checking for external modifications. The periodic
-	 * check is only performed on buffer modification, and the check interval is
-	 * only to prevent checking on every keystroke in case of a file system which
-	 * is slow to process stat requests (which I'm not sure exists) */
-	constexpr auto CheckInterval = std::chrono::milliseconds(3000);
-
-	// TODO(eteran): 2.0, this concept can probably be reworked in terms of QFileSystemWatcher
-	static QPointer<DocumentWidget> lastCheckWindow;
-	static std::chrono::high_resolution_clock::time_point lastCheckTime;
-
 	if (!info_->filenameSet) {
 		return;
 	}
 
-	// If last check was very recent, don't impact performance
-	auto timestamp = std::chrono::high_resolution_clock::now();
-	if (this == lastCheckWindow && (timestamp - lastCheckTime) < CheckInterval) {
-		return;
-	}
-
-	lastCheckWindow = this;
-	lastCheckTime   = timestamp;
-
 	MainWindow *win = MainWindow::fromDocument(this);
 	if (!win) {
 		return;
@@ -2001,6 +2232,11 @@ void DocumentWidget::checkForChangesToFile() {
 	// Get the file mode and modification time
 	QString fullname = fullPath();
 
+	// Unless the file has changed, or can't be watched and is due a poll, don't impact performance
+	if (!FileMonitor::instance()->checkDue(this, fullname, silent)) {
+		return;
+	}
+
 	QT_STATBUF statbuf;
 	if (QT_STAT(fullname.toUtf8().data(), &statbuf) != 0) {
 
@@ -2355,66 +2591,38 @@ void DocumentWidget::revertToSaved() {
 /*
 ** Create a backup file for the current document.  The name for the backup file
 ** is generated using the name and path stored in the window and adding a
-** tilde (~) on UNIX.
+** tilde (~) on UNIX. Only the copy of the text is made here, it is written to
+** the file in the background.
 */
-bool DocumentWidget::writeBackupFile() {
-	FILE *fp;
-
-	// Generate a name for the autoSave file
-	const QString name = backupFileName();
+void DocumentWidget::writeBackupFile() {
+	backupWriter_->write(backupFileName(), info_->buffer->BufGetAll(), Preferences::GetPrefAppendLF());
+}
 
-	// remove the old backup file. Well, this might fail - we'll notice later however.
-	QFile::remove(name);
+/**
+ * @brief DocumentWidget::backupWriteFailed
+ * @param filename
+ * @param error
+ */
+void DocumentWidget::backupWriteFailed(const QString &filename, const QString &error) {
 
-	/* open the file, set more restrictive permissions (using default
-	   permissions was somewhat of a security hole, because permissions were
-	   independent of those of the original file being edited */
-#ifdef Q_OS_WIN
-	int fd = QT_OPEN(name.toUtf8().data(), QT_OPEN_CREAT | O_EXCL | QT_OPEN_WRONLY, _S_IREAD | _S_IWRITE);
-#else
-	int fd = QT_OPEN(name.toUtf8().data(), QT_OPEN_CREAT | O_EXCL | QT_OPEN_WRONLY, S_IRUSR | S_IWUSR);
-#endif
-	if (fd < 0 || (fp = FDOPEN(fd, "w")) == nullptr) {
+	// the document may have been saved, or backups turned off, meanwhile
+	if (!info_->autoSave || filename != backupFileName()) {
+		return;
+	}
 
-		QMessageBox::warning(
-			this,
-			tr("Error writing Backup"),
-			tr("Unable to save backup for %1:\n%2\nAutomatic backup is now off").arg(info_->filename, errorString(errno)));
+	QMessageBox::warning(
+		this,
+		tr("Error writing Backup"),
+		tr("Unable to save backup for %1:\n%2\nAutomatic backup is now off").arg(info_->filename, error));
 
-		info_->autoSave = false;
+	backupWriter_->remove(filename);
+	info_->autoSave = false;
 
+	if (isTopDocument()) {
 		if (auto win = MainWindow::fromDocument(this)) {
 			no_signals(win->ui.action_Incremental_Backup)->setChecked(false);
 		}
-		return false;
 	}
-
-	// get the text buffer contents
-	std::string fileString = info_->buffer->BufGetAll();
-
-	// add a terminating newline if the file doesn't already have one
-	if (Preferences::GetPrefAppendLF()) {
-		if (!fileString.empty() && fileString.back() != '\n') {
-			fileString.append("\n");
-		}
-	}
-
-	auto _ = gsl::finally([fp] { ::fclose(fp); });
-
-	// write out the file
-	::fwrite(fileString.data(), 1, fileString.size(), fp);
-	if (::ferror(fp)) {
-		QMessageBox::critical(
-			this,
-			tr("Error saving Backup"),
-			tr("Error while saving backup for %1:\n%2\nAutomatic backup is now off").arg(info_->filename, errorString(errno)));
-
-		QFile::remove(name);
-		info_->autoSave = false;
-		return false;
-	}
-
-	return true;
 }
 
 /**
@@ -2466,11 +2674,7 @@ bool DocumentWidget::saveDocument() {
 		}
 	}
 
-	if (writeBckVersion()) {
-		return false;
-	}
-
-	const bool status = doSave();
+	const bool status = doSave(/*backup=*/true);
 	if (status) {
 		removeBackupFile();
 	}
@@ -2478,7 +2682,15 @@ bool DocumentWidget::saveDocument() {
 	return status;
 }
 
-bool DocumentWidget::doSave() {
+/**
+ * @brief DocumentWidget::doSave
+ * @param backup
+ * @return
+ *
+ * Write the document to its file, first making a backup of the old version
+ * if "backup" is true and backups are turned on.
+ */
+bool DocumentWidget::doSave(bool backup) {
 
 	QString fullname = fullPath();
 
@@ -2510,9 +2722,23 @@ bool DocumentWidget::doSave() {
 		info_->buffer->BufAppend('\n');
 	}
 
-	// open the file
-	QFile file(fullname);
-	if (!file.open(QIODevice::WriteOnly)) {
+	/* open the file. Where possible, a new file is written and only renamed
+	   over the old one once it has been completely written and synced, so that
+	   a failure part way through leaves the old version intact */
+	QSaveFile saveFile(fullname);
+	QFile directFile(fullname);
+
+	const bool replace = FileWriter::openReplacement(saveFile, fullname);
+
+	/* the backup is made once it's known whether the old file will be
+	   replaced or rewritten, and before it's opened to be rewritten */
+	if (backup && writeBckVersion(replace)) {
+		return false;
+	}
+
+	QFileDevice &file = replace ? static_cast<QFileDevice &>(saveFile) : directFile;
+
+	if (!file.isOpen() && !file.open(QIODevice::WriteOnly)) {
 		QMessageBox messageBox(this);
 		messageBox.setWindowTitle(tr("Error saving File"));
 		messageBox.setIcon(QMessageBox::Warning);
@@ -2531,26 +2757,15 @@ bool DocumentWidget::doSave() {
 		return false;
 	}
 
-	// get the text buffer contents and its length
-	std::string text = info_->buffer->BufGetAll();
-
-	// If the file is to be saved in DOS or Macintosh format, reconvert
-	switch (info_->fileFormat) {
-	case FileFormats::Dos:
-		ConvertToDos(text);
-		break;
-	case FileFormats::Mac:
-		ConvertToMac(text);
-		break;
-	default:
-		break;
-	}
-
-	// write to the file
-	if (file.write(text.data(), static_cast<int64_t>(text.size())) == -1) {
+	/* write to the file, straight from the text buffer. If the file is to be
+	   saved in DOS or Macintosh format, it is reconverted on the way */
+	const bool written = writeText(file, info_->buffer->BufAsViews(), info_->fileFormat);
+	if (!written || !(replace ? saveFile.commit() : directFile.flush())) {
 		QMessageBox::critical(this, tr("Error saving File"), tr("%1 not saved:\n%2").arg(info_->filename, file.errorString()));
-		file.close();
-		file.remove();
+		if (!replace) {
+			directFile.close();
+			directFile.remove();
+		}
 		return false;
 	}
 
@@ -2608,11 +2823,7 @@ bool DocumentWidget::saveDocumentAs(const QString &newName, bool addWrap) {
 
 	// If the requested file is this file, just save it and return
 	if (info_->filename == fi.filename && info_->path == fi.pathname) {
-		if (writeBckVersion()) {
-			return false;
-		}
-
-		return doSave();
+		return doSave(/*backup=*/true);
 	}
 
 	// If the file is open in another window, make user close it.
@@ -2651,7 +2862,7 @@ bool DocumentWidget::saveDocumentAs(const QString &newName, bool addWrap) {
 	info_->statbuf.st_gid  = 0;
 
 	info_->lockReasons.clear();
-	const int retVal = doSave();
+	const int retVal = doSave(/*backup=*/false);
 	Q_EMIT updateWindowReadOnly(this);
 	refreshTabState();
 
@@ -2722,99 +2933,22 @@ void DocumentWidget::addWrapNewlines() {
 
 /*
 ** If saveOldVersion is on, copies the existing version of the file to
-** <filename>.bck in anticipation of a new version being saved.  Returns
-** true if backup fails and user requests that the new file not be written.
+** <filename>.bck in anticipation of a new version being saved. "replace" says
+** whether the new version will replace the old file rather than rewrite it.
+** Returns true if backup fails and user requests that the new file not be
+** written.
 */
-bool DocumentWidget::writeBckVersion() {
+bool DocumentWidget::writeBckVersion(bool replace) {
 
-	struct BackupError {
-		QString filename;
-		QString message;
-	};
+	// Do only if version backups are turned on
+	if (!info_->saveOldVersion) {
+		return false;
+	}
 
 	try {
-		// TODO(eteran): 2.0, this is essentially just a QFile::copy("filename", "filename.bck");
-		// with error reporting
-
-		// Do only if version backups are turned on
-		if (!info_->saveOldVersion) {
-			return false;
-		}
-
-		// Get the full name of the file
-		QString fullname = fullPath();
-
-		// Generate name for old version
-		auto bckname = QStringLiteral("%1.bck").arg(fullname);
-
-		// Delete the old backup file
-		// Errors are ignored; we'll notice them later.
-		QFile::remove(bckname);
-
-		/* open the file being edited.  If there are problems with the
-		 * old file, don't bother the user, just skip the backup */
-		QFile inputFile(fullname);
-		if (!inputFile.open(QIODevice::ReadOnly)) {
-			return false;
-		}
-
-		/* Get permissions of the file.
-		 * We preserve the normal permissions but not ownership, extended
-		 * attributes, et cetera. */
-		QT_STATBUF statbuf;
-		if (QT_FSTAT(inputFile.handle(), &statbuf) != 0) {
-			return false;
-		}
-
-		// open the destination file exclusive and with restrictive permissions.
-#ifdef Q_OS_WIN
-		int out_fd = QT_OPEN(bckname.toUtf8().data(), QT_OPEN_CREAT | O_EXCL | QT_OPEN_TRUNC | QT_OPEN_WRONLY, _S_IREAD | _S_IWRITE);
-#else
-		int out_fd = QT_OPEN(bckname.toUtf8().data(), QT_OPEN_CREAT | O_EXCL | QT_OPEN_TRUNC | QT_OPEN_WRONLY, S_IRUSR | S_IWUSR);
-#endif
-		if (out_fd < 0) {
-			Raise<BackupError>(bckname, tr("Error open backup file"));
-		}
-
-		auto _2 = gsl::finally([out_fd]() {
-			QT_CLOSE(out_fd);
-		});
-
-#ifdef Q_OS_UNIX
-		// Set permissions on new file
-		if (::fchmod(out_fd, statbuf.st_mode) != 0) {
-			QFile::remove(bckname);
-			Raise<BackupError>(bckname, tr("fchmod() failed"));
-		}
-#endif
-
-		// Allocate I/O buffer
-		constexpr size_t IO_BUFFER_SIZE = (1024ul * 1024ul);
-		auto io_buffer                  = std::make_unique<char[]>(IO_BUFFER_SIZE);
-
-		// copy loop
-		for (;;) {
-			qint64 bytes_read = inputFile.read(&io_buffer[0], IO_BUFFER_SIZE);
-
-			if (bytes_read < 0) {
-				QFile::remove(bckname);
-				Raise<BackupError>(info_->filename, tr("read() error"));
-			}
-
-			if (bytes_read == 0) {
-				break; // EOF
-			}
-
-			// write to the file
-			qint64 bytes_written = QT_WRITE(out_fd, &io_buffer[0], static_cast<size_t>(bytes_read));
-			if (bytes_written != bytes_read) {
-				QFile::remove(bckname);
-				Raise<BackupError>(bckname, errorString(errno));
-			}
-		}
-
+		FileWriter::writeBackup(fullPath(), QStringLiteral("%1.bck").arg(fullPath()), replace);
 		return false;
-	} catch (const BackupError &e) {
+	} catch (const FileWriter::BackupError &e) {
 		QMessageBox messageBox(this);
 		messageBox.setWindowTitle(tr("Error writing Backup"));
 		messageBox.setIcon(QMessageBox::Critical);
@@ -3474,7 +3608,7 @@ void DocumentWidget::executeNewlineMacro(SmartIndentEvent *event) {
 			return;
 		}
 
-		event->request = to_integer(result);
+		event->request = static_cast<int>(to_integer(result));
 	}
 }
 
@@ -4171,6 +4305,8 @@ void DocumentWidget::beginSmartIndent(Verbosity verbosity) {
 		return;
 	}
 
+	siData->newlineMacro->name = "smart indent newline macro";
+
 	if (indentMacros->modMacro.isNull()) {
 		siData->modMacro = nullptr;
 	} else {
@@ -4181,6 +4317,8 @@ void DocumentWidget::beginSmartIndent(Verbosity verbosity) {
 			Preferences::reportError(this, indentMacros->modMacro, stoppedAt, tr("smart indent modify macro"), errMsg);
 			return;
 		}
+
+		siData->modMacro->name = "smart indent modify macro";
 	}
 
 	info_->smartIndentData = std::move(siData);
@@ -5580,6 +5718,10 @@ void DocumentWidget::freeHighlightingData() {
 		return;
 	}
 
+	if (summary_) {
+		summary_->setStyleBuffer(nullptr);
+	}
+
 	highlightData_ = nullptr;
 
 	/* The text display may make a last desperate attempt to access highlight
@@ -6016,6 +6158,11 @@ void DocumentWidget::startHighlighting(Verbosity verbosity) {
 
 	highlightData->styleBuffer->BufSetAll(style_buffer);
 
+	// switch the overview ruler to the new styles, before the old ones are freed
+	if (summary_) {
+		summary_->setStyleBuffer(highlightData->styleBuffer.get());
+	}
+
 	// install highlight pattern data in the window data structure
 	highlightData_ = std::move(highlightData);
 
@@ -6701,6 +6848,8 @@ void DocumentWidget::doMacro(const QString &macro, const QString &errInName) {
 		return;
 	}
 
+	prog->name = errInName.toStdString();
+
 	// run the executable program (prog is freed upon completion)
 	runMacro(prog);
 }
@@ -7220,14 +7369,14 @@ void DocumentWidget::createSelectMenu(TextArea *area, const QStringList &args) {
 **                  tip and/or tag database depending on search_type
 **  search_type:    Either TIP or TIP_FROM_TAG
 */
-int DocumentWidget::showTipString(const QString &text, bool anchored, int pos, bool lookup, Tags::SearchMode search_type, TipHAlignMode hAlign, TipVAlignMode vAlign, TipAlignMode alignMode) {
+int DocumentWidget::showTipString(const QString &text, bool anchored, TextCursor pos, bool lookup, Tags::SearchMode search_type, TipHAlignMode hAlign, TipVAlignMode vAlign, TipAlignMode alignMode) {
 	if (search_type == Tags::SearchMode::TAG) {
 		return 0;
 	}
 
 	// So we don't have to carry all of the calltip alignment info around
 	Tags::globAnchored  = anchored;
-	Tags::globPos       = pos;
+	Tags::globPos       = anchored ? CallTipPosition(pos) : CallTipPosition(-1);
 	Tags::globHAlign    = hAlign;
 	Tags::globVAlign    = vAlign;
 	Tags::globAlignMode = alignMode;
@@ -7368,6 +7517,75 @@ TextBuffer *DocumentWidget::buffer() const {
 	return info_->buffer.get();
 }
 
+/**
+ * @brief DocumentWidget::documentLayout
+ * @return
+ */
+DocumentLayout *DocumentWidget::documentLayout() const {
+	return info_->layout.get();
+}
+
+/**
+ * @brief DocumentWidget::documentSummary
+ * @return the summary of the text used to draw the overview ruler, it is only
+ * created (and maintained) once a pane asks for it
+ */
+DocumentSummary *DocumentWidget::documentSummary() {
+	if (!summary_) {
+		summary_ = std::make_unique<DocumentSummary>(info_->buffer.get());
+		if (highlightData_) {
+			summary_->setStyleBuffer(highlightData_->styleBuffer.get());
+		}
+	}
+
+	return summary_.get();
+}
+
+/**
+ * Highlight all of the matches of "searchString" in the document, if that is
+ * turned on, searching from the top of "area". The matches are searched for
+ * a part of the document at a time, in the background, and are kept up to
+ * date as the document is edited, until they are cleared.
+ *
+ * @brief DocumentWidget::highlightMatches
+ * @param area
+ * @param searchString
+ * @param searchType
+ */
+void DocumentWidget::highlightMatches(TextArea *area, const QString &searchString, SearchType searchType) {
+
+	if (!Preferences::GetPrefHighlightAllMatches()) {
+		return;
+	}
+
+	if (searchString.isEmpty()) {
+		clearMatchHighlights();
+		return;
+	}
+
+	if (!searchMatches_) {
+		searchMatches_ = std::make_unique<SearchMatches>(info_->buffer.get(), matchesSearchedCB, this);
+	}
+
+	searchMatches_->setSearch(searchString, searchType, getWindowDelimiters(), area->firstVisiblePos());
+}
+
+/**
+ * @brief DocumentWidget::clearMatchHighlights
+ */
+void DocumentWidget::clearMatchHighlights() {
+
+	if (!searchMatches_) {
+		return;
+	}
+
+	searchMatches_ = nullptr;
+
+	for (TextArea *area : textPanes()) {
+		area->updateOverviewRuler();
+	}
+}
+
 /**
  * @brief DocumentWidget::filenameSet
  * @return
@@ -7,6 +7,7 @@
 #include "CloseMode.h"
 #include "CommandSource.h"
 #include "DocumentInfo.h"
+#include "DocumentSummary.h"
 #include "ErrorSound.h"
 #include "IndentStyle.h"
 #include "LanguageMode.h"
@@ -14,6 +15,7 @@
 #include "MenuData.h"
 #include "MenuItem.h"
 #include "RangesetTable.h"
+#include "SearchMatches.h"
 #include "ShowMatchingStyle.h"
 #include "Tags.h"
 #include "TextBufferFwd.h"
@@ -35,6 +37,7 @@
 
 #include <sys/stat.h>
 
+class BackupWriter;
 class HighlightPattern;
 class MainWindow;
 class PatternSet;
@@ -91,6 +94,7 @@ public:
 	void dragStartCallback(TextArea *area);
 	void modifiedCallback(TextCursor pos, int64_t nInserted, int64_t nDeleted, int64_t nRestyled, view::string_view deletedText);
 	void modifiedCallback(TextCursor pos, int64_t nInserted, int64_t nDeleted, int64_t nRestyled, view::string_view deletedText, TextArea *area);
+	void matchesSearchedCallback();
 	void movedCallback(TextArea *area);
 	void smartIndentCallback(TextArea *area, SmartIndentEvent *event);
 
@@ -105,6 +109,8 @@ public:
 	void action_Set_Language_Mode(const QString &languageMode, bool forceNewDefaults);
 
 public:
+	DocumentLayout *documentLayout() const;
+	DocumentSummary *documentSummary();
 	DocumentWidget *open(const QString &fullpath);
 	FileFormats fileFormat() const;
 	HighlightPattern *findPatternOfWindow(const QString &name) const;
@@ -148,11 +154,12 @@ public:
 	dev_t device() const;
 	ino_t inode() const;
 	int findDefinitionHelperCommon(TextArea *area, const QString &value, Tags::SearchMode search_type);
-	int showTipString(const QString &text, bool anchored, int pos, bool lookup, Tags::SearchMode search_type, TipHAlignMode hAlign, TipVAlignMode vAlign, TipAlignMode alignMode);
+	int showTipString(const QString &text, bool anchored, TextCursor pos, bool lookup, Tags::SearchMode search_type, TipHAlignMode hAlign, TipVAlignMode vAlign, TipAlignMode alignMode);
 	int textPanesCount() const;
 	int widgetToPaneIndex(TextArea *area) const;
 	int64_t highlightLengthOfCodeFromPos(TextCursor pos) const;
 	int64_t styleLengthOfCodeFromPos(TextCursor pos) const;
+	int64_t undoMemory() const;
 	size_t getLanguageMode() const;
 	size_t highlightCodeOfPos(TextCursor pos) const;
 	std::unique_ptr<WindowHighlightData> createHighlightData(PatternSet *patternSet, Verbosity verbosity = Verbosity::Silent);
@@ -162,6 +169,7 @@ public:
 	void beginSmartIndent(Verbosity verbosity);
 	void cancelMacroOrLearn();
 	void checkForChangesToFile();
+	void clearMatchHighlights();
 	void clearModeMessage();
 	void closePane();
 	void doMacro(const QString &macro, const QString &errInName);
@@ -178,6 +186,7 @@ public:
 	void gotoMatchingCharacter(TextArea *area, bool select);
 	void handleUnparsedRegion(const std::shared_ptr<UTextBuffer> &styleBuf, TextCursor pos) const;
 	void handleUnparsedRegion(UTextBuffer *styleBuf, TextCursor pos) const;
+	void highlightMatches(TextArea *area, const QString &searchString, SearchType searchType);
 	void macroBannerTimeoutProc();
 	void makeSelectionVisible(TextArea *area);
 	void moveDocument(MainWindow *fromWindow);
@@ -234,16 +243,16 @@ private:
 	bool closeFileAndWindow(CloseMode preResponse);
 	bool compareDocumentToFile(const QString &fileName) const;
 	bool doOpen(const QString &name, const QString &path, int flags);
-	bool doSave();
+	bool doSave(bool backup);
 	bool fileWasModifiedExternally() const;
 	void includeFile(const QString &name);
 	bool macroWindowCloseActions();
 	bool saveDocument();
 	bool saveDocumentAs(const QString &newName, bool addWrap);
-	bool writeBackupFile();
-	bool writeBckVersion();
+	bool writeBckVersion(bool replace);
 	boost::optional<TextCursor> findMatchingChar(char toMatch, Style styleToMatch, TextCursor charPos, TextCursor startLimit, TextCursor endLimit);
 	int findAllMatches(TextArea *area, const QString &string);
+	int64_t restoreUndoText(UndoInfo &undo);
 	size_t matchLanguageMode() const;
 	std::unique_ptr<HighlightData[]> compilePatterns(const std::vector<HighlightPattern> &patternSrc, Verbosity verbosity = Verbosity::Silent);
 	std::unique_ptr<Regex> compileRegexAndWarn(const QString &re);
@@ -252,8 +261,9 @@ private:
 	void addRedoItem(UndoInfo &&redo);
 	void addUndoItem(UndoInfo &&undo);
 	void addWrapNewlines();
-	void appendDeletedText(view::string_view deletedText, int64_t deletedLen, Direction direction);
+	void appendDeletedText(view::string_view deletedText, Direction direction);
 	void attachHighlightToWidget(TextArea *area);
+	void backupWriteFailed(const QString &filename, const QString &error);
 	void beginLearn();
 	void cancelLearning();
 	void clearRedoList();
@@ -285,7 +295,9 @@ private:
 	void removeUndoItem();
 	void replay();
 	void revertToSaved();
+	void limitUndoMemory();
 	void saveUndoInformation(TextCursor pos, int64_t nInserted, int64_t nDeleted, view::string_view deletedText);
+	void shrinkUndoList(int64_t limit);
 	void setModeMessage(const QString &message);
 	void setWindowModified(bool modified);
 	void trimUndoList(size_t maxLength);
@@ -294,6 +306,7 @@ private:
 	void updateMarkTable(TextCursor pos, int64_t nInserted, int64_t nDeleted);
 	void updateSelectionSensitiveMenu(QMenu *menu, const gsl::span<MenuData> &menuList, bool enabled);
 	void updateSelectionSensitiveMenus(bool enabled);
+	void writeBackupFile();
 
 protected:
 	void dragEnterEvent(QDragEnterEvent *event) override;
@@ -303,8 +316,6 @@ public:
 	std::shared_ptr<DocumentInfo> info_;
 
 public:
-	bool replaceFailed_  = false;               // flags replacements failures during multi-file replacements
-	bool multiFileBusy_  = false;               // suppresses multiple beeps/dialogs during multi-file replacements
 	size_t languageMode_ = PLAIN_LANGUAGE_MODE; // identifies language mode currently selected in the window
 
 public:
@@ -314,6 +325,8 @@ public:
 	std::shared_ptr<MacroCommandData> macroCmdData_;     // same for macro commands
 	std::unique_ptr<RangesetTable> rangesetTable_;       // current range sets
 	std::unique_ptr<WindowHighlightData> highlightData_; // info for syntax highlighting
+	std::unique_ptr<DocumentSummary> summary_;           // overview of the text for the overview ruler, created on demand
+	std::unique_ptr<SearchMatches> searchMatches_;       // highlighted matches of the last search, if highlighting them is on
 
 private:
 	QSplitter *splitter_;
@@ -321,6 +334,7 @@ private:
 	QString backlightCharTypes_; // what backlighting to use
 	QString modeMessage_;        // stats line banner content for learn and shell command executing modes
 	QTimer *flashTimer_;         // timer for getting rid of highlighted matching paren.
+	BackupWriter *backupWriter_; // writes the backup file in the background
 	bool backlightChars_;        // is char backlighting turned on?
 	std::map<QChar, Bookmark> markTable_;
 	std::unique_ptr<ShellCommandData> shellCmdData_; // when a shell command is executing, info. about it, otherwise, nullptr
@@ -0,0 +1,256 @@
+
+#include "FileMonitor.h"
+#include "DocumentWidget.h"
+
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QPointer>
+#include <QStorageInfo>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+// how long changes to files are collected before the documents are checked
+constexpr int ChangeDelay = 250;
+
+/* Maximum frequency of checking a file which can't be watched. It is checked
+ * on buffer modification and change of focus, but no more often than this, and
+ * is checked this often anyway while its document is on top */
+constexpr int PollInterval = 3000;
+
+/**
+ * @brief isNetworkFileSystem
+ * @param path
+ * @return true if "path" is on a file system where changes made from other
+ * hosts aren't noticed by watching the file
+ */
+bool isNetworkFileSystem(const QString &path) {
+
+	static const char *const NetworkFileSystems[] = {
+		"9p",
+		"afpfs",
+		"afs",
+		"cifs",
+		"coda",
+		"fuse.sshfs",
+		"ncp",
+		"nfs",
+		"smb",
+		"webdav",
+	};
+
+	// the file itself may not exist (yet)
+	const QByteArray type = QStorageInfo(QFileInfo(path).absolutePath()).fileSystemType();
+	return std::any_of(std::begin(NetworkFileSystems), std::end(NetworkFileSystems), [&type](const char *fileSystem) {
+		return type.startsWith(fileSystem);
+	});
+}
+
+}
+
+/**
+ * @brief FileMonitor::FileMonitor
+ * @param parent
+ */
+FileMonitor::FileMonitor(QObject *parent)
+	: QObject(parent) {
+
+	changeTimer_.setInterval(ChangeDelay);
+	changeTimer_.setSingleShot(true);
+	pollTimer_.setInterval(PollInterval);
+
+	connect(&watcher_, &QFileSystemWatcher::fileChanged, this, &FileMonitor::fileChanged);
+	connect(&changeTimer_, &QTimer::timeout, this, &FileMonitor::processChanges);
+	connect(&pollTimer_, &QTimer::timeout, this, [this]() {
+		checkDocuments(/*polled=*/true);
+	});
+
+	pollTimer_.start();
+}
+
+/**
+ * @brief FileMonitor::instance
+ * @return global unique instance
+ */
+FileMonitor *FileMonitor::instance() {
+	static FileMonitor *const instance = new FileMonitor(QCoreApplication::instance());
+	return instance;
+}
+
+/**
+ * @brief FileMonitor::checkDue
+ * @param document
+ * @param path
+ * @param silent
+ * @return true if the file "path" of "document" should be checked for changes
+ * now. A check which is "silent" can't warn the user, so doesn't count as the
+ * check of a changed file.
+ */
+bool FileMonitor::checkDue(DocumentWidget *document, const QString &path, bool silent) {
+
+	auto it = documents_.find(document);
+	if (it == documents_.end()) {
+		it = documents_.emplace(document, Entry()).first;
+
+		connect(document, &QObject::destroyed, this, [this, document]() {
+			unwatch(document);
+		});
+	}
+
+	Entry &entry = it->second;
+	if (entry.path != path) {
+		const QString previous = entry.path;
+
+		entry.path     = path;
+		entry.pollOnly = isNetworkFileSystem(path);
+		entry.watched  = !entry.pollOnly && watch(path);
+		entry.changed  = true;
+		release(previous);
+	}
+
+	// a change may have been noticed, but not handled yet
+	if (changedPaths_.contains(path)) {
+		entry.changed = true;
+	}
+
+	const auto now = std::chrono::steady_clock::now();
+
+	if (!entry.changed) {
+		if (entry.watched || now - entry.lastCheck < std::chrono::milliseconds(PollInterval)) {
+			return false;
+		}
+
+		// the file may have been created since it last couldn't be watched
+		entry.watched = !entry.pollOnly && watch(path);
+	}
+
+	if (!silent) {
+		entry.changed = false;
+	}
+
+	entry.lastCheck = now;
+	return true;
+}
+
+/**
+ * @brief FileMonitor::watch
+ * @param path
+ * @return true if "path" is being watched
+ */
+bool FileMonitor::watch(const QString &path) {
+
+	if (watcher_.files().contains(path)) {
+		return true;
+	}
+
+	return QFileInfo::exists(path) && watcher_.addPath(path);
+}
+
+/**
+ * @brief FileMonitor::release
+ * @param path
+ *
+ * Stop watching "path", unless another document still has it open.
+ */
+void FileMonitor::release(const QString &path) {
+
+	if (path.isEmpty()) {
+		return;
+	}
+
+	const bool used = std::any_of(documents_.begin(), documents_.end(), [&path](const std::pair<DocumentWidget *const, Entry> &pair) {
+		return pair.second.path == path;
+	});
+
+	if (!used && watcher_.files().contains(path)) {
+		watcher_.removePath(path);
+	}
+}
+
+/**
+ * @brief FileMonitor::unwatch
+ * @param document
+ */
+void FileMonitor::unwatch(DocumentWidget *document) {
+
+	auto it = documents_.find(document);
+	if (it == documents_.end()) {
+		return;
+	}
+
+	const QString path = it->second.path;
+	documents_.erase(it);
+	release(path);
+}
+
+/**
+ * @brief FileMonitor::fileChanged
+ * @param path
+ */
+void FileMonitor::fileChanged(const QString &path) {
+	changedPaths_.insert(path);
+	changeTimer_.start();
+}
+
+/**
+ * @brief FileMonitor::processChanges
+ */
+void FileMonitor::processChanges() {
+
+	QSet<QString> paths;
+	paths.swap(changedPaths_);
+
+	for (auto &pair : documents_) {
+		Entry &entry = pair.second;
+		if (paths.contains(entry.path)) {
+			entry.changed = true;
+
+			// a file which was deleted or replaced is no longer watched
+			entry.watched = !entry.pollOnly && watch(entry.path);
+		}
+	}
+
+	checkDocuments(/*polled=*/false);
+}
+
+/**
+ * @brief FileMonitor::checkDocuments
+ * @param polled
+ *
+ * Check the topmost documents whose files have changed, or if "polled", whose
+ * files aren't watched. Other documents are checked once they are raised.
+ */
+void FileMonitor::checkDocuments(bool polled) {
+
+	// the user can't be warned while NEdit-ng isn't active
+	if (QGuiApplication::applicationState() != Qt::ApplicationActive) {
+		return;
+	}
+
+	std::vector<QPointer<DocumentWidget>> documents;
+	for (auto &pair : documents_) {
+		if (!pair.first->isTopDocument()) {
+			continue;
+		}
+
+		Entry &entry = pair.second;
+		if (polled && !entry.watched) {
+			entry.changed = true;
+		}
+
+		if (entry.changed) {
+			documents.emplace_back(pair.first);
+		}
+	}
+
+	/* A check may put up a dialog, in response to which the user may close any
+	   of the documents */
+	for (const QPointer<DocumentWidget> &document : documents) {
+		if (document) {
+			document->checkForChangesToFile();
+		}
+	}
+}
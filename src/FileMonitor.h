@@ -0,0 +1,62 @@
+
+#ifndef FILE_MONITOR_H_
+#define FILE_MONITOR_H_
+
+#include <QFileSystemWatcher>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QTimer>
+
+#include <chrono>
+#include <unordered_map>
+
+class DocumentWidget;
+
+/*
+** Watches the files of all open documents for changes made by other programs.
+** A document whose file is watched is only checked once the file has changed,
+** rather than its file being stat'ed on every edit and change of focus.
+** Changes are collected for a moment and then handled together, so that a
+** program rewriting many files causes one round of checks. Files which can't
+** be watched, such as those on network file systems where changes made by
+** other hosts go unseen, are polled instead.
+*/
+class FileMonitor : public QObject {
+	Q_OBJECT
+public:
+	static FileMonitor *instance();
+
+private:
+	explicit FileMonitor(QObject *parent = nullptr);
+	~FileMonitor() override = default;
+
+public:
+	bool checkDue(DocumentWidget *document, const QString &path, bool silent);
+
+private:
+	struct Entry {
+		QString path;
+		std::chrono::steady_clock::time_point lastCheck;
+		bool pollOnly = false; // is the file on a file system where watching it isn't enough?
+		bool watched  = false; // is the file watched, rather than polled?
+		bool changed  = true;  // is a check of the file due?
+	};
+
+private:
+	bool watch(const QString &path);
+	void checkDocuments(bool polled);
+	void fileChanged(const QString &path);
+	void processChanges();
+	void release(const QString &path);
+	void unwatch(DocumentWidget *document);
+
+private:
+	QFileSystemWatcher watcher_;
+	QTimer changeTimer_; // delays handling changes, so that bursts of them are handled together
+	QTimer pollTimer_;
+	QSet<QString> changedPaths_;
+	std::unordered_map<DocumentWidget *, Entry> documents_;
+};
+
+#endif
@@ -0,0 +1,132 @@
+
+#include "FileSearchPattern.h"
+#include "Util/utils.h"
+
+#include <cstring>
+
+/**
+ * @brief FileSearchPattern::FileSearchPattern
+ * @param searchString
+ * @param type
+ * @param wordDelimiters
+ */
+FileSearchPattern::FileSearchPattern(const std::string &searchString, SearchType type, const std::string &wordDelimiters)
+	: searchType(type), text(searchString), delimiters(wordDelimiters) {
+
+	const bool foldCase = (type == SearchType::Literal || type == SearchType::LiteralWord);
+	for (size_t i = 0; i < fold.size(); ++i) {
+		fold[i] = static_cast<unsigned char>(foldCase ? safe_tolower(static_cast<unsigned char>(i)) : static_cast<int>(i));
+	}
+
+	for (char &ch : text) {
+		ch = static_cast<char>(fold[static_cast<unsigned char>(ch)]);
+	}
+
+	/* Pick the character to look for first, the rarer it is the fewer places
+	 * the rest of the text is compared at. Unusual punctuation is taken to be
+	 * rarer than digits, then capitals, then lower case letters in the order
+	 * of how often they're used in English, then the punctuation common in
+	 * source code, and last of all, white space */
+	auto rarity = [foldCase](unsigned char ch) {
+		static const char frequent[]    = "etaoinshrdlcumwfgypbvkjxqz";
+		static const char punctuation[] = "_(),;.*=-/\"'{}[]<>#:&";
+		if (safe_isspace(ch)) {
+			return 0;
+		}
+
+		if (std::strchr(punctuation, ch)) {
+			return 5;
+		}
+
+		if (safe_isalpha(ch)) {
+			const char *index = std::strchr(frequent, safe_tolower(ch));
+			const int rank    = index ? static_cast<int>(index - frequent) : 0;
+			return (safe_isupper(ch) && !foldCase) ? 100 + rank : 10 + rank;
+		}
+
+		return safe_isdigit(ch) ? 200 : 300;
+	};
+
+	for (size_t i = 1; i < text.size(); ++i) {
+		if (rarity(static_cast<unsigned char>(text[i])) > rarity(static_cast<unsigned char>(text[guard]))) {
+			guard = i;
+		}
+	}
+
+	guardLower = text.empty() ? 0 : static_cast<unsigned char>(text[guard]);
+	guardUpper = foldCase ? static_cast<unsigned char>(safe_toupper(guardLower)) : guardLower;
+
+	for (size_t i = 0; i < delimiter.size(); ++i) {
+		const auto ch = static_cast<unsigned char>(i);
+		delimiter[i]  = (ch == '\0' || safe_isspace(ch) || delimiters.find(static_cast<char>(ch)) != std::string::npos);
+	}
+
+	if ((type == SearchType::LiteralWord || type == SearchType::CaseSenseWord) && !text.empty()) {
+		wordStart = !delimiter[static_cast<unsigned char>(text.front())];
+		wordEnd   = !delimiter[static_cast<unsigned char>(text.back())];
+	}
+}
+
+/**
+ * @brief FileSearchPattern::findLiteral
+ * @param string
+ * @param pos
+ * @return where the first literal match at or after "pos" in "string" starts,
+ * or npos if there isn't one
+ *
+ * The guard character is looked for with memchr, and the rest of the text is
+ * only compared where it's found.
+ */
+size_t FileSearchPattern::findLiteral(view::string_view string, size_t pos) const {
+
+	const size_t length = text.size();
+	if (length == 0 || string.size() < length || pos > string.size() - length) {
+		return view::string_view::npos;
+	}
+
+	const char *const begin = string.data();
+	const char *const last  = begin + string.size() - length + 1; // one past the last place a match can start
+
+	for (const char *p = begin + pos; p < last; ++p) {
+		const auto count = static_cast<size_t>(last - p);
+
+		auto candidate = static_cast<const char *>(std::memchr(p + guard, guardLower, count));
+		if (guardUpper != guardLower) {
+			const size_t end = candidate ? static_cast<size_t>(candidate - (p + guard)) : count;
+			if (auto other = static_cast<const char *>(std::memchr(p + guard, guardUpper, end))) {
+				candidate = other;
+			}
+		}
+
+		if (!candidate) {
+			break;
+		}
+
+		p = candidate - guard;
+
+		size_t i = 0;
+		while (i < length && fold[static_cast<unsigned char>(p[i])] == static_cast<unsigned char>(text[i])) {
+			++i;
+		}
+
+		if (i != length) {
+			continue;
+		}
+
+		const auto start = static_cast<size_t>(p - begin);
+		const size_t end = start + length;
+
+		// as for a search of a document, the ends of the string delimit words too
+		if (wordStart && start != 0 && !delimiter[static_cast<unsigned char>(string[start - 1])]) {
+			continue;
+		}
+
+		if (wordEnd && end != string.size() && !delimiter[static_cast<unsigned char>(string[end])]) {
+			continue;
+		}
+
+		return start;
+	}
+
+	return view::string_view::npos;
+}
@@ -0,0 +1,32 @@
+
+#ifndef FILE_SEARCH_PATTERN_H_
+#define FILE_SEARCH_PATTERN_H_
+
+#include "SearchType.h"
+#include "Util/string_view.h"
+
+#include <array>
+#include <string>
+
+/*
+** What a find in files searches for, prepared once and then shared, unchanged,
+** by all of the tasks of a search.
+*/
+struct FileSearchPattern {
+	FileSearchPattern(const std::string &searchString, SearchType type, const std::string &wordDelimiters);
+
+	size_t findLiteral(view::string_view string, size_t pos) const;
+
+	SearchType searchType;
+	std::string text;                    // lower case if the search ignores case
+	std::string delimiters;              // for the '<' and '>' of regular expressions
+	std::array<unsigned char, 256> fold; // the lower case of each character, or itself if case matters
+	std::array<bool, 256> delimiter;     // which characters separate words
+	size_t guard = 0;                    // the position in the text of the character looked for first,
+	unsigned char guardLower;            // which should be one of the rarer ones,
+	unsigned char guardUpper;            // in either case, if case is ignored
+	bool wordStart = false;              // must a match start at the start of a word?
+	bool wordEnd   = false;              // must a match end at the end of a word?
+};
+
+#endif
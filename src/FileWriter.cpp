@@ -0,0 +1,228 @@
+
+#include "FileWriter.h"
+#include "Util/Raise.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <qplatformdefs.h>
+
+#include <gsl/gsl_util>
+
+#include <cerrno>
+#include <cstring>
+#include <memory>
+
+#ifdef Q_OS_LINUX
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+#if defined(Q_OS_LINUX) || defined(Q_OS_MACOS)
+#include <sys/xattr.h>
+#endif
+
+namespace FileWriter {
+
+/**
+ * @brief canReplaceFile
+ * @param fullname
+ * @return true if "fullname" can be saved by writing a new file and renaming it
+ * over the old one, which changes nothing but the file's contents. Otherwise it
+ * must be written in place, so as not to give it a new owner, lose its ACLs,
+ * SELinux label or other extended attributes, or break a symbolic link or hard
+ * links to it. The new file must also be given the old one's group, by
+ * keepFileGroup.
+ */
+bool canReplaceFile(const QString &fullname) {
+
+	if (QFileInfo(fullname).isSymLink()) {
+		return false;
+	}
+
+#ifdef Q_OS_UNIX
+	QT_STATBUF statbuf;
+	if (QT_STAT(fullname.toUtf8().data(), &statbuf) != 0) {
+		return true;
+	}
+
+	if (statbuf.st_uid != ::geteuid()) {
+		return false;
+	}
+
+#if defined(Q_OS_LINUX)
+	if (::listxattr(fullname.toUtf8().data(), nullptr, 0) > 0) {
+		return false;
+	}
+#elif defined(Q_OS_MACOS)
+	if (::listxattr(fullname.toUtf8().data(), nullptr, 0, 0) > 0) {
+		return false;
+	}
+#endif
+
+	if (statbuf.st_nlink == 1) {
+		return true;
+	}
+
+	// the other link may be the backup of the old version, made by writeBackup
+	QT_STATBUF bckbuf;
+	return statbuf.st_nlink == 2 &&
+		   QT_STAT(QStringLiteral("%1.bck").arg(fullname).toUtf8().data(), &bckbuf) == 0 &&
+		   bckbuf.st_dev == statbuf.st_dev &&
+		   bckbuf.st_ino == statbuf.st_ino;
+#else
+	return true;
+#endif
+}
+
+/**
+ * @brief keepFileGroup
+ * @param file
+ * @param fullname
+ * @return true if "file", the new file which is to replace "fullname", has the
+ * same group as it, giving it that group if need be. A new file gets the
+ * user's group, which may not be the one the file is shared with.
+ */
+bool keepFileGroup(QSaveFile &file, const QString &fullname) {
+#ifdef Q_OS_UNIX
+	QT_STATBUF statbuf;
+	if (QT_STAT(fullname.toUtf8().data(), &statbuf) != 0) {
+		return true;
+	}
+
+	QT_STATBUF newbuf;
+	if (QT_FSTAT(file.handle(), &newbuf) != 0) {
+		return false;
+	}
+
+	return newbuf.st_gid == statbuf.st_gid || ::fchown(file.handle(), static_cast<uid_t>(-1), statbuf.st_gid) == 0;
+#else
+	Q_UNUSED(file)
+	Q_UNUSED(fullname)
+	return true;
+#endif
+}
+
+/**
+ * @brief openReplacement
+ * @param file
+ * @param fullname
+ * @return true if "file" has been opened as a new file to be renamed over
+ * "fullname". If not, "fullname" must be written in place. That includes
+ * files in read-only directories, so QSaveFile's own fallback to writing in
+ * place is never used, it would leave the caller thinking the old file was
+ * going to be replaced.
+ */
+bool openReplacement(QSaveFile &file, const QString &fullname) {
+
+	file.setDirectWriteFallback(false);
+
+	if (!canReplaceFile(fullname) || !file.open(QIODevice::WriteOnly)) {
+		return false;
+	}
+
+	if (!keepFileGroup(file, fullname)) {
+		// the new file is removed when "file" is destroyed
+		file.cancelWriting();
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief writeBackup
+ * @param fullname
+ * @param bckname
+ * @param replace
+ *
+ * Make "bckname" a copy of "fullname", throwing BackupError if that fails.
+ * If "replace" is true, "fullname" is certain to be replaced by a new file,
+ * so the backup is simply another link to the old one. Otherwise the old file
+ * is about to be rewritten, and a link would be rewritten with it.
+ */
+void writeBackup(const QString &fullname, const QString &bckname, bool replace) {
+
+	// Delete the old backup file
+	// Errors are ignored; we'll notice them later.
+	QFile::remove(bckname);
+
+#ifdef Q_OS_UNIX
+	if (replace && ::link(fullname.toUtf8().data(), bckname.toUtf8().data()) == 0) {
+		return;
+	}
+#else
+	Q_UNUSED(replace)
+#endif
+
+	/* open the file being edited.  If there are problems with the
+	 * old file, don't bother the user, just skip the backup */
+	QFile inputFile(fullname);
+	if (!inputFile.open(QIODevice::ReadOnly)) {
+		return;
+	}
+
+	/* Get permissions of the file.
+	 * We preserve the normal permissions but not ownership, extended
+	 * attributes, et cetera. */
+	QT_STATBUF statbuf;
+	if (QT_FSTAT(inputFile.handle(), &statbuf) != 0) {
+		return;
+	}
+
+	// open the destination file exclusive and with restrictive permissions.
+#ifdef Q_OS_WIN
+	int out_fd = QT_OPEN(bckname.toUtf8().data(), QT_OPEN_CREAT | O_EXCL | QT_OPEN_TRUNC | QT_OPEN_WRONLY, _S_IREAD | _S_IWRITE);
+#else
+	int out_fd = QT_OPEN(bckname.toUtf8().data(), QT_OPEN_CREAT | O_EXCL | QT_OPEN_TRUNC | QT_OPEN_WRONLY, S_IRUSR | S_IWUSR);
+#endif
+	if (out_fd < 0) {
+		Raise<BackupError>(bckname, tr("Error open backup file"));
+	}
+
+	auto _2 = gsl::finally([out_fd]() {
+		QT_CLOSE(out_fd);
+	});
+
+#ifdef Q_OS_UNIX
+	// Set permissions on new file
+	if (::fchmod(out_fd, statbuf.st_mode) != 0) {
+		QFile::remove(bckname);
+		Raise<BackupError>(bckname, tr("fchmod() failed"));
+	}
+#endif
+
+#ifdef FICLONE
+	// where the file system can share the data of the copy, do that
+	if (::ioctl(out_fd, FICLONE, inputFile.handle()) == 0) {
+		return;
+	}
+#endif
+
+	// Allocate I/O buffer
+	constexpr size_t IO_BUFFER_SIZE = (1024ul * 1024ul);
+	auto io_buffer                  = std::make_unique<char[]>(IO_BUFFER_SIZE);
+
+	// copy loop
+	for (;;) {
+		qint64 bytes_read = inputFile.read(&io_buffer[0], IO_BUFFER_SIZE);
+
+		if (bytes_read < 0) {
+			QFile::remove(bckname);
+			Raise<BackupError>(QFileInfo(fullname).fileName(), tr("read() error"));
+		}
+
+		if (bytes_read == 0) {
+			break; // EOF
+		}
+
+		// write to the file
+		qint64 bytes_written = QT_WRITE(out_fd, &io_buffer[0], static_cast<size_t>(bytes_read));
+		if (bytes_written != bytes_read) {
+			QFile::remove(bckname);
+			Raise<BackupError>(bckname, QString::fromLatin1(strerror(errno)));
+		}
+	}
+}
+
+}
@@ -0,0 +1,33 @@
+
+#ifndef FILE_WRITER_H_
+#define FILE_WRITER_H_
+
+#include "Util/QtHelper.h"
+
+#include <QString>
+
+class QSaveFile;
+
+/*
+** Saving a file over its old version. Where nothing but the contents of the
+** file would change, a new file is written and renamed over the old one, and
+** otherwise the old file is written in place. A backup of the old version is
+** only a link to it when it is certain to be replaced rather than rewritten.
+*/
+namespace FileWriter {
+
+Q_DECLARE_NAMESPACE_TR(FileWriter)
+
+struct BackupError {
+	QString filename;
+	QString message;
+};
+
+bool canReplaceFile(const QString &fullname);
+bool keepFileGroup(QSaveFile &file, const QString &fullname);
+bool openReplacement(QSaveFile &file, const QString &fullname);
+void writeBackup(const QString &fullname, const QString &bckname, bool replace);
+
+}
+
+#endif
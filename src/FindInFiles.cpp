@@ -0,0 +1,449 @@
+
+#include "FindInFiles.h"
+#include "FileSearchPattern.h"
+#include "Regex.h"
+#include "Search.h"
+#include "ThreadPool.h"
+
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegExp>
+
+#include <gsl/gsl_util>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+// how many files each task searches
+constexpr int BatchSize = 64;
+
+// how much of a file is read at a time
+constexpr qint64 ReadSize = 1024 * 1024;
+
+// how much of the start of a file is looked at to decide whether it's binary
+constexpr size_t BinaryCheckSize = 8192;
+
+// how much of a long line is kept to show a match in
+constexpr size_t MaxLineText = 512;
+
+// the search is stopped once this many lines have matched
+constexpr int MaxMatches = 100000;
+
+/**
+ * @brief wildcards
+ * @param patterns
+ * @return "patterns" compiled, to match the names of files with
+ */
+std::vector<QRegExp> wildcards(const QStringList &patterns) {
+#ifdef Q_OS_WIN
+	constexpr Qt::CaseSensitivity FileNameCase = Qt::CaseInsensitive;
+#else
+	constexpr Qt::CaseSensitivity FileNameCase = Qt::CaseSensitive;
+#endif
+
+	std::vector<QRegExp> expressions;
+	for (const QString &pattern : patterns) {
+		expressions.emplace_back(pattern, FileNameCase, QRegExp::Wildcard);
+	}
+
+	return expressions;
+}
+
+/**
+ * @brief matchesAny
+ * @param expressions
+ * @param name
+ * @return true if "name" matches one of "expressions"
+ */
+bool matchesAny(const std::vector<QRegExp> &expressions, const QString &name) {
+	return std::any_of(expressions.begin(), expressions.end(), [&name](const QRegExp &expression) {
+		return expression.exactMatch(name);
+	});
+}
+
+}
+
+/**
+ * @brief FindInFiles::FindInFiles
+ * @param parent
+ */
+FindInFiles::FindInFiles(QObject *parent)
+	: QObject(parent) {
+}
+
+/**
+ * @brief FindInFiles::~FindInFiles
+ */
+FindInFiles::~FindInFiles() {
+	// nothing is told about the search which is abandoned along with this
+	blockSignals(true);
+	cancel();
+	pool_.waitForDone();
+}
+
+/**
+ * @brief FindInFiles::startTask
+ * @param state
+ * @param function
+ *
+ * Run "function" on the pool as one of the tasks of the search "state". The
+ * task is done when the pool is done with it, whether it ran, or was taken
+ * off the queue by cancel() before it could start.
+ */
+template <class Function>
+void FindInFiles::startTask(const std::shared_ptr<State> &state, Function &&function) {
+
+	++state->tasks;
+
+	auto done = gsl::finally([this, state]() {
+		taskDone(*state);
+	});
+
+	StartInPool(&pool_, [function = std::forward<Function>(function), done = std::move(done)]() {
+		function();
+	});
+}
+
+/**
+ * @brief FindInFiles::start
+ * @param query
+ * @return the number which identifies this search, in finished()
+ *
+ * Start searching for "query", abandoning the search in progress, if any.
+ * The search string of a regular expression search must already have been
+ * checked to compile.
+ */
+int FindInFiles::start(const Query &query) {
+
+	auto state    = std::make_shared<State>();
+	state->search = state_->search + 1;
+
+	std::shared_ptr<State> previous;
+	{
+		QMutexLocker locker(&mutex_);
+		matches_.clear();
+		previous = std::exchange(state_, state);
+	}
+
+	/* the tasks of the previous search may still be finishing what they were
+	 * doing, but anything they find now is thrown away, and they finish as a
+	 * search which isn't the current one any more */
+	previous->canceled = true;
+	pool_.clear();
+
+	std::shared_ptr<const FileSearchPattern> pattern = std::make_shared<FileSearchPattern>(query.searchString.toStdString(), query.searchType, query.delimiters.toStdString());
+
+	startTask(state, [this, state, query, pattern]() {
+		walk(state, query, pattern);
+	});
+
+	return state->search;
+}
+
+/**
+ * @brief FindInFiles::cancel
+ *
+ * Stop the search in progress, without waiting for it. The tasks which are
+ * searching files stop at the next chance they get, the ones which haven't
+ * started yet never do, and finished() is emitted once they are all done.
+ */
+void FindInFiles::cancel() {
+	state_->canceled = true;
+	pool_.clear();
+}
+
+/**
+ * @brief FindInFiles::isRunning
+ * @return
+ */
+bool FindInFiles::isRunning() const {
+	return state_->tasks != 0;
+}
+
+/**
+ * @brief FindInFiles::limitReached
+ * @return true if the search stopped because MaxMatches lines had matched
+ */
+bool FindInFiles::limitReached() const {
+	return state_->limitReached;
+}
+
+/**
+ * @brief FindInFiles::fileCount
+ * @return the number of files searched so far
+ */
+int FindInFiles::fileCount() const {
+	return state_->files;
+}
+
+/**
+ * @brief FindInFiles::currentSearch
+ * @return the number which identifies the current search
+ */
+int FindInFiles::currentSearch() const {
+	return state_->search;
+}
+
+/**
+ * @brief FindInFiles::takeMatches
+ * @return the matches found since this was last called
+ */
+std::vector<FindInFiles::Match> FindInFiles::takeMatches() {
+	QMutexLocker locker(&mutex_);
+	std::vector<Match> matches;
+	matches.swap(matches_);
+	return matches;
+}
+
+/**
+ * @brief FindInFiles::addMatches
+ * @param state
+ * @param matches
+ *
+ * Called by the tasks to hand over what they found. The UI is only told when
+ * there were no matches waiting, it takes everything found by then anyway.
+ * The matches of a search which has been replaced by another one are dropped.
+ */
+void FindInFiles::addMatches(State &state, std::vector<Match> &matches) {
+
+	const int count = static_cast<int>(matches.size());
+
+	QMutexLocker locker(&mutex_);
+	if (&state != state_.get()) {
+		matches.clear();
+		return;
+	}
+
+	const bool notify = matches_.empty();
+	std::move(matches.begin(), matches.end(), std::back_inserter(matches_));
+	locker.unlock();
+
+	matches.clear();
+
+	if ((state.matchCount += count) >= MaxMatches) {
+		state.limitReached = true;
+		state.canceled     = true;
+	}
+
+	if (notify) {
+		Q_EMIT matchesFound();
+	}
+}
+
+/**
+ * @brief FindInFiles::taskDone
+ * @param state
+ */
+void FindInFiles::taskDone(State &state) {
+	if (--state.tasks == 0) {
+		Q_EMIT finished(state.search);
+	}
+}
+
+/**
+ * @brief FindInFiles::walk
+ * @param state
+ * @param query
+ * @param pattern
+ *
+ * Find the files to search, and hand them out to tasks in batches. Symbolic
+ * links to directories aren't followed, so that each file is only found once.
+ */
+void FindInFiles::walk(const std::shared_ptr<State> &state, const Query &query, const std::shared_ptr<const FileSearchPattern> &pattern) {
+
+	const std::vector<QRegExp> filePatterns   = wildcards(query.filePatterns);
+	const std::vector<QRegExp> ignorePatterns = wildcards(query.ignorePatterns);
+
+	QStringList batch;
+
+	auto startBatch = [this, &batch, &state, &pattern]() {
+		const QStringList files = batch;
+		batch.clear();
+
+		startTask(state, [this, state, files, pattern]() {
+			searchFiles(*state, *pattern, files);
+		});
+	};
+
+	QStringList directories{query.directory};
+	while (!directories.isEmpty() && !state->canceled) {
+
+		QDirIterator it(directories.takeLast(), QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden);
+		while (it.hasNext() && !state->canceled) {
+			it.next();
+
+			const QFileInfo info = it.fileInfo();
+			const QString name   = info.fileName();
+
+			if (matchesAny(ignorePatterns, name)) {
+				continue;
+			}
+
+			if (info.isDir()) {
+				if (!info.isSymLink()) {
+					directories.append(info.filePath());
+				}
+				continue;
+			}
+
+			if (!info.isFile() || (!filePatterns.empty() && !matchesAny(filePatterns, name))) {
+				continue;
+			}
+
+			batch.append(info.filePath());
+			if (batch.size() == BatchSize) {
+				startBatch();
+			}
+		}
+	}
+
+	if (!batch.isEmpty() && !state->canceled) {
+		startBatch();
+	}
+}
+
+/**
+ * @brief FindInFiles::searchFiles
+ * @param state
+ * @param pattern
+ * @param files
+ */
+void FindInFiles::searchFiles(State &state, const FileSearchPattern &pattern, const QStringList &files) {
+
+	std::unique_ptr<Regex> regex;
+	if (Search::isRegexType(pattern.searchType)) {
+		try {
+			regex = std::make_unique<Regex>(pattern.text, Search::defaultRegexFlags(pattern.searchType));
+		} catch (const RegexError &e) {
+			Q_UNUSED(e)
+			return;
+		}
+	}
+
+	const char *delimiters = pattern.delimiters.empty() ? nullptr : pattern.delimiters.c_str();
+
+	// where the next match at or after "pos" is, as a [start, end) pair, or npos if there isn't one
+	auto find = [&](view::string_view text, size_t pos) -> std::pair<size_t, size_t> {
+		if (!regex) {
+			const size_t start = pattern.findLiteral(text, pos);
+			return {start, start + pattern.text.size()};
+		}
+
+		if (pos > text.size() || !regex->execute(text, pos, text.size(), delimiters, false)) {
+			return {view::string_view::npos, 0};
+		}
+
+		return {static_cast<size_t>(regex->startp[0] - text.data()), static_cast<size_t>(regex->endp[0] - text.data())};
+	};
+
+	std::string buffer;
+	std::vector<Match> matches;
+
+	for (const QString &path : files) {
+		if (state.canceled) {
+			return;
+		}
+
+		QFile file(path);
+		if (!file.open(QIODevice::ReadOnly)) {
+			continue;
+		}
+
+		++state.files;
+
+		/* Like grep, the file is read a block at a time into the same buffer,
+		 * rather than being memory mapped, since a mapped file which something
+		 * else truncates would crash the editor. Each block is searched up to
+		 * the end of its last complete line, and the rest of it is kept for the
+		 * next, so a line is always searched whole. A regular expression which
+		 * matches across lines only finds those within the same block */
+		buffer.clear();
+		int64_t line = 1;
+		bool first   = true;
+
+		while (!state.canceled) {
+			const size_t kept = buffer.size();
+			buffer.resize(kept + static_cast<size_t>(ReadSize));
+			const qint64 n = file.read(&buffer[kept], ReadSize);
+			buffer.resize(kept + static_cast<size_t>(std::max<qint64>(n, 0)));
+
+			const bool atEnd = (n <= 0 || file.atEnd());
+
+			// like grep, files with a null in them are taken to be binary
+			if (first && std::memchr(buffer.data(), '\0', std::min(buffer.size(), BinaryCheckSize))) {
+				break;
+			}
+
+			first = false;
+
+			// an empty file, or the end of one which ends with a newline, has no more lines
+			if (buffer.empty() && atEnd) {
+				break;
+			}
+
+			size_t textSize = buffer.size();
+			if (!atEnd) {
+				const size_t lastNewline = buffer.rfind('\n');
+				if (lastNewline == std::string::npos) {
+					// the line doesn't fit in what has been read so far
+					continue;
+				}
+				textSize = lastNewline + 1;
+			}
+
+			const view::string_view text(buffer.data(), textSize);
+
+			size_t counted = 0; // where the lines have been counted up to
+			size_t pos     = 0;
+
+			while (!state.canceled) {
+				const std::pair<size_t, size_t> match = find(text, pos);
+				// the end of a file which ends with a newline doesn't start another line
+				if (match.first == view::string_view::npos || (match.first == text.size() && text.size() != 0 && text.back() == '\n')) {
+					break;
+				}
+
+				line += std::count(text.begin() + counted, text.begin() + match.first, '\n');
+				counted = match.first;
+
+				size_t lineStart = match.first;
+				while (lineStart > 0 && text[lineStart - 1] != '\n') {
+					--lineStart;
+				}
+
+				auto newline         = static_cast<const char *>(std::memchr(text.data() + match.first, '\n', text.size() - match.first));
+				const size_t lineEnd = newline ? static_cast<size_t>(newline - text.data()) : text.size();
+
+				// a long line is shown from a little before the match
+				const size_t textStart = (lineEnd - lineStart > MaxLineText && match.first - lineStart > MaxLineText / 4) ? match.first - MaxLineText / 4 : lineStart;
+				const size_t textEnd   = std::min(lineEnd, textStart + MaxLineText);
+
+				Match m;
+				m.path   = path;
+				m.line   = line;
+				m.column = static_cast<int64_t>(match.first - lineStart);
+				m.length = static_cast<int64_t>(std::min(match.second, lineEnd) - match.first);
+				m.text   = QString::fromLatin1(text.data() + textStart, static_cast<int>(textEnd - textStart));
+				matches.push_back(std::move(m));
+
+				// like grep, each line is only reported once
+				pos = lineEnd + 1;
+			}
+
+			if (atEnd) {
+				break;
+			}
+
+			line += std::count(text.begin() + counted, text.end(), '\n');
+			buffer.erase(0, textSize);
+		}
+
+		if (!matches.empty()) {
+			addMatches(state, matches);
+		}
+	}
+}
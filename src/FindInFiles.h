@@ -0,0 +1,96 @@
+
+#ifndef FIND_IN_FILES_H_
+#define FIND_IN_FILES_H_
+
+#include "SearchType.h"
+
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+struct FileSearchPattern;
+
+/*
+** Searches the files in a directory tree, the way grep would, on a pool of
+** threads. Each file is read a block at a time and searched with the same
+** types of search as documents are, and the lines which match are collected
+** as they are found, so that they can be shown while the search is still
+** running.
+** Files and directories whose names match one of the ignore patterns are
+** skipped, as are files which look like binaries.
+*/
+class FindInFiles : public QObject {
+	Q_OBJECT
+
+public:
+	struct Query {
+		QString directory;
+		QStringList filePatterns;   // wildcards the names of files searched must match, all of them if empty
+		QStringList ignorePatterns; // wildcards for the names of files and directories which aren't searched
+		QString searchString;
+		SearchType searchType;
+		QString delimiters;         // word delimiters, besides white space
+	};
+
+	struct Match {
+		QString path;
+		int64_t line;   // counted from 1
+		int64_t column; // of the start of the match, in bytes from the start of the line
+		int64_t length; // of the match in bytes, no further than the end of the line
+		QString text;   // the line, or part of it around the match if it's long
+	};
+
+public:
+	explicit FindInFiles(QObject *parent = nullptr);
+	FindInFiles(const FindInFiles &) = delete;
+	FindInFiles &operator=(const FindInFiles &) = delete;
+	~FindInFiles() override;
+
+Q_SIGNALS:
+	// emitted from the worker threads
+	void matchesFound();
+	void finished(int search);
+
+public:
+	bool isRunning() const;
+	bool limitReached() const;
+	int currentSearch() const;
+	int fileCount() const;
+	int start(const Query &query);
+	std::vector<Match> takeMatches();
+	void cancel();
+
+private:
+	// what belongs to one search, shared with the tasks which carry it out
+	struct State {
+		int search = 0;                        // identifies the search
+		std::atomic<bool> canceled{false};
+		std::atomic<bool> limitReached{false};
+		std::atomic<int> tasks{0};             // tasks which haven't finished yet
+		std::atomic<int> files{0};             // files searched so far
+		std::atomic<int> matchCount{0};        // lines which have matched so far
+	};
+
+private:
+	void addMatches(State &state, std::vector<Match> &matches);
+	void searchFiles(State &state, const FileSearchPattern &pattern, const QStringList &files);
+	void taskDone(State &state);
+	void walk(const std::shared_ptr<State> &state, const Query &query, const std::shared_ptr<const FileSearchPattern> &pattern);
+
+	template <class Function>
+	void startTask(const std::shared_ptr<State> &state, Function &&function);
+
+private:
+	QThreadPool pool_;
+	QMutex mutex_;
+	std::vector<Match> matches_;                               // found by the current search, but not yet taken
+	std::shared_ptr<State> state_ = std::make_shared<State>(); // of the current search
+};
+
+#endif
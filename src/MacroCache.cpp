@@ -0,0 +1,157 @@
+
+#include "MacroCache.h"
+#include "Settings.h"
+#include "Util/version.h"
+#include "interpret.h"
+#include "parse.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace {
+
+constexpr quint32 CacheMagic   = 0x4e4d4343; // "NMCC"
+constexpr quint32 CacheVersion = 1;
+constexpr int MaxCacheFiles    = 256; // beyond this, the least recently written cache files are removed
+
+/**
+ * @brief cacheFileName
+ * @param source
+ * @return the name of the file which caches the programs of "source". It
+ * changes whenever the source or the version of NEdit-ng does, so that stale
+ * programs are never found
+ */
+QString cacheFileName(const QString &source) {
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	hash.addData(QByteArray::number(NEDIT_VERSION));
+#ifdef NEDIT_COMMIT_GIT
+	hash.addData(QByteArray(NEDIT_COMMIT_GIT));
+#endif
+	hash.addData(source.toUtf8());
+	return QString::fromLatin1(hash.result().toHex());
+}
+
+/**
+ * @brief removeOldFiles
+ * @param directory
+ */
+void removeOldFiles(const QString &directory) {
+	const QFileInfoList files = QDir(directory).entryInfoList(QDir::Files, QDir::Time);
+	for (int i = MaxCacheFiles; i < files.size(); ++i) {
+		QFile::remove(files[i].filePath());
+	}
+}
+
+}
+
+/**
+ * @brief MacroCache::MacroCache
+ * @param source
+ */
+MacroCache::MacroCache(const QString &source)
+	: source_(source) {
+
+	path_ = QStringLiteral("%1/%2").arg(Settings::macroCacheDirectory(), cacheFileName(source));
+
+	QFile file(path_);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return;
+	}
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_5);
+
+	quint32 magic;
+	quint32 version;
+	quint32 count;
+	stream >> magic >> version >> count;
+	if (stream.status() != QDataStream::Ok || magic != CacheMagic || version != CacheVersion) {
+		return;
+	}
+
+	std::map<int, Entry> entries;
+	for (quint32 i = 0; i < count; ++i) {
+		qint32 offset;
+		qint32 length;
+		QByteArray program;
+		stream >> offset >> length >> program;
+		if (stream.status() != QDataStream::Ok) {
+			return;
+		}
+
+		entries[offset] = Entry{length, program.toStdString()};
+	}
+
+	entries_ = std::move(entries);
+}
+
+/**
+ * @brief MacroCache::compile
+ * @param offset
+ * @param msg
+ * @param stoppedAt
+ * @return the program compiled from the source starting at "offset", as
+ * compileMacro would return it. It comes from the cache if it's there, and
+ * parsing the source again would give the same program
+ */
+Program *MacroCache::compile(int offset, QString *msg, int *stoppedAt) {
+
+	auto it = entries_.find(offset);
+	if (it != entries_.end()) {
+		if (Program *prog = DeserializeProgram(it->second.program)) {
+			*stoppedAt = it->second.length;
+			return prog;
+		}
+	}
+
+	Program *prog = compileMacro(source_.mid(offset), msg, stoppedAt);
+	if (prog) {
+		std::string program = SerializeProgram(prog);
+		if (!program.empty()) {
+			entries_[offset] = Entry{*stoppedAt, std::move(program)};
+			modified_        = true;
+		}
+	}
+
+	return prog;
+}
+
+/**
+ * @brief MacroCache::save
+ *
+ * Write any programs which weren't in the cache to it. Failing to is
+ * harmless, the source will just be parsed again next time.
+ */
+void MacroCache::save() {
+
+	if (!modified_) {
+		return;
+	}
+
+	const QString directory = Settings::macroCacheDirectory();
+	if (!QDir().mkpath(directory)) {
+		return;
+	}
+
+	QSaveFile file(path_);
+	if (!file.open(QIODevice::WriteOnly)) {
+		return;
+	}
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_5);
+
+	stream << CacheMagic << CacheVersion << static_cast<quint32>(entries_.size());
+	for (const auto &entry : entries_) {
+		stream << static_cast<qint32>(entry.first) << static_cast<qint32>(entry.second.length) << QByteArray::fromStdString(entry.second.program);
+	}
+
+	if (stream.status() == QDataStream::Ok && file.commit()) {
+		modified_ = false;
+		removeOldFiles(directory);
+	}
+}
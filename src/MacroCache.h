@@ -0,0 +1,41 @@
+
+#ifndef MACRO_CACHE_H_
+#define MACRO_CACHE_H_
+
+#include <QString>
+
+#include <map>
+#include <string>
+
+struct Program;
+
+/*
+** The compiled programs of a macro string, kept on disk from one session to
+** the next, so that the string doesn't need to be parsed again as long as
+** neither it nor NEdit-ng has changed since it was last compiled.
+*/
+class MacroCache {
+public:
+	explicit MacroCache(const QString &source);
+	MacroCache(const MacroCache &) = delete;
+	MacroCache &operator=(const MacroCache &) = delete;
+	~MacroCache() = default;
+
+public:
+	Program *compile(int offset, QString *msg, int *stoppedAt);
+	void save();
+
+private:
+	struct Entry {
+		int length;          // how much of the source the program was compiled from
+		std::string program; // the program, as serialized by SerializeProgram
+	};
+
+private:
+	QString source_;
+	QString path_;
+	std::map<int, Entry> entries_; // by the position in the source each program starts at
+	bool modified_ = false;
+};
+
+#endif
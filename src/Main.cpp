@@ -28,7 +28,7 @@ constexpr const char cmdLineHelp[] =
 	"                [-lm languagemode] [-rows n] [-columns n] [-font font]\n"
 	"                [-geometry geometry] [-iconic] [-noiconic] [-svrname name]\n"
 	"                [-import file] [-tabbed] [-untabbed] [-group] [-V|-version]\n"
-	"                [-h|-help] [--] [file...]\n";
+	"                [-macroprofile] [-h|-help] [--] [file...]\n";
 
 /**
  * @brief nextArg
@@ -55,6 +55,11 @@ int nextArg(const QStringList &args, int argIndex) {
  * @brief Main::~Main
  */
 Main::~Main() {
+
+	if (profileMacros_) {
+		fputs(MacroProfileReport().c_str(), stderr);
+	}
+
 	CleanupMacroGlobals();
 }
 
@@ -94,6 +99,9 @@ Main::Main(const QStringList &args) {
 	   and set the appropriate preferences */
 	Preferences::RestoreNEditPrefs();
 
+	// Let macros run for as long as the user prefers before preempting them
+	SetMacroTimeSlice(Preferences::GetPrefMacroTimeSlice());
+
 	// Install word delimiters for regular expression matching
 	Regex::SetDefaultWordDelimiters(Preferences::GetPrefDelimiters().toStdString());
 
@@ -115,6 +123,10 @@ Main::Main(const QStringList &args) {
 		if (arg == QLatin1String("-import")) {
 			i = nextArg(args, i);
 			Preferences::ImportPrefFile(args[i]);
+		} else if (arg == QLatin1String("-macroprofile")) {
+			// profile every macro from the start, including any run by -do
+			profileMacros_ = true;
+			SetMacroProfiling(true);
 		}
 	}
 
@@ -248,6 +260,8 @@ Main::Main(const QStringList &args) {
 			langMode = args[i];
 		} else if (opts && args[i] == QLatin1String("-import")) {
 			i = nextArg(args, i); // already processed, skip
+		} else if (opts && args[i] == QLatin1String("-macroprofile")) {
+			// already processed, skip
 		} else if (opts && (args[i] == QLatin1String("-V") || args[i] == QLatin1String("-version"))) {
 			QString infoString = DialogAbout::createInfoString();
 			printf("%s", qPrintable(infoString));
@@ -21,6 +21,7 @@ private:
 
 private:
 	std::unique_ptr<NeditServer> server_;
+	bool profileMacros_ = false;
 };
 
 #endif
@@ -7,6 +7,7 @@
 #include "DialogExecuteCommand.h"
 #include "DialogFilter.h"
 #include "DialogFind.h"
+#include "DialogFindInFiles.h"
 #include "DialogFonts.h"
 #include "DialogLanguageModes.h"
 #include "DialogMacros.h"
@@ -342,6 +343,7 @@ void MainWindow::connectSlots() {
 	connect(ui.action_Replace, &QAction::triggered, this, &MainWindow::action_Replace_triggered);
 	connect(ui.action_Replace_Find_Again, &QAction::triggered, this, &MainWindow::action_Replace_Find_Again_triggered);
 	connect(ui.action_Replace_Again, &QAction::triggered, this, &MainWindow::action_Replace_Again_triggered);
+	connect(ui.action_Find_In_Files, &QAction::triggered, this, &MainWindow::action_Find_In_Files_triggered);
 	connect(ui.action_Mark, &QAction::triggered, this, &MainWindow::action_Mark_triggered);
 	connect(ui.action_Goto_Mark, &QAction::triggered, this, &MainWindow::action_Goto_Mark_triggered);
 	connect(ui.action_Goto_Matching, &QAction::triggered, this, &MainWindow::action_Goto_Matching_triggered);
@@ -396,6 +398,7 @@ void MainWindow::connectSlots() {
 	connect(ui.action_Default_Search_Verbose, &QAction::toggled, this, &MainWindow::action_Default_Search_Verbose_toggled);
 	connect(ui.action_Default_Search_Wrap_Around, &QAction::toggled, this, &MainWindow::action_Default_Search_Wrap_Around_toggled);
 	connect(ui.action_Default_Search_Beep_On_Search_Wrap, &QAction::toggled, this, &MainWindow::action_Default_Search_Beep_On_Search_Wrap_toggled);
+	connect(ui.action_Default_Search_Highlight_All_Matches, &QAction::toggled, this, &MainWindow::action_Default_Search_Highlight_All_Matches_toggled);
 	connect(ui.action_Default_Search_Keep_Dialogs_Up, &QAction::toggled, this, &MainWindow::action_Default_Search_Keep_Dialogs_Up_toggled);
 	connect(ui.action_Default_Apply_Backlighting, &QAction::toggled, this, &MainWindow::action_Default_Apply_Backlighting_toggled);
 	connect(ui.action_Default_Tab_Open_File_In_New_Tab, &QAction::toggled, this, &MainWindow::action_Default_Tab_Open_File_In_New_Tab_toggled);
@@ -542,6 +545,7 @@ void MainWindow::setupGlobalPreferenceDefaults() {
 	no_signals(ui.action_Default_Search_Verbose)->setChecked(Preferences::GetPrefSearchDialogs());
 	no_signals(ui.action_Default_Search_Wrap_Around)->setChecked(Preferences::GetPrefSearchWraps() == WrapMode::Wrap);
 	no_signals(ui.action_Default_Search_Beep_On_Search_Wrap)->setChecked(Preferences::GetPrefBeepOnSearchWrap());
+	no_signals(ui.action_Default_Search_Highlight_All_Matches)->setChecked(Preferences::GetPrefHighlightAllMatches());
 	no_signals(ui.action_Default_Search_Keep_Dialogs_Up)->setChecked(Preferences::GetPrefKeepSearchDlogs());
 
 	switch (Preferences::GetPrefSearch()) {
@@ -2892,6 +2896,8 @@ void MainWindow::action_Find_Incremental(DocumentWidget *document, const QString
 								   searchType,
 								   searchWraps,
 								   isContinue);
+
+		document->highlightMatches(area, searchString, searchType);
 	}
 }
 
@@ -3186,6 +3192,26 @@ void MainWindow::action_Replace_Again_triggered() {
 	}
 }
 
+/**
+ * @brief MainWindow::action_Find_In_Files_triggered
+ */
+void MainWindow::action_Find_In_Files_triggered() {
+
+	if (!dialogFindInFiles_) {
+		dialogFindInFiles_ = new DialogFindInFiles(this);
+		dialogFindInFiles_->initToggleButtons(Preferences::GetPrefSearch());
+	}
+
+	// search the directory of the current document, unless another one was chosen
+	if (DocumentWidget *document = currentDocument()) {
+		dialogFindInFiles_->setDirectory(document->path().isEmpty() ? QDir::currentPath() : document->path());
+	}
+
+	dialogFindInFiles_->show();
+	dialogFindInFiles_->raise();
+	dialogFindInFiles_->activateWindow();
+}
+
 /**
  * @brief MainWindow::action_Shift_Replace_Again_triggered
  */
@@ -4263,6 +4289,26 @@ void MainWindow::action_Default_Search_Beep_On_Search_Wrap_toggled(bool state) {
 	}
 }
 
+/**
+ * @brief MainWindow::action_Default_Search_Highlight_All_Matches_toggled
+ * @param state
+ */
+void MainWindow::action_Default_Search_Highlight_All_Matches_toggled(bool state) {
+
+	// Set the preference and make the other windows' menus agree
+	Preferences::SetPrefHighlightAllMatches(state);
+	for (MainWindow *window : MainWindow::allWindows()) {
+		no_signals(window->ui.action_Default_Search_Highlight_All_Matches)->setChecked(state);
+	}
+
+	// matches are highlighted from the next search on, but stop being so right away
+	if (!state) {
+		for (DocumentWidget *document : DocumentWidget::allDocuments()) {
+			document->clearMatchHighlights();
+		}
+	}
+}
+
 /**
  * @brief MainWindow::action_Default_Search_Keep_Dialogs_Up_toggled
  * @param state
@@ -5598,8 +5644,12 @@ bool MainWindow::eventFilter(QObject *object, QEvent *ev) {
 
 		int index = iSearchHistIndex_;
 
-		// allow escape key to cancel search
+		// allow escape key to cancel search, and stop highlighting its matches
 		if (event->key() == Qt::Key_Escape) {
+			if (DocumentWidget *document = currentDocument()) {
+				document->clearMatchHighlights();
+			}
+
 			endISearch();
 			return true;
 		}
@@ -5697,6 +5747,8 @@ void MainWindow::action_Find(DocumentWidget *document, const QString &string, Di
 			direction,
 			type,
 			searchWrap);
+
+		document->highlightMatches(area, string, type);
 	}
 }
 
@@ -7125,9 +7177,6 @@ bool MainWindow::prefOrUserCancelsSubst(DocumentWidget *document) {
 */
 bool MainWindow::replaceAll(DocumentWidget *document, TextArea *area, const QString &searchString, const QString &replaceString, SearchType searchType) {
 
-	int64_t copyStart;
-	int64_t copyEnd;
-
 	// reject empty string
 	if (searchString.isEmpty()) {
 		return false;
@@ -7143,20 +7192,15 @@ bool MainWindow::replaceAll(DocumentWidget *document, TextArea *area, const QStr
 
 	QString delimiters = document->getWindowDelimiters();
 
-	boost::optional<std::string> newFileString = Search::ReplaceAllInString(
+	const std::vector<Search::Replacement> replacements = Search::ReplacementsInString(
 		fileString,
 		searchString,
 		replaceString,
 		searchType,
-		&copyStart,
-		&copyEnd,
 		delimiters);
 
-	if (!newFileString) {
-		if (document->multiFileBusy_) {
-			// only needed during multi-file replacements
-			document->replaceFailed_ = true;
-		} else if (Preferences::GetPrefSearchDialogs()) {
+	if (replacements.empty()) {
+		if (Preferences::GetPrefSearchDialogs()) {
 
 			if (dialogFind_) {
 				if (!dialogFind_->keepDialog()) {
@@ -7178,12 +7222,32 @@ bool MainWindow::replaceAll(DocumentWidget *document, TextArea *area, const QStr
 		return false;
 	}
 
-	// replace the contents of the text widget with the substituted text
-	buffer->BufReplace(TextCursor(copyStart), TextCursor(copyEnd), *newFileString);
+	replaceRanges(document, area, replacements);
+	return true;
+}
+
+/*
+** Replace the text of each of "replacements", found by Search::ReplacementsInString,
+** in "document", as a single undoable edit, and move the cursor of "area" to
+** the end of the last of them.
+*/
+void MainWindow::replaceRanges(DocumentWidget *document, TextArea *area, const std::vector<Search::Replacement> &replacements) {
+
+	TextBuffer *buffer = document->buffer();
+
+	/* replace just the text which matched, so that only it is saved for undo,
+	   and seen as changed by the display, highlighting and range sets */
+	std::vector<TextBuffer::Edit> edits;
+	edits.reserve(replacements.size());
+
+	for (const Search::Replacement &replacement : replacements) {
+		edits.push_back(TextBuffer::Edit{TextRange{TextCursor(replacement.start), TextCursor(replacement.end)}, replacement.text});
+	}
+
+	buffer->BufReplaceRanges(edits);
 
 	// Move the cursor to the end of the last replacement
-	area->TextSetCursorPos(TextCursor(copyStart + static_cast<int64_t>(newFileString->size())));
-	return true;
+	area->TextSetCursorPos(buffer->BufCursorPosHint());
 }
 
 /*
@@ -7482,6 +7546,12 @@ void MainWindow::updateStatus(DocumentWidget *document, TextArea *area) {
 		slinecol = tr("L: ---  C: ---");
 	}
 
+	// show how much memory undoing changes to the document takes, once it's noticeable
+	const int64_t undoMemory = document->undoMemory();
+	if (undoMemory >= 1024) {
+		string += tr(", undo %1 KB").arg(undoMemory / 1024);
+	}
+
 	// Update the line/column number
 	document->ui.labelStats->setText(slinecol);
 
@@ -27,6 +27,7 @@
 
 class DialogColors;
 class DialogFind;
+class DialogFindInFiles;
 class DialogMacros;
 class DialogReplace;
 class DialogShellMenu;
@@ -105,6 +106,7 @@ public:
 	void openFile(DocumentWidget *document, const QString &text);
 	void parseGeometry(QString geometry);
 	void replaceInSelection(DocumentWidget *document, TextArea *area, const QString &searchString, const QString &replaceString, SearchType searchType);
+	void replaceRanges(DocumentWidget *document, TextArea *area, const std::vector<Search::Replacement> &replacements);
 	void searchForSelected(DocumentWidget *document, TextArea *area, Direction direction, SearchType searchType, WrapMode searchWrap);
 	void setIncrementalSearchLine(bool value);
 	void setShowLineNumbers(bool show);
@@ -341,6 +343,7 @@ public:
 	void action_Replace_triggered();
 	void action_Replace_Find_Again_triggered();
 	void action_Replace_Again_triggered();
+	void action_Find_In_Files_triggered();
 	void action_Mark_triggered();
 	void action_Goto_Mark_triggered();
 	void action_Goto_Matching_triggered();
@@ -388,6 +391,7 @@ public:
 	void action_Default_Search_Verbose_toggled(bool state);
 	void action_Default_Search_Wrap_Around_toggled(bool state);
 	void action_Default_Search_Beep_On_Search_Wrap_toggled(bool state);
+	void action_Default_Search_Highlight_All_Matches_toggled(bool state);
 	void action_Default_Search_Keep_Dialogs_Up_toggled(bool state);
 	void action_Default_Syntax_Recognition_Patterns_triggered();
 	void action_Default_Syntax_Text_Drawing_Styles_triggered();
@@ -444,6 +448,7 @@ public:
 private:
 	QList<QAction *> previousOpenFilesList_;
 	QPointer<DialogFind> dialogFind_;
+	QPointer<DialogFindInFiles> dialogFindInFiles_;
 	QPointer<DialogReplace> dialogReplace_;
 	QPointer<DialogShellMenu> dialogShellMenu_;
 	QPointer<DialogMacros> dialogMacros_;
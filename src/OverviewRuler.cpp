@@ -0,0 +1,265 @@
+
+#include "OverviewRuler.h"
+#include "DocumentSummary.h"
+#include "DocumentWidget.h"
+#include "Highlight.h"
+#include "RangesetTable.h"
+#include "SearchMatches.h"
+#include "TextArea.h"
+#include "TextBuffer.h"
+#include <QMouseEvent>
+#include <QPaintEvent>
+#include <QPainter>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// a row of the ruler is drawn at full width for text which averages this many non-blank characters per line
+constexpr double FullWidthColumns = 60.0;
+
+// width of the marks drawn for range sets, along the right edge of the ruler
+constexpr int RangesetMarkWidth = 3;
+
+}
+
+/**
+ * @brief OverviewRuler::OverviewRuler
+ * @param area
+ * @param summary
+ */
+OverviewRuler::OverviewRuler(TextArea *area, DocumentSummary *summary)
+	: QWidget(area), area_(area), summary_(summary) {
+	resize(0, 0);
+}
+
+/**
+ * @brief OverviewRuler::sizeHint
+ * @return
+ */
+QSize OverviewRuler::sizeHint() const {
+	return QSize(Width, 0);
+}
+
+/**
+ * @brief OverviewRuler::updateBlockStarts
+ */
+void OverviewRuler::updateBlockStarts() {
+
+	const std::vector<DocumentSummary::Block> &blocks = summary_->blocks();
+
+	blockStarts_.resize(blocks.size());
+	blockLines_.resize(blocks.size());
+
+	TextCursor start = {};
+	int64_t lines    = 0;
+	for (size_t i = 0; i < blocks.size(); ++i) {
+		blockStarts_[i] = start;
+		blockLines_[i]  = lines;
+		start += blocks[i].length;
+		lines += blocks[i].lines;
+	}
+}
+
+/**
+ * @brief OverviewRuler::lineOfPosition
+ * @param pos
+ * @return the (fractional) line number of "pos", counting from 0, estimated
+ * from the summary block which contains it
+ */
+double OverviewRuler::lineOfPosition(TextCursor pos) const {
+
+	if (blockStarts_.empty()) {
+		return 0;
+	}
+
+	const auto it      = std::upper_bound(blockStarts_.begin(), blockStarts_.end(), pos);
+	const size_t index = static_cast<size_t>(std::max<ptrdiff_t>(0, (it - blockStarts_.begin()) - 1));
+
+	const DocumentSummary::Block &block = summary_->blocks()[index];
+	if (block.length == 0) {
+		return static_cast<double>(blockLines_[index]);
+	}
+
+	const double fraction = std::min(1.0, static_cast<double>(pos - blockStarts_[index]) / static_cast<double>(block.length));
+	return static_cast<double>(blockLines_[index]) + fraction * static_cast<double>(block.lines);
+}
+
+/**
+ * @brief OverviewRuler::positionOfLine
+ * @param line
+ * @return an estimate of the position of the (fractional) line number "line",
+ * the inverse of lineOfPosition
+ */
+TextCursor OverviewRuler::positionOfLine(double line) const {
+
+	if (blockLines_.empty()) {
+		return {};
+	}
+
+	const auto it      = std::upper_bound(blockLines_.begin(), blockLines_.end(), static_cast<int64_t>(line));
+	const size_t index = static_cast<size_t>(std::max<ptrdiff_t>(0, (it - blockLines_.begin()) - 1));
+
+	const DocumentSummary::Block &block = summary_->blocks()[index];
+	if (block.lines == 0) {
+		return blockStarts_[index];
+	}
+
+	const double fraction = std::min(1.0, (line - static_cast<double>(blockLines_[index])) / static_cast<double>(block.lines));
+	return blockStarts_[index] + static_cast<int64_t>(fraction * static_cast<double>(block.length));
+}
+
+/**
+ * @brief OverviewRuler::paintEvent
+ * @param event
+ */
+void OverviewRuler::paintEvent(QPaintEvent *event) {
+
+	QPainter painter(this);
+	painter.fillRect(event->rect(), area_->lineNumBGColor_);
+
+	const int rows = height();
+	if (rows <= 0) {
+		return;
+	}
+
+	summary_->updateStyles();
+	updateBlockStarts();
+
+	const std::vector<DocumentSummary::Block> &blocks = summary_->blocks();
+	const double scale                                = rows / static_cast<double>(summary_->lineCount() + 1);
+
+	/* Downsample the blocks to one entry per row of pixels, each row taking the
+	   style of the block which contributed most text to it */
+	std::vector<double> rowLines(static_cast<size_t>(rows));
+	std::vector<double> rowNonBlank(static_cast<size_t>(rows));
+	std::vector<double> rowStyleWeight(static_cast<size_t>(rows));
+	std::vector<uint8_t> rowStyle(static_cast<size_t>(rows));
+
+	for (size_t i = 0; i < blocks.size(); ++i) {
+		const DocumentSummary::Block &block = blocks[i];
+
+		const int y0   = std::min(rows - 1, static_cast<int>(blockLines_[i] * scale));
+		const int y1   = std::min(rows - 1, static_cast<int>((blockLines_[i] + block.lines) * scale));
+		const int span = y1 - y0 + 1;
+
+		for (int y = y0; y <= y1; ++y) {
+			const auto row      = static_cast<size_t>(y);
+			const double weight = static_cast<double>(block.nonBlank) / span;
+
+			rowLines[row] += std::max<double>(1, static_cast<double>(block.lines) / span);
+			rowNonBlank[row] += weight;
+
+			if (block.style != 0 && weight > rowStyleWeight[row]) {
+				rowStyleWeight[row] = weight;
+				rowStyle[row]       = block.style;
+			}
+		}
+	}
+
+	const std::vector<StyleTableEntry> &styleTable = area_->styleTable_;
+
+	QColor textColor = area_->getForegroundColor();
+	textColor.setAlpha(128);
+
+	const int textWidth = Width - RangesetMarkWidth - 2;
+	for (int y = 0; y < rows; ++y) {
+		const auto row = static_cast<size_t>(y);
+		if (rowNonBlank[row] == 0) {
+			continue;
+		}
+
+		const double density = std::min(1.0, rowNonBlank[row] / rowLines[row] / FullWidthColumns);
+		const int w          = std::max(1, static_cast<int>(std::lround(density * textWidth)));
+
+		const size_t styleIndex = static_cast<size_t>(rowStyle[row] - ASCII_A);
+		if (rowStyle[row] != 0 && styleIndex < styleTable.size() && styleTable[styleIndex].color.isValid()) {
+			painter.fillRect(1, y, w, 1, styleTable[styleIndex].color);
+		} else {
+			painter.fillRect(1, y, w, 1, textColor);
+		}
+	}
+
+	// Mark the rows holding highlighted search matches, which may be very many
+	if (const std::unique_ptr<SearchMatches> &matches = area_->document_->searchMatches_) {
+		std::vector<bool> rowMatches(static_cast<size_t>(rows));
+		for (const TextRange &range : matches->matches().ranges_) {
+			const int y = std::min(rows - 1, static_cast<int>(lineOfPosition(range.start) * scale));
+			rowMatches[static_cast<size_t>(y)] = true;
+		}
+
+		for (int y = 0; y < rows; ++y) {
+			if (rowMatches[static_cast<size_t>(y)]) {
+				painter.fillRect(Width - RangesetMarkWidth, y, RangesetMarkWidth, 2, area_->matchBGColor_);
+			}
+		}
+	}
+
+	// Mark the ranges of the range sets which have a color
+	if (const std::unique_ptr<RangesetTable> &table = area_->document_->rangesetTable_) {
+		for (size_t i = 0; i < table->sets_.size(); ++i) {
+			const QColor color = area_->getRangesetColor(i + 1, QColor());
+			if (!color.isValid()) {
+				continue;
+			}
+
+			for (const TextRange &range : table->sets_[i].ranges_) {
+				const int y0 = static_cast<int>(lineOfPosition(range.start) * scale);
+				const int y1 = static_cast<int>(lineOfPosition(range.end) * scale);
+				painter.fillRect(Width - RangesetMarkWidth, y0, RangesetMarkWidth, std::max(2, y1 - y0), color);
+			}
+		}
+	}
+
+	// Show the displayed part of the document
+	QColor viewColor = area_->getForegroundColor();
+	viewColor.setAlpha(40);
+
+	const int top    = static_cast<int>(lineOfPosition(area_->firstChar_) * scale);
+	const int bottom = static_cast<int>(lineOfPosition(area_->lastChar_) * scale);
+	painter.fillRect(0, top, Width, std::max(2, bottom - top), viewColor);
+
+	const int cursor = static_cast<int>(lineOfPosition(area_->cursorPos_) * scale);
+	painter.fillRect(0, cursor, Width, 2, area_->cursorFGColor_);
+}
+
+/**
+ * @brief OverviewRuler::moveToRow
+ * @param y
+ */
+void OverviewRuler::moveToRow(int y) {
+
+	const int rows = height();
+	if (rows <= 0) {
+		return;
+	}
+
+	updateBlockStarts();
+
+	const double line    = qBound(0, y, rows - 1) * static_cast<double>(summary_->lineCount() + 1) / rows;
+	TextBuffer *buffer   = area_->buffer();
+	const TextCursor pos = buffer->BufStartOfLine(qBound(buffer->BufStartOfBuffer(), positionOfLine(line), buffer->BufEndOfBuffer()));
+
+	area_->TextSetCursorPos(pos);
+}
+
+/**
+ * @brief OverviewRuler::mousePressEvent
+ * @param event
+ */
+void OverviewRuler::mousePressEvent(QMouseEvent *event) {
+	if (event->button() == Qt::LeftButton) {
+		moveToRow(event->y());
+	}
+}
+
+/**
+ * @brief OverviewRuler::mouseMoveEvent
+ * @param event
+ */
+void OverviewRuler::mouseMoveEvent(QMouseEvent *event) {
+	if (event->buttons() & Qt::LeftButton) {
+		moveToRow(event->y());
+	}
+}
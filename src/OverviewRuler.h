@@ -0,0 +1,44 @@
+
+#ifndef OVERVIEW_RULER_H_
+#define OVERVIEW_RULER_H_
+
+#include "TextCursor.h"
+
+#include <QWidget>
+
+#include <vector>
+
+class DocumentSummary;
+class TextArea;
+
+class OverviewRuler : public QWidget {
+	Q_OBJECT
+public:
+	static constexpr int Width = 14;
+
+public:
+	OverviewRuler(TextArea *area, DocumentSummary *summary);
+	~OverviewRuler() override = default;
+
+public:
+	QSize sizeHint() const override;
+
+protected:
+	void paintEvent(QPaintEvent *event) override;
+	void mouseMoveEvent(QMouseEvent *event) override;
+	void mousePressEvent(QMouseEvent *event) override;
+
+private:
+	double lineOfPosition(TextCursor pos) const;
+	TextCursor positionOfLine(double line) const;
+	void updateBlockStarts();
+	void moveToRow(int y);
+
+private:
+	TextArea *area_;
+	DocumentSummary *summary_;
+	std::vector<TextCursor> blockStarts_; // first character of each block of the summary
+	std::vector<int64_t> blockLines_;     // newlines before each block of the summary
+};
+
+#endif
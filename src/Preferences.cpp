@@ -589,6 +589,10 @@ bool GetPrefHeavyCursor() {
 	return Settings::heavyCursor;
 }
 
+bool GetPrefShowOverviewRuler() {
+	return Settings::showOverviewRuler;
+}
+
 bool GetPrefAutoWrapPastedText() {
 	return Settings::autoWrapPastedText;
 }
@@ -664,6 +668,17 @@ bool GetPrefBeepOnSearchWrap() {
 	return Settings::beepOnSearchWrap;
 }
 
+void SetPrefHighlightAllMatches(bool state) {
+	if (Settings::highlightAllMatches != state) {
+		PrefsHaveChanged = true;
+	}
+	Settings::highlightAllMatches = state;
+}
+
+bool GetPrefHighlightAllMatches() {
+	return Settings::highlightAllMatches;
+}
+
 void SetPrefKeepSearchDlogs(bool state) {
 	if (Settings::retainSearchDialogs != state) {
 		PrefsHaveChanged = true;
@@ -1044,6 +1059,10 @@ QString GetPrefDelimiters() {
 	return Settings::wordDelimiters;
 }
 
+QString GetPrefFindInFilesIgnore() {
+	return Settings::findInFilesIgnore;
+}
+
 QString GetPrefColorName(ColorTypes index) {
 	return Settings::colors[index];
 }
@@ -1106,6 +1125,18 @@ int GetPrefAutoSaveOpLimit() {
 	return std::max(1, Settings::autoSaveOpLimit);
 }
 
+int GetPrefMacroTimeSlice() {
+	return std::max(1, Settings::macroTimeSlice);
+}
+
+int GetPrefUndoMemoryLimit() {
+	return std::max(1, Settings::undoMemoryLimit);
+}
+
+int GetPrefTotalUndoMemoryLimit() {
+	return std::max(1, Settings::totalUndoMemoryLimit);
+}
+
 bool GetPrefTypingHidesPointer() {
 	return Settings::typingHidesPointer;
 }
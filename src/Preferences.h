@@ -42,6 +42,7 @@ bool GetPrefFocusOnRaise();
 bool GetPrefForceOSConversion();
 bool GetPrefGlobalTabNavigate();
 bool GetPrefHeavyCursor();
+bool GetPrefHighlightAllMatches();
 bool GetPrefHighlightSyntax();
 bool GetPrefHonorSymlinks();
 bool GetPrefISearchLine();
@@ -52,6 +53,7 @@ bool GetPrefOpenInTab();
 bool GetPrefRepositionDialogs();
 bool GetPrefSaveOldVersion();
 bool GetPrefSearchDialogs();
+bool GetPrefShowOverviewRuler();
 bool GetPrefShowPathInWindowsMenu();
 bool GetPrefShowResizeNotification();
 bool GetPrefSmartHome();
@@ -74,6 +76,9 @@ int GetPrefAutoSaveOpLimit();
 int GetPrefCols();
 int GetPrefEmTabDist(size_t langMode);
 int GetPrefInsertTabs(size_t langMode);
+int GetPrefMacroTimeSlice();
+int GetPrefUndoMemoryLimit();
+int GetPrefTotalUndoMemoryLimit();
 int GetPrefMaxPrevOpenFiles();
 int GetPrefRows();
 int GetPrefTabDist(size_t langMode);
@@ -83,6 +88,7 @@ QFont GetPrefDefaultFont();
 QString GetPrefBacklightCharTypes();
 QString GetPrefColorName(ColorTypes index);
 QString GetPrefDelimiters();
+QString GetPrefFindInFilesIgnore();
 QString GetPrefFontName();
 QString GetPrefGeometry();
 QString GetPrefServerName();
@@ -109,6 +115,7 @@ void SetPrefFindReplaceUsesSelection(bool state);
 void SetPrefFocusOnRaise(bool);
 void SetPrefFont(const QString &fontName);
 void SetPrefGlobalTabNavigate(bool state);
+void SetPrefHighlightAllMatches(bool state);
 void SetPrefHighlightSyntax(bool state);
 void SetPrefInsertTabs(bool state);
 void SetPrefISearchLine(bool state);
@@ -1009,8 +1009,9 @@ int64_t Rangeset::RangesetAdd(TextRange r) {
 }
 
 /*
-** Remove the range indicated by the positions start and end. Returns the
-** new number of ranges in the set.
+** Remove the range indicated by the positions start and end. Ranges which
+** overlap either end of it are shortened, and any entirely within it are
+** removed. Returns the new number of ranges in the set.
 */
 int64_t Rangeset::RangesetRemove(TextRange r) {
 
@@ -1022,31 +1023,31 @@ int64_t Rangeset::RangesetRemove(TextRange r) {
 		return static_cast<int64_t>(ranges_.size());
 	}
 
-	if (ranges_.empty()) {
+	// the first range which ends after r starts, and the first which starts at or after r ends
+	auto first = std::upper_bound(ranges_.begin(), ranges_.end(), r.start, [](TextCursor pos, const TextRange &range) {
+		return pos < range.end;
+	});
+
+	auto last = std::lower_bound(first, ranges_.end(), r.end, [](const TextRange &range, TextCursor pos) {
+		return range.start < pos;
+	});
+
+	if (first == last) {
+		// nothing overlaps
 		return static_cast<int64_t>(ranges_.size());
 	}
 
-	auto next = std::lower_bound(ranges_.begin(), ranges_.end(), r);
-	if (next != ranges_.end()) {
-		auto prev = (next != ranges_.begin()) ? std::prev(next) : next;
+	// keep the parts of the overlapping ranges which are outside of r
+	const TextRange head = {first->start, r.start};
+	const TextRange tail = {r.end, std::prev(last)->end};
 
-		if (*next == r) {
-			// exact match
-			ranges_.erase(next);
-		} else if (r.start <= next->end && next->start <= r.end) {
-			// range overlaps with one to its right
-			next->start = r.end;
-		} else if (prev->start <= r.end && r.start <= prev->end) {
-			// range overlaps with the one to its left
-			prev->end = r.start;
-		}
-	} else {
-		auto prev = std::prev(ranges_.end());
+	auto it = ranges_.erase(first, last);
+	if (tail.start < tail.end) {
+		it = ranges_.insert(it, tail);
+	}
 
-		if (prev->start <= r.end && r.start <= prev->end) {
-			// range overlaps with the one to its left (last element)
-			prev->end = r.start;
-		}
+	if (head.start < head.end) {
+		ranges_.insert(it, head);
 	}
 
 	RangesetRefreshRange(buffer_, r.start, r.end);
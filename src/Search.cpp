@@ -13,6 +13,8 @@
 #include "WrapStyle.h"
 #include "userCmds.h"
 
+#include <QElapsedTimer>
+
 #include <gsl/gsl_util>
 
 #include <algorithm>
@@ -449,142 +451,140 @@ bool replaceUsingRegex(view::string_view searchStr, view::string_view replaceStr
 	}
 }
 
+/*
+** Find all occurrences of "searchString" in "inString", in order, and append
+** what each is to be replaced with to the string returned by "replacement"
+** for it. This is done in a single pass, and a regular expression is only
+** compiled once, rather than for each match. If "statistics" isn't null, the
+** number of replacements made and the time taken are stored in it. If
+** "canceled" isn't null, the search stops at the next match once it is set.
+*/
+template <class F>
+void replaceEach(view::string_view inString, const QString &searchString, const QString &replaceString, SearchType searchType, const QString &delimiters, Search::ReplaceStatistics *statistics, const std::atomic<bool> *canceled, F replacement) {
+
+	QElapsedTimer timer;
+	timer.start();
+
+	const QByteArray delimiterString = delimiters.toLatin1();
+	const char *delimiterChars       = delimiters.isNull() ? nullptr : delimiterString.data();
+	const std::string searchText     = searchString.toStdString();
+	const std::string replaceText    = replaceString.toStdString();
+	const auto inLength              = gsl::narrow<int64_t>(inString.size());
+
+	int64_t nFound = 0;
+
+	if (Search::isRegexType(searchType)) {
+		try {
+			Regex compiledRE(searchText, Search::defaultRegexFlags(searchType));
+
+			int64_t beginPos = 0;
+			while (beginPos <= inLength && !(canceled && *canceled) && compiledRE.execute(inString, static_cast<size_t>(beginPos), delimiterChars, false)) {
+				const int64_t start = compiledRE.startp[0] - inString.data();
+				const int64_t end   = compiledRE.endp[0] - inString.data();
+
+				compiledRE.SubstituteRE(replaceText, replacement(start, end));
+				++nFound;
+
+				// start next after match unless match was empty, then endPos+1
+				beginPos = (start == end) ? end + 1 : end;
+				if (end == inLength) {
+					break;
+				}
+			}
+		} catch (const RegexError &e) {
+			Q_UNUSED(e)
+		}
+	} else {
+		int64_t beginPos = 0;
+		while (!(canceled && *canceled)) {
+			boost::optional<Search::Result> result = SearchStringEx(inString, searchText, Direction::Forward, searchType, WrapMode::NoWrap, beginPos, delimiterChars);
+			if (!result) {
+				break;
+			}
+
+			replacement(result->start, result->end).append(replaceText);
+			++nFound;
+
+			// literal matches are never empty
+			beginPos = result->end;
+			if (result->end == inLength) {
+				break;
+			}
+		}
+	}
+
+	if (statistics) {
+		statistics->matches     = nFound;
+		statistics->bytes       = inLength;
+		statistics->nanoseconds = timer.nsecsElapsed();
+	}
+}
+
 }
 
 /*
 ** Replace all occurrences of "searchString" in "inString" with "replaceString"
 ** and return a string covering the range between the start of the
 ** first replacement (returned in "copyStart", and the end of the last
-** replacement (returned in "copyEnd")
+** replacement (returned in "copyEnd"). If "statistics" isn't null, the number
+** of replacements made and the time taken are stored in it.
 */
-boost::optional<std::string> Search::ReplaceAllInString(view::string_view inString, const QString &searchString, const QString &replaceString, SearchType searchType, int64_t *copyStart, int64_t *copyEnd, const QString &delimiters) {
-
-	Result searchResult;
-	int64_t lastEndPos;
+boost::optional<std::string> Search::ReplaceAllInString(view::string_view inString, const QString &searchString, const QString &replaceString, SearchType searchType, int64_t *copyStart, int64_t *copyEnd, const QString &delimiters, ReplaceStatistics *statistics) {
 
 	// reject empty string
 	if (searchString.isNull()) {
 		return boost::none;
 	}
 
-	/* rehearse the search first to determine the size of the buffer needed
-	   to hold the substituted text.  No substitution done here yet */
-	bool found        = true;
-	int replaceLen    = replaceString.size();
-	int nFound        = 0;
-	int64_t removeLen = 0;
-	int64_t addLen    = 0;
-	int64_t beginPos  = 0;
-
-	*copyStart = -1;
-
-	while (found) {
-		found = SearchString(
-			inString,
-			searchString,
-			Direction::Forward,
-			searchType,
-			WrapMode::NoWrap,
-			beginPos,
-			&searchResult,
-			delimiters);
-
-		if (found) {
-			if (*copyStart < 0) {
-				*copyStart = searchResult.start;
-			}
+	std::string outString;
+	int64_t lastEndPos = -1;
 
-			*copyEnd = searchResult.end;
-			// start next after match unless match was empty, then endPos+1
-			beginPos = (searchResult.start == searchResult.end) ? searchResult.end + 1 : searchResult.end;
-			++nFound;
-			removeLen += searchResult.end - searchResult.start;
-			if (isRegexType(searchType)) {
-				std::string replaceResult;
-
-				replaceUsingRE(
-					searchString,
-					replaceString,
-					inString.substr(static_cast<size_t>(searchResult.extentBW)),
-					searchResult.start - searchResult.extentBW,
-					replaceResult,
-					searchResult.start == 0 ? -1 : inString[static_cast<size_t>(searchResult.start) - 1],
-					delimiters,
-					defaultRegexFlags(searchType));
-
-				addLen += gsl::narrow<int64_t>(replaceResult.size());
-			} else {
-				addLen += replaceLen;
-			}
+	replaceEach(inString, searchString, replaceString, searchType, delimiters, statistics, nullptr, [&](int64_t start, int64_t end) -> std::string & {
+		if (lastEndPos < 0) {
+			*copyStart = start;
 
-			if (searchResult.end == gsl::narrow<int64_t>(inString.size())) {
-				break;
-			}
+			// replacements are usually about the size of what they replace
+			outString.reserve(inString.size() - static_cast<size_t>(start));
+		} else {
+			// copy the text between the previous match and this one
+			outString.append(inString.data() + lastEndPos, static_cast<size_t>(start - lastEndPos));
 		}
-	}
 
-	if (nFound == 0) {
+		lastEndPos = end;
+		return outString;
+	});
+
+	if (lastEndPos < 0) {
 		return boost::none;
 	}
 
-	const int64_t copyLen = *copyEnd - *copyStart;
-
-	std::string outString;
-	outString.reserve(static_cast<size_t>(copyLen - removeLen + addLen));
-
-	/* Scan through the text buffer again, substituting the replace string
-	   and copying the part between replaced text to the new buffer  */
-	found      = true;
-	beginPos   = {};
-	lastEndPos = {};
-
-	while (found) {
-		found = SearchString(
-			inString,
-			searchString,
-			Direction::Forward,
-			searchType,
-			WrapMode::NoWrap,
-			beginPos,
-			&searchResult,
-			delimiters);
-
-		if (found) {
-			if (beginPos != 0) {
-				outString.append(
-					&inString[static_cast<size_t>(lastEndPos)],
-					&inString[static_cast<size_t>(lastEndPos + (searchResult.start - lastEndPos))]);
-			}
+	*copyEnd = lastEndPos;
+	return outString;
+}
 
-			if (isRegexType(searchType)) {
-				std::string replaceResult;
-
-				replaceUsingRE(
-					searchString,
-					replaceString,
-					inString.substr(static_cast<size_t>(searchResult.extentBW)),
-					searchResult.start - searchResult.extentBW,
-					replaceResult,
-					searchResult.start == 0 ? -1 : inString[static_cast<size_t>(searchResult.start) - 1],
-					delimiters,
-					defaultRegexFlags(searchType));
-
-				outString.append(replaceResult);
-			} else {
-				outString.append(replaceString.toStdString());
-			}
+/*
+** Find all occurrences of "searchString" in "inString", and return where each
+** one is, in order, along with the text to replace it with. Unlike
+** ReplaceAllInString, the text between them isn't copied, so that they can be
+** replaced without the rest of the text being touched. If "canceled" is set
+** while the text is being searched, the search stops, with only some of the
+** replacements found.
+*/
+std::vector<Search::Replacement> Search::ReplacementsInString(view::string_view inString, const QString &searchString, const QString &replaceString, SearchType searchType, const QString &delimiters, ReplaceStatistics *statistics, const std::atomic<bool> *canceled) {
 
-			lastEndPos = searchResult.end;
+	std::vector<Replacement> replacements;
 
-			// start next after match unless match was empty, then endPos+1
-			beginPos = (searchResult.start == searchResult.end) ? searchResult.end + 1 : searchResult.end;
-			if (searchResult.end == gsl::narrow<int64_t>(inString.size())) {
-				break;
-			}
-		}
+	// reject empty string
+	if (searchString.isNull()) {
+		return replacements;
 	}
 
-	return outString;
+	replaceEach(inString, searchString, replaceString, searchType, delimiters, statistics, canceled, [&replacements](int64_t start, int64_t end) -> std::string & {
+		replacements.push_back(Replacement{start, end, std::string()});
+		return replacements.back().text;
+	});
+
+	return replacements;
 }
 
 /**
@@ -626,6 +626,62 @@ bool Search::SearchString(view::string_view string, const QString &searchString,
 	return false;
 }
 
+/*
+** Find all of the occurrences of "searchString" in "string" between "beginPos"
+** and "endPos", in order, without them overlapping. This is done in a single
+** pass, and a regular expression is only compiled once, rather than for each
+** match. Text outside of the range is still seen by the search, so that
+** anchors and look-arounds work as they do for a single search. Throws
+** RegexError if "searchString" is not a valid regular expression, so that
+** callers can report it rather than find nothing.
+*/
+std::vector<Search::Result> Search::SearchAll(view::string_view string, const QString &searchString, SearchType searchType, int64_t beginPos, int64_t endPos, const QString &delimiters) {
+
+	std::vector<Result> results;
+
+	if (searchString.isEmpty()) {
+		return results;
+	}
+
+	beginPos = qBound<int64_t>(0, beginPos, gsl::narrow<int64_t>(string.size()));
+	endPos   = qBound<int64_t>(beginPos, endPos, gsl::narrow<int64_t>(string.size()));
+
+	const QByteArray delimiterString = delimiters.toLatin1();
+	const char *delimiterChars       = delimiters.isNull() ? nullptr : delimiterString.data();
+	const std::string searchText     = searchString.toStdString();
+
+	if (isRegexType(searchType)) {
+		Regex compiledRE(searchText, defaultRegexFlags(searchType));
+
+		while (beginPos <= endPos && compiledRE.execute(string, static_cast<size_t>(beginPos), static_cast<size_t>(endPos), delimiterChars, false)) {
+			Result result;
+			result.start    = compiledRE.startp[0] - string.data();
+			result.end      = compiledRE.endp[0] - string.data();
+			result.extentFW = compiledRE.extentpFW - string.data();
+			result.extentBW = compiledRE.extentpBW - string.data();
+			results.push_back(result);
+
+			// start next after match unless match was empty, then endPos+1
+			beginPos = (result.start == result.end) ? result.end + 1 : result.end;
+		}
+
+		return results;
+	}
+
+	// literal matches are never empty, and are always as long as the search string
+	while (beginPos < endPos) {
+		boost::optional<Result> result = SearchStringEx(string, searchText, Direction::Forward, searchType, WrapMode::NoWrap, beginPos, delimiterChars);
+		if (!result || result->end > endPos) {
+			break;
+		}
+
+		results.push_back(*result);
+		beginPos = result->end;
+	}
+
+	return results;
+}
+
 bool Search::replaceUsingRE(const QString &searchStr, const QString &replaceStr, view::string_view sourceStr, int64_t beginPos, std::string &dest, int prevChar, const QString &delimiters, int defaultFlags) {
 	return replaceUsingRegex(
 		searchStr.toStdString(),
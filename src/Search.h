@@ -10,6 +10,10 @@
 #include <QString>
 #include <boost/optional.hpp>
 
+#include <atomic>
+#include <string>
+#include <vector>
+
 class DocumentWidget;
 class MainWindow;
 class TextArea;
@@ -30,13 +34,27 @@ struct Result {
 	int64_t extentFW = 0;
 };
 
+struct Replacement {
+	int64_t start;
+	int64_t end;
+	std::string text;
+};
+
+struct ReplaceStatistics {
+	int64_t matches     = 0; // the number of replacements made
+	int64_t bytes       = 0; // the size of the text which was searched
+	int64_t nanoseconds = 0; // how long it took
+};
+
 bool isRegexType(SearchType searchType);
 bool replaceUsingRE(const QString &searchStr, const QString &replaceStr, view::string_view sourceStr, int64_t beginPos, std::string &dest, int prevChar, const QString &delimiters, int defaultFlags);
 bool SearchString(view::string_view string, const QString &searchString, Direction direction, SearchType searchType, WrapMode wrap, int64_t beginPos, Result *result, const QString &delimiters);
 boost::optional<Result> SearchString(view::string_view string, const QString &searchString, Direction direction, SearchType searchType, WrapMode wrap, int64_t beginPos, const QString &delimiters);
+std::vector<Result> SearchAll(view::string_view string, const QString &searchString, SearchType searchType, int64_t beginPos, int64_t endPos, const QString &delimiters);
 int defaultRegexFlags(SearchType searchType);
 int historyIndex(int nCycles);
-boost::optional<std::string> ReplaceAllInString(view::string_view inString, const QString &searchString, const QString &replaceString, SearchType searchType, int64_t *copyStart, int64_t *copyEnd, const QString &delimiters);
+boost::optional<std::string> ReplaceAllInString(view::string_view inString, const QString &searchString, const QString &replaceString, SearchType searchType, int64_t *copyStart, int64_t *copyEnd, const QString &delimiters, ReplaceStatistics *statistics = nullptr);
+std::vector<Replacement> ReplacementsInString(view::string_view inString, const QString &searchString, const QString &replaceString, SearchType searchType, const QString &delimiters, ReplaceStatistics *statistics = nullptr, const std::atomic<bool> *canceled = nullptr);
 void saveSearchHistory(const QString &searchString, QString replaceString, SearchType searchType, bool isIncremental);
 HistoryEntry *HistoryByIndex(int index);
 
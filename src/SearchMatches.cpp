@@ -0,0 +1,379 @@
+
+#include "SearchMatches.h"
+#include "RegexError.h"
+#include "Search.h"
+#include "TextBuffer.h"
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+
+namespace {
+
+// how much text is searched at a time, it's extended to the end of a line
+constexpr int64_t ChunkSize = 65536;
+
+// how long (msec) a slice of the search may take before events are processed
+constexpr qint64 SliceTime = 10;
+
+void matchesBufModifiedCB(TextCursor pos, int64_t nInserted, int64_t nDeleted, int64_t nRestyled, view::string_view deletedText, void *user) {
+	Q_UNUSED(nRestyled)
+	Q_UNUSED(deletedText)
+
+	// restyling-only modifications don't change the matches
+	if (nInserted == 0 && nDeleted == 0) {
+		return;
+	}
+
+	if (auto *matches = static_cast<SearchMatches *>(user)) {
+		matches->bufModifiedCallback(pos, nInserted, nDeleted);
+	}
+}
+
+}
+
+/**
+ * @brief SearchMatches::SearchMatches
+ * @param buffer
+ * @param searchedCB
+ * @param user
+ */
+SearchMatches::SearchMatches(TextBuffer *buffer, SearchedCallback searchedCB, void *user)
+	: buffer_(buffer), searchedCB_(searchedCB), user_(user), matches_(nullptr, 0) {
+
+	/* The matches are redrawn a chunk at a time once they're found, rather
+	   than by the range set for each one. Inserting text next to a match
+	   doesn't extend it, the modified lines are searched again instead */
+	matches_.setMode(QLatin1String("exclude"));
+
+	timer_.setSingleShot(true);
+	timer_.setInterval(0);
+	QObject::connect(&timer_, &QTimer::timeout, [this]() {
+		searchSlice();
+	});
+
+	/* The matches must be moved before the text display callbacks are called,
+	   as they are for range sets */
+	buffer->BufAddHighPriorityModifyCB(matchesBufModifiedCB, this);
+}
+
+/**
+ * @brief SearchMatches::~SearchMatches
+ */
+SearchMatches::~SearchMatches() {
+	buffer_->BufRemoveModifyCB(matchesBufModifiedCB, this);
+
+	if (boost::optional<TextRange> span = matches_.RangesetSpan()) {
+		buffer_->BufCheckDisplay(span->start, span->end);
+	}
+}
+
+/**
+ * @brief SearchMatches::contains
+ * @param pos
+ * @return true if "pos" is in one of the matches
+ */
+bool SearchMatches::contains(TextCursor pos) {
+	return matches_.RangesetCheckRangeOfPos(pos) >= 0;
+}
+
+/**
+ * @brief SearchMatches::matches
+ * @return
+ */
+const Rangeset &SearchMatches::matches() const noexcept {
+	return matches_;
+}
+
+/**
+ * Search for "searchString" from the start of the line containing "from",
+ * usually the top of the display, to the end of the text and then from the
+ * start of the text back to "from". The first slice of the search is done
+ * right away, so that the matches which are displayed show up without delay.
+ * Nothing is done if the search is the one whose matches are already held.
+ *
+ * @brief SearchMatches::setSearch
+ * @param searchString
+ * @param searchType
+ * @param delimiters
+ * @param from
+ */
+void SearchMatches::setSearch(const QString &searchString, SearchType searchType, const QString &delimiters, TextCursor from) {
+
+	if (searchString == searchString_ && searchType == searchType_ && delimiters == delimiters_) {
+		return;
+	}
+
+	searchString_ = searchString;
+	searchType_   = searchType;
+	delimiters_   = delimiters;
+	spanLines_    = searchString.count(QLatin1Char('\n'));
+
+	if (Search::isRegexType(searchType)) {
+		spanLines_ += searchString.count(QLatin1String("\\n"));
+	}
+
+	if (boost::optional<TextRange> span = matches_.RangesetSpan()) {
+		matches_.ranges_.clear();
+		buffer_->BufCheckDisplay(span->start, span->end);
+	}
+
+	restart(from);
+	searchSlice();
+}
+
+/**
+ * @brief SearchMatches::lineStartBefore
+ * @param pos
+ * @return the start of the line containing "pos", or of an earlier line if a
+ * match there could reach "pos"
+ */
+TextCursor SearchMatches::lineStartBefore(TextCursor pos) const {
+
+	TextCursor start = buffer_->BufStartOfLine(pos);
+	for (int i = 0; i < spanLines_ && start != buffer_->BufStartOfBuffer(); ++i) {
+		start = buffer_->BufStartOfLine(start - 1);
+	}
+
+	return start;
+}
+
+/**
+ * @brief SearchMatches::lineEndAfter
+ * @param pos
+ * @return the position after the newline ending the line containing "pos",
+ * or a later line if a match from that line could reach it
+ */
+TextCursor SearchMatches::lineEndAfter(TextCursor pos) const {
+
+	const TextCursor bufferEnd = buffer_->BufEndOfBuffer();
+
+	TextCursor end = std::min(buffer_->BufEndOfLine(pos) + 1, bufferEnd);
+	for (int i = 0; i < spanLines_ && end != bufferEnd; ++i) {
+		end = std::min(buffer_->BufEndOfLine(end) + 1, bufferEnd);
+	}
+
+	return end;
+}
+
+/**
+ * @brief SearchMatches::restart
+ * @param from
+ *
+ * Queue the whole of the text to be searched, starting with the line
+ * containing "from".
+ */
+void SearchMatches::restart(TextCursor from) {
+
+	const TextCursor start = buffer_->BufStartOfLine(std::min(from, buffer_->BufEndOfBuffer()));
+
+	pending_.clear();
+	pending_.push_back({start, buffer_->BufEndOfBuffer()});
+	if (start != buffer_->BufStartOfBuffer()) {
+		pending_.push_back({buffer_->BufStartOfBuffer(), start});
+	}
+}
+
+/**
+ * Search the text for the next SliceTime msec, and if there is more to search,
+ * arrange for the search to carry on once the events waiting have been
+ * processed. Once there isn't, searchedCB is called, since matches which
+ * aren't displayed have been found, or have gone, without anything being
+ * redrawn.
+ *
+ * @brief SearchMatches::searchSlice
+ */
+void SearchMatches::searchSlice() {
+
+	QElapsedTimer clock;
+	clock.start();
+
+	while (!pending_.empty()) {
+		TextRange &range = pending_.front();
+
+		// search a chunk of whole lines at a time
+		TextCursor end = range.end;
+		if (end - range.start > ChunkSize) {
+			end = std::min(range.end, buffer_->BufEndOfLine(range.start + ChunkSize) + 1);
+		}
+
+		const TextCursor start = range.start;
+		if (end == range.end) {
+			pending_.erase(pending_.begin());
+		} else {
+			range.start = end;
+		}
+
+		searchRange({start, end});
+
+		if (clock.elapsed() >= SliceTime) {
+			break;
+		}
+	}
+
+	if (!pending_.empty()) {
+		timer_.start();
+		return;
+	}
+
+	if (searchedCB_) {
+		searchedCB_(user_);
+	}
+}
+
+/**
+ * @brief SearchMatches::searchRange
+ * @param range
+ *
+ * Replace the matches in "range" with those found there now. The range should
+ * start at the start of a line and end at the end of one.
+ */
+void SearchMatches::searchRange(TextRange range) {
+
+	const std::vector<TextRange> &ranges = matches_.ranges_;
+
+	/* Take in the lines of any ranges crossing the ends of the range, so that
+	   they are replaced as a whole */
+	for (;;) {
+		auto first = std::upper_bound(ranges.begin(), ranges.end(), range.start, [](TextCursor pos, const TextRange &r) {
+			return pos < r.end;
+		});
+
+		if (first != ranges.end() && first->start < range.start) {
+			range.start = buffer_->BufStartOfLine(first->start);
+			continue;
+		}
+
+		auto last = std::lower_bound(first, ranges.end(), range.end, [](const TextRange &r, TextCursor pos) {
+			return r.start < pos;
+		});
+
+		if (last != first && std::prev(last)->end > range.end) {
+			range.end = std::min(buffer_->BufEndOfLine(std::prev(last)->end - 1) + 1, buffer_->BufEndOfBuffer());
+			continue;
+		}
+
+		break;
+	}
+
+	// matches starting in the range may carry on beyond it
+	const TextCursor searchEnd = (spanLines_ == 0) ? range.end : lineEndAfter(range.end - 1);
+
+	/* Only the text being searched is copied out of the buffer, so that the
+	   cost of an edit doesn't grow with the size of the text. The characters
+	   either side of it come too, so that anchors and word boundaries at its
+	   ends still see what they're next to */
+	const TextCursor textStart = (range.start == buffer_->BufStartOfBuffer()) ? range.start : range.start - 1;
+	const TextCursor textEnd   = std::min(searchEnd + 1, buffer_->BufEndOfBuffer());
+	const int64_t offset       = to_integer(textStart);
+
+	std::vector<Search::Result> results;
+	try {
+		results = Search::SearchAll(
+			buffer_->BufGetRange(textStart, textEnd),
+			searchString_,
+			searchType_,
+			to_integer(range.start) - offset,
+			to_integer(searchEnd) - offset,
+			delimiters_);
+	} catch (const RegexError &e) {
+		Q_UNUSED(e)
+		// an incomplete regular expression, as it's being typed, matches nothing
+		pending_.clear();
+		return;
+	}
+
+	Rangeset found(nullptr, 0);
+	found.ranges_.reserve(results.size());
+
+	for (const Search::Result &result : results) {
+		const TextRange match = {textStart + result.start, textStart + result.end};
+
+		// the ones starting beyond the range are left for when it's searched
+		if (match.start >= range.end) {
+			break;
+		}
+
+		// empty matches can't be shown
+		if (match.start == match.end) {
+			continue;
+		}
+
+		// a range set can't hold ranges which touch, so adjacent matches are joined
+		if (!found.ranges_.empty() && found.ranges_.back().end >= match.start) {
+			found.ranges_.back().end = std::max(found.ranges_.back().end, match.end);
+		} else {
+			found.ranges_.push_back(match);
+		}
+	}
+
+	matches_.RangesetRemove(range);
+	matches_.RangesetAdd(found);
+
+	buffer_->BufCheckDisplay(range.start, searchEnd);
+}
+
+/**
+ * @brief SearchMatches::bufModifiedCallback
+ * @param pos
+ * @param nInserted
+ * @param nDeleted
+ */
+void SearchMatches::bufModifiedCallback(TextCursor pos, int64_t nInserted, int64_t nDeleted) {
+
+	/* A batch of edits, such as the ones made by Replace All, is followed by
+	   searching all of the text again, rather than by adjusting the matches
+	   for each of the edits */
+	const int64_t batchSize = buffer_->BufBatchSize();
+	if (batchSize > 1) {
+		const int64_t batchIndex = buffer_->BufBatchIndex();
+		if (batchIndex == 0) {
+			batchStart_ = pos;
+			if (boost::optional<TextRange> span = matches_.RangesetSpan()) {
+				matches_.ranges_.clear();
+				buffer_->BufCheckDisplay(span->start, span->end);
+			}
+			pending_.clear();
+		}
+
+		if (batchIndex == batchSize - 1) {
+			restart(batchStart_);
+			timer_.start();
+		}
+
+		return;
+	}
+
+	// the ranges are moved with the text, until the modified lines are searched again
+	matches_.update_(&matches_, pos, nInserted, nDeleted);
+
+	// move what is still to be searched with the text too
+	const int64_t delta = nInserted - nDeleted;
+	auto adjust = [pos, nDeleted, delta](TextCursor p) {
+		if (p <= pos) {
+			return p;
+		}
+
+		if (p >= pos + nDeleted) {
+			return p + delta;
+		}
+
+		return pos;
+	};
+
+	for (TextRange &range : pending_) {
+		range.start = adjust(range.start);
+		range.end   = adjust(range.end);
+	}
+
+	pending_.erase(std::remove_if(pending_.begin(), pending_.end(), [](const TextRange &range) {
+					   return range.start == range.end;
+				   }),
+				   pending_.end());
+
+	/* The lines touched by the modification (including the newline at the end
+	   of them, and any lines a match could span from or to them) are searched
+	   first, once the modification is over */
+	pending_.insert(pending_.begin(), {lineStartBefore(pos), lineEndAfter(pos + nInserted)});
+	timer_.start();
+}
@@ -0,0 +1,67 @@
+
+#ifndef SEARCH_MATCHES_H_
+#define SEARCH_MATCHES_H_
+
+#include "Rangeset.h"
+#include "SearchType.h"
+#include "TextBufferFwd.h"
+#include "TextCursor.h"
+#include "TextRange.h"
+
+#include <QString>
+#include <QTimer>
+
+#include <cstdint>
+#include <vector>
+
+/* All of the matches of a search in a document, so that they can be
+ * highlighted. The text is searched a chunk at a time, from the displayed part
+ * of the document onwards, in slices short enough not to hold up the user
+ * interface. The matches are kept as a range set, and kept up to date from the
+ * buffer modify callbacks: the ranges after a modification are moved with the
+ * text, and only the lines which were modified are searched again.
+ *
+ * How many lines a match can span is judged from the line breaks in the search
+ * string, so a regular expression which matches line breaks some other way
+ * may not be found again across the edge of a modification. */
+class SearchMatches {
+public:
+	// called each time all of the text has been searched
+	using SearchedCallback = void (*)(void *user);
+
+public:
+	SearchMatches(TextBuffer *buffer, SearchedCallback searchedCB, void *user);
+	SearchMatches(const SearchMatches &)            = delete;
+	SearchMatches &operator=(const SearchMatches &) = delete;
+	~SearchMatches();
+
+public:
+	bool contains(TextCursor pos);
+	const Rangeset &matches() const noexcept;
+	void setSearch(const QString &searchString, SearchType searchType, const QString &delimiters, TextCursor from);
+
+public:
+	void bufModifiedCallback(TextCursor pos, int64_t nInserted, int64_t nDeleted);
+
+private:
+	TextCursor lineEndAfter(TextCursor pos) const;
+	TextCursor lineStartBefore(TextCursor pos) const;
+	void restart(TextCursor from);
+	void searchRange(TextRange range);
+	void searchSlice();
+
+private:
+	TextBuffer *buffer_;
+	SearchedCallback searchedCB_;
+	void *user_;
+	QString searchString_;
+	SearchType searchType_ = SearchType::Literal;
+	QString delimiters_;
+	int spanLines_         = 0;     // how many line breaks a match can cross
+	Rangeset matches_;              // the matches found so far, adjacent ones are joined
+	std::vector<TextRange> pending_; // parts of the text still to be searched, in the order they will be
+	TextCursor batchStart_ = {};    // where the first edit of a batch of them was made
+	QTimer timer_;                  // searches the next slice of the text
+};
+
+#endif
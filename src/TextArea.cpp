@@ -2,6 +2,7 @@
 #include "TextArea.h"
 #include "BlockDragTypes.h"
 #include "CallTipWidget.h"
+#include "DocumentLayout.h"
 #include "DocumentWidget.h"
 #include "DragEndEvent.h"
 #include "DragStates.h"
@@ -9,8 +10,10 @@
 #include "Highlight.h"
 #include "LanguageMode.h"
 #include "LineNumberArea.h"
+#include "OverviewRuler.h"
 #include "Preferences.h"
 #include "RangesetTable.h"
+#include "SearchMatches.h"
 #include "SmartIndentEvent.h"
 #include "TextAreaMimeData.h"
 #include "TextBuffer.h"
@@ -94,6 +97,9 @@ constexpr int CALLTIP_EDGE_GUARD = 5;
 // Length of delay in milliseconds for vertical auto-scrolling
 constexpr int VERTICAL_SCROLL_DELAY = 50;
 
+// Minimum time in milliseconds between two redisplays caused by buffer modifications
+constexpr int REDISPLAY_FRAME_INTERVAL = 16;
+
 /* Masks for text drawing methods.  These are or'd together to form an
    integer which describes what drawing calls to use to draw a string */
 constexpr int STYLE_LOOKUP_SHIFT = 0;
@@ -103,6 +109,7 @@ constexpr int PRIMARY_SHIFT      = 10;
 constexpr int HIGHLIGHT_SHIFT    = 11;
 constexpr int BACKLIGHT_SHIFT    = 12;
 constexpr int RANGESET_SHIFT     = 20;
+constexpr int MATCH_SHIFT        = 26;
 
 constexpr uint32_t STYLE_LOOKUP_MASK = (0xff << STYLE_LOOKUP_SHIFT);
 constexpr uint32_t FILL_MASK         = (1 << FILL_SHIFT);
@@ -111,13 +118,14 @@ constexpr uint32_t PRIMARY_MASK      = (1 << PRIMARY_SHIFT);
 constexpr uint32_t HIGHLIGHT_MASK    = (1 << HIGHLIGHT_SHIFT);
 constexpr uint32_t BACKLIGHT_MASK    = (0xff << BACKLIGHT_SHIFT);
 constexpr uint32_t RANGESET_MASK     = (0x3f << RANGESET_SHIFT);
+constexpr uint32_t MATCH_MASK        = (1 << MATCH_SHIFT);
 
 /* If you use both 32-Bit Style mask layout:
    Bits +----------------+----------------+----------------+----------------+
 	hex |1F1E1D1C1B1A1918|1716151413121110| F E D C B A 9 8| 7 6 5 4 3 2 1 0|
 	dec |3130292827262524|2322212019181716|151413121110 9 8| 7 6 5 4 3 2 1 0|
 		+----------------+----------------+----------------+----------------+
-   Type |             r r| r r r r b b b b| b b b b H 1 2 F| s s s s s s s s|
+   Type |           M r r| r r r r b b b b| b b b b H 1 2 F| s s s s s s s s|
 		+----------------+----------------+----------------+----------------+
    where:
 		s - style lookup value (8 bits)
@@ -127,7 +135,8 @@ constexpr uint32_t RANGESET_MASK     = (0x3f << RANGESET_SHIFT);
 		H - highlight (1 bit)
 		b - backlighting index (8 bits)
 		r - rangeset index (6 bits)
-   This leaves 6 "unused" bits */
+		M - search match (1 bit)
+   This leaves 5 "unused" bits */
 
 /* Maximum displayable line length (how many characters will fit across the
    widest window).  This amount of memory is temporarily allocated from the
@@ -501,6 +510,7 @@ TextArea::TextArea(DocumentWidget *document, TextBuffer *buffer, const QFont &fo
 	autoScrollTimer_  = new QTimer(this);
 	cursorBlinkTimer_ = new QTimer(this);
 	clickTimer_       = new QTimer(this);
+	redisplayTimer_   = new QTimer(this);
 	lineNumberArea_   = new LineNumberArea(this);
 
 	autoScrollTimer_->setSingleShot(true);
@@ -512,6 +522,10 @@ TextArea::TextArea(DocumentWidget *document, TextBuffer *buffer, const QFont &fo
 		clickTimerExpired_ = true;
 	});
 
+	redisplayTimer_->setSingleShot(true);
+	connect(redisplayTimer_, &QTimer::timeout, this, &TextArea::flushPendingRedisplay);
+	redisplayClock_.start();
+
 	setWordDelimiters(Preferences::GetPrefDelimiters().toStdString());
 
 	showTerminalSizeHint_    = Preferences::GetPrefShowResizeNotification();
@@ -537,6 +551,13 @@ TextArea::TextArea(DocumentWidget *document, TextBuffer *buffer, const QFont &fo
 	// set the default margins
 	viewport()->setContentsMargins(DefaultHMargin, DefaultVMargin, 0, 0);
 
+	layout_ = document->documentLayout();
+
+	if (Preferences::GetPrefShowOverviewRuler()) {
+		overviewRuler_ = new OverviewRuler(this, document->documentSummary());
+		setViewportMargins(0, 0, OverviewRuler::Width, 0);
+	}
+
 	/* Attach the callback to the text buffer for receiving modification
 	 * information */
 	if (buffer) {
@@ -957,6 +978,10 @@ void TextArea::verticalScrollBar_valueChanged(int value) {
 	if (lineDelta != 0) {
 		repaintLineNumbers();
 		updateCalltip(0);
+
+		if (overviewRuler_) {
+			overviewRuler_->update();
+		}
 	}
 }
 
@@ -992,6 +1017,8 @@ void TextArea::cursorBlinkTimerTimeout() {
  */
 void TextArea::autoScrollTimerTimeout() {
 
+	flushPendingRedisplay();
+
 	const QRect viewRect    = viewport()->contentsRect();
 	const int fontWidth     = fixedFontWidth_;
 	const int fontHeight    = fixedFontHeight_;
@@ -1401,6 +1428,11 @@ void TextArea::resizeEvent(QResizeEvent *event) {
 
 	const QRect cr = contentsRect();
 	lineNumberArea_->setGeometry(QRect(cr.left(), cr.top(), lineNumberAreaWidth(), cr.height()));
+
+	if (overviewRuler_) {
+		const QRect vr = viewport()->geometry();
+		overviewRuler_->setGeometry(QRect(vr.right() + 1, vr.top(), OverviewRuler::Width, vr.height()));
+	}
 }
 
 /**
@@ -1434,7 +1466,6 @@ void TextArea::bufPreDeleteCallback(TextCursor pos, int64_t nDeleted) {
  */
 void TextArea::bufModifiedCallback(TextCursor pos, int64_t nInserted, int64_t nDeleted, int64_t nRestyled, view::string_view deletedText) {
 
-	const QRect viewRect = viewport()->contentsRect();
 	int64_t linesInserted;
 	int64_t linesDeleted;
 	TextCursor endDispPos;
@@ -1443,16 +1474,45 @@ void TextArea::bufModifiedCallback(TextCursor pos, int64_t nInserted, int64_t nD
 	TextCursor wrapModStart        = {};
 	TextCursor wrapModEnd          = {};
 	bool scrolled;
+	bool lineNumbers;
 
 	// buffer modification cancels vertical cursor motion column
 	if (nInserted != 0 || nDeleted != 0) {
 		cursorPreferredCol_ = -1;
+		shiftPendingRedisplay(pos, nInserted, nDeleted);
 	}
 
+	/* The document layout has already counted the lines of this modification
+	   if it came from the buffer (as opposed to being synthesized by us) */
+	const bool layoutIsCurrent = layout_ && layout_->isCurrent(pos, nInserted, nDeleted);
+
 	/* Count the number of lines inserted and deleted, and in the case
-	   of continuous wrap mode, how much has changed */
+	   of continuous wrap mode, how much has changed. Other panes with the same
+	   wrap geometry will have found the same wrap range, so reuse theirs if
+	   there is one */
 	if (continuousWrap_) {
-		findWrapRange(deletedText, pos, nInserted, nDeleted, &wrapModStart, &wrapModEnd, &linesInserted, &linesDeleted);
+		const DocumentLayout::WrapGeometry geometry = wrapGeometry();
+		const bool canShare                         = layoutIsCurrent && !suppressResync_;
+
+		boost::optional<DocumentLayout::WrapRange> range;
+		if (canShare) {
+			range = layout_->wrapRange(geometry);
+		}
+
+		if (range) {
+			wrapModStart  = range->modRangeStart;
+			wrapModEnd    = range->modRangeEnd;
+			linesInserted = range->linesInserted;
+			linesDeleted  = range->linesDeleted;
+		} else {
+			findWrapRange(deletedText, pos, nInserted, nDeleted, &wrapModStart, &wrapModEnd, &linesInserted, &linesDeleted);
+			if (canShare) {
+				layout_->setWrapRange(geometry, {wrapModStart, wrapModEnd, linesInserted, linesDeleted});
+			}
+		}
+	} else if (layoutIsCurrent) {
+		linesInserted = layout_->linesInserted();
+		linesDeleted  = layout_->linesDeleted();
 	} else {
 		linesInserted = (nInserted == 0) ? 0 : buffer_->BufCountLines(pos, pos + nInserted);
 		linesDeleted  = (nDeleted == 0) ? 0 : countNewlines(deletedText);
@@ -1473,7 +1533,11 @@ void TextArea::bufModifiedCallback(TextCursor pos, int64_t nInserted, int64_t nD
 	   (non-wrapped) line number of the text displayed */
 	if (maintainingAbsTopLineNum() && (nInserted != 0 || nDeleted != 0)) {
 		if (pos + nDeleted < oldFirstChar) {
-			absTopLineNum_ = absTopLineNum_ + buffer_->BufCountLines(pos, pos + nInserted) - countNewlines(deletedText);
+			if (layoutIsCurrent) {
+				absTopLineNum_ = absTopLineNum_ + layout_->linesInserted() - layout_->linesDeleted();
+			} else {
+				absTopLineNum_ = absTopLineNum_ + buffer_->BufCountLines(pos, pos + nInserted) - countNewlines(deletedText);
+			}
 		} else if (pos < oldFirstChar) {
 			resetAbsLineNum();
 		}
@@ -1482,14 +1546,11 @@ void TextArea::bufModifiedCallback(TextCursor pos, int64_t nInserted, int64_t nD
 	// Update the line count for the whole buffer
 	nBufferLines_ = (nBufferLines_ + linesInserted - linesDeleted);
 
-	/* Update the scroll bar ranges (and value if the value changed).  Note
-	   that updating the horizontal scroll bar range requires scanning the
-	   entire displayed text, however, it doesn't seem to hurt performance
-	   much.  Note also, that the horizontal scroll bar update routine is
-	   allowed to re-adjust horizOffset if there is blank space to the right
-	   of all lines of text. */
+	/* Update the vertical scroll bar range (and value if the value changed).
+	   The horizontal scroll bar range requires scanning the entire displayed
+	   text, so it is left for flushPendingRedisplay, along with the actual
+	   redisplay, to be done once for a whole burst of modifications. */
 	updateVScrollBarRange();
-	scrolled |= updateHScrollBarRange();
 
 	// Update the cursor position
 	if (cursorToHint_ != NO_HINT) {
@@ -1505,7 +1566,7 @@ void TextArea::bufModifiedCallback(TextCursor pos, int64_t nInserted, int64_t nD
 
 	// If the changes caused scrolling, re-paint everything and we're done.
 	if (scrolled) {
-		redisplayRect(viewRect);
+		scheduleFullRedisplay();
 		if (styleBuffer_) { // See comments in extendRangeForStyleMods
 			styleBuffer_->primary.selected_  = false;
 			styleBuffer_->primary.zeroWidth_ = false;
@@ -1534,12 +1595,10 @@ void TextArea::bufModifiedCallback(TextCursor pos, int64_t nInserted, int64_t nD
 		   have changed. If only one line is altered, line numbers cannot
 		   be affected (the insertion or removal of a line break always
 		   results in at least two lines being redrawn). */
-		if (linesInserted > 1) {
-			repaintLineNumbers();
-		}
+		lineNumbers = (linesInserted > 1);
 	} else { // linesInserted != linesDeleted
-		endDispPos = lastChar_ + 1;
-		repaintLineNumbers();
+		endDispPos  = lastChar_ + 1;
+		lineNumbers = true;
 	}
 
 	/* If there is a style buffer, check if the modification caused additional
@@ -1550,8 +1609,121 @@ void TextArea::bufModifiedCallback(TextCursor pos, int64_t nInserted, int64_t nD
 		extendRangeForStyleMods(&startDispPos, &endDispPos);
 	}
 
-	// Redisplay computed range
-	redisplayRange(startDispPos, endDispPos);
+	// Redisplay computed range, along with the rest of this burst of changes
+	scheduleRedisplay(startDispPos, endDispPos, lineNumbers);
+}
+
+/**
+ * Adjusts the range of text waiting to be redisplayed for a buffer
+ * modification, so that it still covers the same text afterwards.
+ *
+ * @brief TextArea::shiftPendingRedisplay
+ * @param pos
+ * @param nInserted
+ * @param nDeleted
+ */
+void TextArea::shiftPendingRedisplay(TextCursor pos, int64_t nInserted, int64_t nDeleted) {
+
+	if (!pendingRedisplay_) {
+		return;
+	}
+
+	auto shift = [pos, nInserted, nDeleted](TextCursor p, TextCursor inDeleted) {
+		if (p <= pos) {
+			return p;
+		}
+
+		if (p >= pos + nDeleted) {
+			return p + nInserted - nDeleted;
+		}
+
+		return inDeleted;
+	};
+
+	pendingRedisplayStart_ = shift(pendingRedisplayStart_, pos);
+	pendingRedisplayEnd_   = shift(pendingRedisplayEnd_, pos + nInserted);
+}
+
+/**
+ * Adds a range of text to be redisplayed by the next flushPendingRedisplay.
+ * Consecutive buffer modifications (a macro in a loop, replace all, shell
+ * output, ...) only accumulate their ranges here, and the display is brought
+ * up to date at most once per REDISPLAY_FRAME_INTERVAL, instead of once per
+ * modification.
+ *
+ * @brief TextArea::scheduleRedisplay
+ * @param start
+ * @param end
+ * @param lineNumbers
+ */
+void TextArea::scheduleRedisplay(TextCursor start, TextCursor end, bool lineNumbers) {
+
+	if (pendingRedisplay_) {
+		pendingRedisplayStart_ = std::min(pendingRedisplayStart_, start);
+		pendingRedisplayEnd_   = std::max(pendingRedisplayEnd_, end);
+	} else {
+		pendingRedisplayStart_ = start;
+		pendingRedisplayEnd_   = end;
+		pendingRedisplay_      = true;
+	}
+
+	pendingLineNumbers_ |= lineNumbers;
+
+	if (!redisplayTimer_->isActive()) {
+		const qint64 elapsed = redisplayClock_.elapsed();
+		redisplayTimer_->start(elapsed >= REDISPLAY_FRAME_INTERVAL ? 0 : static_cast<int>(REDISPLAY_FRAME_INTERVAL - elapsed));
+	}
+}
+
+/**
+ * @brief TextArea::scheduleFullRedisplay
+ */
+void TextArea::scheduleFullRedisplay() {
+	pendingFullRedisplay_ = true;
+	scheduleRedisplay(firstChar_, lastChar_ + 1, true);
+}
+
+/**
+ * Performs the display updates which were postponed by the buffer modify
+ * callback. This is also called before any operation which depends on the
+ * horizontal scroll bar range being up to date.
+ *
+ * @brief TextArea::flushPendingRedisplay
+ */
+void TextArea::flushPendingRedisplay() {
+
+	redisplayTimer_->stop();
+
+	if (!pendingRedisplay_) {
+		return;
+	}
+
+	const bool lineNumbers = pendingLineNumbers_;
+	bool full              = pendingFullRedisplay_;
+	pendingRedisplay_      = false;
+	pendingFullRedisplay_  = false;
+	pendingLineNumbers_    = false;
+	redisplayClock_.restart();
+
+	/* Note that the horizontal scroll bar update routine is allowed to
+	   re-adjust horizOffset if there is blank space to the right of all lines
+	   of text, in which case everything must be re-painted */
+	full |= updateHScrollBarRange();
+
+	if (overviewRuler_) {
+		overviewRuler_->update();
+	}
+
+	if (full) {
+		redisplayRect(viewport()->contentsRect());
+		return;
+	}
+
+	if (lineNumbers) {
+		repaintLineNumbers();
+	}
+
+	redisplayRange(pendingRedisplayStart_, pendingRedisplayEnd_);
 }
 
 /**
@@ -2313,7 +2485,15 @@ bool TextArea::maintainingAbsTopLineNum() const {
 */
 void TextArea::resetAbsLineNum() {
 	absTopLineNum_ = 1;
-	offsetAbsLineNum(buffer_->BufStartOfBuffer());
+
+	if (!layout_) {
+		offsetAbsLineNum(buffer_->BufStartOfBuffer());
+		return;
+	}
+
+	if (maintainingAbsTopLineNum()) {
+		absTopLineNum_ += layout_->countLinesBefore(firstChar_);
+	}
 }
 
 /*
@@ -2978,6 +3158,11 @@ uint32_t TextArea::styleOfPos(TextCursor lineStartPos, size_t lineLen, size_t li
 		style |= ((rangesetIndex << RANGESET_SHIFT) & RANGESET_MASK);
 	}
 
+	// mark the highlighted matches of the last search
+	if (document_->searchMatches_ && document_->searchMatches_->contains(pos)) {
+		style |= MATCH_MASK;
+	}
+
 	/* store in the BACKLIGHT_MASK portion of style the background color class
 	   of the character thisChar */
 	if (!bgClass_.empty()) {
@@ -3016,7 +3201,7 @@ void TextArea::drawString(QPainter *painter, uint32_t style, int x, int y, int t
 
 	const DrawType drawType = [style]() {
 		// select a GC
-		if (style & (STYLE_LOOKUP_MASK | BACKLIGHT_MASK | RANGESET_MASK)) {
+		if (style & (STYLE_LOOKUP_MASK | BACKLIGHT_MASK | RANGESET_MASK | MATCH_MASK)) {
 			return DrawStyle;
 		}
 
@@ -3068,10 +3253,11 @@ void TextArea::drawString(QPainter *painter, uint32_t style, int x, int y, int t
 		/* Background color priority order is:
 		 ** 1 Primary(Selection),
 		 ** 2 Highlight(Parens),
-		 ** 3 Rangeset
-		 ** 4 SyntaxHighlightStyle,
-		 ** 5 Backlight (if NOT fill)
-		 ** 6 DefaultBackground
+		 ** 3 Search matches
+		 ** 4 Rangeset
+		 ** 5 SyntaxHighlightStyle,
+		 ** 6 Backlight (if NOT fill)
+		 ** 7 DefaultBackground
 		 */
 		if (style & PRIMARY_MASK) {
 			bground = pal.color(QPalette::Highlight);
@@ -3084,7 +3270,7 @@ void TextArea::drawString(QPainter *painter, uint32_t style, int x, int y, int t
 				fground = pal.color(QPalette::HighlightedText);
 			}
 
-		} else if (style & HIGHLIGHT_MASK) {
+		} else if (style & (HIGHLIGHT_MASK | MATCH_MASK)) {
 			bground = matchBGColor_;
 			if (!colorizeHighlightedText_) {
 				fground = matchFGColor_;
@@ -3268,7 +3454,7 @@ void TextArea::handleResize(bool widthChanged) {
 		const TextCursor start        = buffer_->BufStartOfBuffer();
 		const TextCursor end          = buffer_->BufEndOfBuffer();
 
-		nBufferLines_ = countLines(start, end, /*startPosIsLineStart=*/true);
+		nBufferLines_ = countBufferLines();
 		firstChar_    = startOfLine(firstChar_);
 		topLineNum_   = countLines(start, firstChar_, /*startPosIsLineStart=*/true) + 1;
 		offsetAbsLineNum(oldFirstChar);
@@ -3333,6 +3519,50 @@ int64_t TextArea::countLines(TextCursor startPos, TextCursor endPos, bool startP
 	return retLines;
 }
 
+/*
+** Count the lines of the whole buffer, taking into account wrapping if it is
+** turned on. The result is shared with the other panes of the document which
+** wrap the same way, so splitting a window doesn't multiply the work of
+** re-counting a large buffer.
+*/
+int64_t TextArea::countBufferLines() {
+
+	const TextCursor start = buffer_->BufStartOfBuffer();
+	const TextCursor end   = buffer_->BufEndOfBuffer();
+
+	if (!layout_) {
+		return countLines(start, end, /*startPosIsLineStart=*/true);
+	}
+
+	if (!continuousWrap_) {
+		return layout_->lineCount();
+	}
+
+	const DocumentLayout::WrapGeometry geometry = wrapGeometry();
+	if (boost::optional<int64_t> lines = layout_->wrappedLineCount(geometry)) {
+		return *lines;
+	}
+
+	const int64_t lines = countLines(start, end, /*startPosIsLineStart=*/true);
+	layout_->setWrappedLineCount(geometry, lines);
+	return lines;
+}
+
+/*
+** Describe everything wrappedLineCounter depends on besides the text, so
+** panes which wrap identically can be recognized.
+*/
+DocumentLayout::WrapGeometry TextArea::wrapGeometry() const {
+
+	const int tabDist = buffer_->BufGetTabDistance();
+
+	if (wrapMargin_ != 0) {
+		return {wrapMargin_, 0, 0, tabDist};
+	}
+
+	return {0, viewport()->contentsRect().width(), fixedFontWidth_, tabDist};
+}
+
 /**
  * @brief TextArea::setCursorStyle
  * @param style
@@ -3834,6 +4064,9 @@ void TextArea::checkAutoShowInsertPos() {
 */
 void TextArea::TextDMakeInsertPosVisible() {
 
+	// the horizontal scroll range must account for any pending changes
+	flushPendingRedisplay();
+
 	const QRect viewRect       = viewport()->contentsRect();
 	const TextCursor cursorPos = cursorPos_;
 	const int cursorVPadding   = cursorVPadding_;
@@ -3953,6 +4186,18 @@ void TextArea::cancelBlockDrag() {
 	}
 }
 
+/**
+ * @brief TextArea::updateOverviewRuler
+ *
+ * Repaint the overview ruler, if it is shown, for changes to what it shows
+ * which don't come with a change to the text or the display.
+ */
+void TextArea::updateOverviewRuler() {
+	if (overviewRuler_) {
+		overviewRuler_->update();
+	}
+}
+
 /*
 ** Do operations triggered by cursor movement: Call cursor movement callback
 ** procedure(s), and cancel marker indicating that the cursor is after one or
@@ -3960,6 +4205,11 @@ void TextArea::cancelBlockDrag() {
 */
 void TextArea::callCursorMovementCBs() {
 	emTabsBeforeCursor_ = 0;
+
+	if (overviewRuler_) {
+		overviewRuler_->update();
+	}
+
 	callMovedCBs();
 }
 
@@ -5784,6 +6034,8 @@ void TextArea::mousePanAP(QMouseEvent *event, EventFlags flags) {
 
 	EMIT_EVENT_0("mouse_pan");
 
+	flushPendingRedisplay();
+
 	const int lineHeight = fixedFontHeight_;
 
 	switch (dragState_) {
@@ -6490,7 +6742,7 @@ int TextArea::lineNumberAreaWidth() const {
 */
 void TextArea::setLineNumberAreaWidth(int lineNumWidth) {
 	lineNumberArea_->resize(lineNumWidth, lineNumberArea_->height());
-	setViewportMargins(lineNumberArea_->width(), 0, 0, 0);
+	setViewportMargins(lineNumberArea_->width(), 0, overviewRuler_ ? OverviewRuler::Width : 0, 0);
 	lineNumberArea_->update();
 }
 
@@ -6500,7 +6752,7 @@ void TextArea::setWrapMode(bool wrap, int wrapMargin) {
 	wrapMargin_     = wrapMargin;
 
 	// wrapping can change change the total number of lines, re-count
-	nBufferLines_ = countLines(buffer_->BufStartOfBuffer(), buffer_->BufEndOfBuffer(), /*startPosIsLineStart=*/true);
+	nBufferLines_ = countBufferLines();
 
 	/* changing wrap margins wrap or changing from wrapped mode to non-wrapped
 	 * can leave the character at the top no longer at a line start, and/or
@@ -7788,11 +8040,13 @@ void TextArea::scrollDownAP(int count, ScrollUnit units, EventFlags flags) {
 
 void TextArea::scrollLeftAP(int pixels, EventFlags flags) {
 	EMIT_EVENT_0("scroll_left");
+	flushPendingRedisplay();
 	horizontalScrollBar()->setValue(horizontalScrollBar()->value() - pixels);
 }
 
 void TextArea::scrollRightAP(int pixels, EventFlags flags) {
 	EMIT_EVENT_0("scroll_right");
+	flushPendingRedisplay();
 	horizontalScrollBar()->setValue(horizontalScrollBar()->value() + pixels);
 }
 
@@ -7858,6 +8112,9 @@ void TextArea::showResizeNotification() {
 */
 void TextArea::makeSelectionVisible() {
 
+	// the horizontal scroll range must account for any pending changes
+	flushPendingRedisplay();
+
 	const QRect viewRect = viewport()->contentsRect();
 	bool isRect;
 	TextCursor left;
@@ -5,6 +5,7 @@
 #include "BlockDragTypes.h"
 #include "CallTip.h"
 #include "CursorStyles.h"
+#include "DocumentLayout.h"
 #include "DragStates.h"
 #include "Location.h"
 #include "StyleTableEntry.h"
@@ -14,6 +15,7 @@
 
 #include <QAbstractScrollArea>
 #include <QColor>
+#include <QElapsedTimer>
 #include <QFlags>
 #include <QFont>
 #include <QPointer>
@@ -50,6 +52,7 @@ class TextArea final : public QAbstractScrollArea {
 
 private:
 	friend class LineNumberArea;
+	friend class OverviewRuler;
 
 public:
 	enum EventFlag {
@@ -251,6 +254,7 @@ public:
 	void TextDKillCalltip(int id);
 	void TextDMaintainAbsLineNum(bool state);
 	void TextSetCursorPos(TextCursor pos);
+	void updateOverviewRuler();
 
 public:
 	void bufPreDeleteCallback(TextCursor pos, int64_t nDeleted);
@@ -288,12 +292,14 @@ private:
 	bool visibleLineContainsCursor(int visLine, TextCursor cursor) const;
 	bool wrapLine(TextBuffer *buf, int64_t bufOffset, TextCursor lineStartPos, TextCursor lineEndPos, TextCursor limitPos, TextCursor *breakAt, int64_t *charsAdded);
 	bool wrapUsesCharacter(TextCursor lineEndPos) const;
+	DocumentLayout::WrapGeometry wrapGeometry() const;
 	boost::optional<TextCursor> spanBackward(TextBuffer *buf, TextCursor startPos, view::string_view searchChars, bool ignoreSpace) const;
 	boost::optional<TextCursor> spanForward(TextBuffer *buf, TextCursor startPos, view::string_view searchChars, bool ignoreSpace) const;
 	int offsetWrappedColumn(int row, int column) const;
 	int offsetWrappedRow(int row) const;
 	int64_t preferredColumn(int *visLineNum, TextCursor *lineStartPos);
 	int64_t countLines(TextCursor startPos, TextCursor endPos, bool startPosIsLineStart);
+	int64_t countBufferLines();
 	int64_t getAbsTopLineNum() const;
 	int getLineNumWidth() const;
 	int lengthToWidth(int length) const noexcept;
@@ -334,6 +340,7 @@ private:
 	void drawString(QPainter *painter, uint32_t style, int x, int y, int toX, view::string_view string);
 	void endDrag();
 	void extendRangeForStyleMods(TextCursor *start, TextCursor *end);
+	void flushPendingRedisplay();
 	void findLineEnd(TextCursor startPos, bool startPosIsLineStart, TextCursor *lineEnd, TextCursor *nextLineStart);
 	void findWrapRange(view::string_view deletedText, TextCursor pos, int64_t nInserted, int64_t nDeleted, TextCursor *modRangeStart, TextCursor *modRangeEnd, int64_t *linesInserted, int64_t *linesDeleted);
 	void handleResize(bool widthChanged);
@@ -350,12 +357,15 @@ private:
 	void redisplayRect(const QRect &rect);
 	void repaintLineNumbers();
 	void resetAbsLineNum();
+	void scheduleRedisplay(TextCursor start, TextCursor end, bool lineNumbers);
+	void scheduleFullRedisplay();
 	void selectLine();
 	void selectWord(int pointerX);
 	void setCursorStyle(CursorStyles style);
 	void setInsertPosition(TextCursor newPos);
 	void setLineNumberAreaWidth(int lineNumWidth);
 	void setupBGClasses(const QString &str);
+	void shiftPendingRedisplay(TextCursor pos, int64_t nInserted, int64_t nDeleted);
 	void showResizeNotification();
 	void simpleInsertAtCursor(view::string_view chars, bool allowPendingDelete);
 	void unblankCursor();
@@ -368,6 +378,7 @@ private:
 
 private:
 	CursorStyles cursorStyle_                      = CursorStyles::Normal;
+	DocumentLayout *layout_                        = nullptr; // Line and wrap information shared with the other panes of the document
 	DocumentWidget *document_                      = nullptr;
 	DragStates dragState_                          = NOT_CLICKED; // Why is the mouse being dragged and what is being acquired
 	QColor cursorFGColor_                          = Qt::black;
@@ -380,9 +391,11 @@ private:
 	QTimer *autoScrollTimer_                       = nullptr;
 	QTimer *clickTimer_                            = nullptr;
 	QTimer *cursorBlinkTimer_                      = nullptr;
+	QTimer *redisplayTimer_                        = nullptr; // Coalesces the redisplay of bursts of buffer modifications
 	QTimer *resizeTimer_                           = nullptr;
 	QVector<TextCursor> lineStarts_                = {TextCursor()};
 	QWidget *lineNumberArea_                       = nullptr;
+	QWidget *overviewRuler_                        = nullptr; // Overview of the whole document (only when enabled)
 	TextBuffer *buffer_                            = nullptr; // Contains text to be displayed
 	UTextBuffer *styleBuffer_                      = nullptr; // Optional parallel buffer containing color and font information
 	TextCursor anchor_                             = {};      // Anchor for drag operations
@@ -392,6 +405,8 @@ private:
 	TextCursor dragSourceDeletePos_                = {};      // location from which move source text was removed at start of drag
 	TextCursor firstChar_                          = {};      // Buffer positions of first and last displayed character (lastChar_ points either to a newline or one character beyond the end of the buffer)
 	TextCursor lastChar_                           = {};
+	TextCursor pendingRedisplayStart_              = {}; // Range of text waiting for redisplay by redisplayTimer_
+	TextCursor pendingRedisplayEnd_                = {};
 	UnfinishedStyleCallback unfinishedHighlightCB_ = nullptr; // Callback to parse "unfinished" regions
 	bool autoIndent_                               = false;
 	bool autoShowInsertPos_                        = true;
@@ -407,6 +422,9 @@ private:
 	bool needAbsTopLineNum_                        = false; // Externally settable flag to continue maintaining absTopLineNum even if it isn't needed for line # display
 	bool overstrike_                               = false;
 	bool pendingDelete_                            = true;
+	bool pendingFullRedisplay_                     = false; // The whole display is waiting for redisplay
+	bool pendingLineNumbers_                       = false; // The line numbers are waiting for redisplay
+	bool pendingRedisplay_                         = false; // pendingRedisplayStart_/pendingRedisplayEnd_ are valid
 	bool readOnly_                                 = false;
 	bool showTerminalSizeHint_                     = false;
 	bool smartHome_                                = false;
@@ -445,6 +463,7 @@ private:
 	QPoint btnDownCoord_; // Mark the position of last btn down action for deciding when to begin paying attention to motion actions, and where to paste columns
 	QPoint clickPos_;
 	QPoint mouseCoord_; // Last known mouse position in drag operation (for auto-scroll)
+	QElapsedTimer redisplayClock_; // Time since the last coalesced redisplay
 	QPointer<CallTipWidget> calltipWidget_;
 	std::string delimiters_;
 	std::shared_ptr<TextBuffer> dragOrigBuf_; // backup buffer copy used during block dragging of selections
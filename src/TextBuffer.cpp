@@ -2,12 +2,32 @@
 #include "TextBuffer.h"
 #include "TextBuffer.tcc"
 
+#include <cstring>
+
 const char *BasicTextBufferBase::ControlCodeTable[32] = {
 	"nul", "soh", "stx", "etx", "eot", "enq", "ack", "bel",
 	"bs", "ht", "nl", "vt", "np", "cr", "so", "si",
 	"dle", "dc1", "dc2", "dc3", "dc4", "nak", "syn", "etb",
 	"can", "em", "sub", "esc", "fs", "gs", "rs", "us"};
 
+const std::array<uint8_t, 256> BasicTextBufferBase::CharWidthTable = []() {
+	std::array<uint8_t, 256> table;
+	table.fill(1);
+
+#if defined(VISUAL_CTRL_CHARS)
+	// control codes are shown as their name, in angle brackets
+	for (size_t ch = 0; ch < 32; ++ch) {
+		table[ch] = static_cast<uint8_t>(strlen(ControlCodeTable[ch]) + 2);
+	}
+
+	table[127] = 5; // strlen("<del>")
+#endif
+
+	// the width of a tab depends on where it is
+	table['\t'] = 0;
+	return table;
+}();
+
 // Force full instantiation
 template class BasicTextBuffer<char>;
 template class gap_buffer<char>;
@@ -10,10 +10,12 @@
 
 #include <gsl/gsl_util>
 
+#include <array>
 #include <cstdint>
 #include <deque>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <boost/optional.hpp>
 
@@ -33,6 +35,11 @@ protected:
 	static constexpr int PreferredGapSize = 80;
 
 	static const char *ControlCodeTable[32];
+
+	/* Display width of each character, other than tab (which is 0 here, as
+	 * its width depends on the column it is in)
+	 */
+	static const std::array<uint8_t, 256> CharWidthTable;
 };
 
 template <class Ch, class Tr>
@@ -54,6 +61,13 @@ public:
 
 	static constexpr int DefaultTabWidth = 8;
 
+public:
+	// One of the replacements made by BufReplaceRanges
+	struct Edit {
+		TextRange range; // the text to replace, as it is before any of the edits are made
+		view_type text;  // what to replace it with
+	};
+
 public:
 	class Selection {
 		template <class CharT, class Traits>
@@ -95,7 +109,18 @@ public:
 	~BasicTextBuffer()                                  = default;
 
 public:
-	static int BufCharWidth(Ch ch, int64_t indent, int tabDist) noexcept;
+	/*
+	** Return the length in displayed characters of character "ch" expanded
+	** for display
+	*/
+	static int BufCharWidth(Ch ch, int64_t indent, int tabDist) noexcept {
+		if (ch == Ch('\t')) {
+			return tabDist - static_cast<int>(indent % tabDist);
+		}
+
+		return CharWidthTable[static_cast<uint8_t>(ch)];
+	}
+
 	static int BufExpandCharacter(Ch ch, int64_t indent, Ch outStr[MAX_EXP_CHAR_LEN], int tabDist) noexcept;
 	static int BufExpandTab(int64_t indent, Ch outStr[MAX_EXP_CHAR_LEN], int tabDist) noexcept;
 
@@ -117,6 +142,8 @@ public:
 	boost::optional<TextCursor> searchForward(TextCursor startPos, view_type searchChars) const noexcept;
 	Ch BufGetCharacter(TextCursor pos) const noexcept;
 	int64_t BufCountDispChars(TextCursor lineStartPos, TextCursor targetPos) const noexcept;
+	int64_t BufBatchIndex() const noexcept;
+	int64_t BufBatchSize() const noexcept;
 	int64_t BufCountLines(TextCursor startPos, TextCursor endPos) const noexcept;
 	int64_t length() const noexcept;
 	int compare(TextCursor pos, Ch ch) const noexcept;
@@ -138,6 +165,7 @@ public:
 	TextCursor BufStartOfLine(TextCursor pos) const noexcept;
 	TextCursor BufEndOfBuffer() const noexcept;
 	constexpr TextCursor BufStartOfBuffer() const noexcept { return {}; }
+	std::pair<view_type, view_type> BufAsViews() const noexcept;
 	view_type BufAsString() noexcept;
 	void BufAddHighPriorityModifyCB(modify_callback_type bufModifiedCB, void *user);
 	void BufAddModifyCB(modify_callback_type bufModifiedCB, void *user);
@@ -164,6 +192,7 @@ public:
 	void BufReplace(TextCursor start, TextCursor end, view_type text) noexcept;
 	void BufReplace(TextRange range, view_type text) noexcept;
 	void BufReplace(TextRange range, Ch ch) noexcept;
+	void BufReplaceRanges(const std::vector<Edit> &edits) noexcept;
 	void BufReplaceRect(TextCursor start, TextCursor end, int64_t rectStart, int64_t rectEnd, view_type text);
 	void BufReplaceSecSelect(view_type text) noexcept;
 	void BufReplaceSelected(view_type text) noexcept;
@@ -212,6 +241,8 @@ private:
 	static int64_t countLines(view_type string) noexcept;
 	static void overlayRectInLine(view_type line, view_type insLine, int64_t rectStart, int64_t rectEnd, int tabDist, bool useTabs, string_type *outStr, int64_t *endOffset) noexcept;
 	static int writeControl(Ch out[MAX_EXP_CHAR_LEN], const char *ctrl_char) noexcept;
+	static size_t plainRunLength(const Ch *first, const Ch *last) noexcept;
+	static int64_t countDispChars(view_type text, int64_t indent, int tabDist) noexcept;
 
 private:
 	template <class Out>
@@ -225,6 +256,8 @@ private:
 	int tabDist_              = DefaultTabWidth; // equiv. number of characters in a tab
 	bool useTabs_             = true;            // true if buffer routines are allowed to use tabs for padding in rectangular operations
 	bool syncXSelection_      = true;
+	int64_t batchIndex_       = -1;              // which edit of a BufReplaceRanges batch is being reported to the modify callbacks, or -1 if none is
+	int64_t batchSize_        = 0;               // the number of edits in that batch
 
 private:
 	gap_buffer<Ch> buffer_;
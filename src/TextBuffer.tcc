@@ -25,6 +25,16 @@ auto BasicTextBuffer<Ch, Tr>::BufAsString() noexcept -> view_type {
 	return buffer_.to_view();
 }
 
+/*
+** Get the entire contents of a text buffer as two read-only views, the text
+** before and after the gap, which unlike BufAsString neither copies nor moves
+** any of it
+*/
+template <class Ch, class Tr>
+auto BasicTextBuffer<Ch, Tr>::BufAsViews() const noexcept -> std::pair<view_type, view_type> {
+	return buffer_.to_views(0, buffer_.size());
+}
+
 /*
 ** Replace the entire contents of the text buffer
 */
@@ -176,6 +186,54 @@ void BasicTextBuffer<Ch, Tr>::BufReplace(TextCursor start, TextCursor end, Ch ch
 	callModifyCBs(start, end - start, nInserted, 0, deletedText);
 }
 
+/*
+** Replace the ranges of "edits" with their text, as a single batch. The
+** ranges are where the text is before any of the edits are made, and must be
+** in order and must not overlap. The modify callbacks are called for each
+** edit which changes something, so that listeners only see the parts of the
+** buffer which change, and can use BufBatchIndex and BufBatchSize to tell
+** which edits belong together.
+*/
+template <class Ch, class Tr>
+void BasicTextBuffer<Ch, Tr>::BufReplaceRanges(const std::vector<Edit> &edits) noexcept {
+
+	auto changes = [](const Edit &edit) {
+		return edit.range.start != edit.range.end || !edit.text.empty();
+	};
+
+	batchSize_  = std::count_if(edits.begin(), edits.end(), changes);
+	batchIndex_ = 0;
+
+	// how far the edits made so far have moved the rest of the text
+	int64_t offset = 0;
+
+	for (const Edit &edit : edits) {
+		if (!changes(edit)) {
+			continue;
+		}
+
+		TextCursor start = edit.range.start + offset;
+		TextCursor end   = edit.range.end + offset;
+		sanitizeRange(start, end);
+
+		const auto nInserted = static_cast<int64_t>(edit.text.size());
+
+		callPreDeleteCBs(start, end - start);
+		const string_type deletedText = BufGetRange(start, end);
+
+		deleteRange(start, end);
+		insert(start, edit.text);
+		cursorPosHint_ = start + nInserted;
+		offset += nInserted - (end - start);
+
+		callModifyCBs(start, end - start, nInserted, 0, deletedText);
+		++batchIndex_;
+	}
+
+	batchIndex_ = -1;
+	batchSize_  = 0;
+}
+
 template <class Ch, class Tr>
 void BasicTextBuffer<Ch, Tr>::BufRemove(TextCursor start, TextCursor end) noexcept {
 
@@ -833,27 +891,68 @@ int BasicTextBuffer<Ch, Tr>::BufExpandCharacter(Ch ch, int64_t indent, Ch outStr
 }
 
 /*
-** Return the length in displayed characters of character "ch" expanded
-** for display
+** Return the number of characters from "first" which are displayed as
+** themselves, one column each, stopping at the first tab, newline or other
+** control character. Text is mostly made of such runs, so they are skipped
+** a machine word at a time rather than measured character by character
 */
 template <class Ch, class Tr>
-int BasicTextBuffer<Ch, Tr>::BufCharWidth(Ch ch, int64_t indent, int tabDist) noexcept {
+size_t BasicTextBuffer<Ch, Tr>::plainRunLength(const Ch *first, const Ch *last) noexcept {
 
-	if (ch == Ch('\t')) {
-		return tabDist - (indent % tabDist);
+	static_assert(sizeof(Ch) == 1, "plainRunLength expects single byte characters");
+
+	constexpr uint64_t Ones  = 0x0101010101010101;
+	constexpr uint64_t Highs = 0x8080808080808080;
+
+	const Ch *p = first;
+
+	while (last - p >= 8) {
+		uint64_t word;
+		std::memcpy(&word, p, sizeof(word));
+
+		// does any byte of the word hold a value below 32, or 127?
+		const uint64_t del       = word ^ (Ones * 127);
+		const uint64_t belowCtrl = (word - Ones * 32) & ~word & Highs;
+		const uint64_t isDel     = (del - Ones) & ~del & Highs;
+		if ((belowCtrl | isDel) != 0) {
+			break;
+		}
+
+		p += 8;
 	}
 
-#if defined(VISUAL_CTRL_CHARS)
-	if (static_cast<size_t>(ch) < 32) {
-		const char *s = ControlCodeTable[static_cast<size_t>(ch)];
-		return static_cast<int>(strlen(s) + 2);
+	while (p != last) {
+		const auto ch = static_cast<uint8_t>(*p);
+		if (ch < 32 || ch == 127) {
+			break;
+		}
+		++p;
 	}
 
-	if (ch == 127) {
-		return 5; // strlen("<del>")
+	return static_cast<size_t>(p - first);
+}
+
+/*
+** Count the displayed characters of "text" for a line in which it starts at
+** column "indent", returning the column following it.
+*/
+template <class Ch, class Tr>
+int64_t BasicTextBuffer<Ch, Tr>::countDispChars(view_type text, int64_t indent, int tabDist) noexcept {
+
+	const Ch *p          = text.data();
+	const Ch *const last = p + text.size();
+
+	while (p != last) {
+		const size_t run = plainRunLength(p, last);
+		indent += static_cast<int64_t>(run);
+		p += run;
+
+		if (p != last) {
+			indent += BufCharWidth(*p++, indent, tabDist);
+		}
 	}
-#endif
-	return 1;
+
+	return indent;
 }
 
 /*
@@ -865,16 +964,17 @@ int BasicTextBuffer<Ch, Tr>::BufCharWidth(Ch ch, int64_t indent, int tabDist) no
 template <class Ch, class Tr>
 int64_t BasicTextBuffer<Ch, Tr>::BufCountDispChars(TextCursor lineStartPos, TextCursor targetPos) const noexcept {
 
-	int64_t charCount = 0;
-	Ch expandedChar[MAX_EXP_CHAR_LEN];
+	const int64_t start = to_integer(lineStartPos);
+	const int64_t end   = std::min<int64_t>(to_integer(targetPos), buffer_.size());
 
-	TextCursor pos = lineStartPos;
-	while (pos < targetPos && pos < BufEndOfBuffer()) {
-		charCount += BufGetExpandedChar(pos, charCount, expandedChar);
-		++pos;
+	if (start >= end) {
+		return 0;
 	}
 
-	return charCount;
+	const std::pair<view_type, view_type> text = buffer_.to_views(start, end);
+
+	const int64_t charCount = countDispChars(text.first, 0, tabDist_);
+	return countDispChars(text.second, charCount, tabDist_);
 }
 
 /*
@@ -885,19 +985,43 @@ int64_t BasicTextBuffer<Ch, Tr>::BufCountDispChars(TextCursor lineStartPos, Text
 template <class Ch, class Tr>
 TextCursor BasicTextBuffer<Ch, Tr>::BufCountForwardDispChars(TextCursor lineStartPos, int64_t nChars) const noexcept {
 
+	const int64_t start = to_integer(lineStartPos);
+	const int64_t end   = buffer_.size();
+
+	if (start >= end) {
+		return lineStartPos;
+	}
+
 	int64_t charCount = 0;
+	TextCursor pos    = lineStartPos;
 
-	TextCursor pos = lineStartPos;
-	TextCursor end = BufEndOfBuffer();
+	const std::pair<view_type, view_type> text = buffer_.to_views(start, end);
 
-	while (charCount < nChars && pos < end) {
-		const Ch ch = BufGetCharacter(pos);
-		if (ch == Ch('\n')) {
-			return pos;
-		}
+	for (view_type part : {text.first, text.second}) {
 
-		charCount += BufCharWidth(ch, charCount, tabDist_);
-		++pos;
+		const Ch *p          = part.data();
+		const Ch *const last = p + part.size();
+
+		while (charCount < nChars && p != last) {
+
+			// plain characters are one column each, so the run can't overshoot
+			const Ch *const limit = p + std::min<int64_t>(last - p, nChars - charCount);
+			const size_t run      = plainRunLength(p, limit);
+			charCount += static_cast<int64_t>(run);
+			pos += static_cast<int64_t>(run);
+			p += run;
+
+			if (p == limit) {
+				continue;
+			}
+
+			if (*p == Ch('\n')) {
+				return pos;
+			}
+
+			charCount += BufCharWidth(*p++, charCount, tabDist_);
+			++pos;
+		}
 	}
 
 	return pos;
@@ -2065,6 +2189,24 @@ TextCursor BasicTextBuffer<Ch, Tr>::BufCursorPosHint() const noexcept {
 	return cursorPosHint_;
 }
 
+/*
+** While BufReplaceRanges is calling the modify callbacks, the index of the
+** edit they are being called for, otherwise -1
+*/
+template <class Ch, class Tr>
+int64_t BasicTextBuffer<Ch, Tr>::BufBatchIndex() const noexcept {
+	return batchIndex_;
+}
+
+/*
+** While BufReplaceRanges is calling the modify callbacks, the number of edits
+** they will be called for, otherwise 0
+*/
+template <class Ch, class Tr>
+int64_t BasicTextBuffer<Ch, Tr>::BufBatchSize() const noexcept {
+	return batchSize_;
+}
+
 template <class Ch, class Tr>
 void BasicTextBuffer<Ch, Tr>::BufSetUseTabs(bool useTabs) noexcept {
 	useTabs_ = useTabs;
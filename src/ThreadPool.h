@@ -0,0 +1,40 @@
+
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <QRunnable>
+#include <QThreadPool>
+
+#include <type_traits>
+#include <utility>
+
+namespace detail {
+
+template <class Function>
+class FunctionRunnable : public QRunnable {
+public:
+	explicit FunctionRunnable(Function function)
+		: function_(std::move(function)) {
+	}
+
+	void run() override {
+		function_();
+	}
+
+private:
+	Function function_;
+};
+
+}
+
+/*
+** Run "function" on one of the threads of "pool". QThreadPool only accepts
+** functions itself from Qt 5.15 on.
+*/
+template <class Function>
+void StartInPool(QThreadPool *pool, Function &&function) {
+	using Runnable = detail::FunctionRunnable<typename std::decay<Function>::type>;
+	pool->start(new Runnable(std::forward<Function>(function)));
+}
+
+#endif
@@ -1,6 +1,105 @@
 
 #include "UndoInfo.h"
 
+#include <limits>
+
 UndoInfo::UndoInfo(UndoTypes undoType, TextCursor start, TextCursor end)
 	: type(undoType), startPos(start), endPos(end) {
 }
+
+/**
+ * @brief UndoInfo::compress
+ * @return true if oldText was large enough to be worth compressing, and was
+ * compressed
+ */
+bool UndoInfo::compress() {
+
+	joinText();
+
+	if (!compressedText.isEmpty() || oldText.size() < UNDO_COMPRESS_MIN || oldText.size() > static_cast<size_t>(std::numeric_limits<int>::max())) {
+		return false;
+	}
+
+	// favor speed, the text may be the whole of a large file
+	QByteArray compressed = qCompress(reinterpret_cast<const uchar *>(oldText.data()), static_cast<int>(oldText.size()), 1);
+	if (static_cast<size_t>(compressed.size()) >= oldText.size()) {
+		return false;
+	}
+
+	compressedText = std::move(compressed);
+	std::string().swap(oldText);
+	return true;
+}
+
+/**
+ * @brief UndoInfo::memoryUsage
+ * @return the number of bytes used by the record and the text it saves
+ */
+int64_t UndoInfo::memoryUsage() const {
+
+	auto usage = static_cast<int64_t>(sizeof(UndoInfo) + oldText.size() + prependedText.size()) + compressedText.size();
+
+	for (const UndoEdit &edit : edits) {
+		usage += static_cast<int64_t>(sizeof(UndoEdit) + edit.oldText.size());
+	}
+
+	return usage;
+}
+
+/**
+ * @brief UndoInfo::uncompressedText
+ * @return oldText, as it was before it was compressed
+ */
+std::string UndoInfo::uncompressedText() const {
+
+	if (compressedText.isEmpty()) {
+		return oldText;
+	}
+
+	return qUncompress(compressedText).toStdString();
+}
+
+/**
+ * @brief UndoInfo::addDeletedText
+ * @param deletedText
+ * @param direction
+ *
+ * Add text deleted after the saved text (Forward) or in front of it
+ * (Backward), as a run of deletions carries on. A compressed record is
+ * uncompressed first, as it can become the most recent one again once the
+ * records after it are undone, and uncompressedText() knows nothing of text
+ * added after it was compressed.
+ */
+void UndoInfo::addDeletedText(view::string_view deletedText, Direction direction) {
+
+	if (!compressedText.isEmpty()) {
+		oldText = uncompressedText();
+		QByteArray().swap(compressedText);
+	}
+
+	if (direction == Direction::Forward) {
+		oldText.append(deletedText.begin(), deletedText.end());
+	} else {
+		prependedText.append(deletedText.rbegin(), deletedText.rend());
+	}
+}
+
+/**
+ * @brief UndoInfo::joinText
+ *
+ * Put the text in prependedText in front of oldText, where it belongs
+ */
+void UndoInfo::joinText() {
+
+	if (prependedText.empty()) {
+		return;
+	}
+
+	std::string text;
+	text.reserve(prependedText.size() + oldText.size());
+	text.append(prependedText.rbegin(), prependedText.rend());
+	text.append(oldText);
+
+	oldText = std::move(text);
+	std::string().swap(prependedText);
+}
@@ -2,8 +2,12 @@
 #ifndef UNDO_INFO_H_
 #define UNDO_INFO_H_
 
+#include "Direction.h"
 #include "TextCursor.h"
+#include "Util/string_view.h"
+#include <QByteArray>
 #include <string>
+#include <vector>
 
 /* The accumulated list of undo operations can potentially consume huge
    amounts of memory.  These tuning parameters determine how much undo
@@ -14,6 +18,11 @@
 constexpr auto UNDO_OP_LIMIT  = 400u;
 constexpr auto UNDO_OP_TRIMTO = 200u;
 
+/* The memory used by the undo list is also limited, by the undoMemoryLimit
+   and totalUndoMemoryLimit preferences. Text smaller than this isn't worth
+   compressing to stay within them. */
+constexpr auto UNDO_COMPRESS_MIN = 64 * 1024;
+
 enum UndoTypes {
 	UNDO_NOOP,
 	ONE_CHAR_INSERT,
@@ -21,7 +30,15 @@ enum UndoTypes {
 	ONE_CHAR_DELETE,
 	BLOCK_INSERT,
 	BLOCK_REPLACE,
-	BLOCK_DELETE
+	BLOCK_DELETE,
+	BATCH_REPLACE
+};
+
+/* One of the edits of a BATCH_REPLACE record */
+struct UndoEdit {
+	TextCursor startPos;
+	TextCursor endPos;
+	std::string oldText;
 };
 
 /* Record on undo list */
@@ -34,13 +51,23 @@ public:
 	UndoInfo &operator=(UndoInfo &&)      = default;
 	~UndoInfo()                           = default;
 
+public:
+	bool compress();
+	int64_t memoryUsage() const;
+	std::string uncompressedText() const;
+	void addDeletedText(view::string_view deletedText, Direction direction);
+	void joinText();
+
 public:
 	std::string oldText;
+	std::string prependedText;   // text deleted in front of oldText, in reverse order, so that adding to it doesn't copy oldText. joinText() puts it in place
+	QByteArray compressedText;   // oldText, compressed by compress(), in which case oldText is empty
 	UndoTypes type;
 	TextCursor startPos;
 	TextCursor endPos;
-	bool inUndo          = false; // flag to indicate undo command on this record in progress. Redirects SaveUndoInfo to save the next modifications on the redo list instead of the undo list.
-	bool restoresToSaved = false; // flag to indicate undoing this operation will restore file to last saved (unmodified) state
+	uint64_t generation = 0;     // identifies the record, see DocumentInfo::savedGeneration
+	bool inUndo         = false; // flag to indicate undo command on this record in progress. Redirects SaveUndoInfo to save the next modifications on the redo list instead of the undo list.
+	std::vector<UndoEdit> edits; // for BATCH_REPLACE, the edits in the order they were made, instead of oldText. startPos and endPos span all of them
 };
 
 #endif
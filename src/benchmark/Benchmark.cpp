@@ -0,0 +1,423 @@
+
+#include "DocumentWidget.h"
+#include "MainWindow.h"
+#include "Preferences.h"
+#include "RangesetTable.h"
+#include "Search.h"
+#include "TextArea.h"
+#include "TextBuffer.h"
+#include "Util/FileSystem.h"
+#include "WrapStyle.h"
+#include "interpret.h"
+#include "macro.h"
+#include "nedit.h"
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+/* Measures how long the text area takes to draw itself for scripted
+ * sequences of scrolling, paging, resizing and typing, and how many
+ * allocations it makes doing so. It runs on Qt's offscreen platform, with
+ * an empty settings directory, so that results don't depend on the display
+ * or on the user's preferences. It also measures the throughput of Replace
+ * All on the same text.
+ *
+ * Usage: nedit-ng-benchmark [-frames n] [-lines n] [file...]
+ *
+ * Without files, a generated C document of "-lines" lines is used.
+ */
+
+bool IsServer = false;
+
+namespace {
+
+std::atomic<uint64_t> AllocationCount{0};
+
+constexpr const char cmdLineHelp[] = "Usage: nedit-ng-benchmark [-frames n] [-lines n] [file...]\n";
+
+struct Scenario {
+	const char *name;
+	bool highlight;
+	WrapStyle wrap;
+	int rangesets;
+};
+
+struct Replacement {
+	const char *search;
+	const char *replace;
+	SearchType type;
+};
+
+const Replacement Replacements[] = {
+	{"value", "amount", SearchType::CaseSense},
+	{"NAME", "label", SearchType::Literal},
+	{"return", "yield", SearchType::CaseSenseWord},
+	{"[0-9]+", "<&>", SearchType::Regex},
+	{"(\\w+)\\((\\w+)", "\\2(\\1", SearchType::Regex},
+	{"^\\t+", "  ", SearchType::Regex},
+};
+
+const Scenario Scenarios[] = {
+	{"plain", false, WrapStyle::None, 0},
+	{"highlighted", true, WrapStyle::None, 0},
+	{"wrapped", false, WrapStyle::Continuous, 0},
+	{"highlighted+wrapped", true, WrapStyle::Continuous, 0},
+	{"highlighted+rangesets", true, WrapStyle::None, 3},
+};
+
+/**
+ * @brief generateDocument
+ * @param lines
+ * @return C source code with a mix of comments, strings, indentation and
+ * the occasional long line, so that all of the drawing paths are used
+ */
+std::string generateDocument(int lines) {
+
+	std::string text;
+
+	for (int i = 0; i < lines; ++i) {
+		switch (i % 8) {
+		case 0:
+			text += "/* function number " + std::to_string(i) + " does nothing useful */\n";
+			break;
+		case 1:
+			text += "int function_" + std::to_string(i) + "(int value, const char *name) {\n";
+			break;
+		case 2:
+			text += "\tif (value > " + std::to_string(i) + " && name != NULL) {\n";
+			break;
+		case 3:
+			text += "\t\tprintf(\"%s: %d\\n\", name, value); // report it\n";
+			break;
+		case 4:
+			text += "\t\treturn value * " + std::to_string(i % 97) + ";\n";
+			break;
+		case 5:
+			text += "\t}\n";
+			break;
+		case 6:
+			if (i % 64 == 6) {
+				text += "\tstatic const char table[] = \"" + std::string(static_cast<size_t>(300 + i % 200), 'x') + "\";\n";
+			} else {
+				text += "\treturn 0;\n";
+			}
+			break;
+		default:
+			text += "}\n";
+			break;
+		}
+	}
+
+	return text;
+}
+
+/**
+ * @brief addRangesets
+ * @param document
+ * @param count
+ *
+ * Creates "count" colored range sets, each marking a different pattern of
+ * lines of the document
+ */
+void addRangesets(DocumentWidget *document, int count) {
+
+	static const char *const colors[] = {"light blue", "pale green", "wheat"};
+
+	document->rangesetTable_ = std::make_unique<RangesetTable>(document->buffer());
+
+	TextBuffer *buffer = document->buffer();
+
+	for (int n = 0; n < count; ++n) {
+		const int label    = document->rangesetTable_->RangesetCreate();
+		Rangeset *rangeset = document->rangesetTable_->RangesetFetch(label);
+		rangeset->setColor(buffer, QString::fromLatin1(colors[n % 3]));
+
+		int64_t line   = 0;
+		TextCursor pos = buffer->BufStartOfBuffer();
+		while (pos < buffer->BufEndOfBuffer()) {
+			const TextCursor lineEnd = buffer->BufEndOfLine(pos);
+			if (line % (n + 3) == 0) {
+				rangeset->RangesetAdd(TextRange{pos, lineEnd});
+			}
+
+			pos = lineEnd + 1;
+			++line;
+		}
+	}
+}
+
+/**
+ * @brief measure
+ * @param label
+ * @param area
+ * @param frames
+ * @param action
+ *
+ * Runs "action" for each of "frames" frames, and reports how long it took
+ * to perform the action and repaint the text area, and the number of
+ * allocations made
+ */
+template <class Action>
+void measure(const QString &label, TextArea *area, int frames, Action action) {
+
+	std::vector<double> times;
+	std::vector<uint64_t> allocations;
+	times.reserve(static_cast<size_t>(frames));
+	allocations.reserve(static_cast<size_t>(frames));
+
+	for (int i = 0; i < frames; ++i) {
+		const uint64_t allocationsBefore = AllocationCount;
+
+		QElapsedTimer timer;
+		timer.start();
+
+		action(i);
+		QCoreApplication::processEvents();
+		area->repaint();
+
+		times.push_back(static_cast<double>(timer.nsecsElapsed()) / 1.0e6);
+		allocations.push_back(AllocationCount - allocationsBefore);
+	}
+
+	if (times.empty()) {
+		return;
+	}
+
+	const double total    = std::accumulate(times.begin(), times.end(), 0.0);
+	const uint64_t allocs = std::accumulate(allocations.begin(), allocations.end(), uint64_t{0});
+
+	std::vector<double> sorted = times;
+	std::sort(sorted.begin(), sorted.end());
+
+	printf("%-60s %6d %9.3f %9.3f %9.3f %10.1f\n",
+		   qPrintable(label),
+		   frames,
+		   total / static_cast<double>(times.size()),
+		   sorted[sorted.size() / 2],
+		   sorted.back(),
+		   static_cast<double>(allocs) / static_cast<double>(allocations.size()));
+}
+
+/**
+ * @brief measureReplaceAll
+ * @param name
+ * @param text
+ *
+ * Reports how many replacements each of the Replacements makes in "text",
+ * and how quickly it is searched
+ */
+void measureReplaceAll(const QString &name, const std::string &text) {
+
+	for (const Replacement &replacement : Replacements) {
+		int64_t copyStart;
+		int64_t copyEnd;
+		Search::ReplaceStatistics statistics;
+
+		Search::ReplaceAllInString(
+			text,
+			QString::fromLatin1(replacement.search),
+			QString::fromLatin1(replacement.replace),
+			replacement.type,
+			&copyStart,
+			&copyEnd,
+			QString(),
+			&statistics);
+
+		const double ms = static_cast<double>(statistics.nanoseconds) / 1.0e6;
+
+		printf("%-60s %10lld %9.3f %9.1f\n",
+			   qPrintable(QStringLiteral("%1 [replace %2]").arg(name, QString::fromLatin1(replacement.search))),
+			   static_cast<long long>(statistics.matches),
+			   ms,
+			   ms > 0 ? static_cast<double>(statistics.bytes) / (1024.0 * 1024.0) / (ms / 1000.0) : 0.0);
+	}
+}
+
+/**
+ * @brief runScenario
+ * @param name
+ * @param document
+ * @param text
+ * @param scenario
+ * @param frames
+ */
+void runScenario(const QString &name, DocumentWidget *document, const std::string &text, const Scenario &scenario, int frames) {
+
+	MainWindow *window = MainWindow::fromDocument(document);
+	TextArea *area     = document->firstPane();
+
+	// every scenario starts from the same text, at the same size
+	window->resize(1024, 768);
+	document->buffer()->BufSetAll(text);
+	document->rangesetTable_ = nullptr;
+	document->setAutoWrap(scenario.wrap);
+	document->setHighlightSyntax(scenario.highlight);
+
+	if (scenario.rangesets != 0) {
+		addRangesets(document, scenario.rangesets);
+	}
+
+	area->beginningOfFileAP();
+	QCoreApplication::processEvents();
+	area->repaint();
+
+	const QString label = QStringLiteral("%1 [%2]").arg(name, QString::fromLatin1(scenario.name));
+
+	// scroll down a line at a time, then back up again
+	measure(label + QLatin1String(" scroll"), area, frames, [area, frames](int i) {
+		if (i < frames / 2) {
+			area->scrollDownAP(1);
+		} else {
+			area->scrollUpAP(1);
+		}
+	});
+
+	measure(label + QLatin1String(" page"), area, frames, [area, frames](int i) {
+		if (i < frames / 2) {
+			area->nextPageAP();
+		} else {
+			area->previousPageAP();
+		}
+	});
+
+	measure(label + QLatin1String(" resize"), area, frames, [window](int i) {
+		window->resize(800 + (i % 8) * 40, 600 + (i % 5) * 30);
+	});
+
+	// type a few short lines in to the middle of the display
+	window->resize(1024, 768);
+	area->TextSetCursorPos(document->buffer()->BufCountForwardNLines(document->buffer()->BufStartOfBuffer(), 10));
+
+	measure(label + QLatin1String(" type"), area, frames, [area](int i) {
+		area->insertStringAP((i % 40 == 39) ? QStringLiteral("\n") : QStringLiteral("x"));
+	});
+}
+
+}
+
+/**
+ * counts every allocation made, so that the number made for each frame can
+ * be reported
+ */
+void *operator new(std::size_t size) {
+
+	++AllocationCount;
+
+	if (void *p = std::malloc(size != 0 ? size : 1)) {
+		return p;
+	}
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+	std::free(p);
+}
+
+/**
+ * @brief main
+ * @param argc
+ * @param argv
+ * @return
+ */
+int main(int argc, char *argv[]) {
+
+	// results must not depend on the display, or the user's own settings
+	if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+		qputenv("QT_QPA_PLATFORM", "offscreen");
+	}
+
+	QTemporaryDir settingsDir;
+	if (qEnvironmentVariableIsEmpty("NEDIT_NG_HOME") && settingsDir.isValid()) {
+		qputenv("NEDIT_NG_HOME", settingsDir.path().toLocal8Bit());
+	}
+
+	QApplication app(argc, argv);
+
+	int frames = 200;
+	int lines  = 20000;
+	QStringList files;
+
+	const QStringList args = QApplication::arguments();
+	for (int i = 1; i < args.size(); ++i) {
+		if ((args[i] == QLatin1String("-frames") || args[i] == QLatin1String("-lines")) && i + 1 < args.size()) {
+			bool ok;
+			const int value = args[i + 1].toInt(&ok);
+			if (!ok || value <= 0) {
+				fprintf(stderr, "nedit-ng-benchmark: %s requires a positive number\n%s", qPrintable(args[i]), cmdLineHelp);
+				return EXIT_FAILURE;
+			}
+
+			if (args[i] == QLatin1String("-frames")) {
+				frames = value;
+			} else {
+				lines = value;
+			}
+
+			++i;
+		} else if (args[i].startsWith(QLatin1Char('-'))) {
+			fprintf(stderr, "%s", cmdLineHelp);
+			return EXIT_FAILURE;
+		} else {
+			files.push_back(args[i]);
+		}
+	}
+
+	InitMacroGlobals();
+	RegisterMacroSubroutines();
+	Preferences::RestoreNEditPrefs();
+
+	printf("%-60s %6s %9s %9s %9s %10s\n", "benchmark", "frames", "mean ms", "median ms", "max ms", "allocs");
+
+	std::vector<std::pair<QString, std::string>> texts;
+
+	if (files.empty()) {
+		DocumentWidget *document = MainWindow::editNewFile(nullptr, QString(), false, QStringLiteral("C"));
+		const std::string text   = generateDocument(lines);
+		const QString name       = QStringLiteral("generated %1 lines").arg(lines);
+
+		for (const Scenario &scenario : Scenarios) {
+			runScenario(name, document, text, scenario, frames);
+		}
+
+		texts.emplace_back(name, text);
+	}
+
+	for (const QString &file : files) {
+		const PathInfo fi = parseFilename(file);
+
+		DocumentWidget *document = DocumentWidget::editExistingFile(nullptr, fi.filename, fi.pathname, 0, QString(), false, QString(), false, false);
+		if (!document) {
+			fprintf(stderr, "nedit-ng-benchmark: could not open %s\n", qPrintable(file));
+			continue;
+		}
+
+		const std::string text = document->buffer()->BufGetAll();
+
+		for (const Scenario &scenario : Scenarios) {
+			runScenario(fi.filename, document, text, scenario, frames);
+		}
+
+		texts.emplace_back(fi.filename, text);
+	}
+
+	printf("\n%-60s %10s %9s %9s\n", "benchmark", "matches", "ms", "MiB/s");
+
+	for (const auto &text : texts) {
+		measureReplaceAll(text.first, text.second);
+	}
+
+	CleanupMacroGlobals();
+	return EXIT_SUCCESS;
+}
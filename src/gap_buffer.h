@@ -10,6 +10,7 @@
 #include <cassert>
 #include <memory>
 #include <string>
+#include <utility>
 
 template <class Ch, class Tr>
 class gap_buffer {
@@ -78,6 +79,7 @@ public:
 	string_type to_string(size_type start, size_type end) const;
 	view_type to_view() noexcept;
 	view_type to_view(size_type start, size_type end) noexcept;
+	std::pair<view_type, view_type> to_views(size_type start, size_type end) const noexcept;
 
 public:
 	void append(view_type str);
@@ -279,6 +281,31 @@ auto gap_buffer<Ch, Tr>::to_string(size_type start, size_type end) const -> stri
 	return text;
 }
 
+/**
+ * Returns the text between "start" and "end" as the parts before and after
+ * the gap (the second view is empty if the range is on one side of the gap).
+ * Unlike to_view, this does not move the gap.
+ */
+template <class Ch, class Tr>
+auto gap_buffer<Ch, Tr>::to_views(size_type start, size_type end) const noexcept -> std::pair<view_type, view_type> {
+
+	assert(start <= size() && start >= 0);
+	assert(end <= size() && end >= 0);
+	assert(start <= end);
+
+	const Ch *const text = buf_.get();
+
+	if (end <= gap_start_) {
+		return {view_type(text + start, static_cast<size_t>(end - start)), view_type()};
+	}
+
+	if (start >= gap_start_) {
+		return {view_type(text + start + gap_size(), static_cast<size_t>(end - start)), view_type()};
+	}
+
+	return {view_type(text + start, static_cast<size_t>(gap_start_ - start)), view_type(text + gap_end_, static_cast<size_t>(end - gap_start_))};
+}
+
 /**
  *
  */
@@ -8,9 +8,11 @@
 #include "DocumentWidget.h"
 #include "Highlight.h"
 #include "HighlightPattern.h"
+#include "MacroCache.h"
 #include "MainWindow.h"
 #include "Preferences.h"
 #include "RangesetTable.h"
+#include "RegexError.h"
 #include "Search.h"
 #include "SearchType.h"
 #include "SignalBlocker.h"
@@ -26,7 +28,9 @@
 #include "parse.h"
 
 #include <boost/optional.hpp>
+#include <algorithm>
 #include <fstream>
+#include <limits>
 #include <stack>
 
 #include <QClipboard>
@@ -53,6 +57,7 @@ enum class MacroErrorCode {
 	TooManyArguments,
 	UnknownObject,
 	NotAnInteger,
+	IntegerOutOfRange,
 	NotAString,
 	InvalidContext,
 	NeedsArguments,
@@ -78,6 +83,7 @@ enum class MacroErrorCode {
 	FailedToAddSelection,
 	Param2CannotBeEmptyString,
 	InvalidSearchReplaceArgs,
+	InvalidRegex,
 	InvalidRepeatArg,
 	ReadOnly,
 	WrongNumberOfToggleArguments,
@@ -111,6 +117,8 @@ std::string MacroErrorCategory::message(int ev) const {
 		return "%s called with unknown object";
 	case MacroErrorCode::NotAnInteger:
 		return "%s called with non-integer argument";
+	case MacroErrorCode::IntegerOutOfRange:
+		return "%s called with an integer argument which is out of range";
 	case MacroErrorCode::NotAString:
 		return "%s not called with a string parameter";
 	case MacroErrorCode::InvalidContext:
@@ -161,6 +169,8 @@ std::string MacroErrorCategory::message(int ev) const {
 		return "Second argument must be a non-empty string: %s";
 	case MacroErrorCode::InvalidSearchReplaceArgs:
 		return "%s action requires search and replace string arguments";
+	case MacroErrorCode::InvalidRegex:
+		return "%s called with an invalid regular expression";
 	case MacroErrorCode::InvalidRepeatArg:
 		return "%s requires method/count";
 	case MacroErrorCode::ReadOnly:
@@ -267,6 +277,24 @@ struct is_error_code_enum<MacroErrorCode> : true_type {};
 
 namespace {
 
+/**
+ * @brief isAscii
+ * @param dv
+ * @return true if "dv" is a string containing only ASCII characters, so that
+ * its length and positions in characters are the same as they are in bytes
+ */
+bool isAscii(const DataValue &dv) {
+
+	if (!is_string(dv)) {
+		return false;
+	}
+
+	const view::string_view string = to_string_view(dv);
+	return std::all_of(string.begin(), string.end(), [](char ch) {
+		return static_cast<unsigned char>(ch) < 0x80;
+	});
+}
+
 /**
  * @brief readArgument - Get an integer value from a DataValue structure.
  * @param dv
@@ -304,7 +332,12 @@ std::error_code readArgument(const DataValue &dv, int64_t *result) {
 std::error_code readArgument(const DataValue &dv, int *result) {
 
 	if (is_integer(dv)) {
-		*result = to_integer(dv);
+		const int64_t value = to_integer(dv);
+		if (value < std::numeric_limits<int>::min() || value > std::numeric_limits<int>::max()) {
+			return MacroErrorCode::IntegerOutOfRange;
+		}
+
+		*result = static_cast<int>(value);
 		return MacroErrorCode::Success;
 	}
 
@@ -1588,6 +1621,11 @@ std::error_code lengthMS(DocumentWidget *document, Arguments arguments, DataValu
 
 	Q_UNUSED(document)
 
+	if (arguments.size() == 1 && isAscii(arguments[0])) {
+		*result = make_value(static_cast<int>(to_string_view(arguments[0]).size()));
+		return MacroErrorCode::Success;
+	}
+
 	QString string;
 	if (std::error_code ec = readArguments(arguments, 0, &string)) {
 		return ec;
@@ -1608,13 +1646,13 @@ std::error_code minMS(DocumentWidget *document, Arguments arguments, DataValue *
 		return MacroErrorCode::TooFewArguments;
 	}
 
-	int minVal;
+	int64_t minVal;
 	if (std::error_code ec = readArgument(arguments[0], &minVal)) {
 		return ec;
 	}
 
 	for (const DataValue &dv : arguments) {
-		int value;
+		int64_t value;
 		if (std::error_code ec = readArgument(dv, &value)) {
 			return ec;
 		}
@@ -1634,13 +1672,13 @@ std::error_code maxMS(DocumentWidget *document, Arguments arguments, DataValue *
 		return MacroErrorCode::TooFewArguments;
 	}
 
-	int maxVal;
+	int64_t maxVal;
 	if (std::error_code ec = readArgument(arguments[0], &maxVal)) {
 		return ec;
 	}
 
 	for (const DataValue &dv : arguments) {
-		int value;
+		int64_t value;
 		if (std::error_code ec = readArgument(dv, &value)) {
 			return ec;
 		}
@@ -1751,6 +1789,54 @@ std::error_code getRangeMS(DocumentWidget *document, Arguments arguments, DataVa
 	return MacroErrorCode::Success;
 }
 
+/*
+** Built-in macro subroutine for getting all of the lines of text touched by
+** the range from $1 to $2 in the current window's text buffer at once.
+** Returns an array of the lines, without their newlines, indexed from 0
+*/
+std::error_code getLinesMS(DocumentWidget *document, Arguments arguments, DataValue *result) {
+
+	int64_t from;
+	int64_t to;
+	TextBuffer *buf = document->buffer();
+
+	// Validate arguments and convert to int
+	if (std::error_code ec = readArguments(arguments, 0, &from, &to)) {
+		return ec;
+	}
+
+	from = qBound<int64_t>(0, from, buf->length());
+	to   = qBound<int64_t>(0, to, buf->length());
+
+	if (from > to) {
+		std::swap(from, to);
+	}
+
+	const std::string text = buf->BufGetRange(buf->BufStartOfLine(TextCursor(from)), buf->BufEndOfLine(TextCursor(to)));
+
+	*result = make_value(std::make_shared<Array>());
+
+	int64_t index    = 0;
+	size_t lineStart = 0;
+
+	while (true) {
+		const size_t lineEnd = std::min(text.find('\n', lineStart), text.size());
+
+		DataValue element = make_value(view::string_view(text.data() + lineStart, lineEnd - lineStart));
+		if (!ArrayInsert(result, index++, &element)) {
+			return MacroErrorCode::InsertFailed;
+		}
+
+		if (lineEnd == text.size()) {
+			break;
+		}
+
+		lineStart = lineEnd + 1;
+	}
+
+	return MacroErrorCode::Success;
+}
+
 /*
 ** Built-in macro subroutine for getting a single character at the position
 ** given, from the current window
@@ -1812,6 +1898,114 @@ std::error_code replaceRangeMS(DocumentWidget *document, Arguments arguments, Da
 	return MacroErrorCode::Success;
 }
 
+/*
+** Built-in macro subroutine for making many replacements in the current
+** window's text buffer at once. $1 is an array, indexed from 0, of arrays
+** with the "start" and "end" positions of some text and the "text" to replace
+** it with, such as search_all returns with "text" added. The ranges may not
+** overlap. The replacements are made as a single change to the buffer.
+**
+** Returns the number of replacements made.
+*/
+std::error_code replaceRangesMS(DocumentWidget *document, Arguments arguments, DataValue *result) {
+
+	document = MacroFocusDocument();
+
+	struct Replacement {
+		int64_t start;
+		int64_t end;
+		std::string text;
+	};
+
+	TextBuffer *buf = document->buffer();
+
+	if (arguments.size() != 1) {
+		return MacroErrorCode::WrongNumberOfArguments;
+	}
+
+	if (!is_array(arguments[0])) {
+		return MacroErrorCode::InvalidArgument;
+	}
+
+	DataValue *array = arguments.data();
+	int arraySize    = ArraySize(array);
+
+	std::vector<Replacement> replacements;
+	replacements.reserve(static_cast<size_t>(arraySize));
+
+	for (int i = 0; i < arraySize; i++) {
+
+		DataValue element;
+		if (!ArrayGet(array, i, &element) || !is_array(element)) {
+			return MacroErrorCode::InvalidArrayKey;
+		}
+
+		DataValue start;
+		DataValue end;
+		DataValue text;
+		if (!ArrayGet(&element, "start", &start) || !ArrayGet(&element, "end", &end) || !ArrayGet(&element, "text", &text)) {
+			return MacroErrorCode::InvalidArrayKey;
+		}
+
+		Replacement replacement;
+		if (std::error_code ec = readArgument(start, &replacement.start)) {
+			return ec;
+		}
+
+		if (std::error_code ec = readArgument(end, &replacement.end)) {
+			return ec;
+		}
+
+		if (std::error_code ec = readArgument(text, &replacement.text)) {
+			return ec;
+		}
+
+		replacement.start = qBound<int64_t>(0, replacement.start, buf->length());
+		replacement.end   = qBound<int64_t>(0, replacement.end, buf->length());
+
+		if (replacement.start > replacement.end) {
+			std::swap(replacement.start, replacement.end);
+		}
+
+		replacements.push_back(std::move(replacement));
+	}
+
+	std::stable_sort(replacements.begin(), replacements.end(), [](const Replacement &lhs, const Replacement &rhs) {
+		return lhs.start < rhs.start;
+	});
+
+	for (size_t i = 1; i < replacements.size(); ++i) {
+		if (replacements[i].start < replacements[i - 1].end) {
+			return MacroErrorCode::InvalidArgument;
+		}
+	}
+
+	// Don't allow modifications if the window is read-only
+	if (document->lockReasons().isAnyLocked()) {
+		QApplication::beep();
+		*result = make_value(0);
+		return MacroErrorCode::Success;
+	}
+
+	if (replacements.empty()) {
+		*result = make_value(0);
+		return MacroErrorCode::Success;
+	}
+
+	// replace just the ranges given, as a single change
+	std::vector<TextBuffer::Edit> edits;
+	edits.reserve(replacements.size());
+
+	for (const Replacement &replacement : replacements) {
+		edits.push_back(TextBuffer::Edit{TextRange{TextCursor(replacement.start), TextCursor(replacement.end)}, replacement.text});
+	}
+
+	buf->BufReplaceRanges(edits);
+
+	*result = make_value(static_cast<int64_t>(replacements.size()));
+	return MacroErrorCode::Success;
+}
+
 /*
 ** Built-in macro subroutine for replacing the primary-selection selected
 ** text in the current window's text buffer
@@ -1938,12 +2132,21 @@ std::error_code substringMS(DocumentWidget *document, Arguments arguments, DataV
 	int from;
 	QString string;
 
-	if (std::error_code ec = readArguments(arguments, 0, &string, &from)) {
+	/* Positions are counted in characters, which for ASCII strings are the
+	 * same as bytes, so those can share the text of the original string
+	 * instead of being converted and copied */
+	const bool ascii = isAscii(arguments[0]);
+
+	if (ascii) {
+		if (std::error_code ec = readArgument(arguments[1], &from)) {
+			return ec;
+		}
+	} else if (std::error_code ec = readArguments(arguments, 0, &string, &from)) {
 		return ec;
 	}
 
-	int length = string.size();
-	int to     = string.size();
+	int length = ascii ? static_cast<int>(to_string_view(arguments[0]).size()) : string.size();
+	int to     = length;
 
 	if (arguments.size() == 3) {
 		if (std::error_code ec = readArgument(arguments[2], &to)) {
@@ -1973,6 +2176,11 @@ std::error_code substringMS(DocumentWidget *document, Arguments arguments, DataV
 		to = from;
 	}
 
+	if (ascii) {
+		*result = make_value(to_macro_string(arguments[0]).substr(static_cast<size_t>(from), static_cast<size_t>(to - from)));
+		return MacroErrorCode::Success;
+	}
+
 	// Allocate a new string and copy the sub-string into it
 	*result = make_value(string.mid(from, to - from));
 	return MacroErrorCode::Success;
@@ -2151,7 +2359,8 @@ std::error_code searchStringMS(DocumentWidget *document, Arguments arguments, Da
 	SearchType type;
 	QString searchStr;
 	Direction direction;
-	std::string string;
+	std::string numberString;
+	view::string_view string;
 
 	bool found      = false;
 	bool skipSearch = false;
@@ -2161,7 +2370,16 @@ std::error_code searchStringMS(DocumentWidget *document, Arguments arguments, Da
 		return MacroErrorCode::TooFewArguments;
 	}
 
-	if (std::error_code ec = readArguments(arguments, 0, &string, &searchStr, &beginPos)) {
+	// search the text of string values where it is, rather than a copy of it
+	if (is_string(arguments[0])) {
+		string = to_string_view(arguments[0]);
+	} else if (std::error_code ec = readArgument(arguments[0], &numberString)) {
+		return ec;
+	} else {
+		string = numberString;
+	}
+
+	if (std::error_code ec = readArguments(arguments, 1, &searchStr, &beginPos)) {
 		return ec;
 	}
 
@@ -2169,7 +2387,7 @@ std::error_code searchStringMS(DocumentWidget *document, Arguments arguments, Da
 		return ec;
 	}
 
-	auto len = static_cast<int64_t>(to_string(arguments[0]).size());
+	auto len = static_cast<int64_t>(string.size());
 	if (beginPos > len) {
 		if (direction == Direction::Forward) {
 			if (wrap == WrapMode::Wrap) {
@@ -2251,6 +2469,75 @@ std::error_code searchMS(DocumentWidget *document, Arguments arguments, DataValu
 		result);
 }
 
+/*
+** Built-in macro subroutine for finding all of the occurrences of a search
+** string between two positions in the current window at once, without
+** dialogs, beeps, or changes to the selection. Arguments are $1: string to
+** search for, $2: start position, $3: end position, and optionally the search
+** type: one of "literal", "case", "word", "caseWord", "regex" or "regexNoCase"
+** (default is "literal").
+**
+** Returns an array, indexed from 0, of the matches in order. Each is an array
+** with the "start" and "end" positions of the match. A regular expression
+** which doesn't compile is an error.
+*/
+std::error_code searchAllMS(DocumentWidget *document, Arguments arguments, DataValue *result) {
+
+	QString searchStr;
+	int64_t from;
+	int64_t to;
+	SearchType searchType = SearchType::Literal;
+	TextBuffer *buf       = document->buffer();
+
+	if (arguments.size() < 3 || arguments.size() > 4) {
+		return MacroErrorCode::WrongNumberOfArguments;
+	}
+
+	if (std::error_code ec = readArguments(arguments, 0, &searchStr, &from, &to)) {
+		return ec;
+	}
+
+	if (arguments.size() > 3) {
+		QString typeStr;
+		if (readArgument(arguments[3], &typeStr) || !StringToSearchType(typeStr, &searchType)) {
+			return MacroErrorCode::UnrecognizedArgument;
+		}
+	}
+
+	if (from > to) {
+		std::swap(from, to);
+	}
+
+	std::vector<Search::Result> matches;
+	try {
+		matches = Search::SearchAll(
+			buf->BufAsString(),
+			searchStr,
+			searchType,
+			from,
+			to,
+			document->getWindowDelimiters());
+	} catch (const RegexError &e) {
+		Q_UNUSED(e)
+		return MacroErrorCode::InvalidRegex;
+	}
+
+	*result = make_value(std::make_shared<Array>());
+
+	int64_t index = 0;
+	for (const Search::Result &match : matches) {
+		DataValue element = make_value(std::make_shared<Array>());
+		DataValue start   = make_value(match.start);
+		DataValue end     = make_value(match.end);
+
+		if (!ArrayInsert(&element, "start", &start) || !ArrayInsert(&element, "end", &end) || !ArrayInsert(result, index++, &element)) {
+			return MacroErrorCode::InsertFailed;
+		}
+	}
+
+	return MacroErrorCode::Success;
+}
+
 /*
 ** Built-in macro subroutine for replacing all occurrences of a search string in
 ** a string with a replacement string.  Arguments are $1: string to search in,
@@ -2333,7 +2620,7 @@ std::error_code replaceInStringMS(DocumentWidget *document, Arguments arguments,
 }
 
 std::error_code setCursorPosMS(DocumentWidget *document, Arguments arguments, DataValue *result) {
-	int pos;
+	int64_t pos;
 
 	// Get argument and convert to int
 	if (std::error_code ec = readArguments(arguments, 0, &pos)) {
@@ -2447,6 +2734,45 @@ std::error_code getenvMS(DocumentWidget *document, Arguments arguments, DataValu
 	return MacroErrorCode::Success;
 }
 
+/*
+** Built-in macro subroutine for turning the macro profiler on or off. Turning
+** it on starts a fresh profile, turning it off keeps the one gathered so far
+*/
+std::error_code setMacroProfilingMS(DocumentWidget *document, Arguments arguments, DataValue *result) {
+
+	Q_UNUSED(document)
+
+	if (arguments.size() != 1) {
+		return MacroErrorCode::WrongNumberOfArguments;
+	}
+
+	int enabled;
+	if (std::error_code ec = readArgument(arguments[0], &enabled)) {
+		return ec;
+	}
+
+	SetMacroProfiling(enabled != 0);
+
+	*result = make_value();
+	return MacroErrorCode::Success;
+}
+
+/*
+** Built-in macro subroutine for getting the counts and times gathered by the
+** macro profiler, as a printable table
+*/
+std::error_code macroProfileMS(DocumentWidget *document, Arguments arguments, DataValue *result) {
+
+	Q_UNUSED(document)
+
+	if (!arguments.empty()) {
+		return MacroErrorCode::WrongNumberOfArguments;
+	}
+
+	*result = make_value(MacroProfileReport());
+	return MacroErrorCode::Success;
+}
+
 std::error_code shellCmdMS(DocumentWidget *document, Arguments arguments, DataValue *result) {
 
 	QString cmdString;
@@ -2643,7 +2969,7 @@ std::error_code calltipMS(DocumentWidget *document, Arguments arguments, DataVal
 	bool anchored = false;
 	bool lookup   = true;
 	size_t i;
-	int anchorPos;
+	int64_t anchorPos;
 	auto mode      = Tags::SearchMode::None;
 	auto hAlign    = TipHAlignMode::Left;
 	auto vAlign    = TipVAlignMode::Below;
@@ -2729,7 +3055,7 @@ std::error_code calltipMS(DocumentWidget *document, Arguments arguments, DataVal
 	*result = make_value(document->showTipString(
 		tipText,
 		anchored,
-		anchorPos,
+		TextCursor(anchorPos),
 		lookup,
 		mode,
 		hAlign,
@@ -3108,8 +3434,6 @@ std::error_code splitMS(DocumentWidget *document, Arguments arguments, DataValue
 
 	while (found && beginPos < strLength) {
 
-		auto indexStr = std::to_string(indexNum);
-
 		found = Search::SearchString(
 			sourceStr,
 			splitStr,
@@ -3128,7 +3452,7 @@ std::error_code splitMS(DocumentWidget *document, Arguments arguments, DataValue
 			static_cast<size_t>(elementLen));
 
 		element = make_value(str);
-		if (!ArrayInsert(result, indexStr, &element)) {
+		if (!ArrayInsert(result, indexNum, &element)) {
 			return MacroErrorCode::InsertFailed;
 		}
 
@@ -3148,13 +3472,11 @@ std::error_code splitMS(DocumentWidget *document, Arguments arguments, DataValue
 
 	if (found) {
 
-		auto indexStr = std::to_string(indexNum);
-
 		if (lastEnd == strLength) {
 			// The pattern matched the end of the string. Add an empty chunk.
 			element = make_value(std::string());
 
-			if (!ArrayInsert(result, indexStr, &element)) {
+			if (!ArrayInsert(result, indexNum, &element)) {
 				return MacroErrorCode::InsertFailed;
 			}
 		} else {
@@ -3164,7 +3486,7 @@ std::error_code splitMS(DocumentWidget *document, Arguments arguments, DataValue
 			view::string_view str(&sourceStr[static_cast<size_t>(lastEnd)], static_cast<size_t>(elementLen));
 
 			element = make_value(str);
-			if (!ArrayInsert(result, indexStr, &element)) {
+			if (!ArrayInsert(result, indexNum, &element)) {
 				return MacroErrorCode::InsertFailed;
 			}
 
@@ -3189,10 +3511,8 @@ std::error_code splitMS(DocumentWidget *document, Arguments arguments, DataValue
 			if (found) {
 				++indexNum;
 
-				auto indexStr = std::to_string(indexNum);
-
 				element = make_value();
-				if (!ArrayInsert(result, indexStr, &element)) {
+				if (!ArrayInsert(result, indexNum, &element)) {
 					return MacroErrorCode::InsertFailed;
 				}
 			}
@@ -3592,6 +3912,31 @@ std::error_code displayWidthMV(DocumentWidget *document, Arguments arguments, Da
 	return MacroErrorCode::Success;
 }
 
+std::error_code macroSlicesMV(DocumentWidget *document, Arguments arguments, DataValue *result) {
+
+	Q_UNUSED(document)
+	Q_UNUSED(arguments)
+
+	*result = make_value(CurrentMacroStatistics().slices);
+	return MacroErrorCode::Success;
+}
+
+std::error_code macroInstructionsPerSecondMV(DocumentWidget *document, Arguments arguments, DataValue *result) {
+
+	Q_UNUSED(document)
+	Q_UNUSED(arguments)
+
+	const MacroStatistics statistics = CurrentMacroStatistics();
+
+	int64_t rate = 0;
+	if (statistics.nanoseconds > 0) {
+		rate = static_cast<int64_t>(static_cast<double>(statistics.instructions) * 1.0e9 / static_cast<double>(statistics.nanoseconds));
+	}
+
+	*result = make_value(rate);
+	return MacroErrorCode::Success;
+}
+
 std::error_code activePaneMV(DocumentWidget *document, Arguments arguments, DataValue *result) {
 
 	Q_UNUSED(arguments)
@@ -3698,7 +4043,7 @@ std::error_code rangesetListMV(DocumentWidget *document, Arguments arguments, Da
 
 		element = make_value(rangesetList[i]);
 
-		if (!ArrayInsert(result, std::to_string(nRangesets - i - 1), &element)) {
+		if (!ArrayInsert(result, static_cast<int>(nRangesets - i - 1), &element)) {
 			return MacroErrorCode::InsertFailed;
 		}
 	}
@@ -3764,7 +4109,7 @@ std::error_code rangesetCreateMS(DocumentWidget *document, Arguments arguments,
 
 	for (int i = 0; i < nRangesetsRequired; i++) {
 		DataValue element = make_value(rangesetTable->RangesetCreate());
-		ArrayInsert(result, std::to_string(i), &element);
+		ArrayInsert(result, i, &element);
 	}
 
 	return MacroErrorCode::Success;
@@ -3789,10 +4134,8 @@ std::error_code rangesetDestroyMS(DocumentWidget *document, Arguments arguments,
 
 		for (int i = 0; i < arraySize; i++) {
 
-			auto keyString = std::to_string(i);
-
 			DataValue element;
-			if (!ArrayGet(array, keyString, &element)) {
+			if (!ArrayGet(array, i, &element)) {
 				return MacroErrorCode::InvalidArrayKey;
 			}
 
@@ -3858,7 +4201,7 @@ std::error_code rangesetGetByNameMS(DocumentWidget *document, Arguments argument
 
 				element = make_value(label);
 
-				if (!ArrayInsert(result, std::to_string(insertIndex), &element)) {
+				if (!ArrayInsert(result, insertIndex, &element)) {
 					return MacroErrorCode::InsertFailed;
 				}
 
@@ -5058,10 +5401,12 @@ const SubRoutine MenuMacroSubrNames[] = {
 const SubRoutine MacroSubrs[] = {
 	{"length", lengthMS},
 	{"get_range", getRangeMS},
+	{"get_lines", getLinesMS},
 	{"t_print", tPrintMS},
 	{"dialog", dialogMS},
 	{"string_dialog", stringDialogMS},
 	{"replace_range", replaceRangeMS},
+	{"replace_ranges", replaceRangesMS},
 	{"replace_selection", replaceSelectionMS},
 	{"set_cursor_pos", setCursorPosMS},
 	{"get_character", getCharacterMS},
@@ -5069,6 +5414,7 @@ const SubRoutine MacroSubrs[] = {
 	{"max", maxMS},
 	{"search", searchMS},
 	{"search_string", searchStringMS},
+	{"search_all", searchAllMS},
 	{"substring", substringMS},
 	{"replace_substring", replaceSubstringMS},
 	{"read_file", readFileMS},
@@ -5089,6 +5435,8 @@ const SubRoutine MacroSubrs[] = {
 	{"tolower", tolowerMS},
 	{"list_dialog", listDialogMS},
 	{"getenv", getenvMS},
+	{"set_macro_profiling", setMacroProfilingMS},
+	{"macro_profile", macroProfileMS},
 	{"string_compare", stringCompareMS},
 	{"split", splitMS},
 	{"calltip", calltipMS},
@@ -5166,6 +5514,8 @@ const SubRoutine SpecialVars[] = {
 	{"$backlight_string", backlightStringMV},
 #endif
 	{"$rangeset_list", rangesetListMV},
+	{"$macro_slices", macroSlicesMV},
+	{"$macro_instructions_per_second", macroInstructionsPerSecondMV},
 	{"$VERSION", versionMV}};
 
 }
@@ -5238,6 +5588,22 @@ bool readCheckMacroString(QWidget *dialogParent, const QString &string, Document
 	Input in(&string);
 	std::stack<Program *> progStack;
 
+	/* programs compiled from this string before don't need to be parsed
+	   again, but a string which is only being checked isn't cached, as it
+	   is likely to be edited and checked again before it's ever run */
+	std::unique_ptr<MacroCache> cache;
+	if (runDocument) {
+		cache = std::make_unique<MacroCache>(string);
+	}
+
+	auto compile = [&cache, &in](QString *errMsg, int *stoppedAt) {
+		if (cache) {
+			return cache->compile(in.index(), errMsg, stoppedAt);
+		}
+
+		return compileMacro(in.mid(), errMsg, stoppedAt);
+	};
+
 	while (!in.atEnd()) {
 
 		// skip over white space and comments
@@ -5288,11 +5654,9 @@ bool readCheckMacroString(QWidget *dialogParent, const QString &string, Document
 					QLatin1String("expected '{'"));
 			}
 
-			QString code = in.mid();
-
 			int stoppedAt;
 			QString errMsg;
-			Program *const prog = compileMacro(code, &errMsg, &stoppedAt);
+			Program *const prog = compile(&errMsg, &stoppedAt);
 			if (!prog) {
 				if (errPos) {
 					*errPos = in.index() + stoppedAt;
@@ -5300,12 +5664,14 @@ bool readCheckMacroString(QWidget *dialogParent, const QString &string, Document
 
 				return Preferences::reportError(
 					dialogParent,
-					code,
+					in.mid(),
 					stoppedAt,
 					errIn,
 					errMsg);
 			}
 
+			prog->name = routineName.toStdString();
+
 			if (runDocument) {
 				if (Symbol *const sym = LookupSymbolEx(routineName)) {
 
@@ -5330,10 +5696,9 @@ bool readCheckMacroString(QWidget *dialogParent, const QString &string, Document
 			   definitions in a file which is loaded from another macro file, it
 			   will probably run the code blocks in reverse order! */
 		} else {
-			QString code = in.mid();
 			int stoppedAt;
 			QString errMsg;
-			Program *const prog = compileMacro(code, &errMsg, &stoppedAt);
+			Program *const prog = compile(&errMsg, &stoppedAt);
 			if (!prog) {
 				if (errPos) {
 					*errPos = in.index() + stoppedAt;
@@ -5341,12 +5706,14 @@ bool readCheckMacroString(QWidget *dialogParent, const QString &string, Document
 
 				return Preferences::reportError(
 					dialogParent,
-					code,
+					in.mid(),
 					stoppedAt,
 					errIn,
 					errMsg);
 			}
 
+			prog->name = errIn.toStdString();
+
 			if (runDocument) {
 
 				if (!runDocument->macroCmdData_) {
@@ -5369,6 +5736,10 @@ bool readCheckMacroString(QWidget *dialogParent, const QString &string, Document
 		}
 	}
 
+	if (cache) {
+		cache->save();
+	}
+
 	//  Unroll reversal stack for macros loaded from macros.
 	while (!progStack.empty()) {
 
@@ -0,0 +1,237 @@
+
+#include "DocumentLayout.h"
+#include "FileSearchPattern.h"
+#include "FileWriter.h"
+#include "Rangeset.h"
+#include "TextBuffer.h"
+#include "UndoInfo.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QTemporaryDir>
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct RemoveTest {
+	const char *name;
+	std::vector<TextRange> ranges;
+	TextRange removed;
+	std::vector<TextRange> expected;
+};
+
+struct FindLiteralTest {
+	const char *name;
+	const char *searchString;
+	SearchType type;
+	const char *delimiters;
+	const char *text;
+	size_t pos;
+	size_t expected;
+	size_t guard;
+};
+
+constexpr size_t npos = view::string_view::npos;
+
+std::string readFile(const QString &path) {
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return "<missing>";
+	}
+
+	return file.readAll().toStdString();
+}
+
+bool writeFile(const QString &path, const char *text) {
+	QFile file(path);
+	return file.open(QIODevice::WriteOnly) && file.write(text) == static_cast<qint64>(std::strlen(text)) && file.flush();
+}
+
+/* Save "text" over "path" with a backup of the old version, the way
+ * DocumentWidget::doSave does. If "replace" is false, the file is written in
+ * place, as it is when the new file can't be given the old one's group */
+bool saveWithBackup(const QString &path, const char *text, bool replace) {
+
+	QSaveFile saveFile(path);
+	replace = replace && FileWriter::openReplacement(saveFile, path);
+
+	FileWriter::writeBackup(path, path + QLatin1String(".bck"), replace);
+
+	if (replace) {
+		return saveFile.write(text) == static_cast<qint64>(std::strlen(text)) && saveFile.commit();
+	}
+
+	return writeFile(path, text);
+}
+
+TextRange makeRange(int64_t start, int64_t end) {
+	return {TextCursor(start), TextCursor(end)};
+}
+
+std::ostream &operator<<(std::ostream &os, const std::vector<TextRange> &ranges) {
+	for (const TextRange &range : ranges) {
+		os << '[' << to_integer(range.start) << ", " << to_integer(range.end) << ") ";
+	}
+
+	return os;
+}
+
+}
+
+int main() {
+
+	const RemoveTest removeTests[] = {
+		{"split", {makeRange(10, 30)}, makeRange(15, 20), {makeRange(10, 15), makeRange(20, 30)}},
+		{"exact", {makeRange(10, 30)}, makeRange(10, 30), {}},
+		{"head", {makeRange(10, 30)}, makeRange(5, 15), {makeRange(15, 30)}},
+		{"tail", {makeRange(10, 30)}, makeRange(25, 35), {makeRange(10, 25)}},
+		{"multi-range", {makeRange(0, 5), makeRange(10, 15), makeRange(20, 25), makeRange(30, 35)}, makeRange(3, 32), {makeRange(0, 3), makeRange(32, 35)}},
+		{"multi-range covered", {makeRange(10, 15), makeRange(20, 25)}, makeRange(0, 40), {}},
+		{"touching before", {makeRange(10, 20)}, makeRange(0, 10), {makeRange(10, 20)}},
+		{"touching after", {makeRange(10, 20)}, makeRange(20, 30), {makeRange(10, 20)}},
+		{"touching both", {makeRange(0, 10), makeRange(20, 30)}, makeRange(10, 20), {makeRange(0, 10), makeRange(20, 30)}},
+		{"reversed", {makeRange(10, 30)}, makeRange(20, 15), {makeRange(10, 15), makeRange(20, 30)}},
+		{"empty", {makeRange(10, 30)}, makeRange(15, 15), {makeRange(10, 30)}},
+		{"empty set", {}, makeRange(15, 20), {}},
+	};
+
+	for (const RemoveTest &t : removeTests) {
+		Rangeset rangeset(nullptr, 0);
+		rangeset.ranges_ = t.ranges;
+		rangeset.RangesetRemove(t.removed);
+
+		if (!(rangeset.ranges_ == t.expected)) {
+			std::cerr << "ERROR    : RangesetRemove " << t.name << '\n';
+			std::cerr << "EXPECTED : " << t.expected << '\n';
+			std::cerr << "GOT      : " << rangeset.ranges_ << std::endl;
+			return -1;
+		}
+	}
+
+	const FindLiteralTest findLiteralTests[] = {
+		{"guard first", "qaa", SearchType::CaseSense, "", "aa qaa", 0, 3, 0},
+		{"guard last", "eeq", SearchType::CaseSense, "", "eeeeq", 0, 2, 2},
+		{"guard punctuation", "a%b", SearchType::CaseSense, "", "a %b a%b", 0, 5, 1},
+		{"match at end", "foo", SearchType::CaseSense, "", "xx foo", 0, 3, 0},
+		{"match is the text", "foo", SearchType::CaseSense, "", "foo", 0, 0, 0},
+		{"case sensitive", "Foo", SearchType::CaseSense, "", "foo FOO Foo", 0, 8, 0},
+		{"mixed case guard", "jQz", SearchType::Literal, "", "zz JqZ", 0, 3, 2},
+		{"upper case guard first", "jqz", SearchType::Literal, "", "JQZ jqz", 0, 0, 2},
+		{"lower case guard first", "jqz", SearchType::Literal, "", "jqz JQZ", 1, 4, 2},
+		{"start position", "foo", SearchType::CaseSense, "", "foo foo", 1, 4, 0},
+		{"start past last match", "foo", SearchType::CaseSense, "", "foo foo", 5, npos, 0},
+		{"start past end", "foo", SearchType::CaseSense, "", "foo", 4, npos, 0},
+		{"needle longer than text", "foobar", SearchType::CaseSense, "", "foo", 0, npos, 3},
+		{"empty needle", "", SearchType::CaseSense, "", "foo", 0, npos, 0},
+		{"word is the text", "foo", SearchType::LiteralWord, "", "foo", 0, 0, 0},
+		{"word at start", "foo", SearchType::LiteralWord, "", "foo bar", 0, 0, 0},
+		{"word at end", "foo", SearchType::LiteralWord, "", "a foo", 0, 2, 0},
+		{"word after a longer one", "foo", SearchType::LiteralWord, "", "xfoo foo", 0, 5, 0},
+		{"word before a character", "foo", SearchType::LiteralWord, "", "foox", 0, npos, 0},
+		{"word after a delimiter", "foo", SearchType::CaseSenseWord, ".", "x.foo", 0, 2, 0},
+		{"word of delimiters", ". ", SearchType::LiteralWord, ".", "a. b", 0, 1, 0},
+	};
+
+	for (const FindLiteralTest &t : findLiteralTests) {
+		const FileSearchPattern pattern(t.searchString, t.type, t.delimiters);
+
+		// a word character follows the text, so only the end of the text can delimit a word there
+		const std::string buffer = std::string(t.text) + 'x';
+		const view::string_view text(buffer.data(), buffer.size() - 1);
+
+		if (pattern.guard != t.guard) {
+			std::cerr << "ERROR    : FileSearchPattern guard " << t.name << '\n';
+			std::cerr << "EXPECTED : " << t.guard << '\n';
+			std::cerr << "GOT      : " << pattern.guard << std::endl;
+			return -1;
+		}
+
+		const size_t found = pattern.findLiteral(text, t.pos);
+		if (found != t.expected) {
+			std::cerr << "ERROR    : FileSearchPattern::findLiteral " << t.name << '\n';
+			std::cerr << "EXPECTED : " << static_cast<int64_t>(t.expected) << '\n';
+			std::cerr << "GOT      : " << static_cast<int64_t>(found) << std::endl;
+			return -1;
+		}
+	}
+
+	for (bool replace : {true, false}) {
+		QTemporaryDir dir;
+		const QString path = dir.filePath(QLatin1String("file"));
+		const QString bck  = path + QLatin1String(".bck");
+
+		if (!dir.isValid() || !writeFile(path, "old") || !saveWithBackup(path, "new", replace)) {
+			std::cerr << "ERROR    : couldn't save a file in " << dir.path().toStdString() << std::endl;
+			return -1;
+		}
+
+		if (readFile(path) != "new" || readFile(bck) != "old") {
+			std::cerr << "ERROR    : FileWriter " << (replace ? "replaced" : "rewritten") << '\n';
+			std::cerr << "EXPECTED : new, old\n";
+			std::cerr << "GOT      : " << readFile(path) << ", " << readFile(bck) << std::endl;
+			return -1;
+		}
+	}
+
+	/* a run of deletions whose record was compressed when newer records were
+	 * added, and which carries on once they have been undone */
+	for (Direction direction : {Direction::Forward, Direction::Backward}) {
+		const std::string deleted(UNDO_COMPRESS_MIN, 'a');
+		UndoInfo undo(ONE_CHAR_DELETE, TextCursor(), TextCursor());
+		undo.oldText = deleted;
+
+		if (!undo.compress()) {
+			std::cerr << "ERROR    : UndoInfo::compress didn't compress " << deleted.size() << " bytes" << std::endl;
+			return -1;
+		}
+
+		undo.addDeletedText("b", direction);
+		undo.joinText();
+
+		const std::string expected = (direction == Direction::Forward) ? deleted + 'b' : 'b' + deleted;
+		const std::string restored = undo.uncompressedText();
+		if (restored != expected) {
+			std::cerr << "ERROR    : UndoInfo::addDeletedText " << to_string(direction).data() << " after compress\n";
+			std::cerr << "EXPECTED : " << expected.size() << " bytes\n";
+			std::cerr << "GOT      : " << restored.size() << " bytes" << std::endl;
+			return -1;
+		}
+	}
+
+	/* the wrap results which the panes of a document share only hold until the
+	 * text is modified */
+	{
+		TextBuffer buffer;
+		buffer.BufSetAll("one\ntwo\n");
+
+		DocumentLayout layout(&buffer);
+		const DocumentLayout::WrapGeometry geometry = {0, 640, 8, 8};
+
+		layout.setWrappedLineCount(geometry, 5);
+		layout.setWrapRange(geometry, {TextCursor(), TextCursor(4), 1, 0});
+		if (!layout.wrappedLineCount(geometry) || !layout.wrapRange(geometry)) {
+			std::cerr << "ERROR    : DocumentLayout didn't keep the wrap results" << std::endl;
+			return -1;
+		}
+
+		buffer.BufInsert(TextCursor(4), "new\n");
+
+		if (layout.wrappedLineCount(geometry) || layout.wrapRange(geometry)) {
+			std::cerr << "ERROR    : DocumentLayout kept the wrap results of an earlier modification" << std::endl;
+			return -1;
+		}
+
+		if (!layout.isCurrent(TextCursor(4), 4, 0) || layout.lineCount() != 3 || layout.linesInserted() != 1 || layout.countLinesBefore(TextCursor(8)) != 2) {
+			std::cerr << "ERROR    : DocumentLayout after inserting a line\n";
+			std::cerr << "EXPECTED : 3 lines, 1 inserted, 2 before the last\n";
+			std::cerr << "GOT      : " << layout.lineCount() << " lines, " << layout.linesInserted() << " inserted, " << layout.countLinesBefore(TextCursor(8)) << " before the last" << std::endl;
+			return -1;
+		}
+	}
+
+	std::cout << "SUCCESS\n";
+}